@@ -0,0 +1,53 @@
+// $sort and $group spill to disk past maxMemoryBytes; the results must not change
+
+db = db.getSiblingDB('aggdb');
+var c = db.aggspill;
+c.drop();
+
+var filler = new Array(200).join('x');
+for (var i = 0; i < 5000; i++) {
+    c.insert({_id: i, k: i % 37, v: i % 11, s: filler + (i % 13), d: i / 7});
+}
+
+function agg(pipeline, maxMemoryBytes) {
+    var cmd = {aggregate: c.getName(), pipeline: pipeline};
+    if (maxMemoryBytes)
+        cmd.maxMemoryBytes = maxMemoryBytes;
+    var r = db.runCommand(cmd);
+    assert(r.ok, tojson(r));
+    return r.result;
+}
+
+// a $sort with lots of ties, so the spilled merge also has to be stable
+var sortPipeline = [{$sort: {v: -1, k: 1}}];
+var inMemory = agg(sortPipeline);
+var spilled = agg(sortPipeline, 64 * 1024);
+assert.eq(5000, spilled.length);
+assert.eq(tojson(inMemory), tojson(spilled), 'spilled $sort differs');
+
+// $group with every accumulator; spilled groups come out in _id order
+var groupPipeline = [{$group: {_id: "$k",
+                               n: {$sum: 1},
+                               total: {$sum: "$v"},
+                               avg: {$avg: "$d"},
+                               first: {$first: "$_id"},
+                               last: {$last: "$_id"},
+                               min: {$min: "$s"},
+                               max: {$max: "$v"},
+                               pushed: {$push: "$_id"},
+                               set: {$addToSet: "$v"}}}];
+
+function canonical(groups) {
+    groups.forEach(function(g) { g.set.sort(); });
+    groups.sort(function(l, r) { return l._id - r._id; });
+    return tojson(groups);
+}
+
+inMemory = agg(groupPipeline);
+spilled = agg(groupPipeline, 64 * 1024);
+assert.eq(37, spilled.length);
+assert.eq(canonical(inMemory), canonical(spilled), 'spilled $group differs');
+
+// the budget has to be sensible
+assert(!db.runCommand({aggregate: c.getName(), pipeline: sortPipeline,
+                       maxMemoryBytes: 0}).ok);
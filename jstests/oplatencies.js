@@ -0,0 +1,43 @@
+// serverStatus.opLatencies reports latency percentiles by kind of op, and by namespace when
+// asked; resetOpLatencies zeroes them
+
+t = db.oplatencies;
+t.drop();
+
+admin = db.getSisterDB( "admin" );
+assert.commandWorked( admin.runCommand( { resetOpLatencies : 1 } ) );
+
+for ( i = 0; i < 100; i++ )
+    t.insert( { _id : i , x : i } );
+db.getLastError();
+for ( i = 0; i < 50; i++ )
+    t.findOne( { x : i } );
+t.update( { _id : 1 } , { $set : { y : 1 } } );
+t.find().batchSize( 2 ).toArray();
+db.getLastError();
+
+s = admin.runCommand( { serverStatus : 1 , opLatencies : 2 } ).opLatencies;
+printjson( s );
+
+assert.lte( 50 , s.reads.count , "reads" );
+assert.lte( 101 , s.writes.count , "writes" );
+assert.lt( 0 , s.commands.count , "commands" );
+assert.lt( 0 , s.getmores.count , "getmores" );
+
+["reads", "writes", "commands", "getmores"].forEach( function( k ) {
+    var h = s[k];
+    assert( h.p50 <= h.p95 && h.p95 <= h.p99 && h.p99 <= h.p999 && h.p999 <= h.max , k + " in order" );
+    assert( h.lockWait , k + " lockWait" );
+    assert.eq( h.count , h.lockWait.count , k + " lockWait count" );
+    assert.eq( h.count , h.execution.count , k + " execution count" );
+} );
+
+ns = s.namespaces[ t.getFullName() ];
+assert( ns , "no namespace" );
+assert.lte( 50 , ns.reads.count , "ns reads" );
+assert.lte( 101 , ns.writes.count , "ns writes" );
+
+assert.eq( undefined , db.serverStatus().opLatencies.namespaces , "namespaces only when asked" );
+
+assert.commandWorked( admin.runCommand( { resetOpLatencies : 1 } ) );
+assert.gt( 50 , db.serverStatus().opLatencies.reads.count , "reset" );
@@ -0,0 +1,46 @@
+// a secondary reads in documents and index keys before applying ops, in each replIndexPrefetch
+// mode, and reports the time spent prefetching and applying in serverStatus.repl.apply
+
+var replTest = new ReplSetTest( {name: 'indexPrefetch', nodes: 2} );
+replTest.startSet();
+replTest.initiate();
+
+var master = replTest.getMaster();
+replTest.awaitSecondaryNodes();
+var slave = replTest.liveNodes.slaves[0];
+
+var db = master.getDB("test");
+var slaveDb = slave.getDB("test");
+db.foo.ensureIndex({a:1});
+db.foo.ensureIndex({b:1});
+
+var slaveAdmin = slave.getDB("admin");
+assert.eq("all", slaveAdmin.runCommand({getParameter:1, replIndexPrefetch:1}).replIndexPrefetch);
+assert.commandFailed(slaveAdmin.runCommand({setParameter:1, replIndexPrefetch:"some"}));
+
+var n = 0;
+["none", "_id_only", "all"].forEach(function(mode) {
+    var res = slaveAdmin.runCommand({setParameter:1, replIndexPrefetch:mode});
+    assert.commandWorked(res);
+
+    for (var i = 0; i < 300; i++, n++)
+        db.foo.insert({_id:n, a:n, b:-n});
+    for (var i = 0; i < 300; i += 3) {
+        db.foo.update({_id:n - i}, {$inc:{a:1}});
+        db.foo.remove({_id:n - i - 1});
+    }
+    replTest.awaitReplication();
+
+    assert.eq(db.foo.count(), slaveDb.foo.count(), mode);
+    assert.eq(db.foo.find().sort({a:1}).toArray(), slaveDb.foo.find().sort({a:1}).toArray(), mode);
+    assert.eq(mode, slaveAdmin.runCommand({getParameter:1, replIndexPrefetch:1}).replIndexPrefetch);
+});
+
+var apply = slave.getDB("admin").serverStatus().repl.apply;
+printjson(apply);
+assert.lt(0, apply.batches, "no batches");
+assert.lte(n, apply.ops, "ops");
+assert.eq("all", apply.indexPrefetch);
+assert(apply.prefetchMicros >= 0 && apply.applyMicros > 0, "timings");
+
+replTest.stopSet();
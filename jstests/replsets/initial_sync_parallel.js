@@ -0,0 +1,62 @@
+// initial sync copies many collections at once and builds their indexes afterwards,
+// and replSetGetStatus reports what it copied and how long each phase took
+
+var replTest = new ReplSetTest( {name: 'initialSyncParallel', nodes: 2} );
+var nodes = replTest.startSet();
+replTest.initiate();
+
+var master = replTest.getMaster();
+var big = new Array( 512 ).toString();
+var N = 2000;
+["a", "b"].forEach( function( dbName ) {
+    var db = master.getDB( dbName );
+    for ( var c = 0; c < 4; c++ ) {
+        var coll = db["c" + c];
+        for ( var i = 0; i < N; i++ )
+            coll.insert( { _id : i , x : i % 100 , y : "y" + i , s : big } );
+        coll.ensureIndex( { x : 1 } );
+        coll.ensureIndex( { y : 1 } , { unique : true } );
+    }
+    db.createCollection( "capped" , { capped : true , size : 100000 } );
+    for ( var i = 0; i < 100; i++ )
+        db.capped.insert( { i : i } );
+    assert.eq( null , db.getLastError() );
+} );
+replTest.awaitReplication();
+
+print( "restart 1 with an empty data directory so it initial syncs" );
+replTest.stop( 1 );
+replTest.start( 1 );
+
+assert.soon( function() {
+    var result = nodes[1].getDB( "admin" ).runCommand( { isMaster : 1 } );
+    return result.secondary;
+} , "never became secondary" , 120000 );
+
+["a", "b"].forEach( function( dbName ) {
+    var mdb = master.getDB( dbName );
+    var sdb = nodes[1].getDB( dbName );
+    sdb.getMongo().setSlaveOk();
+    for ( var c = 0; c < 4; c++ ) {
+        assert.eq( N , sdb["c" + c].count() , dbName + ".c" + c );
+        assert.eq( 3 , sdb.system.indexes.find( { ns : dbName + ".c" + c } ).count() , "indexes " + dbName + ".c" + c );
+        assert.eq( 20 , sdb["c" + c].find( { x : 7 } ).hint( { x : 1 } ).itcount() );
+    }
+    assert.eq( mdb.capped.find().toArray() , sdb.capped.find().toArray() , "capped order" );
+} );
+
+var status = nodes[1].getDB( "admin" ).runCommand( { replSetGetStatus : 1 } );
+printjson( status.initialSync );
+assert( status.initialSync , "no initialSync" );
+assert.eq( undefined , status.initialSync.phase , "still under way" );
+assert.eq( 10 , status.initialSync.clone.collections );
+assert.lte( 10 , status.initialSync.clone.ranges );
+assert.eq( 8 * N + 200 , status.initialSync.clone.docs );
+assert.lt( 8 * N * 512 , status.initialSync.clone.bytes );
+// the capped collections have no _id index
+assert.eq( 8 * 3 , status.initialSync.clone.indexes );
+["dropDatabases", "clone", "buildIndexes", "applyOplog", "finish"].forEach( function( p ) {
+    assert( status.initialSync.phaseMillis[p] >= 0 , "phase " + p );
+} );
+
+replTest.stopSet();
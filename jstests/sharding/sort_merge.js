@@ -0,0 +1,59 @@
+// sort_merge.js
+// sorted queries merge shard results in order while later batches are prefetched,
+// and mongos reports how long it waited on each shard
+
+s = new ShardingTest( "sort_merge" , 3 , 0 , 1 )
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.data" , key : { _id : 1 } } );
+
+db = s.getDB( "test" );
+
+N = 6000
+big = new Array( 1024 ).toString()
+for ( i=0; i<N; i++ ){
+    db.data.insert( { _id : i , x : ( i * 7919 ) % N , s : big } )
+}
+db.getLastError();
+
+s.adminCommand( { split : "test.data" , middle : { _id : N / 3 } } )
+s.adminCommand( { split : "test.data" , middle : { _id : 2 * N / 3 } } )
+
+shards = s.config.shards.find().toArray()
+s.adminCommand( { movechunk : "test.data" , find : { _id : N / 3 } , to : shards[1]._id } )
+s.adminCommand( { movechunk : "test.data" , find : { _id : 2 * N / 3 } , to : shards[2]._id } )
+
+function checkSorted( dir , batchSize ) {
+    var c = db.data.find( {} , { x : 1 } ).sort( { x : dir } ).batchSize( batchSize );
+    var last = null;
+    var n = 0;
+    while ( c.hasNext() ) {
+        var o = c.next();
+        if ( last != null )
+            assert( dir > 0 ? last <= o.x : last >= o.x , "out of order at " + n + ": " + last + " " + o.x );
+        last = o.x;
+        n++;
+    }
+    assert.eq( N , n , "count dir: " + dir + " batchSize: " + batchSize );
+}
+
+checkSorted( 1 , 0 )
+checkSorted( -1 , 0 )
+checkSorted( 1 , 50 )
+
+// a cursor left open part way through still cleans up
+c = db.data.find().sort( { x : 1 } ).batchSize( 10 )
+for ( i=0; i<500; i++ )
+    c.next()
+c = null
+gc(); gc();
+
+info = db.runCommand( { cursorInfo : 1 } )
+printjson( info )
+assert( info.shardWaits , "no shardWaits" )
+batches = 0
+for ( host in info.shardWaits )
+    batches += info.shardWaits[host].batches
+assert.lt( 0 , batches , "no batches counted" )
+
+s.stop()
@@ -0,0 +1,48 @@
+// dumprestore11.js
+
+// Tests restoring several collections at once, with several insertion workers per collection,
+// and that their indexes are built once the data is in.
+
+t = new ToolTest( "dumprestore11" );
+
+t.startDB( "foo" );
+db = t.db;
+
+db.dropDatabase();
+
+var big = new Array( 4096 ).toString();
+for ( var c = 0; c < 5; c++ ) {
+    var coll = db.getCollection( "c" + c );
+    for ( var i = 0; i < 5000; i++ ) {
+        coll.insert( { _id : i , x : i % 100 , s : big } );
+    }
+    coll.ensureIndex( { x : 1 } );
+}
+db.getLastError();
+assert.eq( 10 , db.system.indexes.count() , "setup indexes" );
+
+t.runTool( "dump" , "--out" , t.ext );
+
+function check( msg ) {
+    for ( var c = 0; c < 5; c++ ) {
+        var coll = db.getCollection( "c" + c );
+        assert.eq( 5000 , coll.count() , msg + ": count c" + c );
+        assert.eq( 50 , coll.find( { x : 7 } ).hint( { x : 1 } ).itcount() , msg + ": index c" + c );
+    }
+    assert.eq( 10 , db.system.indexes.count() , msg + ": indexes" );
+}
+
+db.dropDatabase();
+t.runTool( "restore" , "--dir" , t.ext , "--numParallelCollections" , "3" );
+check( "parallel collections" );
+
+db.dropDatabase();
+t.runTool( "restore" , "--dir" , t.ext , "--numParallelCollections" , "1" ,
+           "--numInsertionWorkersPerCollection" , "4" );
+check( "insertion workers" );
+
+// restoring over what is there already continues past the duplicate keys
+t.runTool( "restore" , "--dir" , t.ext , "--numInsertionWorkersPerCollection" , "2" );
+check( "duplicates" );
+
+t.stop();
@@ -0,0 +1,54 @@
+// dumprestore12.js
+
+// Tests dumping several collections at once, splitting a collection over several cursors, and
+// compressed dumps.
+
+t = new ToolTest( "dumprestore12" );
+
+t.startDB( "foo" );
+db = t.db;
+
+db.dropDatabase();
+
+var big = new Array( 1024 ).toString();
+for ( var c = 0; c < 4; c++ ) {
+    var coll = db.getCollection( "c" + c );
+    for ( var i = 0; i < 2000; i++ ) {
+        coll.insert( { _id : i , x : i % 10 , s : big } );
+    }
+    coll.ensureIndex( { x : 1 } );
+}
+db.createCollection( "capped" , { capped : true , size : 100000 } );
+for ( var i = 0; i < 100; i++ ) {
+    db.capped.insert( { _id : i } );
+}
+db.getLastError();
+
+function check( msg ) {
+    for ( var c = 0; c < 4; c++ ) {
+        var coll = db.getCollection( "c" + c );
+        assert.eq( 2000 , coll.count() , msg + ": count c" + c );
+        assert.eq( 2000 , coll.distinct( "_id" ).length , msg + ": distinct c" + c );
+        assert.eq( 200 , coll.find( { x : 3 } ).hint( { x : 1 } ).itcount() , msg + ": index c" + c );
+    }
+    var last = -1;
+    db.capped.find().forEach( function( o ) { assert.lt( last , o._id , msg + ": capped order" ); last = o._id; } );
+    assert.eq( 100 , db.capped.count() , msg + ": capped count" );
+}
+
+function dumpAndRestore( msg , args ) {
+    resetDbpath( t.ext );
+    t.runTool.apply( t , [ "dump" , "--out" , t.ext ].concat( args ) );
+    db.dropDatabase();
+    t.runTool( "restore" , "--dir" , t.ext );
+    check( msg );
+}
+
+dumpAndRestore( "parallel collections" , [ "--numParallelCollections" , "3" ] );
+
+// each of the c collections is a little over 2MB
+dumpAndRestore( "split" , [ "--numCursorsPerCollection" , "4" , "--minBytesPerCursor" , "500000" ] );
+
+dumpAndRestore( "compressed" , [ "--compress" , "--numCursorsPerCollection" , "3" , "--minBytesPerCursor" , "500000" ] );
+
+t.stop();
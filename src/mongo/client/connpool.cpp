@@ -22,11 +22,33 @@
 #include "connpool.h"
 #include "syncclusterconnection.h"
 #include "../s/shard.h"
+#include "../util/timer.h"
 
 namespace mongo {
 
     // ------ PoolForHost ------
 
+    static Histogram* newWaitHistogram() {
+        // 100us, 200us, ... 13s and up
+        Histogram::Options opts;
+        opts.numBuckets = 18;
+        opts.bucketSize = 100;
+        opts.exponential = true;
+        return new Histogram( opts );
+    }
+
+    PoolForHost::PoolForHost()
+        : _created(0), _inUse(0), _connecting(0), _gets(0), _queued(0), _timeouts(0), _waitMicros(0),
+          _waits( newWaitHistogram() ) {
+    }
+
+    PoolForHost::PoolForHost( const PoolForHost& other )
+        : _created(0), _inUse(0), _connecting(0), _gets(0), _queued(0), _timeouts(0), _waitMicros(0),
+          _waits( newWaitHistogram() ) {
+        verify( other._pool.size() == 0 );
+        verify( other._created == 0 );
+    }
+
     PoolForHost::~PoolForHost() {
         while ( ! _pool.empty() ) {
             StoredConnection sc = _pool.top();
@@ -83,6 +105,45 @@ namespace mongo {
         }
     }
 
+    void PoolForHost::takeIdle( vector<DBClientBase*>& toCheck ) {
+        while ( ! _pool.empty() ) {
+            toCheck.push_back( _pool.top().conn );
+            _pool.pop();
+            _inUse++;
+        }
+    }
+
+    void PoolForHost::noteWait( long long micros , bool queued ) {
+        _gets++;
+        if ( queued )
+            _queued++;
+        _waitMicros += micros;
+        _waits->insert( micros > 0xffffffffLL ? 0xffffffffU : (uint32_t) micros );
+    }
+
+    void PoolForHost::appendStats( BSONObjBuilder& b ) const {
+        b.append( "available" , numAvailable() );
+        b.appendNumber( "created" , _created );
+        b.append( "inUse" , _inUse );
+        b.append( "connecting" , _connecting );
+        b.appendNumber( "gets" , _gets );
+        b.appendNumber( "queued" , _queued );
+        b.appendNumber( "timeouts" , _timeouts );
+        b.appendNumber( "waitMillis" , _waitMicros / 1000 );
+
+        BSONObjBuilder h( b.subobjStart( "waitMicros" ) );
+        for ( uint32_t i = 0; i < _waits->getBucketsNum(); i++ ) {
+            uint64_t n = _waits->getCount( i );
+            if ( n == 0 )
+                continue;
+            if ( i == _waits->getBucketsNum() - 1 )
+                h.append( "over" , (long long) n );
+            else
+                h.append( BSONObjBuilder::numStr( _waits->getBoundary( i ) ) , (long long) n );
+        }
+        h.done();
+    }
+
     void PoolForHost::getStaleConnections( vector<DBClientBase*>& stale ) {
         time_t now = time(0);
 
@@ -120,6 +181,9 @@ namespace mongo {
     }
 
     unsigned PoolForHost::_maxPerHost = 50;
+    unsigned PoolForHost::_maxOpenPerHost = 0;
+    unsigned PoolForHost::_minOpenPerHost = 0;
+    unsigned PoolForHost::_maxWaitMillis = 10000;
 
     // ------ DBConnectionPool ------
 
@@ -131,11 +195,50 @@ namespace mongo {
           _hooks( new list<DBConnectionHook*>() ) { 
     }
 
+    /**
+     * @return an idle connection, or NULL with room made for the caller to open one.  at the
+     *         limit of open connections, waits for one to come back.
+     */
     DBClientBase* DBConnectionPool::_get(const string& ident , double socketTimeout ) {
         verify( ! inShutdown() );
+        Timer t;
+        bool queued = false;
         scoped_lock L(_mutex);
         PoolForHost& p = _pools[PoolKey(ident,socketTimeout)];
-        return p.get( this , socketTimeout );
+        while ( true ) {
+            DBClientBase* c = p.get( this , socketTimeout );
+            if ( c ) {
+                p.handedOut();
+                p.noteWait( t.micros() , queued );
+                return c;
+            }
+
+            unsigned max = PoolForHost::getMaxOpenPerHost();
+            if ( max == 0 || p.numOpen() < (int) max ) {
+                p.startConnect();
+                p.noteWait( t.micros() , queued );
+                return NULL;
+            }
+
+            queued = true;
+            long long left = (long long) PoolForHost::getMaxWaitMillis() - t.millis();
+            if ( left <= 0 ||
+                 ! _connectionReturned.timed_wait( L.boost() , boost::posix_time::milliseconds( left ) ) ) {
+                // a wakeup can come with the time just gone; one more try before giving up
+                if ( (long long) PoolForHost::getMaxWaitMillis() - t.millis() > 0 )
+                    continue;
+                p.noteTimeout();
+                p.noteWait( t.micros() , queued );
+                uasserted( 16401 , str::stream() << _name << ": timed out after " << t.millis()
+                           << "ms waiting for one of the " << max << " connections to " << ident );
+            }
+        }
+    }
+
+    void DBConnectionPool::_connectFailed( const string& host , double socketTimeout ) {
+        scoped_lock L(_mutex);
+        _pools[PoolKey(host,socketTimeout)].finishConnect();
+        _connectionReturned.notify_all();
     }
 
     DBClientBase* DBConnectionPool::_finishCreate( const string& host , double socketTimeout , DBClientBase* conn ) {
@@ -143,6 +246,8 @@ namespace mongo {
             scoped_lock L(_mutex);
             PoolForHost& p = _pools[PoolKey(host,socketTimeout)];
             p.createdOne( conn );
+            p.finishConnect();
+            p.handedOut();
         }
         
         try {
@@ -150,7 +255,7 @@ namespace mongo {
             onHandedOut( conn );
         }
         catch ( std::exception & ) {
-            delete conn;
+            destroy( host , conn );
             throw;
         }
 
@@ -164,7 +269,7 @@ namespace mongo {
                 onHandedOut( c );
             }
             catch ( std::exception& ) {
-                delete c;
+                destroy( url.toString() , c );
                 throw;
             }
             return c;
@@ -172,42 +277,64 @@ namespace mongo {
 
         string errmsg;
         c = url.connect( errmsg, socketTimeout );
-        uassert( 13328 ,  _name + ": connect failed " + url.toString() + " : " + errmsg , c );
+        if ( ! c ) {
+            _connectFailed( url.toString() , socketTimeout );
+            uasserted( 13328 ,  _name + ": connect failed " + url.toString() + " : " + errmsg );
+        }
 
         return _finishCreate( url.toString() , socketTimeout , c );
     }
 
     DBClientBase* DBConnectionPool::get(const string& host, double socketTimeout) {
+        string errmsg;
+        ConnectionString cs = ConnectionString::parse( host , errmsg );
+        uassert( 13071 , (string)"invalid hostname [" + host + "]" + errmsg , cs.isValid() );
+
         DBClientBase * c = _get( host , socketTimeout );
         if ( c ) {
             try {
                 onHandedOut( c );
             }
             catch ( std::exception& ) {
-                delete c;
+                destroy( host , c );
                 throw;
             }
             return c;
         }
 
-        string errmsg;
-        ConnectionString cs = ConnectionString::parse( host , errmsg );
-        uassert( 13071 , (string)"invalid hostname [" + host + "]" + errmsg , cs.isValid() );
-
         c = cs.connect( errmsg, socketTimeout );
-        if ( ! c )
+        if ( ! c ) {
+            _connectFailed( host , socketTimeout );
             throw SocketException( SocketException::CONNECT_ERROR , host , 11002 , str::stream() << _name << " error: " << errmsg );
+        }
         return _finishCreate( host , socketTimeout , c );
     }
 
     void DBConnectionPool::release(const string& host, DBClientBase *c) {
         if ( c->isFailed() ) {
-            onDestroy( c );
-            delete c;
+            destroy( host , c );
             return;
         }
         scoped_lock L(_mutex);
-        _pools[PoolKey(host,c->getSoTimeout())].done(this,c);
+        PoolForHost& p = _pools[PoolKey(host,c->getSoTimeout())];
+        p.returned();
+        p.done(this,c);
+        _connectionReturned.notify_all();
+    }
+
+    void DBConnectionPool::destroy(const string& host, DBClientBase *c) {
+        double socketTimeout = c->getSoTimeout();
+        try {
+            onDestroy( c );
+        }
+        catch ( std::exception& e ) {
+            LOG(1) << _name << ": error destroying connection to " << host << causedBy( e ) << endl;
+        }
+        delete c;
+
+        scoped_lock L(_mutex);
+        _pools[PoolKey(host,socketTimeout)].returned();
+        _connectionReturned.notify_all();
     }
 
 
@@ -274,8 +401,7 @@ namespace mongo {
                 string s = str::stream() << i->first.ident << "::" << i->first.timeout;
 
                 BSONObjBuilder temp( bb.subobjStart( s ) );
-                temp.append( "available" , i->second.numAvailable() );
-                temp.appendNumber( "created" , i->second.numCreated() );
+                i->second.appendStats( temp );
                 temp.done();
 
                 avail += i->second.numAvailable();
@@ -321,6 +447,13 @@ namespace mongo {
 
         b.append( "totalAvailable" , avail );
         b.appendNumber( "totalCreated" , created );
+
+        BSONObjBuilder limits( b.subobjStart( "limits" ) );
+        limits.append( "maxOpenPerHost" , (int) PoolForHost::getMaxOpenPerHost() );
+        limits.append( "minOpenPerHost" , (int) PoolForHost::getMinOpenPerHost() );
+        limits.append( "maxIdlePerHost" , (int) PoolForHost::getMaxPerHost() );
+        limits.append( "maxWaitMillis" , (int) PoolForHost::getMaxWaitMillis() );
+        limits.done();
     }
 
     bool DBConnectionPool::serverNameCompare::operator()( const string& a , const string& b ) const{
@@ -381,6 +514,103 @@ namespace mongo {
                 // we don't care if there was a socket error
             }
         }
+
+        if ( ! toDelete.empty() ) {
+            scoped_lock lk( _mutex );
+            _connectionReturned.notify_all();
+        }
+
+        _checkIdle();
+        _warm();
+    }
+
+    /**
+     * pings the idle connections so ones to a server that went away are dropped here rather
+     * than failing the request that would have gotten them
+     */
+    void DBConnectionPool::_checkIdle() {
+        vector< pair<string,DBClientBase*> > toCheck;
+        {
+            scoped_lock lk( _mutex );
+            for ( PoolMap::iterator i=_pools.begin(); i!=_pools.end(); ++i ) {
+                vector<DBClientBase*> idle;
+                i->second.takeIdle( idle );
+                for ( size_t j=0; j<idle.size(); j++ )
+                    toCheck.push_back( make_pair( i->first.ident , idle[j] ) );
+            }
+        }
+
+        for ( size_t i=0; i<toCheck.size(); i++ ) {
+            DBClientBase* c = toCheck[i].second;
+            try {
+                bool isMaster;
+                c->isMaster( isMaster );
+            }
+            catch ( std::exception& e ) {
+                LOG(1) << _name << ": dropping idle connection to " << toCheck[i].first << causedBy( e ) << endl;
+            }
+            // release() drops it if that failed
+            release( toCheck[i].first , c );
+        }
+    }
+
+    /** opens connections to each host in use until it has getMinOpenPerHost() */
+    void DBConnectionPool::_warm() {
+        unsigned min = PoolForHost::getMinOpenPerHost();
+        if ( min == 0 )
+            return;
+
+        vector<PoolKey> toOpen;
+        {
+            scoped_lock lk( _mutex );
+            for ( PoolMap::iterator i=_pools.begin(); i!=_pools.end(); ++i ) {
+                PoolForHost& p = i->second;
+                if ( p.numCreated() == 0 )
+                    continue;
+                for ( int n = p.numOpen(); n < (int) min; n++ ) {
+                    p.startConnect();
+                    toOpen.push_back( i->first );
+                }
+            }
+        }
+
+        for ( size_t i=0; i<toOpen.size(); i++ ) {
+            const PoolKey& k = toOpen[i];
+            DBClientBase* c = 0;
+            try {
+                string errmsg;
+                ConnectionString cs = ConnectionString::parse( k.ident , errmsg );
+                c = cs.connect( errmsg , k.timeout );
+                if ( ! c ) {
+                    LOG(1) << _name << ": couldn't warm a connection to " << k.ident << causedBy( errmsg ) << endl;
+                    _connectFailed( k.ident , k.timeout );
+                    continue;
+                }
+            }
+            catch ( std::exception& e ) {
+                LOG(1) << _name << ": couldn't warm a connection to " << k.ident << causedBy( e ) << endl;
+                _connectFailed( k.ident , k.timeout );
+                continue;
+            }
+
+            {
+                scoped_lock lk( _mutex );
+                PoolForHost& p = _pools[k];
+                p.createdOne( c );
+                p.finishConnect();
+                p.handedOut();
+            }
+            try {
+                // not onHandedOut(), nobody has it yet
+                onCreate( c );
+            }
+            catch ( std::exception& e ) {
+                LOG(1) << _name << ": couldn't warm a connection to " << k.ident << causedBy( e ) << endl;
+                destroy( k.ident , c );
+                continue;
+            }
+            release( k.ident , c );
+        }
     }
 
     // ------ ScopedDbConnection ------
@@ -20,6 +20,7 @@
 #include <stack>
 
 #include "mongo/util/background.h"
+#include "mongo/util/histogram.h"
 #include "mongo/client/dbclientinterface.h"
 
 namespace mongo {
@@ -33,22 +34,35 @@ namespace mongo {
      */
     class PoolForHost {
     public:
-        PoolForHost()
-            : _created(0) {}
+        PoolForHost();
 
-        PoolForHost( const PoolForHost& other ) {
-            verify(other._pool.size() == 0);
-            _created = other._created;
-            verify( _created == 0 );
-        }
+        PoolForHost( const PoolForHost& other );
 
         ~PoolForHost();
 
         int numAvailable() const { return (int)_pool.size(); }
 
+        /** connections handed out and not yet returned or destroyed */
+        int numInUse() const { return _inUse; }
+
+        /** idle, in use, and being connected */
+        int numOpen() const { return numAvailable() + _inUse + _connecting; }
+
         void createdOne( DBClientBase * base );
         long long numCreated() const { return _created; }
 
+        // accounting for DBConnectionPool, which holds its mutex
+        void handedOut() { _inUse++; }
+        void returned() { if ( _inUse > 0 ) _inUse--; }
+        void startConnect() { _connecting++; }
+        void finishConnect() { _connecting--; }
+
+        /** a get() that waited micros for a connection or a slot to open one; queued if at the limit */
+        void noteWait( long long micros , bool queued );
+        void noteTimeout() { _timeouts++; }
+
+        void appendStats( BSONObjBuilder& b ) const;
+
         ConnectionString::ConnectionType type() const { verify(_created); return _type; }
 
         /**
@@ -62,8 +76,25 @@ namespace mongo {
         
         void getStaleConnections( vector<DBClientBase*>& stale );
 
+        /** moves the idle connections to toCheck, counting them as in use */
+        void takeIdle( vector<DBClientBase*>& toCheck );
+
+        /** most idle connections kept */
         static void setMaxPerHost( unsigned max ) { _maxPerHost = max; }
         static unsigned getMaxPerHost() { return _maxPerHost; }
+
+        /** most connections open at once, beyond which get() waits for one.  0 for no limit */
+        static void setMaxOpenPerHost( unsigned max ) { _maxOpenPerHost = max; }
+        static unsigned getMaxOpenPerHost() { return _maxOpenPerHost; }
+
+        /** connections opened ahead of need for each host in use */
+        static void setMinOpenPerHost( unsigned min ) { _minOpenPerHost = min; }
+        static unsigned getMinOpenPerHost() { return _minOpenPerHost; }
+
+        /** how long get() waits at the limit before giving up */
+        static void setMaxWaitMillis( unsigned millis ) { _maxWaitMillis = millis; }
+        static unsigned getMaxWaitMillis() { return _maxWaitMillis; }
+
     private:
 
         struct StoredConnection {
@@ -80,7 +111,19 @@ namespace mongo {
         long long _created;
         ConnectionString::ConnectionType _type;
 
+        int _inUse;
+        int _connecting;
+
+        long long _gets;
+        long long _queued;
+        long long _timeouts;
+        long long _waitMicros;
+        shared_ptr<Histogram> _waits; // micros per get()
+
         static unsigned _maxPerHost;
+        static unsigned _maxOpenPerHost;
+        static unsigned _minOpenPerHost;
+        static unsigned _maxWaitMillis;
     };
 
     class DBConnectionHook {
@@ -127,6 +170,9 @@ namespace mongo {
 
         void release(const string& host, DBClientBase *c);
 
+        /** for a connection from get() that isn't coming back: runs the onDestroy hooks and deletes it */
+        void destroy(const string& host, DBClientBase *c);
+
         void addHook( DBConnectionHook * hook ); // we take ownership
         void appendInfo( BSONObjBuilder& b );
 
@@ -144,6 +190,12 @@ namespace mongo {
         DBClientBase* _get( const string& ident , double socketTimeout );
 
         DBClientBase* _finishCreate( const string& ident , double socketTimeout, DBClientBase* conn );
+
+        /** a connect that _get() made room for failed */
+        void _connectFailed( const string& ident , double socketTimeout );
+
+        void _checkIdle();
+        void _warm();
         
         struct PoolKey {
             PoolKey( string i , double t ) : ident( i ) , timeout( t ) {}
@@ -162,6 +214,9 @@ namespace mongo {
         
         PoolMap _pools;
 
+        // signalled when a connection comes back or goes away, for get()s waiting at the limit
+        boost::condition _connectionReturned;
+
         // pointers owned by me, right now they leak on shutdown
         // _hooks itself also leaks because it creates a shutdown race condition
         list<DBConnectionHook*> * _hooks; 
@@ -250,7 +305,8 @@ namespace mongo {
             a bad state.  Destructor will do this too, but it is verbose.
         */
         void kill() {
-            delete _conn;
+            if ( _conn )
+                pool.destroy( _host , _conn );
             _conn = 0;
         }
 
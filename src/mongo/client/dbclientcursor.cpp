@@ -33,15 +33,15 @@ namespace mongo {
         _originalHost = _client->toString();
     }
 
-    int DBClientCursor::nextBatchSize() {
+    int DBClientCursor::nextBatchSize( int nToReturnLeft ) {
 
-        if ( nToReturn == 0 )
+        if ( nToReturnLeft == 0 )
             return batchSize;
 
         if ( batchSize == 0 )
-            return nToReturn;
+            return nToReturnLeft;
 
-        return batchSize < nToReturn ? batchSize : nToReturn;
+        return batchSize < nToReturnLeft ? batchSize : nToReturnLeft;
     }
 
     void DBClientCursor::_assembleInit( Message& toSend ) {
@@ -105,21 +105,109 @@ namespace mongo {
         return ! retry;
     }
 
+    void DBClientCursor::_assembleGetMore( Message& toSend , int nToReturnLeft ) {
+        BufBuilder b;
+        b.appendNum(opts);
+        b.appendStr(ns);
+        b.appendNum(nextBatchSize(nToReturnLeft));
+        b.appendNum(cursorId);
+        toSend.setData(dbGetMore, b.buf(), b.len());
+    }
+
+    static AtomicUInt prefetchesInFlight;
+
+    void DBClientCursor::prefetchMore() {
+        if ( _prefetchConn || _client || _scopedHost.empty() || ! cursorId || tailable() )
+            return;
+
+        int left = nToReturn;
+        if ( haveLimit ) {
+            left -= batch.nReturned;
+            if ( left <= 0 )
+                return;
+        }
+
+        if ( ++prefetchesInFlight > (unsigned) MaxPrefetches ) {
+            prefetchesInFlight--;
+            return;
+        }
+
+        auto_ptr<ScopedDbConnection> conn;
+        try {
+            conn.reset( new ScopedDbConnection( _scopedHost ) );
+            if ( ! conn->get()->lazySupported() ) {
+                conn->done();
+                prefetchesInFlight--;
+                return;
+            }
+            Message toSend;
+            _assembleGetMore( toSend , left );
+            conn->get()->say( toSend );
+        }
+        catch ( DBException& e ) {
+            // more() will ask again the usual way
+            LOG(1) << "couldn't prefetch getMore from " << _scopedHost << causedBy( e ) << endl;
+            prefetchesInFlight--;
+            return;
+        }
+
+        _prefetchConn = conn.release();
+        _prefetchReturned = batch.nReturned;
+    }
+
+    void DBClientCursor::_receivePrefetched() {
+        auto_ptr<ScopedDbConnection> conn( _prefetchConn );
+        _prefetchConn = 0;
+        prefetchesInFlight--;
+
+        if ( haveLimit )
+            nToReturn -= _prefetchReturned;
+
+        auto_ptr<Message> response(new Message());
+        // if this throws the connection isn't returned to the pool, as its reply is unread
+        uassert( 16400 , str::stream() << "couldn't receive prefetched getMore from " << _scopedHost ,
+                 conn->get()->recv( *response ) && ! response->empty() );
+
+        _client = conn->get();
+        this->batch.m = response;
+        try {
+            dataReceived();
+        }
+        catch ( ... ) {
+            _client = 0;
+            conn->done();
+            throw;
+        }
+        _client = 0;
+        conn->done();
+    }
+
+    void DBClientCursor::_cancelPrefetch() {
+        auto_ptr<ScopedDbConnection> conn( _prefetchConn );
+        _prefetchConn = 0;
+        prefetchesInFlight--;
+
+        // the reply has to be read before the connection can go back to the pool
+        Message response;
+        if ( conn->get()->recv( response ) )
+            conn->done();
+    }
+
     void DBClientCursor::requestMore() {
         verify( cursorId && batch.pos == batch.nReturned );
 
+        if ( _prefetchConn ) {
+            _receivePrefetched();
+            return;
+        }
+
         if (haveLimit) {
             nToReturn -= batch.nReturned;
             verify(nToReturn > 0);
         }
-        BufBuilder b;
-        b.appendNum(opts);
-        b.appendStr(ns);
-        b.appendNum(nextBatchSize());
-        b.appendNum(cursorId);
 
         Message toSend;
-        toSend.setData(dbGetMore, b.buf(), b.len());
+        _assembleGetMore( toSend , nToReturn );
         auto_ptr<Message> response(new Message());
 
         if ( _client ) {
@@ -302,6 +390,9 @@ namespace mongo {
 
         DESTRUCTOR_GUARD (
 
+        if ( _prefetchConn )
+            _cancelPrefetch();
+
         if ( cursorId && _ownCursor && ! inShutdown() ) {
             BufBuilder b;
             b.appendNum( (int)0 ); // reserved
@@ -140,7 +140,9 @@ namespace mongo {
             batchSize(bs==1?2:bs),
             cursorId(),
             _ownCursor( true ),
-            wasError( false ) {
+            wasError( false ),
+            _prefetchConn( 0 ),
+            _prefetchReturned( 0 ) {
             _finishConsInit();
         }
 
@@ -151,7 +153,9 @@ namespace mongo {
             haveLimit( _nToReturn > 0 && !(options & QueryOption_CursorTailable)),
             opts( options ),
             cursorId(_cursorId),
-            _ownCursor( true ) {
+            _ownCursor( true ),
+            _prefetchConn( 0 ),
+            _prefetchReturned( 0 ) {
             _finishConsInit();
         }
 
@@ -168,6 +172,20 @@ namespace mongo {
 
         string originalHost() const { return _originalHost; }
 
+        /**
+         * sends the getMore for the batch after this one now, on a pooled connection of its own,
+         * so the reply is on its way while this batch is read.  more() receives it.
+         * does nothing unless the cursor is attach()ed, there will be another batch, and
+         * no more than MaxPrefetches are already in flight.
+         */
+        void prefetchMore();
+
+        /** @return true if a prefetched batch has been asked for and not received yet */
+        bool prefetching() const { return _prefetchConn != 0; }
+
+        /** most getMores prefetched at once, each holding a pooled connection */
+        static const int MaxPrefetches = 1000;
+
         Message* getMessage(){ return batch.m.get(); }
 
         /**
@@ -192,7 +210,8 @@ namespace mongo {
         friend class DBClientBase;
         friend class DBClientConnection;
 
-        int nextBatchSize();
+        int nextBatchSize() { return nextBatchSize( nToReturn ); }
+        int nextBatchSize( int nToReturnLeft );
         void _finishConsInit();
         
         Batch batch;
@@ -214,9 +233,15 @@ namespace mongo {
         string _lazyHost;
         bool wasError;
 
+        // the connection a prefetched getMore went out on, and batch.nReturned when it did
+        ScopedDbConnection* _prefetchConn;
+        int _prefetchReturned;
+
         void dataReceived() { bool retry; string lazyHost; dataReceived( retry, lazyHost ); }
         void dataReceived( bool& retry, string& lazyHost );
         void requestMore();
+        void _receivePrefetched();
+        void _cancelPrefetch();
         void exhaustReceiveMore(); // for exhaust
 
         // Don't call from a virtual function
@@ -228,6 +253,7 @@ namespace mongo {
 
         // init pieces
         void _assembleInit( Message& toSend );
+        void _assembleGetMore( Message& toSend , int nToReturnLeft );
     };
 
     /** iterate over objects in current batch only - will not cause a network call
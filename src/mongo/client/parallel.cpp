@@ -295,15 +295,15 @@ namespace mongo {
 
     // --------  FilteringClientCursor -----------
     FilteringClientCursor::FilteringClientCursor( const BSONObj filter )
-        : _matcher( filter ) , _pcmData( NULL ), _done( true ) {
+        : _matcher( filter ) , _pcmData( NULL ), _done( true ), _prefetch( false ) {
     }
 
     FilteringClientCursor::FilteringClientCursor( auto_ptr<DBClientCursor> cursor , const BSONObj filter )
-        : _matcher( filter ) , _cursor( cursor ) , _pcmData( NULL ), _done( cursor.get() == 0 ) {
+        : _matcher( filter ) , _cursor( cursor ) , _pcmData( NULL ), _done( _cursor.get() == 0 ), _prefetch( false ) {
     }
 
     FilteringClientCursor::FilteringClientCursor( DBClientCursor* cursor , const BSONObj filter )
-        : _matcher( filter ) , _cursor( cursor ) , _pcmData( NULL ), _done( cursor == 0 ) {
+        : _matcher( filter ) , _cursor( cursor ) , _pcmData( NULL ), _done( cursor == 0 ), _prefetch( false ) {
     }
 
 
@@ -354,12 +354,37 @@ namespace mongo {
         return _next;
     }
 
+    ShardWaitStats FilteringClientCursor::takeWaitStats() {
+        ShardWaitStats s = _waitStats;
+        _waitStats = ShardWaitStats();
+        return s;
+    }
+
     void FilteringClientCursor::_advance() {
         verify( _next.isEmpty() );
         if ( ! _cursor.get() || _done )
             return;
 
-        while ( _cursor->more() ) {
+        while ( true ) {
+            if ( ! _cursor->moreInCurrentBatch() ) {
+                // out of this batch: more() waits for the next one, which is already on its way
+                // if we prefetched it
+                bool prefetched = _cursor->prefetching();
+                Timer t;
+                bool more = _cursor->more();
+                if ( prefetched || _cursor->moreInCurrentBatch() ) {
+                    _waitStats.batches++;
+                    if ( prefetched )
+                        _waitStats.prefetched++;
+                    _waitStats.waitMicros += t.micros();
+                }
+                if ( ! more )
+                    break;
+            }
+
+            if ( _prefetch )
+                _cursor->prefetchMore();
+
             _next = _cursor->next();
             if ( _matcher.matches( _next ) ) {
                 if ( ! _cursor->moreInCurrentBatch() )
@@ -462,6 +487,7 @@ namespace mongo {
     void ParallelSortClusteredCursor::_finishCons() {
         _numServers = _servers.size();
         _cursors = 0;
+        _heapBuilt = false;
 
         if( ! _qSpec.isEmpty() ){
 
@@ -1445,50 +1471,83 @@ namespace mongo {
             _needToSkip = n;
         }
 
+        if ( ! _heapBuilt )
+            _buildHeap();
+
+        return ! _heap.empty();
+    }
+
+    /**
+     * std heap ordering of cursor indexes that puts the one whose next document sorts first on
+     * top; the lower index on ties, and when unsorted, so a shard is drained before the next
+     */
+    class CursorHeapOrder {
+    public:
+        CursorHeapOrder( FilteringClientCursor* cursors , const BSONObj& sortKey )
+            : _cursors( cursors ) , _sortKey( sortKey ) {
+        }
+        bool operator()( int l , int r ) const {
+            if ( ! _sortKey.isEmpty() ) {
+                int c = _cursors[l].peek().woSortOrder( _cursors[r].peek() , _sortKey , true );
+                if ( c )
+                    return c > 0;
+            }
+            return l > r;
+        }
+    private:
+        FilteringClientCursor* _cursors;
+        const BSONObj& _sortKey;
+    };
+
+    void ParallelSortClusteredCursor::_buildHeap() {
+        _heapBuilt = true;
+        _heap.clear();
         for ( int i=0; i<_numServers; i++ ) {
+            _cursors[i].setPrefetch( true );
             if ( _cursors[i].more() )
-                return true;
+                _heap.push_back( i );
+            else if( _cursors[i].rawMData() )
+                _cursors[i].rawMData()->pcState->done = true;
         }
-        return false;
+        make_heap( _heap.begin() , _heap.end() , CursorHeapOrder( _cursors , _sortKey ) );
     }
 
     BSONObj ParallelSortClusteredCursor::next() {
-        BSONObj best = BSONObj();
-        int bestFrom = -1;
-
-        for ( int i=0; i<_numServers; i++) {
-            if ( ! _cursors[i].more() ){
-                if( _cursors[i].rawMData() )
-                    _cursors[i].rawMData()->pcState->done = true;
-                continue;
-            }
-
-            BSONObj me = _cursors[i].peek();
-
-            if ( best.isEmpty() ) {
-                best = me;
-                bestFrom = i;
-                if( _sortKey.isEmpty() ) break;
-                continue;
-            }
+        if ( ! _heapBuilt )
+            _buildHeap();
 
-            int comp = best.woSortOrder( me , _sortKey , true );
-            if ( comp < 0 )
-                continue;
+        uassert( 10019 ,  "no more elements" , ! _heap.empty() );
 
-            best = me;
-            bestFrom = i;
-        }
+        CursorHeapOrder order( _cursors , _sortKey );
+        pop_heap( _heap.begin() , _heap.end() , order );
+        int bestFrom = _heap.back();
+        _heap.pop_back();
 
-        uassert( 10019 ,  "no more elements" , ! best.isEmpty() );
-        _cursors[bestFrom].next();
+        // only this shard's cursor moves, so only it has to find its place again
+        BSONObj best = _cursors[bestFrom].next();
 
         if( _cursors[bestFrom].rawMData() )
             _cursors[bestFrom].rawMData()->pcState->count++;
 
+        if ( _cursors[bestFrom].more() ) {
+            _heap.push_back( bestFrom );
+            push_heap( _heap.begin() , _heap.end() , order );
+        }
+        else if( _cursors[bestFrom].rawMData() ) {
+            _cursors[bestFrom].rawMData()->pcState->done = true;
+        }
+
         return best;
     }
 
+    void ParallelSortClusteredCursor::takeShardWaitStats( ShardWaitStatsMap& out ) {
+        for ( int i=0; i<_numServers && _cursors; i++ ) {
+            if ( ! _cursors[i].raw() )
+                continue;
+            out[ _cursors[i].raw()->originalHost() ].add( _cursors[i].takeWaitStats() );
+        }
+    }
+
     void ParallelSortClusteredCursor::_explain( map< string,list<BSONObj> >& out ) {
 
         set<Shard> shards;
@@ -64,6 +64,31 @@ namespace mongo {
         BSONObj _orderObject;
     };
 
+    /**
+     * time a mongos cursor spent waiting on one shard's getMores
+     */
+    struct ShardWaitStats {
+        ShardWaitStats() : batches(), prefetched(), waitMicros() {}
+
+        void add( const ShardWaitStats& other ) {
+            batches += other.batches;
+            prefetched += other.prefetched;
+            waitMicros += other.waitMicros;
+        }
+
+        void append( BSONObjBuilder& b ) const {
+            b.appendNumber( "batches" , batches );
+            b.appendNumber( "prefetched" , prefetched );
+            b.appendNumber( "waitMillis" , waitMicros / 1000 );
+        }
+
+        long long batches;      // getMore replies received
+        long long prefetched;   // of those, ones asked for before they were needed
+        long long waitMicros;   // time spent in more() waiting for them
+    };
+
+    typedef map<string,ShardWaitStats> ShardWaitStatsMap;
+
     /**
      * this is a cursor that works over a set of servers
      * can be used in serial/paralellel as controlled by sub classes
@@ -87,6 +112,9 @@ namespace mongo {
 
         virtual void explain(BSONObjBuilder& b) = 0;
 
+        /** adds the wait stats per shard host since the last call to out, and resets them */
+        virtual void takeShardWaitStats( ShardWaitStatsMap& out ) {}
+
     protected:
 
         virtual void _init() = 0;
@@ -139,6 +167,12 @@ namespace mongo {
         DBClientCursor* raw() { return _cursor.get(); }
         ParallelConnectionMetadata* rawMData(){ return _pcmData; }
 
+        /** keep the getMore for the next batch in flight while this one is read */
+        void setPrefetch( bool prefetch ) { _prefetch = prefetch; }
+
+        /** @return the wait stats since the last call, and resets them */
+        ShardWaitStats takeWaitStats();
+
         // Required for new PCursor
         void release(){
             _cursor.release();
@@ -154,6 +188,9 @@ namespace mongo {
 
         BSONObj _next;
         bool _done;
+
+        bool _prefetch;
+        ShardWaitStats _waitStats;
     };
 
 
@@ -367,6 +404,8 @@ namespace mongo {
 
         virtual void explain(BSONObjBuilder& b);
 
+        virtual void takeShardWaitStats( ShardWaitStatsMap& out );
+
     protected:
         void _finishCons();
         void _init();
@@ -394,6 +433,11 @@ namespace mongo {
 
         FilteringClientCursor * _cursors;
         int _needToSkip;
+
+        // indexes of the _cursors with documents left, as a heap with the next one to return on top
+        void _buildHeap();
+        bool _heapBuilt;
+        vector<int> _heap;
     };
 
     /**
@@ -48,6 +48,12 @@ namespace mongo {
         void commit();
 
         unsigned long long getn() { return n; }
+
+        /**
+         * call after the lock was released and reacquired between addKey() calls, so writes to
+         * the current bucket are declared again.
+         */
+        void relocked() { b = cur.btreemod<V>(); }
     };
 
 }
@@ -134,6 +134,7 @@ namespace mongo {
         string _threadId; // "" on non support systems
         CurOp * _curOp;
         Context * _context;
+        Top::NsCache _topNs; // what our ops record usage under, see CurOp::enter()
         bool _shutdown; // to track if Client::shutdown() gets called
         const std::string _desc;
         bool _god;
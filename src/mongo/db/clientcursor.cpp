@@ -36,24 +36,54 @@
 
 namespace mongo {
 
-    CCById ClientCursor::clientCursorsById;
-    boost::recursive_mutex& ClientCursor::ccmutex( *(new boost::recursive_mutex()) );
+    // never freed, so they outlive any static ClientCursor users at shutdown
+    ClientCursor::ByIdPartition* ClientCursor::partitions = new ClientCursor::ByIdPartition[ ClientCursor::NumPartitions ];
+    boost::recursive_mutex* ClientCursor::byLocMutexes = new boost::recursive_mutex[ ClientCursor::NumByLocMutexes ];
     long long ClientCursor::numberTimedOut = 0;
 
     void aboutToDeleteForSharding( const Database* db , const DiskLoc& dl ); // from s/d_logic.h
 
+    /** holds every byLoc lock, for deleting cursors of any database while iterating partitions */
+    class AllByLocLocks : boost::noncopyable {
+    public:
+        AllByLocLocks( boost::recursive_mutex* mutexes, unsigned n ) : _mutexes( mutexes ), _n( n ) {
+            for( unsigned i = 0; i < _n; i++ )
+                _mutexes[i].lock();
+        }
+        ~AllByLocLocks() {
+            for( unsigned i = _n; i > 0; i-- )
+                _mutexes[i-1].unlock();
+        }
+    private:
+        boost::recursive_mutex* _mutexes;
+        unsigned _n;
+    };
+
     /*static*/ void ClientCursor::assertNoCursors() {
-        recursive_scoped_lock lock(ccmutex);
-        if( clientCursorsById.size() ) {
-            log() << "ERROR clientcursors exist but should not at this point" << endl;
-            ClientCursor *cc = clientCursorsById.begin()->second;
-            log() << "first one: " << cc->_cursorid << ' ' << cc->_ns << endl;
-            clientCursorsById.clear();
-            verify(false);
+        for( unsigned p = 0; p < NumPartitions; p++ ) {
+            recursive_scoped_lock lock(partitions[p].m);
+            CCById& byId = partitions[p].cursors;
+            if( byId.size() ) {
+                log() << "ERROR clientcursors exist but should not at this point" << endl;
+                ClientCursor *cc = byId.begin()->second;
+                log() << "first one: " << cc->_cursorid << ' ' << cc->_ns << endl;
+                byId.clear();
+                verify(false);
+            }
         }
     }
 
+    /*static*/ unsigned ClientCursor::numCursors() {
+        unsigned n = 0;
+        for( unsigned p = 0; p < NumPartitions; p++ ) {
+            recursive_scoped_lock lock(partitions[p].m);
+            n += partitions[p].cursors.size();
+        }
+        return n;
+    }
 
+
+    /** caller holds byLocMutex(_db) */
     void ClientCursor::setLastLoc_inlock(DiskLoc L) {
         verify( _pos != -2 ); // defensive - see ~ClientCursor
 
@@ -138,7 +168,7 @@ namespace mongo {
         }
     }
 
-    /* note called outside of locks (other than ccmutex) so care must be exercised */
+    /* note called outside of locks (other than its partition's) so care must be exercised */
     bool ClientCursor::shouldTimeout( unsigned millis ) {
         _idleAgeMillis += millis;
         return _idleAgeMillis > 600000 && _pinValue == 0;
@@ -150,39 +180,52 @@ namespace mongo {
 
         // two passes so that we don't need to readlock unless we really do some timeouts
         // we assume here that incrementing _idleAgeMillis outside readlock is ok.
-        {
-            recursive_scoped_lock lock(ccmutex);
-            {
-                unsigned sz = clientCursorsById.size();
-                static time_t last;
-                if( sz >= 100000 ) { 
-                    if( time(0) - last > 300 ) {
-                        last = time(0);
-                        log() << "warning number of open cursors is very large: " << sz << endl;
-                    }
+        // the first pass takes one partition's lock at a time, so getMores elsewhere go on.
+        unsigned sz = 0;
+        for( unsigned p = 0; p < NumPartitions; p++ ) {
+            ByIdPartition& part = partitions[p];
+            recursive_scoped_lock lock(part.m);
+            sz += part.cursors.size();
+            for ( CCById::iterator i = part.cursors.begin(); i != part.cursors.end(); ++i ) {
+                if( i->second->shouldTimeout( millis ) ) {
+                    part.mayTimeout = true;
+                    foundSomeToTimeout = true;
                 }
             }
-            for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end();  ) {
-                CCById::iterator j = i;
-                i++;
-                if( j->second->shouldTimeout( millis ) ) {
-                    foundSomeToTimeout = true;
+        }
+        {
+            static time_t last;
+            if( sz >= 100000 ) { 
+                if( time(0) - last > 300 ) {
+                    last = time(0);
+                    log() << "warning number of open cursors is very large: " << sz << endl;
                 }
             }
         }
 
         if( foundSomeToTimeout ) {
+            // and the second only visits the partitions the first found something in
             Lock::GlobalRead lk;
-            for( LockedIterator i; i.ok(); ) {
-                ClientCursor *cc = i.current();
-                if( cc->shouldTimeout(0) ) {
-                    numberTimedOut++;
-                    LOG(1) << "killing old cursor " << cc->_cursorid << ' ' << cc->_ns
-                           << " idle:" << cc->idleTime() << "ms\n";
-                    i.deleteAndAdvance();
-                }
-                else {
-                    i.advance();
+            AllByLocLocks byLocLocks( byLocMutexes, NumByLocMutexes );
+            for( unsigned p = 0; p < NumPartitions; p++ ) {
+                ByIdPartition& part = partitions[p];
+                recursive_scoped_lock lock(part.m);
+                if( !part.mayTimeout )
+                    continue;
+                part.mayTimeout = false;
+                for ( CCById::iterator i = part.cursors.begin(); i != part.cursors.end(); ) {
+                    ClientCursor *cc = i->second;
+                    if( cc->shouldTimeout(0) ) {
+                        numberTimedOut++;
+                        LOG(1) << "killing old cursor " << cc->_cursorid << ' ' << cc->_ns
+                               << " idle:" << cc->idleTime() << "ms\n";
+                        CursorId id = cc->_cursorid;
+                        delete cc;
+                        i = part.cursors.upper_bound( id );
+                    }
+                    else {
+                        ++i;
+                    }
                 }
             }
         }
@@ -192,8 +235,8 @@ namespace mongo {
        note this is potentially slow
     */
     void ClientCursor::informAboutToDeleteBucket(const DiskLoc& b) {
-        recursive_scoped_lock lock(ccmutex);
         Database *db = cc().database();
+        recursive_scoped_lock lock(byLocMutex(db));
         CCByLoc& bl = db->ccByLoc;
         RARELY if ( bl.size() > 70 ) {
             log() << "perf warning: byLoc.size=" << bl.size() << " in aboutToDeleteBucket\n";
@@ -210,10 +253,9 @@ namespace mongo {
 
     /* must call this on a delete so we clean up the cursors. */
     void ClientCursor::aboutToDelete(const DiskLoc& dl) {
-        recursive_scoped_lock lock(ccmutex);
-
         Database *db = cc().database();
         verify(db);
+        recursive_scoped_lock lock(byLocMutex(db));
 
         aboutToDeleteForSharding( db , dl );
 
@@ -289,11 +331,37 @@ namespace mongo {
     }
     void aboutToDelete(const DiskLoc& dl) { ClientCursor::aboutToDelete(dl); }
 
+    ClientCursor::LockedIterator::LockedIterator() : _p( 0 ) {
+        // deleting a cursor takes its byLoc lock, which must come before its partition's
+        for( unsigned i = 0; i < NumByLocMutexes; i++ )
+            byLocMutexes[i].lock();
+        _lock.reset( new recursive_scoped_lock( partitions[_p].m ) );
+        _i = partitions[_p].cursors.begin();
+        skipEmpty();
+    }
+
+    ClientCursor::LockedIterator::~LockedIterator() {
+        _lock.reset();
+        for( unsigned i = NumByLocMutexes; i > 0; i-- )
+            byLocMutexes[i-1].unlock();
+    }
+
+    void ClientCursor::LockedIterator::skipEmpty() {
+        while( _i == partitions[_p].cursors.end() ) {
+            _lock.reset();
+            if( ++_p == NumPartitions )
+                return;
+            _lock.reset( new recursive_scoped_lock( partitions[_p].m ) );
+            _i = partitions[_p].cursors.begin();
+        }
+    }
+
     void ClientCursor::LockedIterator::deleteAndAdvance() {
         ClientCursor *cc = current();
         CursorId id = cc->cursorid();
         delete cc;
-        _i = clientCursorsById.upper_bound( id );
+        _i = partitions[_p].cursors.upper_bound( id );
+        skipEmpty();
     }
     
     ClientCursor::ClientCursor(int queryOptions, const shared_ptr<Cursor>& c, const string& ns, BSONObj query ) :
@@ -309,9 +377,7 @@ namespace mongo {
         verify( str::startsWith(_ns, _db->name) );
         if( queryOptions & QueryOption_NoCursorTimeout )
             noTimeout();
-        recursive_scoped_lock lock(ccmutex);
-        _cursorid = allocCursorId_inlock();
-        clientCursorsById.insert( make_pair(_cursorid, this) );
+        registerWithNewId();
 
         if ( ! _c->modifiedKeys() ) {
             // store index information so we can decide if we can
@@ -340,9 +406,10 @@ namespace mongo {
         }
 
         {
-            recursive_scoped_lock lock(ccmutex);
+            recursive_scoped_lock byLocLock(byLocMutex(_db));
             setLastLoc_inlock( DiskLoc() ); // removes us from bylocation multimap
-            clientCursorsById.erase(_cursorid);
+            recursive_scoped_lock lock(partition(_cursorid).m);
+            partition(_cursorid).cursors.erase(_cursorid);
 
             // defensive:
             (CursorId&)_cursorid = -1;
@@ -444,7 +511,7 @@ namespace mongo {
             //log() << "info: lastloc==curloc " << ns << '\n';
         }
         else {
-            recursive_scoped_lock lock(ccmutex);
+            recursive_scoped_lock lock(byLocMutex(_db));
             setLastLoc_inlock(cl);
         }
     }
@@ -474,8 +541,10 @@ namespace mongo {
             return 0;
         }
         else if ( need == MaybeCovered ) {
-            // TODO
-            return 0;
+            // if the matcher can decide from the key alone the record may never be read
+            CoveredIndexMatcher *matcher = _c->matcher();
+            if ( matcher ? ! matcher->needRecord() : _c->keyFieldsOnly() != 0 )
+                return 0;
         }
         else if ( need == WillNeed ) {
             // no-op
@@ -530,6 +599,8 @@ namespace mongo {
                 // need to lock this else rec->touch won't be safe file could disappear
                 lk.reset( new LockMongoFilesShared() );
             }
+            // how far past rec we may read ahead, found while we still have the database
+            const char *limit = rec ? rec->prefetchLimit() : 0;
             
             dbtempreleasecond unlock;
             if ( unlock.unlocked() ) {
@@ -549,7 +620,7 @@ namespace mongo {
             }
 
             if ( rec )
-                rec->touch();
+                rec->prefetch( limit );
 
             lk.reset(0); // need to release this before dbtempreleasecond
         }
@@ -615,19 +686,26 @@ namespace mongo {
         return ClientCursor::recoverFromYield( data );
     }
 
-    long long ctmLast = 0; // so we don't have to do find() which is a little slow very often.
-    long long ClientCursor::allocCursorId_inlock() {
+    static SimpleMutex cursorIdRandMutex("cursorIdRand");
+
+    void ClientCursor::registerWithNewId() {
         long long ctm = curTimeMillis64();
         dassert( ctm );
-        long long x;
         while ( 1 ) {
-            x = (((long long)rand()) << 32);
+            long long x;
+            {
+                SimpleMutex::scoped_lock lk(cursorIdRandMutex);
+                x = (((long long)rand()) << 32);
+            }
             x = x ^ ctm;
-            if ( ctm != ctmLast || ClientCursor::find_inlock(x, false) == 0 )
-                break;
+            ByIdPartition& part = partition(x);
+            recursive_scoped_lock lock(part.m);
+            if ( x != 0 && find_inlock(x, false) == 0 ) {
+                _cursorid = x;
+                part.cursors.insert( make_pair(_cursorid, this) );
+                return;
+            }
         }
-        ctmLast = ctm;
-        return x;
     }
 
     void ClientCursor::storeOpForSlave( DiskLoc last ) {
@@ -650,19 +728,24 @@ namespace mongo {
 
 
     void ClientCursor::appendStats( BSONObjBuilder& result ) {
-        recursive_scoped_lock lock(ccmutex);
-        result.appendNumber("totalOpen", clientCursorsById.size() );
-        result.appendNumber("clientCursors_size", (int) numCursors());
-        result.appendNumber("timedOut" , numberTimedOut);
+        size_t total = 0;
         unsigned pinned = 0;
         unsigned notimeout = 0;
-        for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end(); i++ ) {
-            unsigned p = i->second->_pinValue;
-            if( p >= 100 )
-                pinned++;
-            else if( p > 0 )
-                notimeout++;
+        for( unsigned part = 0; part < NumPartitions; part++ ) {
+            recursive_scoped_lock lock(partitions[part].m);
+            CCById& byId = partitions[part].cursors;
+            total += byId.size();
+            for ( CCById::iterator i = byId.begin(); i != byId.end(); i++ ) {
+                unsigned p = i->second->_pinValue;
+                if( p >= 100 )
+                    pinned++;
+                else if( p > 0 )
+                    notimeout++;
+            }
         }
+        result.appendNumber("totalOpen", total );
+        result.appendNumber("clientCursors_size", (int) total);
+        result.appendNumber("timedOut" , numberTimedOut);
         if( pinned ) 
             result.append("pinned", pinned);
         if( notimeout )
@@ -741,19 +824,34 @@ namespace mongo {
     }
 
     void ClientCursor::find( const string& ns , set<CursorId>& all ) {
-        recursive_scoped_lock lock(ccmutex);
-
-        for ( CCById::iterator i=clientCursorsById.begin(); i!=clientCursorsById.end(); ++i ) {
-            if ( i->second->_ns == ns )
-                all.insert( i->first );
+        for( unsigned p = 0; p < NumPartitions; p++ ) {
+            recursive_scoped_lock lock(partitions[p].m);
+            CCById& byId = partitions[p].cursors;
+            for ( CCById::iterator i=byId.begin(); i!=byId.end(); ++i ) {
+                if ( i->second->_ns == ns )
+                    all.insert( i->first );
+            }
         }
     }
 
     bool ClientCursor::erase( CursorId id ) {
-        recursive_scoped_lock lock( ccmutex );
-        ClientCursor *cursor = find_inlock( id );
-        if ( ! cursor )
+        // the byLoc lock comes first, so look up which one with just the partition lock
+        Database *db;
+        {
+            recursive_scoped_lock lock( partition(id).m );
+            ClientCursor *cursor = find_inlock( id );
+            if ( ! cursor )
+                return false;
+            db = cursor->_db;
+        }
+
+        recursive_scoped_lock byLocLock( byLocMutex( db ) );
+        recursive_scoped_lock lock( partition(id).m );
+        ClientCursor *cursor = find_inlock( id, false );
+        if ( ! cursor || cursor->_db != db ) {
+            // deleted meanwhile
             return false;
+        }
 
         if ( ! cc().getAuthenticationInfo()->isAuthorizedReads( nsToDatabase( cursor->ns() ) ) )
             return false;
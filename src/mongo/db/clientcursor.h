@@ -105,7 +105,7 @@ namespace mongo {
             }
             ~Pointer() { release(); }
             Pointer(long long cursorid) {
-                recursive_scoped_lock lock(ccmutex);
+                recursive_scoped_lock lock(partition(cursorid).m);
                 _c = ClientCursor::find_inlock(cursorid, true);
                 if( _c ) {
                     if( _c->_pinValue >= 100 ) {
@@ -153,22 +153,26 @@ namespace mongo {
         };
 
         /**
-         * Iterates through all ClientCursors, under its own ccmutex lock.
-         * Also supports deletion on the fly.
+         * Iterates through all ClientCursors, a partition at a time under that partition's lock.
+         * Also supports deletion on the fly, so it holds every byLoc lock throughout.
          */
         class LockedIterator : boost::noncopyable {
         public:
-            LockedIterator() : _lock( ccmutex ), _i( clientCursorsById.begin() ) {}
-            bool ok() const { return _i != clientCursorsById.end(); }
+            LockedIterator();
+            ~LockedIterator();
+            bool ok() const { return _p < NumPartitions; }
             ClientCursor *current() const { return _i->second; }
-            void advance() { ++_i; }
+            void advance() { ++_i; skipEmpty(); }
             /**
              * Delete 'current' and advance. Properly handles cascading deletions that may occur
              * when one ClientCursor is directly deleted.
              */
             void deleteAndAdvance();
         private:
-            recursive_scoped_lock _lock;
+            /** move to the next partition with cursors, if at the end of this one */
+            void skipEmpty();
+            unsigned _p;
+            scoped_ptr<recursive_scoped_lock> _lock;
             CCById::const_iterator _i;
         };
         
@@ -302,9 +306,11 @@ namespace mongo {
     private:
         void setLastLoc_inlock(DiskLoc);
 
+        /** caller holds partition(id).m */
         static ClientCursor* find_inlock(CursorId id, bool warn = true) {
-            CCById::iterator it = clientCursorsById.find(id);
-            if ( it == clientCursorsById.end() ) {
+            CCById& byId = partition(id).cursors;
+            CCById::iterator it = byId.find(id);
+            if ( it == byId.end() ) {
                 if ( warn )
                     OCCASIONALLY out() << "ClientCursor::find(): cursor not found in map " << id << " (ok after a drop)\n";
                 return 0;
@@ -320,7 +326,7 @@ namespace mongo {
 
     public:
         static ClientCursor* find(CursorId id, bool warn = true) {
-            recursive_scoped_lock lock(ccmutex);
+            recursive_scoped_lock lock(partition(id).m);
             ClientCursor *c = find_inlock(id, warn);
             // if this asserts, your code was not thread safe - you either need to set no timeout
             // for the cursor or keep a ClientCursor::Pointer in scope for it.
@@ -369,7 +375,7 @@ namespace mongo {
         static void idleTimeReport(unsigned millis);
 
         static void appendStats( BSONObjBuilder& result );
-        static unsigned numCursors() { return clientCursorsById.size(); }
+        static unsigned numCursors();
         static void informAboutToDeleteBucket(const DiskLoc& b);
         static void aboutToDelete(const DiskLoc& dl);
         static void find( const string& ns , set<CursorId>& all );
@@ -382,6 +388,9 @@ namespace mongo {
         void noTimeout() { _pinValue++; }
 
         CCByLoc& byLoc() { return _db->ccByLoc; }
+        static boost::recursive_mutex& byLocMutex( const Database *db ) {
+            return byLocMutexes[ ( (size_t) db >> 6 ) % NumByLocMutexes ];
+        }
         
         Record* _recordForYield( RecordNeeds need );
 
@@ -426,10 +435,29 @@ namespace mongo {
 
     private: // static members
 
-        static CCById clientCursorsById;
+        /**
+         * The cursors are registered by id in partitions, picked by the random high bits of the
+         * id, each with its own lock, so getMores and the creation and deletion of unrelated
+         * cursors don't contend.  The byLoc map of a database is under one of a set of byLoc locks,
+         * picked by the Database address.  Where both are held the byLoc lock is taken first.
+         */
+        struct ByIdPartition {
+            ByIdPartition() : mayTimeout(false) { }
+            boost::recursive_mutex m;
+            CCById cursors;
+            /** set by the idle time sweep when a cursor here may have timed out */
+            bool mayTimeout;
+        };
+        enum { NumPartitions = 32, NumByLocMutexes = 16 };
+        static ByIdPartition* partitions;
+        static boost::recursive_mutex* byLocMutexes;
+        static ByIdPartition& partition( CursorId id ) {
+            return partitions[ ( (unsigned long long) id >> 32 ) % NumPartitions ];
+        }
+
         static long long numberTimedOut;
-        static boost::recursive_mutex& ccmutex;   // must use this for all statics above!
-        static CursorId allocCursorId_inlock();
+        /** adds this to its partition with a new unique id */
+        void registerWithNewId();
 
     };
 
@@ -25,6 +25,7 @@
 #include "db.h"
 #include "instance.h"
 #include "repl.h"
+#include "mongo/client/dbclientcursor.h"
 
 namespace mongo {
 
@@ -34,6 +35,8 @@ namespace mongo {
 
     bool replAuthenticate(DBClientBase *);
 
+    void replLocalAuth();
+
     /** Selectively release the mutex based on a parameter. */
     class dbtempreleaseif {
     public:
@@ -508,6 +511,309 @@ namespace mongo {
         return c.go(masterHost, errmsg, fromdb, logForReplication, slaveOk, useReplAuth, snapshot, mayYield, mayBeInterrupted, errCode);
     }
 
+    void CloneStats::reset() {
+        collections.zero();
+        ranges.zero();
+        docs.zero();
+        bytes.zero();
+        indexes.zero();
+    }
+
+    void CloneStats::append( BSONObjBuilder& b ) const {
+        b.append( "collections" , (long long) collections );
+        b.append( "ranges" , (long long) ranges );
+        b.append( "docs" , (long long) docs );
+        b.append( "bytes" , (long long) bytes );
+        b.append( "indexes" , (long long) indexes );
+    }
+
+    struct ParallelCloner::Errors {
+        Errors() : m("parallelClonerErrors") { }
+        SimpleMutex m;
+        ExceptionInfo first;
+    };
+
+    ParallelCloner::ParallelCloner( const string& host , ThreadPool& pool , CloneStats& stats ) :
+        _host( host ),
+        _pool( pool ),
+        _stats( stats ),
+        _conn( new DBClientConnection() ),
+        _m( "ParallelCloner" ),
+        _failed( false ) {
+    }
+
+    ParallelCloner::~ParallelCloner() {
+    }
+
+    bool ParallelCloner::connect( DBClientConnection& conn , string& errmsg ) const {
+        if ( ! conn.connect( _host , errmsg ) )
+            return false;
+        if ( ! replAuthenticate( &conn ) ) {
+            errmsg = "can't authenticate to " + _host;
+            return false;
+        }
+        return true;
+    }
+
+    bool ParallelCloner::cloneData( const vector<string>& dbs , string& errmsg ) {
+        if ( ! connect( *_conn , errmsg ) )
+            return false;
+        try {
+            for ( vector<string>::const_iterator i = dbs.begin(); i != dbs.end(); ++i ) {
+                if ( ! createCollections( *i , errmsg ) )
+                    return false;
+            }
+        }
+        catch ( DBException& e ) {
+            errmsg = e.toString();
+            return false;
+        }
+
+        log() << "initial sync cloning " << (unsigned long long) _stats.collections << " collections in " << _ranges.size()
+              << " parts with " << _pool.nThreads() << " threads" << endl;
+        Errors errs;
+        for ( int i = 0; i < _pool.nThreads(); i++ )
+            _pool.schedule( copyRanges , this , &errs );
+        _pool.join();
+        if ( ! errs.first.empty() ) {
+            errmsg = errs.first.msg;
+            return false;
+        }
+        return true;
+    }
+
+    bool ParallelCloner::createCollections( const string& db , string& errmsg ) {
+        // the same collections Cloner::go() copies
+        string system_namespaces = db + ".system.namespaces";
+        auto_ptr<DBClientCursor> c = _conn->query( system_namespaces , BSONObj() , 0 , 0 , 0 , QueryOption_SlaveOk );
+        if ( ! c.get() ) {
+            errmsg = "query failed " + system_namespaces;
+            return false;
+        }
+        vector<BSONObj> colls;
+        while ( c->more() ) {
+            BSONObj o = c->nextSafe();
+            const char *name = o.getStringField( "name" );
+            if ( strstr( name , ".system." ) && legalClientSystemNS( name , true ) == 0 )
+                continue;
+            if ( ! NamespaceString::normal( name ) )
+                continue;
+            colls.push_back( o.getOwned() );
+        }
+
+        vector< pair<string,bool> >& created = _created[db];
+        set<string> names;
+        for ( vector<BSONObj>::const_iterator i = colls.begin(); i != colls.end(); ++i ) {
+            string ns = i->getStringField( "name" );
+            BSONObj options = i->getObjectField( "options" );
+            // the _id index waits until the data is in, like the others
+            bool wantIdIndex = false;
+            {
+                Client::WriteContext ctx( ns );
+                string err;
+                userCreateNS( ns.c_str() , options , err , false , &wantIdIndex );
+            }
+            created.push_back( make_pair( ns , wantIdIndex ) );
+            names.insert( ns );
+            _stats.collections += 1;
+
+            if ( options["capped"].trueValue() ) {
+                // copied in natural order, in one piece
+                Range r;
+                r.ns = ns;
+                _ranges.push_back( r );
+            }
+            else {
+                split( ns );
+            }
+        }
+
+        // _id indexes are built by ensureIdIndexForNewNs()
+        auto_ptr<DBClientCursor> idx = _conn->query( db + ".system.indexes" , BSON( "name" << NE << "_id_" ) , 0 , 0 , 0 , QueryOption_SlaveOk );
+        if ( ! idx.get() ) {
+            errmsg = "query failed " + db + ".system.indexes";
+            return false;
+        }
+        vector<BSONObj>& indexes = _indexes[db];
+        while ( idx->more() ) {
+            BSONObj o = idx->nextSafe();
+            if ( names.count( o.getStringField( "ns" ) ) )
+                indexes.push_back( o.getOwned() );
+        }
+        return true;
+    }
+
+    void ParallelCloner::split( const string& ns ) {
+        NamespaceString s( ns );
+        BSONObj stats;
+        long long size = 0;
+        if ( _conn->runCommand( s.db , BSON( "collstats" << s.coll ) , stats , QueryOption_SlaveOk ) )
+            size = stats["size"].numberLong();
+
+        Range rest;
+        rest.ns = ns;
+        BSONObj res;
+        if ( size > SplitBytes &&
+             _conn->runCommand( "admin" ,
+                                BSON( "splitVector" << ns << "keyPattern" << BSON( "_id" << 1 ) <<
+                                      "maxChunkSizeBytes" << max( (long long) SplitBytes , size / MaxRanges ) ) ,
+                                res , QueryOption_SlaveOk ) ) {
+            BSONObjIterator i( res.getObjectField( "splitKeys" ) );
+            while ( i.more() ) {
+                Range r;
+                r.ns = ns;
+                r.min = rest.min;
+                r.max = i.next().Obj().getOwned();
+                _ranges.push_back( r );
+                rest.min = r.max;
+            }
+        }
+        _ranges.push_back( rest );
+    }
+
+    bool ParallelCloner::nextRange( Range& r ) {
+        SimpleMutex::scoped_lock lk( _m );
+        if ( _failed || _ranges.empty() )
+            return false;
+        r = _ranges.front();
+        _ranges.pop_front();
+        return true;
+    }
+
+    void ParallelCloner::copyRanges( ParallelCloner* pc , Errors* errs ) {
+        Client::initThreadIfNotAlready( "initial sync cloner" );
+        replLocalAuth();
+        try {
+            DBClientConnection conn;
+            string errmsg;
+            uassert( 16410 , str::stream() << "initial sync can't connect to " << pc->_host << ": " << errmsg ,
+                     pc->connect( conn , errmsg ) );
+            Range r;
+            while ( pc->nextRange( r ) )
+                pc->copyRange( conn , r );
+        }
+        catch ( DBException& e ) {
+            {
+                SimpleMutex::scoped_lock lk( pc->_m );
+                pc->_failed = true;
+            }
+            SimpleMutex::scoped_lock lk( errs->m );
+            if ( errs->first.empty() )
+                errs->first = ExceptionInfo( e.toString() , e.getCode() );
+        }
+    }
+
+    void ParallelCloner::copyRange( DBClientBase& conn , const Range& r ) {
+        LOG(1) << "initial sync cloning " << r.ns << " from " << r.min << " to " << r.max << endl;
+        Query q;
+        if ( ! r.min.isEmpty() || ! r.max.isEmpty() ) {
+            // $min and $max bound the _id index scan without the type bracketing of $gte and $lt
+            q.hint( BSON( "_id" << 1 ) );
+            if ( ! r.min.isEmpty() )
+                q.minKey( r.min );
+            if ( ! r.max.isEmpty() )
+                q.maxKey( r.max );
+        }
+        conn.query( boost::function<void(DBClientCursorBatchIterator &)>( boost::bind( &ParallelCloner::insertBatch , this , r.ns , _1 ) ) ,
+                    r.ns , q , 0 , QueryOption_NoCursorTimeout | QueryOption_SlaveOk );
+        _stats.ranges += 1;
+    }
+
+    void ParallelCloner::insertBatch( const string& ns , DBClientCursorBatchIterator& i ) {
+        vector<BSONObj> objs;
+        long long bytes = 0;
+        while ( i.moreInCurrentBatch() ) {
+            BSONObj o = i.nextSafe();
+            if ( ! o.valid() ) {
+                log() << "initial sync skipping corrupt object from " << ns << endl;
+                continue;
+            }
+            bytes += o.objsize();
+            objs.push_back( o );
+        }
+        if ( objs.empty() )
+            return;
+
+        {
+            // only this collection, so the others being copied go on
+            scoped_ptr<Lock::ScopedLock> lk( newWriteLock( ns.c_str() ) );
+            Client::Context ctx( ns );
+            if ( ! theDataFileMgr.insertBatch( ns.c_str() , objs , 0 , objs.size() ) ) {
+                // capped, or a duplicate in a system collection's index
+                for ( vector<BSONObj>::iterator j = objs.begin(); j != objs.end(); ++j ) {
+                    try {
+                        theDataFileMgr.insertWithObjMod( ns.c_str() , *j );
+                    }
+                    catch( UserException& e ) {
+                        log() << "warning: exception cloning object in " << ns << ' ' << e.what() << " obj:" << j->toString() << endl;
+                    }
+                }
+            }
+            getDur().commitIfNeeded();
+        }
+        _stats.docs += objs.size();
+        _stats.bytes += bytes;
+    }
+
+    bool ParallelCloner::buildIndexes( string& errmsg ) {
+        // the _id indexes first, with dropDups: the copy wasn't a snapshot, so a document that 
+        // moved while it was copied can be there twice.  applying the oplog puts that right.
+        for ( int pass = 0; pass < 2; pass++ ) {
+            Errors errs;
+            bool old = inDBRepair;
+            inDBRepair = pass == 0 || old;
+            for ( map< string , vector< pair<string,bool> > >::const_iterator i = _created.begin(); i != _created.end(); ++i )
+                _pool.schedule( buildDbIndexes , this , &i->first , pass == 0 , &errs );
+            _pool.join();
+            inDBRepair = old;
+            if ( ! errs.first.empty() ) {
+                errmsg = errs.first.msg;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ParallelCloner::buildDbIndexes( ParallelCloner* pc , const string* db , bool idIndexes , Errors* errs ) {
+        Client::initThreadIfNotAlready( "initial sync cloner" );
+        replLocalAuth();
+        try {
+            Lock::DBWrite lk( *db );
+            Client::Context ctx( *db );
+            if ( idIndexes ) {
+                const vector< pair<string,bool> >& created = pc->_created.find( *db )->second;
+                for ( vector< pair<string,bool> >::const_iterator i = created.begin(); i != created.end(); ++i ) {
+                    if ( ! i->second )
+                        continue;
+                    ensureIdIndexForNewNs( i->first.c_str() );
+                    pc->_stats.indexes += 1;
+                    getDur().commitIfNeeded();
+                }
+                return;
+            }
+
+            // inserting the spec builds the index from the collection's data, sorted in bulk
+            string system_indexes = *db + ".system.indexes";
+            const vector<BSONObj>& indexes = pc->_indexes.find( *db )->second;
+            for ( vector<BSONObj>::const_iterator i = indexes.begin(); i != indexes.end(); ++i ) {
+                BSONObj js = fixindex( *i );
+                try {
+                    theDataFileMgr.insertWithObjMod( system_indexes.c_str() , js );
+                    pc->_stats.indexes += 1;
+                }
+                catch( UserException& e ) {
+                    log() << "warning: exception building index in " << *db << ' ' << e.what() << " index:" << js.toString() << endl;
+                }
+                getDur().commitIfNeeded();
+            }
+        }
+        catch ( DBException& e ) {
+            SimpleMutex::scoped_lock lk( errs->m );
+            if ( errs->first.empty() )
+                errs->first = ExceptionInfo( e.toString() , e.getCode() );
+        }
+    }
+
     /* Usage:
        mydb.$cmd.findOne( { clone: "fromhost" } );
     */
@@ -19,8 +19,15 @@
 #pragma once
 
 #include "jsobj.h"
+#include "mongo/platform/atomic_uint64.h"
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
+
+    class DBClientBase;
+    class DBClientConnection;
+    class DBClientCursorBatchIterator;
     
     /**
      * @param slaveOk     - if true it is ok if the source of the data is !ismaster.
@@ -36,4 +43,75 @@ namespace mongo {
 
     bool copyCollectionFromRemote(const string& host, const string& ns, string& errmsg);
 
+    /** what a ParallelCloner has copied so far */
+    struct CloneStats {
+        AtomicUInt64 collections;
+        /** parts of collections copied, each a whole collection or an _id range of one */
+        AtomicUInt64 ranges;
+        AtomicUInt64 docs;
+        AtomicUInt64 bytes;
+        AtomicUInt64 indexes;
+        void reset();
+        void append( BSONObjBuilder& b ) const;
+    };
+
+    /**
+     * Copies whole databases from another server, as initial sync does, many collections at a
+     * time.  The collections are created first, then their documents are copied by threads with
+     * a connection each; a collection of more than SplitBytes is split into _id ranges (with
+     * splitVector on the source) which are copied at the same time.  No index is built until all
+     * the data is there, and then each from it in bulk, one database's while another's builds.
+     * Nothing is logged for replication.  Used with nothing locked.
+     */
+    class ParallelCloner : boost::noncopyable {
+    public:
+        enum { SplitBytes = 256 * 1024 * 1024, MaxRanges = 1000 };
+
+        /** @param pool the threads to copy with, each with its own connection to host */
+        ParallelCloner( const string& host , ThreadPool& pool , CloneStats& stats );
+        ~ParallelCloner();
+
+        /**
+         * create the collections of dbs and copy their documents
+         * @return false, with errmsg set, if something failed
+         */
+        bool cloneData( const vector<string>& dbs , string& errmsg );
+
+        /** build the indexes the source has for the collections cloneData() copied */
+        bool buildIndexes( string& errmsg );
+
+    private:
+        struct Range {
+            string ns;
+            /** $min and $max on the _id index, empty for the start or end of the collection */
+            BSONObj min;
+            BSONObj max;
+        };
+        struct Errors;
+
+        bool connect( DBClientConnection& conn , string& errmsg ) const;
+        bool createCollections( const string& db , string& errmsg );
+        void split( const string& ns );
+        bool nextRange( Range& r );
+        void copyRange( DBClientBase& conn , const Range& r );
+        void insertBatch( const string& ns , DBClientCursorBatchIterator& i );
+        static void copyRanges( ParallelCloner* pc , Errors* errs );
+        static void buildDbIndexes( ParallelCloner* pc , const string* db , bool idIndexes , Errors* errs );
+
+        const string _host;
+        ThreadPool& _pool;
+        CloneStats& _stats;
+        scoped_ptr<DBClientConnection> _conn;
+
+        SimpleMutex _m;
+        /** guarded by _m */
+        deque<Range> _ranges;
+        bool _failed;
+
+        /** by database: the collections created and whether each is waiting for its _id index */
+        map< string , vector< pair<string,bool> > > _created;
+        /** by database: the other indexes to build, as in the source's system.indexes */
+        map< string , vector<BSONObj> > _indexes;
+    };
+
 } // namespace mongo
@@ -62,6 +62,9 @@ namespace mongo {
         ("port", po::value<int>(&cmdLine.port), "specify port number")
         ("bind_ip", po::value<string>(&cmdLine.bind_ip), "comma separated list of ip addresses to listen on - all local ips by default")
         ("maxConns",po::value<int>(), "max number of simultaneous connections")
+#ifdef __linux__
+        ("netWorkerThreads", po::value<int>(&cmdLine.netWorkerThreads), "process requests on a pool of this many threads rather than a thread per connection. the pool grows while blocking requests (fsyncLock, getLastError w, awaitData) hold all its threads")
+#endif
         ("objcheck", "inspect client data for validity on receipt")
         ("logpath", po::value<string>() , "log file to send write to instead of stdout - has to be a file, not directory" )
         ("logappend" , "append to logpath instead of over-writing" )
@@ -251,6 +254,11 @@ namespace mongo {
             connTicketHolder.resize( newSize );
         }
 
+        if ( cmdLine.netWorkerThreads < 0 ) {
+            out() << "netWorkerThreads can't be negative" << endl;
+            ::exit( EXIT_BADOPTIONS );
+        }
+
         if (params.count("objcheck")) {
             cmdLine.objcheck = true;
         }
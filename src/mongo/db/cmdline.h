@@ -108,9 +108,14 @@ namespace mongo {
         int slowMS;            // --time in ms that is "slow"
 
         int pretouch;          // --pretouch for replication application (experimental)
+        int replWriterThreads; // --replWriterThreads threads applying batches of ops on a secondary
+        string replIndexPrefetch; // --replIndexPrefetch none, _id_only or all
+        int initialSyncThreads; // --initialSyncThreads threads (and connections) cloning for initial sync
         bool moveParanoia;     // for move chunk paranoia
+        int migrateWriterThreads; // --migrateWriterThreads threads inserting a migrated chunk's documents
         double syncdelay;      // seconds between fsyncs
 
+        int netWorkerThreads;  // --netWorkerThreads 0 means a thread per connection
         bool noUnixSocket;     // --nounixsocket
         bool doFork;           // --fork
         string socket;         // UNIX domain socket directory
@@ -156,8 +161,8 @@ namespace mongo {
     inline CmdLine::CmdLine() :
         port(DefaultDBPort), rest(false), jsonp(false), quiet(false), noTableScan(false), prealloc(true), preallocj(true), smallfiles(sizeof(int*) == 4),
         configsvr(false),
-        quota(false), quotaFiles(8), cpu(false), durOptions(0), objcheck(false), oplogSize(0), defaultProfile(0), slowMS(100), pretouch(0), moveParanoia( true ),
-        syncdelay(60), noUnixSocket(false), doFork(0), socket("/tmp") 
+        quota(false), quotaFiles(8), cpu(false), durOptions(0), objcheck(false), oplogSize(0), defaultProfile(0), slowMS(100), pretouch(0), replWriterThreads(16), replIndexPrefetch("all"), initialSyncThreads(8), moveParanoia( true ), migrateWriterThreads(4),
+        syncdelay(60), netWorkerThreads(0), noUnixSocket(false), doFork(0), socket("/tmp") 
     {
         started = time(0);
 
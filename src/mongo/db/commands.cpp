@@ -191,6 +191,8 @@ namespace mongo {
 
     } poolFlushCmd;
 
+    extern DBConnectionPool shardConnectionPool;
+
     class PoolStats : public Command {
     public:
         PoolStats() : Command( "connPoolStats" ) {}
@@ -198,6 +200,11 @@ namespace mongo {
         virtual LockType locktype() const { return NONE; }
         virtual bool run(const string&, mongo::BSONObj&, int, std::string&, mongo::BSONObjBuilder& result, bool) {
             pool.appendInfo( result );
+            {
+                BSONObjBuilder b( result.subobjStart( "shardPool" ) );
+                shardConnectionPool.appendInfo( b );
+                b.done();
+            }
             result.append( "numDBClientConnection" , DBClientConnection::getNumConnections() );
             result.append( "numAScopedConnection" , AScopedConnection::getNumConnections() );
             return true;
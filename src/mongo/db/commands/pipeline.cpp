@@ -33,6 +33,7 @@ namespace mongo {
     const char Pipeline::pipelineName[] = "pipeline";
     const char Pipeline::fromRouterName[] = "fromRouter";
     const char Pipeline::splitMongodPipelineName[] = "splitMongodPipeline";
+    const char Pipeline::maxMemoryBytesName[] = "maxMemoryBytes";
 
     Pipeline::~Pipeline() {
     }
@@ -121,6 +122,17 @@ namespace mongo {
                 continue;
             }
 
+            /* memory budget for $sort and $group before they spill */
+            if (!strcmp(pFieldName, maxMemoryBytesName)) {
+                if (!cmdElement.isNumber() || (cmdElement.numberLong() <= 0)) {
+                    errmsg = str::stream() << "Pipeline::parseCommand(): " <<
+                        maxMemoryBytesName << " must be a positive number";
+                    return intrusive_ptr<Pipeline>();
+                }
+                pCtx->setMaxMemoryBytes((size_t)cmdElement.numberLong());
+                continue;
+            }
+
             /* we didn't recognize a field in the command */
             ostringstream sb;
             sb <<
@@ -336,6 +348,10 @@ namespace mongo {
         if ((btemp = pCtx->getInRouter())) {
             pBuilder->append(fromRouterName, btemp);
         }
+        if (pCtx->getMaxMemoryBytes() != ExpressionContext::DefaultMaxMemoryBytes) {
+            pBuilder->append(maxMemoryBytesName,
+                             (long long)pCtx->getMaxMemoryBytes());
+        }
     }
 
     bool Pipeline::run(BSONObjBuilder &result, string &errmsg,
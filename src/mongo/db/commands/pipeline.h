@@ -137,6 +137,7 @@ namespace mongo {
         static const char pipelineName[];
         static const char fromRouterName[];
         static const char splitMongodPipelineName[];
+        static const char maxMemoryBytesName[];
 
         Pipeline(const intrusive_ptr<ExpressionContext> &pCtx);
 
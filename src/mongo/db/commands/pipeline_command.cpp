@@ -62,18 +62,29 @@ namespace mongo {
     }
 
     void PipelineCommand::help(stringstream &help) const {
-        help << "{ pipeline : [ { <data-pipe-op>: {...}}, ... ] }";
+        help << "{ pipeline : [ { <data-pipe-op>: {...}}, ... ]" <<
+            " [, maxMemoryBytes : <n>] }\n" <<
+            "$sort and $group spill to disk past maxMemoryBytes";
     }
 
     PipelineCommand::~PipelineCommand() {
     }
 
+    /* let $sort and $group spill to the temp directory under dbpath */
+    static void setTempDir(const intrusive_ptr<ExpressionContext> &pCtx) {
+        string tempDir(dbpath);
+        if (tempDir[tempDir.size() - 1] != '/')
+            tempDir += '/';
+        pCtx->setTempDir(tempDir + "_tmp/");
+    }
+
     bool PipelineCommand::run(const string &db, BSONObj &cmdObj,
                               int options, string &errmsg,
                               BSONObjBuilder &result, bool fromRepl) {
 
         intrusive_ptr<ExpressionContext> pCtx(
             ExpressionContext::create(&InterruptStatusMongod::status));
+        setTempDir(pCtx);
 
         /* try to parse the command; if this fails, then we didn't run */
         intrusive_ptr<Pipeline> pPipeline(
@@ -126,6 +137,7 @@ namespace mongo {
         /* on the shard servers, create the local pipeline */
         intrusive_ptr<ExpressionContext> pShardCtx(
             ExpressionContext::create(&InterruptStatusMongod::status));
+        setTempDir(pShardCtx);
         intrusive_ptr<Pipeline> pShardPipeline(
             Pipeline::parseCommand(errmsg, shardBson, pShardCtx));
         if (!pShardPipeline.get()) {
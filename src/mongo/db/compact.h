@@ -35,8 +35,13 @@ namespace mongo {
         void addKeys(const IndexSpec& spec, const BSONObj& o, DiskLoc loc) { 
             BSONObjSet keys;
             spec.getKeys(o, keys);
+            addKeys(keys, loc);
+        }
+
+        /** keys already extracted from a record */
+        void addKeys(const BSONObjSet& keys, DiskLoc loc) { 
             int k = 0;
-            for ( BSONObjSet::iterator i=keys.begin(); i != keys.end(); i++ ) {
+            for ( BSONObjSet::const_iterator i=keys.begin(); i != keys.end(); i++ ) {
                 if( ++k == 2 ) {
                     multi = true;
                 }
@@ -46,6 +46,8 @@ namespace mongo {
         _dbprofile = 0;
         _end = 0;
         _waitingForLock = false;
+        _lockWaitStart = 0;
+        _lockWaitMicros = 0;
         _message = "";
         _progressMeter.finished();
         _killed = false;
@@ -108,12 +110,14 @@ namespace mongo {
     void CurOp::enter( Client::Context * context ) {
         ensureStarted();
         setNS( context->ns() );
+        // usually the same collection as this client's last op, when this looks nothing up
+        Top::global.intern( _client->_topNs , _ns , _op == dbQuery );
         _dbprofile = context->_db ? context->_db->profile : 0;
     }
     
     void CurOp::leave( Client::Context * context ) {
         unsigned long long now = curTimeMicros64();
-        Top::global.record( _ns , _op , _lockType , now - _checkpoint , _command );
+        Top::global.record( _client->_topNs , _op , _lockType , now - _checkpoint , _command );
         _checkpoint = now;
     }
 
@@ -169,8 +169,15 @@ namespace mongo {
         void waitingForLock( char type ) {
             _waitingForLock = true;
             _lockType = type;
+            _lockWaitStart = curTimeMicros64();
         }
-        void gotLock()             { _waitingForLock = false; }
+        void gotLock() {
+            if ( _waitingForLock )
+                _lockWaitMicros += curTimeMicros64() - _lockWaitStart;
+            _waitingForLock = false;
+        }
+        /** time spent waiting for locks so far */
+        unsigned long long lockWaitMicros() const { return _lockWaitMicros; }
         OpDebug& debug()           { return _debug; }
         int profileLevel() const   { return _dbprofile; }
         const char * getNS() const { return _ns; }
@@ -247,6 +254,8 @@ namespace mongo {
         bool _command;
         char _lockType;                   // r w R W
         bool _waitingForLock;
+        unsigned long long _lockWaitStart;
+        unsigned long long _lockWaitMicros;
         int _dbprofile;                  // 0=off, 1=slow, 2=all
         AtomicUInt _opNum;               // todo: simple being "unsigned" may make more sense here
         char _ns[Namespace::MaxNsLen+2];
@@ -47,9 +47,21 @@ namespace mongo {
             y.append("r", (long long) timeAcquiring[2]);
             y.append("w", (long long) timeAcquiring[3]);
         }
+        BSONObjBuilder n;
+        BSONObjBuilder w;
+        const char *types = "RWrw";
+        for( unsigned i = 0; i < N; i++ ) {
+            if( i < 2 || numAcquiring[i] ) {
+                char t[2] = { types[i], 0 };
+                n.append(t, (long long) numAcquiring[i]);
+                w.append(t, (long long) numWaits[i]);
+            }
+        }
         return BSON(
             "timeLocked" << x.obj() << 
-            "timeAcquiring" << y.obj()
+            "timeAcquiring" << y.obj() <<
+            "acquireCount" << n.obj() <<
+            "acquireWaitCount" << w.obj()
         );
     }
 
@@ -74,7 +86,11 @@ namespace mongo {
     // hmmm....
 
     inline LockStat::Acquiring::~Acquiring() { 
-        ls.timeAcquiring[type] += tmr.micros();
+        unsigned long long t = tmr.micros();
+        ls.timeAcquiring[type] += t;
+        ls.numAcquiring[type] += 1;
+        if( t )
+            ls.numWaits[type] += 1;
         if( type == 1 ) 
             ls.W_Timer.reset();
     }
@@ -88,16 +104,22 @@ namespace mongo {
 
 namespace mongo { 
 
+    /** a database or collection lock.  a QLock so that a database can also be locked in 
+        intent mode ('w') by CollectionWrite; DBWrite and DBRead use W and R.
+    */
     class WrapperForRWLock : boost::noncopyable { 
-        SimpleRWLock r;
+        QLock q;
+        const string _name;
     public:
-        string name() const { return r.name; }
+        string name() const { return _name; }
         LockStat stats;
-        WrapperForRWLock(const char *name) : r(name) { }
-        void lock()          { LockStat::Acquiring a(stats,'W'); r.lock();          }
-        void lock_shared()   { LockStat::Acquiring a(stats,'R'); r.lock_shared();   }
-        void unlock()        { stats.unlocking('W');             r.unlock();        }
-        void unlock_shared() { stats.unlocking('R');             r.unlock_shared(); }
+        WrapperForRWLock(const char *name) : _name(name) { }
+        void lock()          { LockStat::Acquiring a(stats,'W'); q.lock_W(); }
+        void lock_shared()   { LockStat::Acquiring a(stats,'R'); q.lock_R(); }
+        void lock_intent()   { LockStat::Acquiring a(stats,'w'); q.lock_w(); }
+        void unlock()        { stats.unlocking('W');             q.unlock_W(); }
+        void unlock_shared() { stats.unlocking('R');             q.unlock_R(); }
+        void unlock_intent() { stats.unlocking('w');             q.unlock_w(); }
     };
 
     class DBTryLockTimeoutException : public std::exception {
@@ -143,6 +165,17 @@ namespace mongo {
     */
     static mapsf<string,WrapperForRWLock*> dblocks;
 
+    /* ns->lock for CollectionWrite.  like dblocks these are never deleted. */
+    static mapsf<string,WrapperForRWLock*> collectionlocks;
+
+    static WrapperForRWLock* getLock(mapsf<string,WrapperForRWLock*>& locks, const string& name) {
+        mapsf<string,WrapperForRWLock*>::ref r(locks);
+        WrapperForRWLock*& lock = r[name];
+        if( lock == 0 )
+            lock = new WrapperForRWLock(name.c_str());
+        return lock;
+    }
+
     /* we don't want to touch dblocks too much as a mutex is involved.  thus party for that, 
        this is here...
     */
@@ -192,9 +225,25 @@ namespace mongo {
         b.append("admin", nestableLocks[Lock::local]->stats.report());
         b.append("local", nestableLocks[Lock::local]->stats.report());
         {
+            // each database's collection locks, which sort together as they all start "<db>."
             mapsf<string,WrapperForRWLock*>::ref r(dblocks);
+            mapsf<string,WrapperForRWLock*>::ref c(collectionlocks);
             for( map<string,WrapperForRWLock*>::const_iterator i = r.r.begin(); i != r.r.end(); i++ ) {
-                b.append(i->first, i->second->stats.report());
+                BSONObj stats = i->second->stats.report();
+                string prefix = i->first + '.';
+                map<string,WrapperForRWLock*>::const_iterator j = c.r.lower_bound(prefix);
+                if( j == c.r.end() || !str::startsWith(j->first, prefix) ) {
+                    b.append(i->first, stats);
+                    continue;
+                }
+                BSONObjBuilder d(b.subobjStart(i->first));
+                d.appendElements(stats);
+                BSONObjBuilder colls(d.subobjStart("collections"));
+                for( ; j != c.r.end() && str::startsWith(j->first, prefix); j++ ) {
+                    colls.append(j->first.substr(prefix.size()), j->second->stats.report());
+                }
+                colls.done();
+                d.done();
             }
         }
         result.append("locks", b.obj());
@@ -249,8 +298,11 @@ namespace mongo {
           _threadState(0),
           _whichNestable( Lock::notnestable ),
           _nestableCount(0), 
+          _nestableIntent(false),
           _otherCount(0), 
           _otherLock(NULL),
+          _collectionLock(NULL),
+          _batchWriter(false),
           _scopedLk(NULL)
     {
     }
@@ -286,14 +338,20 @@ namespace mongo {
                 s = ".local";
             else if( _whichNestable == Lock::admin ) 
                 s = ".admin";
-            b.append(s, kind(_nestableCount));
+            b.append(s, _nestableIntent ? "w" : kind(_nestableCount));
         }
         if( _otherCount ) { 
             WrapperForRWLock *k = _otherLock;
+            WrapperForRWLock *c = _collectionLock;
             if( k ) {
                 string s = ".";
                 s += k->name();
-                b.append(s, kind(_otherCount));
+                b.append(s, c ? "w" : kind(_otherCount));
+            }
+            if( c ) {
+                string s = ".";
+                s += c->name();
+                b.append(s, "W");
             }
         }
         BSONObj o = b.obj();
@@ -320,8 +378,11 @@ namespace mongo {
             if( _otherCount ) {
                 ss << " otherdb:" << _otherName;
             }
+            if( _collectionLock ) {
+                ss << " collection:" << _collectionName;
+            }
             if( _nestableCount ) {
-                ss << " nestableCount:" << _nestableCount << " which:";
+                ss << " nestableCount:" << _nestableCount << ( _nestableIntent ? " intent" : "" ) << " which:";
                 if( _whichNestable == Lock::local ) 
                     ss << "local";
                 else if( _whichNestable == Lock::admin ) 
@@ -363,6 +424,7 @@ namespace mongo {
     void LockState::unlockedNestable() {
         _whichNestable = Lock::notnestable;
         _nestableCount = 0;
+        _nestableIntent = false;
     }
 
     void LockState::lockedOther( const string& other , int type , WrapperForRWLock* lock ) {
@@ -372,10 +434,18 @@ namespace mongo {
         _otherLock = lock;
     }
 
+    void LockState::lockedCollection( const string& db , WrapperForRWLock* dbLock , const string& ns , WrapperForRWLock* lock ) {
+        lockedOther( db , 1 , dbLock );
+        _collectionName = ns;
+        _collectionLock = lock;
+    }
+
     void LockState::unlockedOther() {
         _otherName = "";
         _otherCount = 0;
         _otherLock = 0;
+        _collectionName = "";
+        _collectionLock = 0;
     }
 
     char threadState() { 
@@ -486,6 +556,23 @@ namespace mongo {
         // (such as including local) 
         return lockState().recursiveCount() > 1;
     }
+    /** with just a collection locked we may use it and its indexes, and, for allocating extents,
+        the database's files and free extents.  
+        @param dbItself if the bare database name counts
+    */
+    static bool collectionCovers(const LockState &ls, const StringData& ns, bool dbItself) { 
+        const string& coll = ls.collectionName();
+        const char *p = ns.data();
+        if( strchr(p, '.') == 0 )
+            return dbItself;
+        if( strncmp(p, coll.c_str(), coll.size()) == 0 ) {
+            // the collection itself, or one of its indexes "<coll>.$<index>"
+            char c = p[coll.size()];
+            if( c == 0 || ( c == '.' && p[coll.size()+1] == '$' ) )
+                return true;
+        }
+        return dbItself && ls.otherName() + ".$freelist" == p;
+    }
     static bool weLocked(const LockState &ls, const StringData& ns) { 
         char db[MaxDatabaseNameLen];
         nsToDatabase(ns.data(), db);
@@ -499,7 +586,9 @@ namespace mongo {
                 return ls.nestableCount();
             return false;
         }
-        return db == ls.otherName() && ls.otherCount();
+        if( db != ls.otherName() || !ls.otherCount() )
+            return false;
+        return !ls.collectionLock() || collectionCovers(ls, ns, true);
     }
     bool Lock::isWriteLocked(const StringData& ns) { 
         LockState &ls = lockState();
@@ -509,6 +598,9 @@ namespace mongo {
             return false;
         return weLocked(ls,ns);
     }
+    bool Lock::isCollectionWriteLocked() { 
+        return lockState().collectionLock() != 0;
+    }
     bool Lock::atLeastReadLocked(const StringData& ns)
     { 
         LockState &ls = lockState();
@@ -536,6 +628,23 @@ namespace mongo {
         return DB_LEVEL_LOCKING_ENABLED;
     }
     
+    RWLockRecursive Lock::ParallelBatchWriterMode::_batchLock("special");
+
+    void Lock::ParallelBatchWriterMode::iAmABatchParticipant() {
+        lockState().setIsBatchWriter(true);
+    }
+
+    Lock::ParallelBatchWriterSupport::ParallelBatchWriterSupport() {
+        relock();
+    }
+    void Lock::ParallelBatchWriterSupport::tempRelease() {
+        _lk.reset();
+    }
+    void Lock::ParallelBatchWriterSupport::relock() {
+        if( !lockState().isBatchWriter() )
+            _lk.reset( new RWLockRecursive::Shared(ParallelBatchWriterMode::_batchLock) );
+    }
+
     Lock::ScopedLock::ScopedLock() {
         LockState& ls = lockState();
         ls.enterScopedLock( this );
@@ -546,6 +655,14 @@ namespace mongo {
         Lock::ScopedLock* what = ls.leaveScopedLock();
         fassert( 16171 , prevCount != 1 || what == this );
     }
+    void Lock::ScopedLock::_tempRelease() {
+        tempRelease();
+        _pbws_lk.tempRelease(); // let a pending batch apply run while we are yielded
+    }
+    void Lock::ScopedLock::_relock() {
+        _pbws_lk.relock(); // batch lock first, same order as when we first locked
+        relock();
+    }
 
     Lock::TempRelease::TempRelease() : cant( Lock::nested() )
     {
@@ -559,7 +676,7 @@ namespace mongo {
         
         scopedLk = ls.leaveScopedLock();
         fassert( 16118, scopedLk );
-        scopedLk->tempRelease();
+        scopedLk->_tempRelease();
     }
     Lock::TempRelease::~TempRelease()
     {
@@ -574,7 +691,7 @@ namespace mongo {
         fassert( 16120 , ls.threadState() == 0 );
 
         ls.enterScopedLock( scopedLk );
-        scopedLk->relock();
+        scopedLk->_relock();
     }
 
     void Lock::GlobalWrite::tempRelease() { 
@@ -732,6 +849,7 @@ namespace mongo {
                 fassert(16131,false);
             }
             verify( ls.nestableCount() > 0 );
+            massert(16411, "can't lock local for writing while appending to the oplog", !ls.nestableIntent());
         }
         else {
             fassert(16132,weLocked==0);
@@ -809,6 +927,8 @@ namespace mongo {
                 locked_W = true;
                 return;
             } 
+            massert(16405, str::stream() << "can't lock " << ns << " for writing when just " << ls.collectionName() << " is locked", 
+                    nested || !ls.collectionLock() || collectionCovers(ls, ns, false));
             if( !nested )
                 lockOther(db);
             lockTop(ls);
@@ -832,6 +952,8 @@ namespace mongo {
             char db[MaxDatabaseNameLen];
             nsToDatabase(ns.data(), db);
             Nestable nested = n(db);
+            massert(16406, str::stream() << "can't lock " << ns << " for reading when just " << ls.collectionName() << " is locked", 
+                    nested || !ls.collectionLock() || collectionCovers(ls, ns, false));
             if( !nested )
                 lockOther(db);
             lockTop(ls);
@@ -969,6 +1091,122 @@ namespace mongo {
     }
 
 
+    Lock::CollectionWrite::CollectionWrite( const StringData& ns ) : 
+        _ns(ns.data()), _dbLock(0), _collLock(0), _locked(false), _locked_W(false)
+    {
+        LockState& ls = lockState();
+        massert(16404, str::stream() << "can't lock collection " << _ns << " when something is already locked", ls.threadState() == 0);
+        char db[MaxDatabaseNameLen];
+        nsToDatabase(_ns.c_str(), db);
+        _db = db;
+        verify( n(db) == notnestable );
+        if( DB_LEVEL_LOCKING_ENABLED ) {
+            _dbLock = getLock(dblocks, _db);
+            _collLock = getLock(collectionlocks, _ns);
+        }
+        lock();
+    }
+    Lock::CollectionWrite::~CollectionWrite() {
+        unlock();
+    }
+    void Lock::CollectionWrite::tempRelease() { 
+        unlock();
+    }
+    void Lock::CollectionWrite::relock() { 
+        lock();
+    }
+
+    /** database intent, then the collection, then the global 'w' last as DBWrite does: nothing may
+        wait on another lock with the global 'w' held, or a runExclusively() commit would wait on it.
+    */
+    void Lock::CollectionWrite::lock() {
+        Acquiring a( 'w' );
+        if( !DB_LEVEL_LOCKING_ENABLED ) { 
+            lock_W();
+            _locked_W = true;
+            return;
+        }
+        LockState& ls = lockState();
+        ls.lockedCollection( _db , _dbLock , _ns , _collLock );
+        _dbLock->lock_intent();
+        _collLock->lock();
+        lock_w();
+        _locked = true;
+    }
+    void Lock::CollectionWrite::unlock() { 
+        if( _locked_W ) { 
+            unlock_W();
+            _locked_W = false;
+        }
+        if( _locked ) { 
+            unlock_w();
+            lockState().unlockedOther();
+            _collLock->unlock();
+            _dbLock->unlock_intent();
+            _locked = false;
+        }
+    }
+
+    Lock::OplogAppend::OplogAppend() : _local(0), _locked_w(false), _locked_W(false) {
+        lock();
+    }
+    Lock::OplogAppend::~OplogAppend() {
+        unlock();
+    }
+    void Lock::OplogAppend::tempRelease() { 
+        unlock();
+    }
+    void Lock::OplogAppend::relock() { 
+        lock();
+    }
+
+    /** as DBWrite("local"): the global 'w' if we don't have it yet, then local, but in intent mode */
+    void Lock::OplogAppend::lock() {
+        Acquiring a( 'w' );
+        LockState& ls = lockState();
+        if( ls.threadState() == 'W' )
+            return;
+        if( !DB_LEVEL_LOCKING_ENABLED ) { 
+            lock_W();
+            _locked_W = true;
+            return;
+        }
+        if( ls.nestableCount() ) { 
+            // already have local (or admin) locked
+            massert(16412, "can't append to the oplog with local read locked", 
+                    ls.whichNestable() == local && ls.nestableCount() > 0);
+            return;
+        }
+        switch( ls.threadState() ) { 
+        case 'w':
+            break;
+        default:
+            verify(false);
+        case  0  : 
+            lock_w();
+            _locked_w = true;
+        }
+        ls.lockedNestable(local, 1);
+        ls.setNestableIntent(true);
+        _local = nestableLocks[local];
+        _local->lock_intent();
+    }
+    void Lock::OplogAppend::unlock() { 
+        if( _local ) { 
+            lockState().unlockedNestable();
+            _local->unlock_intent();
+            _local = 0;
+        }
+        if( _locked_w ) { 
+            unlock_w();
+            _locked_w = false;
+        }
+        if( _locked_W ) { 
+            unlock_W();
+            _locked_W = false;
+        }
+    }
+
     writelocktry::writelocktry( int tryms ) : 
         _got( false ),
         _dbwlock( NULL )
@@ -6,6 +6,7 @@
 
 #include "mongo/util/concurrency/qlock.h"
 #include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/concurrency/rwlock.h"
 #include "mongo/bson/stringdata.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/lockstat.h"
@@ -26,6 +27,7 @@ namespace mongo {
         static bool isRW();         // R or W. i.e., we are write-exclusive          
         static bool nested();
         static bool isWriteLocked(const StringData& ns);
+        static bool isCollectionWriteLocked(); // just a collection, see CollectionWrite
         static bool atLeastReadLocked(const StringData& ns); // true if this db is locked
         static void assertAtLeastReadLocked(const StringData& ns);
         static void assertWriteLocked(const StringData& ns);
@@ -34,6 +36,19 @@ namespace mongo {
 
         class ScopedLock;
 
+        /** a secondary applies a batch of oplog operations with several writer threads.  readers 
+            must not see a partially applied batch, so the batch applier holds this exclusively 
+            for the duration of the batch; every other ScopedLock holds it shared.  the writer 
+            threads of the batch call iAmABatchParticipant() so they are not blocked by it.
+        */
+        class ParallelBatchWriterMode : boost::noncopyable {
+            RWLockRecursive::Exclusive _lk;
+        public:
+            ParallelBatchWriterMode() : _lk(_batchLock) { }
+            static void iAmABatchParticipant();
+            static RWLockRecursive _batchLock;
+        };
+
         // note: avoid TempRelease when possible. not a good thing.
         struct TempRelease {
             TempRelease(); 
@@ -42,7 +57,20 @@ namespace mongo {
             ScopedLock *scopedLk;
         };
 
+    private:
+        class ParallelBatchWriterSupport : boost::noncopyable {
+            scoped_ptr<RWLockRecursive::Shared> _lk;
+        public:
+            ParallelBatchWriterSupport();
+            void tempRelease();
+            void relock();
+        };
+
+    public:
         class ScopedLock : boost::noncopyable {
+            ParallelBatchWriterSupport _pbws_lk;
+            void _tempRelease();
+            void _relock();
         protected: 
             friend struct TempRelease;
             ScopedLock(); 
@@ -122,6 +150,48 @@ namespace mongo {
             DBRead(const StringData& dbOrNs);
             virtual ~DBRead();
         };
+        /** lock one collection for writing.  its database is locked in intent mode, so writers to
+            other collections of the database go on at the same time while DBWrite and DBRead of 
+            the database wait.  only for writes within the collection's existing records, extents 
+            and indexes: adding or removing a namespace needs DBWrite, and new extents come from 
+            Database::allocExtent() which serializes allocation within the database.
+            not for local or admin, and not when something is already locked.
+        */
+        class CollectionWrite : public ScopedLock {
+            const string _ns;
+            string _db;
+            WrapperForRWLock *_dbLock;
+            WrapperForRWLock *_collLock;
+            bool _locked;
+            bool _locked_W;
+            void lock();
+            void unlock();
+        protected:
+            void tempRelease();
+            void relock();
+        public:
+            CollectionWrite(const StringData& ns);
+            virtual ~CollectionWrite();
+        };
+        /** for appending to local.oplog.rs.  local is locked in intent mode, so writers to different
+            databases append at the same time while DBRead and DBWrite of local wait for them all. 
+            each appender reserves its record under OpTime::m and fills it in outside of that (see
+            _logOpRS()).  counts as a write lock on local for its duration, but local may not be 
+            locked again for writing within it.  a no-op when local is already write locked.
+        */
+        class OplogAppend : public ScopedLock {
+            WrapperForRWLock *_local;
+            bool _locked_w;
+            bool _locked_W;
+            void lock();
+            void unlock();
+        protected:
+            void tempRelease();
+            void relock();
+        public:
+            OplogAppend();
+            virtual ~OplogAppend();
+        };
 
     };
 
@@ -183,13 +253,23 @@ namespace mongo {
         int otherCount() const { return _otherCount; }
         string otherName() const { return _otherName; }
         WrapperForRWLock* otherLock() const { return _otherLock; }
+
+        const string& collectionName() const { return _collectionName; }
+        WrapperForRWLock* collectionLock() const { return _collectionLock; }
         
         void enterScopedLock( Lock::ScopedLock* lock );
         Lock::ScopedLock* leaveScopedLock();
 
+        bool isBatchWriter() const { return _batchWriter; }
+        void setIsBatchWriter(bool v) { _batchWriter = v; }
+
         void lockedNestable( Lock::Nestable what , int type );
         void unlockedNestable();
+        /** local is locked in intent mode by an OplogAppend */
+        bool nestableIntent() const { return _nestableIntent; }
+        void setNestableIntent(bool v) { _nestableIntent = v; }
         void lockedOther( const string& db , int type , WrapperForRWLock* lock );
+        void lockedCollection( const string& db , WrapperForRWLock* dbLock , const string& ns , WrapperForRWLock* lock );
         void unlockedOther();
     private:
         unsigned _recursive;           // we allow recursively asking for a lock; we track that here
@@ -200,11 +280,18 @@ namespace mongo {
         // db level locking related
         Lock::Nestable _whichNestable;
         int _nestableCount;            // recursive lock count on local or admin db XXX - change name
+        bool _nestableIntent;          // with an OplogAppend _nestableCount is 1 but local is held in intent mode
         
         int _otherCount;               //   >0 means write lock, <0 read lock - XXX change name
         string _otherName;             // which database are we locking and working with (besides local/admin) 
         WrapperForRWLock* _otherLock;  // so we don't have to check the map too often (the map has a mutex)
 
+        // with a CollectionWrite the other db is locked in intent mode and this collection exclusively
+        string _collectionName;
+        WrapperForRWLock* _collectionLock;
+
+        bool _batchWriter;             // a writer thread of a secondary's parallel batch apply
+
         // for temprelease
         // for the nonrecursive case. otherwise there would be many
         // the first lock goes here, which is ok since we can't yield recursive locks
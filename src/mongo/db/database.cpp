@@ -59,9 +59,10 @@ namespace mongo {
     }
 
     Database::Database(const char *nm, bool& newDb, const string& _path )
-        : name(nm), path(_path), namespaceIndex( path, name ),
+        : name(nm), path(_path), _allocExtentMutex("allocExtent"), namespaceIndex( path, name ),
           profileName(name + ".system.profile")
     {
+        _files.reserve( DiskLoc::MaxFiles );
         try {
             {
                 // check db name is valid
@@ -342,6 +343,7 @@ namespace mongo {
 
 
     Extent* Database::allocExtent( const char *ns, int size, bool capped, bool enforceQuota ) {
+        SimpleMutex::scoped_lock lk( _allocExtentMutex );
         // todo: when profiling, these may be worth logging into profile collection
         bool fromFreeList = true;
         Extent *e = DataFileMgr::allocFromFreeList( ns, size, capped );
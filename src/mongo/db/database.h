@@ -131,8 +131,14 @@ namespace mongo {
         // must be in the dbLock when touching this (and write locked when writing to of course)
         // however during Database object construction we aren't, which is ok as it isn't yet visible
         //   to others and we are in the dbholder lock then.
+        // with Lock::CollectionWrite a file may be added while other writers read the vector, so
+        //   it is reserved to DiskLoc::MaxFiles up front and never reallocates.
         vector<MongoDataFile*> _files;
 
+        // writers of different collections (Lock::CollectionWrite) share the database's files and 
+        // free extents, so allocExtent() holds this
+        SimpleMutex _allocExtentMutex;
+
     public: // this should be private later
 
         NamespaceIndex namespaceIndex;
@@ -43,8 +43,11 @@
 #include "dbwebserver.h"
 #include "dur.h"
 #include "d_concurrency.h"
+#include "../s/d_logic.h"
 #include "../s/d_writeback.h"
 #include "d_globals.h"
+#include "prefetch.h"
+#include "nonce.h"
 
 #if defined(_WIN32)
 # include "../util/ntservice.h"
@@ -228,6 +231,39 @@ namespace mongo {
             globalScriptEngine->threadDone();
         }
 
+        /** a connection's Client, sharding info and nonce, while it is off a worker thread */
+        class ConnectionState : public ThreadState {
+        public:
+            ConnectionState() : client(0), sharding(0), nonce(0) { }
+            virtual ~ConnectionState() {
+                delete client;
+                delete sharding;
+                delete nonce;
+            }
+            Client *client;
+            ShardedConnectionInfo *sharding;
+            nonce64 *nonce;
+        };
+
+        virtual ThreadState* newThreadState() { return new ConnectionState(); }
+
+        virtual void attach( ThreadState* s ) {
+            ConnectionState *cs = static_cast<ConnectionState*>( s );
+            currentClient.reset( cs->client );
+            ShardedConnectionInfo::attach( cs->sharding );
+            lastNonce.reset( cs->nonce );
+            cs->client = 0;
+            cs->sharding = 0;
+            cs->nonce = 0;
+        }
+
+        virtual void detach( ThreadState* s ) {
+            ConnectionState *cs = static_cast<ConnectionState*>( s );
+            cs->client = currentClient.release();
+            cs->sharding = ShardedConnectionInfo::detach();
+            cs->nonce = lastNonce.release();
+        }
+
     };
 
     void listen(int port) {
@@ -235,6 +271,7 @@ namespace mongo {
         MessageServer::Options options;
         options.port = port;
         options.ipList = cmdLine.bind_ip;
+        options.workerThreads = cmdLine.netWorkerThreads;
 
         MessageServer * server = createServer( options , new MyMessageHandler() );
         server->setAsTimeTracker();
@@ -526,6 +563,7 @@ namespace mongo {
         snapshotThread.go();
         d.clientCursorMonitor.go();
         PeriodicTask::theRunner->go();
+        startFreeListCoalescer();
         
 #ifndef _WIN32
         CmdLine::launchOk();
@@ -666,12 +704,16 @@ int main(int argc, char* argv[]) {
 
     rs_options.add_options()
     ("replSet", po::value<string>(), "arg is <setname>[/<optionalseedhostlist>]")
+    ("replWriterThreads", po::value<int>(), "number of threads a secondary uses to apply replicated operations (default 16)")
+    ("replIndexPrefetch", po::value<string>(), "index pages a secondary reads in before applying an op: none, _id_only or all (default all)")
+    ("initialSyncThreads", po::value<int>(), "number of threads, each with a connection, cloning collections for an initial sync (default 8)")
     ;
 
     sharding_options.add_options()
     ("configsvr", "declare this is a config db of a cluster; default port 27019; default dir /data/configdb")
     ("shardsvr", "declare this is a shard db of a cluster; default port 27018")
     ("noMoveParanoia" , "turn off paranoid saving of data for moveChunk.  this is on by default for now, but default will switch" )
+    ("migrateWriterThreads", po::value<int>(), "number of threads inserting the documents of a chunk migrated to this shard (default 4)")
     ;
 
     hidden_options.add_options()
@@ -897,6 +939,26 @@ int main(int argc, char* argv[]) {
         if( params.count("pretouch") ) {
             cmdLine.pretouch = params["pretouch"].as<int>();
         }
+        if( params.count("replWriterThreads") ) {
+            cmdLine.replWriterThreads = params["replWriterThreads"].as<int>();
+            if( cmdLine.replWriterThreads < 1 ) {
+                out() << "bad --replWriterThreads arg" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
+        if( params.count("replIndexPrefetch") ) {
+            if( !setReplIndexPrefetch( params["replIndexPrefetch"].as<string>() ) ) {
+                out() << "bad --replIndexPrefetch arg, must be none, _id_only or all" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
+        if( params.count("initialSyncThreads") ) {
+            cmdLine.initialSyncThreads = params["initialSyncThreads"].as<int>();
+            if( cmdLine.initialSyncThreads < 1 ) {
+                out() << "bad --initialSyncThreads arg" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
         if (params.count("replSet")) {
             if (params.count("slavedelay")) {
                 out() << "--slavedelay cannot be used with --replSet" << endl;
@@ -980,6 +1042,13 @@ int main(int argc, char* argv[]) {
         if (params.count("ipv6")) {
             enableIPv6();
         }
+        if( params.count("migrateWriterThreads") ) {
+            cmdLine.migrateWriterThreads = params["migrateWriterThreads"].as<int>();
+            if( cmdLine.migrateWriterThreads < 1 ) {
+                out() << "bad --migrateWriterThreads arg" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
         if (params.count("noMoveParanoia")) {
             cmdLine.moveParanoia = false;
         }
@@ -44,10 +44,13 @@
 #include "queryoptimizer.h"
 #include "../scripting/engine.h"
 #include "stats/counters.h"
+#include "stats/latency.h"
 #include "background.h"
 #include "../util/version.h"
 #include "../s/d_writeback.h"
 #include "dur_stats.h"
+#include "pagefault.h"
+#include "prefetch.h"
 #include "../server.h"
 
 namespace mongo {
@@ -64,6 +67,15 @@ namespace mongo {
             dur::setAgeOutJournalFiles(r);
             return true;
         }
+        e = cmdObj["replIndexPrefetch"];
+        if( !e.eoo() ) {
+            string was = cmdLine.replIndexPrefetch;
+            uassert( 16409 , "replIndexPrefetch must be none, _id_only or all" ,
+                     e.type() == String && setReplIndexPrefetch( e.String() ) );
+            result.append("was", was);
+            log() << "setParameter replIndexPrefetch=" << e.String() << endl;
+            return true;
+        }
         return false;
     }
 
@@ -572,6 +584,12 @@ namespace mongo {
                 bb.done();
             }
 
+            {
+                BSONObjBuilder bb( result.subobjStart( "recordStats" ) );
+                recordStats.append( bb );
+                bb.done();
+            }
+
             {
                 BSONObjBuilder bb( result.subobjStart( "network" ) );
                 networkCounter.append( bb );
@@ -584,6 +602,11 @@ namespace mongo {
             if ( anyReplEnabled() ) {
                 BSONObjBuilder bb( result.subobjStart( "repl" ) );
                 appendReplicationInfo( bb , authed , cmdObj["repl"].numberInt() );
+                if ( replSet ) {
+                    BSONObjBuilder apply( bb.subobjStart( "apply" ) );
+                    replApplyStats.append( apply );
+                    apply.done();
+                }
                 bb.done();
 
                 if ( ! _isMaster() ) {
@@ -596,6 +619,12 @@ namespace mongo {
 
             result.append( "opcounters" , globalOpCounters.getObj() );
 
+            {
+                BSONObjBuilder bb( result.subobjStart( "opLatencies" ) );
+                opLatencies.append( bb , cmdObj["opLatencies"].numberInt() > 1 );
+                bb.done();
+            }
+
             {
                 BSONObjBuilder asserts( result.subobjStart( "asserts" ) );
                 asserts.append( "regular" , assertionCount.regular );
@@ -986,6 +1015,51 @@ namespace mongo {
         }
     } cmdReIndex;
 
+    class CmdPlanCache : public Command {
+    public:
+        virtual bool logTheOp() { return false; }
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return READ; }
+        virtual void help( stringstream& help ) const {
+            help << "query plans cached for a collection, by query shape\n"
+                "{ planCache: <collection> } lists the plans and their statistics\n"
+                "{ planCache: <collection>, pin: <bool>, query: <query>[, sort: <sort>] } pins or unpins the plans for a shape\n"
+                "{ planCache: <collection>, clear: true } clears the cache";
+        }
+        CmdPlanCache() : Command("planCache") { }
+        bool run(const string& dbname , BSONObj& jsobj, int, string& errmsg, BSONObjBuilder& result, bool /*fromRepl*/) {
+            string ns = dbname + '.' + jsobj.firstElement().valuestrsafe();
+            if ( !nsdetails( ns.c_str() ) ) {
+                errmsg = "ns not found";
+                return false;
+            }
+
+            if ( jsobj["clear"].trueValue() ) {
+                SimpleMutex::scoped_lock lk(NamespaceDetailsTransient::_qcMutex);
+                NamespaceDetailsTransient::get_inlock( ns.c_str() ).clearQueryCache();
+                return true;
+            }
+
+            if ( jsobj.hasField( "pin" ) ) {
+                BSONElement query = jsobj["query"];
+                uassert( 16390, "pin requires a query", query.type() == Object );
+                BSONObj sort = jsobj["sort"].type() == Object ? jsobj["sort"].embeddedObject() : BSONObj();
+                FieldRangeSetPair frsp( ns.c_str(), query.embeddedObject() );
+                int n = QueryUtilIndexed::pinIndexesForPatterns( frsp, sort, jsobj["pin"].trueValue() );
+                if ( n == 0 ) {
+                    errmsg = "no plan cached for this query shape";
+                    return false;
+                }
+                result.append( "n", n );
+                return true;
+            }
+
+            SimpleMutex::scoped_lock lk(NamespaceDetailsTransient::_qcMutex);
+            NamespaceDetailsTransient::get_inlock( ns.c_str() ).queryPlanCache().appendStats( result );
+            return true;
+        }
+    } cmdPlanCache;
+
     class CmdListDatabases : public Command {
     public:
         virtual bool slaveOk() const {
@@ -1312,6 +1386,37 @@ namespace mongo {
     }
 
     class CollectionStats : public Command {
+        /** the deleted lists, so fragmentation shows.  long lists are only partly looked at. */
+        static void appendFreeListStats( NamespaceDetails *nsd, BSONObjBuilder& result, int scale ) {
+            NamespaceDetails::FreeListStats s;
+            nsd->freeListStats( s, 100000 );
+            BSONObjBuilder b( result.subobjStart( "freeList" ) );
+            b.appendNumber( "count" , s.records );
+            b.appendNumber( "size" , s.size / scale );
+            b.append( "largest" , s.largest / scale );
+            b.appendNumber( "coalescible" , s.coalescible );
+            {
+                BSONObjBuilder buckets( b.subobjStart( "buckets" ) );
+                for ( int i = 0; i < Buckets; i++ ) {
+                    if ( s.byBucket[i] )
+                        buckets.appendNumber( BSONObjBuilder::numStr( bucketSizes[i] ) , s.byBucket[i] );
+                }
+                buckets.done();
+            }
+            if ( s.truncated )
+                b.appendBool( "truncated" , true );
+            b.done();
+
+            // the part of the free space on lists whose records are all smaller than an average
+            // document with its header
+            if ( s.size ) {
+                int avg = nsd->averageObjectSize() + Record::HeaderSize;
+                long long small = 0;
+                for ( int i = 0; i < Buckets && bucketSizes[i] <= avg; i++ )
+                    small += s.sizeByBucket[i];
+                result.append( "fragmentation" , (double) small / s.size );
+            }
+        }
     public:
         CollectionStats() : Command( "collStats", false, "collstats" ) {}
         virtual bool slaveOk() const { return true; }
@@ -1372,6 +1477,9 @@ namespace mongo {
                 result.append( "capped" , nsd->isCapped() );
                 result.appendNumber( "max" , nsd->maxCappedDocs() );
             }
+            else {
+                appendFreeListStats( nsd, result, scale );
+            }
 
             if ( verbose )
                 result.appendArray( "extents" , extents.arr() );
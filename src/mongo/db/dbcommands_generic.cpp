@@ -159,6 +159,9 @@ namespace mongo {
             if( all || cmdObj.hasElement("replApplyBatchSize") ) {
                 result.append("replApplyBatchSize", replApplyBatchSize);
             }
+            if( all || cmdObj.hasElement("replIndexPrefetch") ) {
+                result.append("replIndexPrefetch", cmdLine.replIndexPrefetch);
+            }
 
             if ( before == result.len() ) {
                 errmsg = "no option found to get";
@@ -185,6 +188,7 @@ namespace mongo {
             help << "  logLevel\n";
             help << "  notablescan\n";
             help << "  quiet\n";
+            help << "  replIndexPrefetch\n";
             help << "  syncdelay\n";
         }
         bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
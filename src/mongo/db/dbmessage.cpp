@@ -60,18 +60,17 @@ namespace mongo {
                       int nReturned, int startingFrom,
                       long long cursorId 
                       ) {
-        BufBuilder b(32768);
-        b.skip(sizeof(QueryResult));
-        b.appendBuf(data, size);
-        QueryResult *qr = (QueryResult *) b.buf();
+        // the header and the results go out from where they are, without copying them together
+        char header[sizeof(QueryResult)];
+        QueryResult *qr = (QueryResult *) header;
         qr->_resultFlags() = queryResultFlags;
-        qr->len = b.len();
         qr->setOperation(opReply);
         qr->cursorId = cursorId;
         qr->startingFrom = startingFrom;
         qr->nReturned = nReturned;
-        b.decouple();
-        Message resp(qr, true);
+        Message resp;
+        resp.appendUnownedData(header, sizeof(QueryResult));
+        resp.appendUnownedData((char *) data, size);
         p->reply(requestMsg, resp, requestMsg.header()->id);
     }
 
@@ -41,15 +41,23 @@
      READLOCK dbMutex
      LOCK groupCommitMutex
        PREPLOGBUFFER()
-     READLOCK mmmutex
        commitJob.reset()
      UNLOCK dbMutex                                     // now other threads can write
        WRITETOJOURNAL()
+       wait for the previous batch to reach the data files
+       hand this batch to the durDataFiles thread
+     UNLOCK groupCommitMutex
+
+     durDataFiles thread:
+     READLOCK mmmutex
        WRITETODATAFILES()
      UNLOCK mmmutex
-     UNLOCK groupCommitMutex
+
+     so the commit is a pipeline: while one batch is written to the data files, the next is
+     journaled, and the one after that gathers intents in commitJob.
 
      on the next write lock acquisition for dbMutex:    // see MongoMutex::_acquiredWriteLock()
+       wait for the data files write in flight, if any
        REMAPPRIVATEVIEW()
 
      @see https://docs.google.com/drawings/edit?id=1TklsmZzm7ohIZkwgeK6rMvsdaR13KjtJYMsfLr175Zc
@@ -110,7 +118,7 @@ namespace mongo {
                         string _CSVHeader();
 
         string Stats::S::_CSVHeader() { 
-            return "cmts  jrnMB\twrDFMB\tcIWLk\tearly\tprpLgB  wrToJ\twrToDF\trmpPrVw";
+            return "cmts  jrnMB\twrDFMB\tcIWLk\tearly\tprpLgB  wrToJ\twrToDF\trmpPrVw\twtDF";
         }
 
         string Stats::S::_asCSV() { 
@@ -125,7 +133,8 @@ namespace mongo {
                 (unsigned) (_prepLogBufferMicros/1000) << '\t' << 
                 (unsigned) (_writeToJournalMicros/1000) << '\t' << 
                 (unsigned) (_writeToDataFilesMicros/1000) << '\t' << 
-                (unsigned) (_remapPrivateViewMicros/1000);
+                (unsigned) (_remapPrivateViewMicros/1000) << '\t' << 
+                (unsigned) (_waitForDataFilesMicros/1000);
             return ss.str();
         }
 
@@ -139,12 +148,15 @@ namespace mongo {
                        "compression" << _journaledBytes / (_uncompressedBytes+1.0) <<
                        "commitsInWriteLock" << _commitsInWriteLock <<
                        "earlyCommits" << _earlyCommits << 
+                       "pipelinedCommits" << _pipelinedCommits <<
                        "timeMs" <<
                        BSON( "dt" << _dtMillis <<
                              "prepLogBuffer" << (unsigned) (_prepLogBufferMicros/1000) <<
                              "writeToJournal" << (unsigned) (_writeToJournalMicros/1000) <<
                              "writeToDataFiles" << (unsigned) (_writeToDataFilesMicros/1000) <<
-                             "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000)
+                             "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000) <<
+                             "waitForDataFiles" << (unsigned) (_waitForDataFilesMicros/1000) <<
+                             "groupCommitMutexHeld" << (unsigned) (_groupCommitMutexMicros/1000)
                            );
             /*int r = getAgeOutJournalFiles();
             if( r == -1 )
@@ -526,14 +538,117 @@ namespace mongo {
             stats.curr->_remapPrivateViewMicros += t.micros();
         }
 
-        // this is a pseudo-local variable in the groupcommit functions 
-        // below.  however we don't truly do that so that we don't have to 
-        // reallocate, and more importantly regrow it, on every single commit.
-        static AlignedBuilder __theBuilder(4 * 1024 * 1024);
+        /** the back half of the group commit pipeline.  the committing thread (in groupCommitMutex)
+            journals a batch from one of our two buffers and then hands it to us; the durDataFiles
+            thread writes it to the data files while the next batch is prepared and journaled in the
+            other buffer.  at most one batch is pending here, and a batch reaches the data files only
+            after every batch before it.
+
+            REMAPPRIVATEVIEW, and closing a file, need the data files current: call drain() first.
+        */
+        class DataFilesWriter : boost::noncopyable {
+        public:
+            DataFilesWriter() : _m("durDataFiles"), _pending(false), _claimed(false), _next(0) {
+                // kept across commits so that we don't have to reallocate, and more importantly 
+                // regrow them, on every single commit.
+                _ab[0] = new AlignedBuilder(4 * 1024 * 1024);
+                _ab[1] = new AlignedBuilder(4 * 1024 * 1024);
+            }
+
+            /** the buffer to prepare the next batch in.  call in groupCommitMutex. */
+            AlignedBuilder& builder() { return *_ab[_next]; }
+
+            /** queue the batch just journaled from builder() for WRITETODATAFILES, once the one 
+                before it is done.  call in groupCommitMutex. 
+            */
+            void enqueue(const JSectHeader& h) {
+                drain();
+                scoped_lock lk(_m);
+                _h = h;
+                _cur = _next;
+                _next ^= 1;
+                _pending = true;
+                _c.notify_all();
+            }
+
+            /** returns once no batch is pending.  if the durDataFiles thread hasn't started on the 
+                pending batch we write it ourself: our caller may hold mmmutex exclusively (closing 
+                files), which the durDataFiles thread would wait on.
+            */
+            void drain() {
+                Timer t;
+                {
+                    scoped_lock lk(_m);
+                    while( 1 ) {
+                        if( !_pending ) {
+                            stats.curr->_waitForDataFilesMicros += t.micros();
+                            return;
+                        }
+                        if( !_claimed )
+                            break;
+                        _c.wait(lk.boost());
+                    }
+                    _claimed = true;
+                }
+                write();
+                stats.curr->_waitForDataFilesMicros += t.micros();
+            }
+
+            void run() {
+                while( 1 ) {
+                    {
+                        scoped_lock lk(_m);
+                        while( !_pending || _claimed ) {
+                            if( inShutdown() && !_pending )
+                                return;
+                            _c.timed_wait(lk.boost(), boost::posix_time::milliseconds(500));
+                        }
+                    }
+                    // mmmutex before claiming, so a drain() in an exclusive mmmutex holder never 
+                    // waits for us
+                    LockMongoFilesShared lk;
+                    {
+                        scoped_lock lk2(_m);
+                        if( !_pending || _claimed )
+                            continue;
+                        _claimed = true;
+                    }
+                    write();
+                }
+            }
+
+        private:
+            void write() {
+                AlignedBuilder& ab = *_ab[_cur];
+                unsigned abLen = ab.len();
+                WRITETODATAFILES(_h, ab);
+                verify( abLen == ab.len() ); // a check that no one touched the builder while we were doing work
+                ab.reset();
+                scoped_lock lk(_m);
+                _pending = false;
+                _claimed = false;
+                _c.notify_all();
+            }
+
+            mongo::mutex _m;
+            boost::condition _c;
+            bool _pending;       // a batch is journaled but not yet in the data files
+            bool _claimed;       // and it is being written
+            JSectHeader _h;      // of the pending batch
+            AlignedBuilder *_ab[2];
+            int _cur;            // _ab of the pending batch
+            int _next;           // _ab to prepare the next batch in
+        };
+        static DataFilesWriter& dataFilesWriter = *(new DataFilesWriter()); // don't destroy
+
+        void durDataFilesThread() {
+            Client::initThread("durDataFiles");
+            dataFilesWriter.run();
+            cc().shutdown();
+        }
 
         static bool _groupCommitWithLimitedLocks() {
             unspoolWriteIntents(); // in case we were doing some writing ourself (likely impossible with limitedlocks version)
-            AlignedBuilder &ab = __theBuilder;
 
             verify( ! Lock::isLocked() );
 
@@ -544,6 +659,7 @@ namespace mongo {
             scoped_ptr<Lock::GlobalRead> lk1( new Lock::GlobalRead() );
 
             SimpleMutex::scoped_lock lk2(commitJob.groupCommitMutex);
+            Timer held;
 
             commitJob.commitingBegin(); // increments the commit epoch for getlasterror j:true
 
@@ -553,11 +669,10 @@ namespace mongo {
                 return true;
             }
 
+            AlignedBuilder &ab = dataFilesWriter.builder();
             JSectHeader h;
             PREPLOGBUFFER(h,ab); // need to be in readlock (writes excluded) for this
 
-            LockMongoFilesShared lk3;
-
             unsigned abLen = ab.len();
             commitJob.committingReset(); // must be reset before allowing anyone to write
             DEV verify( !commitJob.hasWritten() );
@@ -574,9 +689,10 @@ namespace mongo {
             // (ok to crash after that)
             commitJob.committingNotifyCommitted();
 
-            WRITETODATAFILES(h, ab);
-            verify( abLen == ab.len() ); // check again wasn't modded
-            ab.reset();
+            // WRITETODATAFILES happens on the durDataFiles thread, overlapping our next commit
+            dataFilesWriter.enqueue(h);
+            stats.curr->_pipelinedCommits++;
+            stats.curr->_groupCommitMutexMicros += held.micros();
 
             // can't : d.dbMutex._remapPrivateViewRequested = true;
             // (writes have happened we released)
@@ -615,11 +731,16 @@ namespace mongo {
             assertLockedForCommitting();
 
             unspoolWriteIntents(); // in case we were doing some writing ourself
-            AlignedBuilder &ab = __theBuilder;
 
             // we need to make sure two group commits aren't running at the same time
             // (and we are only read locked in the dbMutex, so it could happen)
             SimpleMutex::scoped_lock lk(commitJob.groupCommitMutex);
+            Timer held;
+
+            // we write to the data files ourself below, and remap after that: the batch from
+            // the last limited locks commit must be in the data files first
+            dataFilesWriter.drain();
+            AlignedBuilder &ab = dataFilesWriter.builder();
 
             commitJob.commitingBegin();
 
@@ -682,6 +803,7 @@ namespace mongo {
                 //
                 REMAPPRIVATEVIEW();
             }
+            stats.curr->_groupCommitMutexMicros += held.micros();
         }
 
         /** locking: in read lock when called
@@ -851,6 +973,7 @@ namespace mongo {
             preallocateFiles();
 
             boost::thread t(durThread);
+            boost::thread t2(durDataFilesThread);
         }
 
         void DurableImpl::syncDataAndTruncateJournal() {
@@ -5,6 +5,7 @@ namespace mongo {
 
         /** journaling stats.  the model here is that the commit thread is the only writer, and that reads are
             uncommon (from a serverStatus command and such).  Thus, there should not be multicore chatter overhead.
+            (the durDataFiles thread also adds to _writeToDataFiles*; a lost add at a rotate is acceptable.)
         */
         struct Stats {
             Stats();
@@ -27,6 +28,10 @@ namespace mongo {
                 unsigned long long _writeToJournalMicros;
                 unsigned long long _writeToDataFilesMicros;
                 unsigned long long _remapPrivateViewMicros;
+                unsigned long long _waitForDataFilesMicros; // committer stalled on the previous batch's WRITETODATAFILES
+                unsigned long long _groupCommitMutexMicros; // groupCommitMutex held by the committer
+
+                unsigned _pipelinedCommits; // commits whose WRITETODATAFILES overlapped the next commit
 
                 // undesirable to be in write lock for the group commit (it can be done in a read lock), so good if we
                 // have visibility when this happens.  can happen for a couple reasons
@@ -29,15 +29,13 @@
 
 namespace mongo {
 
-    HLMutex BSONObjExternalSorter::_extSortMutex("s");
-    IndexInterface *BSONObjExternalSorter::extSortIdxInterface;
-    Ordering BSONObjExternalSorter::extSortOrder( Ordering::make(BSONObj()) );
-    unsigned long long BSONObjExternalSorter::_compares = 0;
+    boost::thread_specific_ptr<BSONObjExternalSorter::SortContext> BSONObjExternalSorter::_sortContext;
 
     /*static*/
-    int BSONObjExternalSorter::_compare(IndexInterface& i, const Data& l, const Data& r, const Ordering& order) { 
-        RARELY killCurrentOp.checkForInterrupt();
-        _compares++;
+    int BSONObjExternalSorter::_compare(IndexInterface& i, const Data& l, const Data& r, const Ordering& order, bool interruptible) { 
+        if( interruptible ) {
+            RARELY killCurrentOp.checkForInterrupt();
+        }
         int x = i.keyCompare(l.first, r.first, order);
         if ( x )
             return x;
@@ -46,17 +44,17 @@ namespace mongo {
 
     /*static*/
     int BSONObjExternalSorter::extSortComp( const void *lv, const void *rv ) {
-        DEV RARELY {
-            _extSortMutex.dassertLocked(); // must be as we use a global var
-        }
+        SortContext *c = _sortContext.get();
+        dassert( c );
         Data * l = (Data*)lv;
         Data * r = (Data*)rv;
-        return _compare(*extSortIdxInterface, *l, *r, extSortOrder);
+        return _compare(*c->idxi, *l, *r, *c->order, c->interruptible);
     };
 
-    BSONObjExternalSorter::BSONObjExternalSorter( IndexInterface &i, const BSONObj & order , long maxFileSize )
+    BSONObjExternalSorter::BSONObjExternalSorter( IndexInterface &i, const BSONObj & order , long maxFileSize , int nThreads )
         : _idxi(i), _order( order.getOwned() ) , _maxFilesize( maxFileSize ) ,
-          _arraySize(1000000), _cur(0), _curSizeSoFar(0), _sorted(0) {
+          _arraySize(1000000), _cur(0), _curSizeSoFar(0), _sorted(0),
+          _nThreads( nThreads < 1 ? 1 : nThreads ), _runsMutex("extsort"), _runsInFlight(0) {
 
         stringstream rootpath;
         rootpath << dbpath;
@@ -68,35 +66,88 @@ namespace mongo {
         log(1) << "external sort root: " << _root.string() << endl;
 
         create_directories( _root );
-        _compares = 0;
+
+        if ( _nThreads > 1 ) {
+            _pool.reset( new ThreadPool( _nThreads ) );
+            // runs in flight and the one being filled share the memory budget
+            _maxFilesize = max( _maxFilesize / _nThreads , 1L );
+        }
     }
 
     BSONObjExternalSorter::~BSONObjExternalSorter() {
+        if ( _pool ) {
+            // runs still in flight if we are unwinding from an exception
+            _pool->join();
+        }
         if ( _cur ) {
             delete _cur;
             _cur = 0;
         }
+        for ( unsigned i = 0; i < _spareRuns.size(); i++ )
+            delete _spareRuns[i];
         unsigned long removed = remove_all( _root );
         wassert( removed == 1 + _files.size() );
     }
 
+    /** make extSortComp compare for sorter on this thread, for the life of this object */
+    class ExtSortContextSetter : boost::noncopyable {
+    public:
+        ExtSortContextSetter( boost::thread_specific_ptr<BSONObjExternalSorter::SortContext>& tl, 
+                              const BSONObjExternalSorter::SortContext& c ) : _tl(tl), _c(c) {
+            _tl.reset( &_c );
+        }
+        ~ExtSortContextSetter() { _tl.release(); }
+    private:
+        boost::thread_specific_ptr<BSONObjExternalSorter::SortContext>& _tl;
+        BSONObjExternalSorter::SortContext _c;
+    };
+
     void BSONObjExternalSorter::_sortInMem() {
-        // extSortComp needs to use glpbals
-        // qsort_r only seems available on bsd, which is what i really want to use
-        HLMutex::scoped_lock lk(_extSortMutex);
-        extSortIdxInterface = &_idxi;
-        extSortOrder = Ordering::make(_order);
+        Ordering order = Ordering::make(_order);
+        SortContext c = { &_idxi, &order, true };
+        ExtSortContextSetter setter( _sortContext, c );
         _cur->sort( BSONObjExternalSorter::extSortComp );
     }
 
+    /*static*/
+    void BSONObjExternalSorter::_sortRange( BSONObjExternalSorter *sorter, int from, int to ) {
+        Ordering order = Ordering::make(sorter->_order);
+        SortContext c = { &sorter->_idxi, &order, false };
+        ExtSortContextSetter setter( _sortContext, c );
+        sorter->_cur->sort( from, to, BSONObjExternalSorter::extSortComp );
+    }
+
+    /*static*/
+    void BSONObjExternalSorter::_mergeRanges( BSONObjExternalSorter *sorter, int from, int mid, int to ) {
+        sorter->_cur->merge( from, mid, to, MyCmp( sorter->_idxi, sorter->_order, false ) );
+    }
+
+    /** sort _cur as _nThreads pieces at once, then merge the pieces pairwise, also in parallel */
+    void BSONObjExternalSorter::_sortInMemParallel() {
+        int n = _cur->size();
+        int piece = n / _nThreads + 1;
+        for ( int from = 0; from < n; from += piece )
+            _pool->schedule( &BSONObjExternalSorter::_sortRange, this, from, min( from + piece, n ) );
+        _pool->join();
+        for ( ; piece < n; piece *= 2 ) {
+            for ( int from = 0; from + piece < n; from += 2 * piece )
+                _pool->schedule( &BSONObjExternalSorter::_mergeRanges, this, from, from + piece, min( from + 2 * piece, n ) );
+            _pool->join();
+        }
+        killCurrentOp.checkForInterrupt();
+    }
+
     void BSONObjExternalSorter::sort() {
         uassert( 10048 ,  "already sorted" , ! _sorted );
 
         _sorted = true;
 
         if ( _cur && _files.size() == 0 ) {
-            _sortInMem();
-            log(1) << "\t\t not using file.  size:" << _curSizeSoFar << " _compares:" << _compares << endl;
+            if ( _pool && _cur->size() > 10000 )
+                _sortInMemParallel();
+            else
+                _sortInMem();
+            log(1) << "\t\t not using file.  size:" << _curSizeSoFar << endl;
             return;
         }
 
@@ -104,6 +155,8 @@ namespace mongo {
             finishMap();
         }
 
+        _waitForRuns();
+
         if ( _cur ) {
             delete _cur;
             _cur = 0;
@@ -118,7 +171,15 @@ namespace mongo {
         uassert( 10049 ,  "sorted already" , ! _sorted );
 
         if ( ! _cur ) {
-            _cur = new InMemory( _arraySize );
+            scoped_lock lk( _runsMutex );
+            uassert( 16382, _runError, _runError.empty() );
+            if ( _spareRuns.empty() ) {
+                _cur = new InMemory( _arraySize );
+            }
+            else {
+                _cur = _spareRuns.back();
+                _spareRuns.pop_back();
+            }
         }
 
         Data& d = _cur->getNext();
@@ -142,12 +203,63 @@ namespace mongo {
         if ( _cur->size() == 0 )
             return;
 
-        _sortInMem();
-
         stringstream ss;
         ss << _root.string() << "/file." << _files.size();
         string file = ss.str();
+        _files.push_back( file );
+
+        if ( ! _pool ) {
+            _sortInMem();
+            _writeRun( _cur, file );
+            return;
+        }
+
+        // hand the run off to be sorted and written while we fill the next one
+        {
+            scoped_lock lk( _runsMutex );
+            while ( _runsInFlight >= _nThreads )
+                _runDone.wait( lk.boost() );
+            _runsInFlight++;
+        }
+        InMemory *run = _cur;
+        _cur = 0;
+        _pool->schedule( &BSONObjExternalSorter::_sortAndWriteRun, this, run, file );
+        killCurrentOp.checkForInterrupt();
+    }
+
+    /*static*/
+    void BSONObjExternalSorter::_sortAndWriteRun( BSONObjExternalSorter *sorter, InMemory *run, string file ) {
+        string err;
+        try {
+            Ordering order = Ordering::make(sorter->_order);
+            SortContext c = { &sorter->_idxi, &order, false };
+            ExtSortContextSetter setter( _sortContext, c );
+            run->sort( BSONObjExternalSorter::extSortComp );
+            sorter->_writeRun( run, file );
+        }
+        catch ( DBException& e ) {
+            err = e.toString();
+        }
+        catch ( std::exception& e ) {
+            err = e.what();
+        }
+        scoped_lock lk( sorter->_runsMutex );
+        if ( ! err.empty() && sorter->_runError.empty() )
+            sorter->_runError = str::stream() << "external sort of " << file << " failed: " << err;
+        sorter->_spareRuns.push_back( run );
+        sorter->_runsInFlight--;
+        sorter->_runDone.notify_all();
+    }
 
+    void BSONObjExternalSorter::_waitForRuns() {
+        if ( ! _pool )
+            return;
+        _pool->join();
+        scoped_lock lk( _runsMutex );
+        uassert( 16383, _runError, _runError.empty() );
+    }
+
+    void BSONObjExternalSorter::_writeRun( InMemory *run, const string& file ) {
         // todo: it may make sense to fadvise that this not be cached so that building the index doesn't 
         //       eject other things the db is using from the file system cache.  while we will soon be reading 
         //       this back, if it fit in ram, there wouldn't have been a need for an external sort in the first 
@@ -158,16 +270,15 @@ namespace mongo {
         assertStreamGood( 10051 ,  (string)"couldn't open file: " + file , out );
 
         int num = 0;
-        for ( InMemory::iterator i=_cur->begin(); i != _cur->end(); ++i ) {
+        for ( InMemory::iterator i=run->begin(); i != run->end(); ++i ) {
             Data p = *i;
             out.write( p.first.objdata() , p.first.objsize() );
             out.write( (char*)(&p.second) , sizeof( DiskLoc ) );
             num++;
         }
 
-        _cur->clear();
+        run->clear();
 
-        _files.push_back( file );
         out.close();
 
         log(2) << "Added file: " << file << " with " << num << "objects for external sort" << endl;
@@ -176,37 +287,98 @@ namespace mongo {
     // ---------------------------------
 
     BSONObjExternalSorter::Iterator::Iterator( BSONObjExternalSorter * sorter ) :
-        _cmp( sorter->_idxi, sorter->_order ) , _in( 0 ) {
+        _cmp( sorter->_idxi, sorter->_order, /*interruptible*/ ! sorter->_pool ) , _in( 0 ),
+        _m( "extsort::Iterator" ), _batchPos( 0 ), _mergeDone( false ), _stop( false ) {
 
         for ( list<string>::iterator i=sorter->_files.begin(); i!=sorter->_files.end(); i++ ) {
-            _files.push_back( new FileIterator( *i ) );
-            _stash.push_back( pair<Data,bool>( Data( BSONObj() , DiskLoc() ) , false ) );
+            FileIterator *f = new FileIterator( *i );
+            verify( f->more() ); // finishMap() doesn't write empty runs
+            _files.push_back( f );
+            _heads.push_back( f->next() );
+            _heap.push_back( _files.size() - 1 );
         }
+        make_heap( _heap.begin(), _heap.end(), HeadCmp( this ) );
 
         if ( _files.size() == 0 && sorter->_cur ) {
             _in = sorter->_cur;
             _it = sorter->_cur->begin();
         }
+        else if ( sorter->_pool && _files.size() > 1 ) {
+            _merger.reset( new boost::thread( boost::bind( &Iterator::_mergeThread, this ) ) );
+        }
     }
 
     BSONObjExternalSorter::Iterator::~Iterator() {
+        if ( _merger ) {
+            {
+                scoped_lock lk( _m );
+                _stop = true;
+                _c.notify_all();
+            }
+            _merger->join();
+        }
         for ( vector<FileIterator*>::iterator i=_files.begin(); i!=_files.end(); i++ )
             delete *i;
         _files.clear();
     }
 
+    BSONObjExternalSorter::Data BSONObjExternalSorter::Iterator::_mergeNext() {
+        pop_heap( _heap.begin(), _heap.end(), HeadCmp( this ) );
+        int slot = _heap.back();
+        Data best = _heads[slot];
+        if ( _files[slot]->more() ) {
+            _heads[slot] = _files[slot]->next();
+            push_heap( _heap.begin(), _heap.end(), HeadCmp( this ) );
+        }
+        else {
+            _heap.pop_back();
+        }
+        return best;
+    }
+
+    void BSONObjExternalSorter::Iterator::_mergeThread() {
+        const unsigned BatchSize = 4096;
+        vector<Data> merged;
+        while ( 1 ) {
+            merged.clear();
+            while ( merged.size() < BatchSize && _mergeMore() )
+                merged.push_back( _mergeNext() );
+
+            scoped_lock lk( _m );
+            while ( ! _ready.empty() && ! _stop )
+                _c.wait( lk.boost() );
+            if ( _stop )
+                return;
+            _ready.swap( merged );
+            _mergeDone = ! _mergeMore();
+            _c.notify_all();
+            if ( _mergeDone )
+                return;
+        }
+    }
+
+    void BSONObjExternalSorter::Iterator::_nextBatch() {
+        scoped_lock lk( _m );
+        while ( _ready.empty() && ! _mergeDone )
+            _c.wait( lk.boost() );
+        _batch.clear();
+        _batch.swap( _ready );
+        _batchPos = 0;
+        _c.notify_all();
+    }
+
     bool BSONObjExternalSorter::Iterator::more() {
 
         if ( _in )
             return _it != _in->end();
 
-        for ( vector<FileIterator*>::iterator i=_files.begin(); i!=_files.end(); i++ )
-            if ( (*i)->more() )
-                return true;
-        for ( vector< pair<Data,bool> >::iterator i=_stash.begin(); i!=_stash.end(); i++ )
-            if ( i->second )
-                return true;
-        return false;
+        if ( _merger ) {
+            if ( _batchPos == _batch.size() )
+                _nextBatch();
+            return _batchPos < _batch.size();
+        }
+
+        return _mergeMore();
     }
 
     BSONObjExternalSorter::Data BSONObjExternalSorter::Iterator::next() {
@@ -217,29 +389,15 @@ namespace mongo {
             return d;
         }
 
-        Data best;
-        int slot = -1;
-
-        for ( unsigned i=0; i<_stash.size(); i++ ) {
-
-            if ( ! _stash[i].second ) {
-                if ( _files[i]->more() )
-                    _stash[i] = pair<Data,bool>( _files[i]->next() , true );
-                else
-                    continue;
-            }
-
-            if ( slot == -1 || _cmp( best , _stash[i].first ) == 0 ) {
-                best = _stash[i].first;
-                slot = i;
-            }
-
+        if ( _merger ) {
+            if ( _batchPos == _batch.size() )
+                _nextBatch();
+            verify( _batchPos < _batch.size() );
+            return _batch[_batchPos++];
         }
 
-        verify( slot >= 0 );
-        _stash[slot].second = false;
-
-        return best;
+        verify( _mergeMore() );
+        return _mergeNext();
     }
 
     // -----------------------------------
@@ -26,37 +26,51 @@
 #include "mongo/db/curop-inl.h"
 #include "mongo/util/array.h"
 #include "mongo/util/mmap.h"
+#include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
 
     /**
        for external (disk) sorting by BSONObj and attaching a value
+
+       with nThreads > 1, full runs are sorted and written to disk on a pool of that many threads
+       while add() fills the next one, an in memory sort is done in parallel pieces, and the 
+       iterator merges the runs on its own thread ahead of the caller.  memory use stays about 
+       maxFileSize: each run is then at most maxFileSize / nThreads.
      */
     class BSONObjExternalSorter : boost::noncopyable {
     public:
-        BSONObjExternalSorter( IndexInterface &i, const BSONObj & order = BSONObj() , long maxFileSize = 1024 * 1024 * 100 );
+        BSONObjExternalSorter( IndexInterface &i, const BSONObj & order = BSONObj() , long maxFileSize = 1024 * 1024 * 100 , int nThreads = 1 );
         ~BSONObjExternalSorter();
         typedef pair<BSONObj,DiskLoc> Data;
  
     private:
-        static HLMutex _extSortMutex;
         IndexInterface& _idxi;
 
-        static int _compare(IndexInterface& i, const Data& l, const Data& r, const Ordering& order);
+        /** @param interruptible false on threads that have no Client (and so no op to kill) */
+        static int _compare(IndexInterface& i, const Data& l, const Data& r, const Ordering& order, bool interruptible = true);
 
         class MyCmp {
         public:
-            MyCmp( IndexInterface& i, BSONObj order = BSONObj() ) : _i(i), _order( Ordering::make(order) ) {}
+            MyCmp( IndexInterface& i, BSONObj order = BSONObj(), bool interruptible = true ) : 
+                _i(i), _order( Ordering::make(order) ), _interruptible(interruptible) {}
             bool operator()( const Data &l, const Data &r ) const {
-                return _compare(_i, l, r, _order) < 0;
+                return _compare(_i, l, r, _order, _interruptible) < 0;
             };
         private:
             IndexInterface& _i;
             const Ordering _order;
+            bool _interruptible;
         };
 
-        static IndexInterface *extSortIdxInterface;
-        static Ordering extSortOrder;
+        /** qsort has no context argument, so extSortComp finds the index and order in a thread local */
+        struct SortContext {
+            IndexInterface *idxi;
+            const Ordering *order;
+            bool interruptible;
+        };
+        static boost::thread_specific_ptr<SortContext> _sortContext;
+        friend class ExtSortContextSetter;
         static int extSortComp( const void *lv, const void *rv );
 
         class FileIterator : boost::noncopyable {
@@ -84,13 +98,37 @@ namespace mongo {
             Data next();
 
         private:
+            /** k way merge of _files, smallest head on top of the heap */
+            class HeadCmp {
+            public:
+                HeadCmp( Iterator *it ) : _it(it) { }
+                bool operator()( int l, int r ) const { return _it->_cmp( _it->_heads[r], _it->_heads[l] ); }
+            private:
+                Iterator *_it;
+            };
+            bool _mergeMore() const { return !_heap.empty(); }
+            Data _mergeNext();
+
+            /** with a parallel sorter, merges into _ready on _merger ahead of next() */
+            void _mergeThread();
+            void _nextBatch();
+
             MyCmp _cmp;
             vector<FileIterator*> _files;
-            vector< pair<Data,bool> > _stash;
+            vector<Data> _heads; // current smallest of each of _files
+            vector<int> _heap;   // of _files that still have a head
 
             InMemory * _in;
             InMemory::iterator _it;
 
+            scoped_ptr<boost::thread> _merger;
+            mongo::mutex _m;
+            boost::condition _c;
+            vector<Data> _ready;  // merged by _merger, not yet taken
+            vector<Data> _batch;  // being returned by next()
+            unsigned _batchPos;
+            bool _mergeDone;
+            bool _stop;
         };
 
         void add( const BSONObj& o , const DiskLoc & loc );
@@ -120,9 +158,16 @@ namespace mongo {
     private:
 
         void _sortInMem();
+        void _sortInMemParallel();
+        static void _sortRange( BSONObjExternalSorter *sorter, int from, int to );
+        static void _mergeRanges( BSONObjExternalSorter *sorter, int from, int mid, int to );
 
         void sort( string file );
         void finishMap();
+        /** sort a full run and write it to file, on a pool thread */
+        static void _sortAndWriteRun( BSONObjExternalSorter *sorter, InMemory *run, string file );
+        void _writeRun( InMemory *run, const string& file );
+        void _waitForRuns();
 
         BSONObj _order;
         long _maxFilesize;
@@ -135,6 +180,12 @@ namespace mongo {
         list<string> _files;
         bool _sorted;
 
-        static unsigned long long _compares;
+        int _nThreads;
+        scoped_ptr<ThreadPool> _pool;
+        mongo::mutex _runsMutex;
+        boost::condition _runDone;
+        int _runsInFlight;
+        vector<InMemory*> _spareRuns; // written runs, to reuse rather than reallocate
+        string _runError;             // from a failed _writeRun
     };
 }
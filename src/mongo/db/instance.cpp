@@ -36,6 +36,7 @@
 #include <sys/file.h>
 #endif
 #include "stats/counters.h"
+#include "stats/latency.h"
 #include "background.h"
 #include "dur_journal.h"
 #include "dur_recover.h"
@@ -68,6 +69,12 @@ namespace mongo {
 
     bool useHints = true;
 
+    /** see insertMulti() */
+    bool useBatchInserts = true;
+
+    /** see newWriteLock() */
+    bool useCollectionLocks = true;
+
     KillCurrentOp killCurrentOp;
 
     int lockFile = 0;
@@ -445,6 +452,8 @@ namespace mongo {
         currentOp.ensureStarted();
         currentOp.done();
         debug.executionTime = currentOp.totalTimeMillis();
+        opLatencies.record( currentOp.getNS() , op , isCommand , currentOp.totalTimeMicros() , 
+                            currentOp.lockWaitMicros() );
 
         logThreshold += currentOp.getExpectedLatencyMs();
 
@@ -535,6 +544,25 @@ namespace mongo {
         delete database; // closes files
     }
 
+    /** the lock for an insert, update or remove on ns.  if the collection is there already, in an
+        open database, that is all that is locked so writes to its neighbours can go on; see
+        Lock::CollectionWrite.  otherwise, and for system collections, local, admin and nested
+        locks, it is the whole database.
+    */
+    Lock::ScopedLock* newWriteLock(const char *ns) {
+        if ( useCollectionLocks && Lock::dbLevelLockingEnabled() && !Lock::isLocked() &&
+             Database::_openAllFiles && NamespaceString::normal( ns ) ) {
+            NamespaceString s( ns );
+            if ( s.db != "local" && s.db != "admin" && !s.isSystem() ) {
+                auto_ptr<Lock::CollectionWrite> lk( new Lock::CollectionWrite( ns ) );
+                Database *db = dbHolder().get( ns, dbpath );
+                if ( db && db->namespaceIndex.details( ns ) )
+                    return lk.release();
+            }
+        }
+        return new Lock::DBWrite( ns );
+    }
+
     void receivedUpdate(Message& m, CurOp& op) {
         DbMessage d(m);
         const char *ns = d.getns();
@@ -558,7 +586,7 @@ namespace mongo {
         PageFaultRetryableSection s;
         while ( 1 ) {
             try {
-                Lock::DBWrite lk(ns);
+                scoped_ptr<Lock::ScopedLock> lk( newWriteLock( ns ) );
                 
                 // void ReplSetImpl::relinquish() uses big write lock so 
                 // this is thus synchronized given our lock above.
@@ -596,7 +624,7 @@ namespace mongo {
         //PageFaultRetryableSection s;
         while ( 1 ) {
             try {
-                Lock::DBWrite lk(ns);
+                scoped_ptr<Lock::ScopedLock> lk( newWriteLock( ns ) );
                 
                 // writelock is used to synchronize stepdowns w/ writes
                 uassert( 10056 ,  "not master", isMasterNs( ns ) );
@@ -737,7 +765,7 @@ namespace mongo {
         return ok;
     }
 
-    void checkAndInsert(const char *ns, /*modifies*/BSONObj& js) { 
+    static void checkInsertable(const BSONObj& js) {
         uassert( 10059 , "object to insert too large", js.objsize() <= BSONObjMaxUserSize);
         {
             // check no $ modifiers.  note we only check top level.  (scanning deep would be quite expensive)
@@ -747,22 +775,69 @@ namespace mongo {
                 uassert( 13511 , "document to insert can't have $ fields" , e.fieldName()[0] != '$' );
             }
         }
+    }
+
+    void checkAndInsert(const char *ns, /*modifies*/BSONObj& js) { 
+        checkInsertable(js);
         theDataFileMgr.insertWithObjMod(ns, js, false); // js may be modified in the call to add an _id field.
         logOp("i", ns, js);
     }
 
+    /** @return false, having inserted none of objs[begin, end), if they have to go in one at a time */
+    static bool insertBatch(const char *ns, vector<BSONObj>& objs, size_t begin, size_t end) {
+        // an error undone with the batch mustn't be left for getLastError
+        LastError *le = lastError.get();
+        LastError before;
+        if ( le )
+            before = *le;
+        try {
+            for ( size_t i = begin; i < end; i++ )
+                checkInsertable( objs[i] );
+            if ( theDataFileMgr.insertBatch( ns, objs, begin, end ) ) {
+                for ( size_t i = begin; i < end; i++ )
+                    logOp( "i", ns, objs[i] );
+                return true;
+            }
+        }
+        catch ( const UserException& ) {
+            // checked before anything was written; one at a time will report it
+        }
+        if ( le )
+            *le = before;
+        return false;
+    }
+
+    /** inserts go to DataFileMgr::insertBatch() InsertBatchDocs or InsertBatchBytes at a time.  a
+        batch that can't go in whole, say for a duplicate key, is done one document at a time
+        instead, so which documents are inserted and which error is reported are the same either way.
+    */
     NOINLINE_DECL void insertMulti(bool keepGoing, const char *ns, vector<BSONObj>& objs) {
-        size_t i;
-        for (i=0; i<objs.size(); i++){
-            try {
-                checkAndInsert(ns, objs[i]);
-                getDur().commitIfNeeded();
-            } catch (const UserException&) {
-                if (!keepGoing || i == objs.size()-1){
-                    globalOpCounters.incInsertInWriteLock(i);
-                    throw;
+        enum { InsertBatchDocs = 1000, InsertBatchBytes = 4 * 1024 * 1024 };
+        size_t i = 0;
+        while ( i < objs.size() ) {
+            size_t end = i;
+            if ( useBatchInserts ) {
+                int bytes = 0;
+                while ( end < objs.size() && end - i < InsertBatchDocs && bytes < InsertBatchBytes )
+                    bytes += objs[end++].objsize();
+                if ( insertBatch( ns, objs, i, end ) ) {
+                    i = end;
+                    getDur().commitIfNeeded();
+                    continue;
+                }
+            }
+            end = max( end, i + 1 );
+            for ( ; i < end; i++ ) {
+                try {
+                    checkAndInsert(ns, objs[i]);
+                    getDur().commitIfNeeded();
+                } catch (const UserException&) {
+                    if (!keepGoing || i == objs.size()-1){
+                        globalOpCounters.incInsertInWriteLock(i);
+                        throw;
+                    }
+                    // otherwise ignore and keep going
                 }
-                // otherwise ignore and keep going
             }
         }
 
@@ -787,7 +862,7 @@ namespace mongo {
             multi.push_back( d.nextJsObj() );
         }
 
-        Lock::DBWrite lk(ns);
+        scoped_ptr<Lock::ScopedLock> lk( newWriteLock( ns ) );
 
         // CONCURRENCY TODO: is being read locked in big log sufficient here?
         // writelock is used to synchronize stepdowns w/ writes
@@ -73,6 +73,11 @@ namespace mongo {
 
     void assembleResponse( Message &m, DbResponse &dbresponse, const HostAndPort &client );
 
+    /** the lock for an insert, update or remove on ns: the collection alone if it is there 
+        already, else its database.  see instance.cpp.
+    */
+    Lock::ScopedLock* newWriteLock( const char *ns );
+
     void getDatabaseNames( vector< string > &names , const string& usePath = dbpath );
 
     /* returns true if there is no data on this server.  useful when starting replication.
@@ -29,6 +29,9 @@ namespace mongo {
         // RWrw
         AtomicUInt64 timeAcquiring[N];
         AtomicUInt64 timeLocked[N];
+        AtomicUInt64 numAcquiring[N];
+        // acquisitions that took a measurable time (a microsecond or more), i.e. had to wait
+        AtomicUInt64 numWaits[N];
 
         static unsigned mapNo(char type);
     };
@@ -30,6 +30,7 @@
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/scripting/engine.h"
+#include "mongo/util/background.h"
 #include "mongo/util/hashtab.h"
 #include "mongo/util/util.h"
 
@@ -321,6 +322,12 @@ namespace mongo {
        returned item is out of the deleted list upon return
     */
     DiskLoc NamespaceDetails::__stdAlloc(int len, bool peekOnly) {
+        if ( isUserFlagSet( Flag_UsePowerOf2Sizes ) ) {
+            int b = bucket(len);
+            if ( b > 0 && bucketSizes[b-1] == len )
+                return _sizeClassAlloc(len, peekOnly);
+        }
+
         DiskLoc *prev;
         DiskLoc *bestprev = 0;
         DiskLoc bestmatch;
@@ -393,6 +400,135 @@ namespace mongo {
         return bestmatch;
     }
 
+    /* for a len that is exactly one of the bucketSizes, as getRecordAllocationSize() gives with
+       Flag_UsePowerOf2Sizes: every record on the lists from bucket(len) up is big enough, so rather
+       than searching for the best fit take the first one there is.
+    */
+    DiskLoc NamespaceDetails::_sizeClassAlloc(int len, bool peekOnly) {
+        for ( int b = bucket(len); b <= MaxBucket; b++ ) {
+            DiskLoc loc = deletedList[b];
+            if ( loc.isNull() )
+                continue;
+            DeletedRecord *r = loc.drec();
+            dassert( r->lengthWithHeaders() >= len );
+            if( !peekOnly ) {
+                getDur().writingDiskLoc( deletedList[b] ) = r->nextDeleted();
+                r->nextDeleted().writing().setInvalid(); // defensive.
+                verify(r->extentOfs() < loc.getOfs());
+            }
+            return loc;
+        }
+        // out of space. alloc a new extent.
+        return DiskLoc();
+    }
+
+    NamespaceDetails::FreeListStats::FreeListStats() :
+        records(), size(), largest(), coalescible(), truncated() {
+        memset( byBucket, 0, sizeof( byBucket ) );
+        memset( sizeByBucket, 0, sizeof( sizeByBucket ) );
+    }
+
+    void NamespaceDetails::freeListStats( FreeListStats& s , long long maxRecords ) const {
+        verify( !isCapped() );
+        vector< pair<DiskLoc,int> > drecs;
+        for ( int b = 0; b < Buckets && !s.truncated; b++ ) {
+            for ( DiskLoc i = deletedList[b]; !i.isNull(); i = i.drec()->nextDeleted() ) {
+                if ( s.records >= maxRecords ) {
+                    s.truncated = true;
+                    break;
+                }
+                int len = i.drec()->lengthWithHeaders();
+                s.records++;
+                s.size += len;
+                s.largest = max( s.largest, len );
+                s.byBucket[b]++;
+                s.sizeByBucket[b] += len;
+                drecs.push_back( make_pair( i, len ) );
+            }
+        }
+
+        sort( drecs.begin(), drecs.end() );
+        for ( size_t i = 1; i < drecs.size(); i++ ) {
+            const DiskLoc& a = drecs[i-1].first;
+            const DiskLoc& b = drecs[i].first;
+            if ( a.a() == b.a() && a.getOfs() + drecs[i-1].second == b.getOfs() &&
+                 a.drec()->extentOfs() == b.drec()->extentOfs() )
+                s.coalescible++;
+        }
+    }
+
+    long long NamespaceDetails::coalesceDeletedRecords( long long maxScan , long long maxMerged ) {
+        verify( !isCapped() );
+
+        // each with the bucket whose list it's on
+        vector< pair<DiskLoc,int> > drecs;
+        for ( int b = 0; b < Buckets && (long long) drecs.size() < maxScan; b++ ) {
+            for ( DiskLoc i = deletedList[b]; !i.isNull() && (long long) drecs.size() < maxScan;
+                  i = i.drec()->nextDeleted() )
+                drecs.push_back( make_pair( i, b ) );
+        }
+        sort( drecs.begin(), drecs.end() );
+
+        // find the runs first so nothing is written if there's nothing to merge
+        vector< pair<size_t,size_t> > runs; // [first,end) in drecs
+        long long merged = 0;
+        for ( size_t i = 0; i < drecs.size() && merged < maxMerged; ) {
+            DiskLoc a = drecs[i].first;
+            DeletedRecord *r = a.drec();
+            int len = r->lengthWithHeaders();
+            size_t j = i + 1;
+            for ( ; j < drecs.size() && merged + (long long) ( j - i ) <= maxMerged; j++ ) {
+                DiskLoc b = drecs[j].first;
+                if ( b.a() != a.a() || a.getOfs() + len != b.getOfs() ||
+                     b.drec()->extentOfs() != r->extentOfs() )
+                    break;
+                len += b.drec()->lengthWithHeaders();
+            }
+            if ( j - i > 1 ) {
+                runs.push_back( make_pair( i, j ) );
+                merged += j - i - 1;
+            }
+            i = j;
+        }
+        if ( merged == 0 )
+            return 0;
+
+        // take the records of the runs off their lists, walking each list only as far as the
+        // last of them
+        set<DiskLoc> taken;
+        vector<long long> left( Buckets );
+        for ( size_t k = 0; k < runs.size(); k++ ) {
+            for ( size_t i = runs[k].first; i < runs[k].second; i++ ) {
+                taken.insert( drecs[i].first );
+                left[ drecs[i].second ]++;
+            }
+        }
+        for ( int b = 0; b < Buckets; b++ ) {
+            DiskLoc *prev = &deletedList[b];
+            while ( left[b] > 0 ) {
+                DiskLoc cur = *prev;
+                verify( !cur.isNull() );
+                DeletedRecord *r = cur.drec();
+                if ( taken.count( cur ) ) {
+                    *getDur().writing( prev ) = r->nextDeleted();
+                    left[b]--;
+                }
+                else {
+                    prev = &r->nextDeleted();
+                }
+            }
+        }
+
+        for ( size_t k = 0; k < runs.size(); k++ ) {
+            DiskLoc a = drecs[ runs[k].first ].first;
+            DeletedRecord *r = a.drec();
+            for ( size_t i = runs[k].first + 1; i < runs[k].second; i++ )
+                getDur().writingInt( r->lengthWithHeaders() ) += drecs[i].first.drec()->lengthWithHeaders();
+            addDeletedRec( r, a );
+        }
+        return merged;
+    }
+
     void NamespaceDetails::dumpDeleted(set<DiskLoc> *extents) {
         for ( int i = 0; i < Buckets; i++ ) {
             DiskLoc dl = deletedList[i];
@@ -457,6 +593,7 @@ namespace mongo {
 
     void NamespaceIndex::kill_ns(const char *ns) {
         Lock::assertWriteLocked(ns);
+        massert( 16408, "can't remove a namespace with just a collection locked", !Lock::isCollectionWriteLocked() );
         if ( !ht )
             return;
         Namespace n(ns);
@@ -479,6 +616,7 @@ namespace mongo {
     }
     void NamespaceIndex::add_ns( const char *ns, const NamespaceDetails &details ) {
         Lock::assertWriteLocked(ns);
+        massert( 16407, "can't add a namespace with just a collection locked", !Lock::isCollectionWriteLocked() );
         init();
         Namespace n(ns);
         uassert( 10081 , "too many namespaces/collections", ht->put(n, details));
@@ -647,7 +785,7 @@ namespace mongo {
     // that is NOT handled here yet!  TODO
     // repair may not use nsdt though not sure.  anyway, requires work.
     NamespaceDetailsTransient::NamespaceDetailsTransient(Database *db, const char *ns) : 
-        _ns(ns), _keysComputed(false), _qcWriteCount() 
+        _ns(ns), _keysComputed(false) 
     {
         dassert(db);
     }
@@ -719,7 +857,8 @@ namespace mongo {
         verify( _paddingFactor >= 1 );
 
         
-        if ( isUserFlagSet( Flag_UsePowerOf2Sizes ) ) {
+        // records beyond the biggest bucket just get the padding factor
+        if ( isUserFlagSet( Flag_UsePowerOf2Sizes ) && minRecordSize < bucketSizes[MaxBucket] ) {
             int x = bucket( minRecordSize );
             x = bucketSizes[x];
             return x;
@@ -845,4 +984,102 @@ namespace mongo {
         return false;
     }
 
+    /**
+     * Freed records of a collection using power of 2 sizes go back on the deleted lists at their
+     * exact size, so without merging, space freed by small documents never holds a bigger one.
+     * Every minute this looks over such collections and coalesces their deleted records where
+     * that would merge at least MinCoalescible of them.  It merges at most MaxMergedPerPass
+     * records with the write lock held, committing and relocking between passes.
+     */
+    class FreeListCoalescer : public BackgroundJob {
+    public:
+        FreeListCoalescer() : BackgroundJob( true /* selfDelete */ ) { }
+        string name() const { return "FreeListCoalescer"; }
+        void run() {
+            Client::initThread( name().c_str() );
+            while ( ! inShutdown() ) {
+                sleepsecs( Secs );
+                set<string> dbs;
+                {
+                    Lock::GlobalRead lk;
+                    dbHolder().getAllShortNames( false, dbs );
+                }
+                for ( set<string>::const_iterator i = dbs.begin(); i != dbs.end() && !inShutdown(); ++i ) {
+                    try {
+                        coalesceDatabase( *i );
+                    }
+                    catch ( std::exception& e ) {
+                        log() << "error coalescing deleted records in " << *i << causedBy( e ) << endl;
+                    }
+                }
+            }
+            cc().shutdown();
+        }
+
+    private:
+        enum { Secs = 60, MinCoalescible = 16, MaxScan = 1000000, MaxMergedPerPass = 1000 };
+
+        static bool wanted( NamespaceDetails *d ) {
+            return d && !d->isCapped() && d->isUserFlagSet( NamespaceDetails::Flag_UsePowerOf2Sizes );
+        }
+
+        void coalesceDatabase( const string& dbname ) {
+            list<string> collections;
+            {
+                Lock::DBRead lk( dbname );
+                Database *db = dbHolder().get( dbname, dbpath );
+                if ( !db )
+                    return;
+                db->namespaceIndex.getNamespaces( collections );
+            }
+
+            for ( list<string>::const_iterator i = collections.begin(); i != collections.end(); ++i ) {
+                const string& ns = *i;
+                {
+                    // worth the write lock?
+                    Lock::DBRead lk( ns );
+                    Database *db = dbHolder().get( ns, dbpath );
+                    if ( !db )
+                        return;
+                    Client::Context ctx( ns, db );
+                    NamespaceDetails *d = nsdetails( ns.c_str() );
+                    if ( !wanted( d ) )
+                        continue;
+                    NamespaceDetails::FreeListStats s;
+                    d->freeListStats( s, MaxScan );
+                    if ( s.coalescible < MinCoalescible )
+                        continue;
+                }
+
+                Timer t;
+                long long n = 0;
+                while ( !inShutdown() ) {
+                    long long merged;
+                    {
+                        Lock::DBWrite lk( ns );
+                        Database *db = dbHolder().get( ns, dbpath );
+                        if ( !db )
+                            return;
+                        Client::Context ctx( ns, db );
+                        NamespaceDetails *d = nsdetails( ns.c_str() );
+                        if ( !wanted( d ) )
+                            break;
+                        merged = d->coalesceDeletedRecords( MaxScan, MaxMergedPerPass );
+                        getDur().commitIfNeeded();
+                    }
+                    n += merged;
+                    if ( merged < MaxMergedPerPass )
+                        break;
+                    // let in whoever queued up behind us
+                    sleepmillis( 1 );
+                }
+                LOG(1) << "coalesced " << n << " deleted records in " << ns << ' ' << t.millis() << "ms" << endl;
+            }
+        }
+    };
+
+    void startFreeListCoalescer() {
+        ( new FreeListCoalescer() )->go();
+    }
+
 } // namespace mongo
@@ -27,6 +27,7 @@
 #include "mongo/db/mongommf.h"
 #include "mongo/db/namespace.h"
 #include "mongo/db/queryoptimizercursor.h"
+#include "mongo/db/queryplancache.h"
 #include "mongo/db/querypattern.h"
 #include "mongo/util/hashtab.h"
 
@@ -343,6 +344,30 @@ namespace mongo {
         /* add a given record to the deleted chains for this NS */
         void addDeletedRec(DeletedRecord *d, DiskLoc dloc);
         void dumpDeleted(set<DiskLoc> *extents = 0);
+
+        /** what's on the deleted lists of a collection that isn't capped */
+        struct FreeListStats {
+            FreeListStats();
+            long long records;
+            long long size; // with headers
+            int largest;
+            /** records right after another deleted record in the same extent, which
+                coalesceDeletedRecords() would merge */
+            long long coalescible;
+            long long byBucket[Buckets];
+            long long sizeByBucket[Buckets];
+            /** stopped after maxRecords, so the above are for part of the lists */
+            bool truncated;
+        };
+        void freeListStats( FreeListStats& s , long long maxRecords ) const;
+
+        /** merge deleted records that are next to each other in an extent, as compact() does for
+            capped collections.  not for capped collections.  bounded, so a caller can let others
+            in between calls: looks at the first maxScan records on the lists and merges at most
+            maxMerged of them, writing only the records it merges.
+            @return how many records were merged into the one before them
+        */
+        long long coalesceDeletedRecords( long long maxScan = 1000000 , long long maxMerged = 10000 );
         // Start from firstExtent by default.
         DiskLoc firstRecord( const DiskLoc &startExtent = DiskLoc() ) const;
         // Start from lastExtent by default.
@@ -365,6 +390,7 @@ namespace mongo {
         DiskLoc _alloc(const char *ns, int len);
         void maybeComplain( const char *ns, int len ) const;
         DiskLoc __stdAlloc(int len, bool willBeAt);
+        DiskLoc _sizeClassAlloc(int len, bool peekOnly);
         void compact(); // combine adjacent deleted records
         friend class NamespaceIndex;
         struct ExtraOld {
@@ -510,8 +536,7 @@ namespace mongo {
 
         /* query cache (for query optimizer) ------------------------------------- */
     private:
-        int _qcWriteCount;
-        map<QueryPattern,CachedQueryPlan> _qcCache;
+        QueryPlanCache _qcCache;
         static NamespaceDetailsTransient& make_inlock(const char *ns);
     public:
         static SimpleMutex _qcMutex;
@@ -532,22 +557,19 @@ namespace mongo {
 
         void clearQueryCache() {
             _qcCache.clear();
-            _qcWriteCount = 0;
         }
         /* you must notify the cache if you are doing writes, as query plan utility will change */
         void notifyOfWriteOp() {
-            if ( _qcCache.empty() )
-                return;
-            if ( ++_qcWriteCount >= 100 )
-                clearQueryCache();
+            _qcCache.noteWrite();
         }
         CachedQueryPlan cachedQueryPlanForPattern( const QueryPattern &pattern ) {
-            return _qcCache[ pattern ];
+            return _qcCache.get( pattern );
         }
         void registerCachedQueryPlanForPattern( const QueryPattern &pattern,
                                                const CachedQueryPlan &cachedQueryPlan ) {
-            _qcCache[ pattern ] = cachedQueryPlan;
+            _qcCache.set( pattern, cachedQueryPlan );
         }
+        QueryPlanCache& queryPlanCache() { return _qcCache; }
 
     }; /* NamespaceDetailsTransient */
 
@@ -627,5 +649,8 @@ namespace mongo {
     // (Arguments should include db name)
     void renameNamespace( const char *from, const char *to, bool stayTemp);
 
+    /** starts the thread that coalesces the deleted records of collections using power of 2 sizes */
+    void startFreeListCoalescer();
+
 
 } // namespace mongo
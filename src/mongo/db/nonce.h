@@ -17,10 +17,16 @@
 
 #pragma once
 
+#include <boost/thread/tss.hpp>
+
 namespace mongo {
 
     typedef unsigned long long nonce64;
 
+    /** the nonce getnonce last gave this thread's connection, for authenticate to check.  a
+        connection served by worker threads takes it along: see MessageHandler::attach() */
+    extern boost::thread_specific_ptr<nonce64> lastNonce;
+
     struct Security {
         Security();
         static nonce64 getNonce();
@@ -29,6 +29,7 @@
 #include "ops/update.h"
 #include "ops/delete.h"
 #include "mongo/db/instance.h"
+#include "mongo/util/concurrency/threadlocal.h"
 
 namespace mongo {
 
@@ -121,82 +122,154 @@ namespace mongo {
         *b = EOO;
     }
 
-    // global is safe as we are in write lock. we put the static outside the function to avoid the implicit mutex 
-    // the compiler would use if inside the function.  the reason this is static is to avoid a malloc/free for this
-    // on every logop call.
-    static BufBuilder logopbufbuilder(8*1024);
-    static void _logOpRS(const char *opstr, const char *ns, const char *logNS, const BSONObj& obj, BSONObj *o2, bool *bb, bool fromMigrate ) {
-        Lock::DBWrite lk1("local");
+    /** the entries of local.oplog.rs that have been reserved but not yet filled in, in the order
+        they were reserved, which is ts order.  the visible point of the oplog, 
+        theReplSet->lastOpTimeWritten, only moves past an entry once it and every entry before it
+        is filled in.  guarded by OpTime::m.
+    */
+    class OplogSlots : boost::noncopyable {
+        struct Slot {
+            OpTime ts;
+            bool filled;
+        };
+        deque<Slot> _slots;
+    public:
+        /** @return the newest ts reserved, or visible if nothing is in flight */
+        OpTime last(const OpTime& visible) const { 
+            return _slots.empty() ? visible : _slots.back().ts;
+        }
+        void reserved(const OpTime& ts) {
+            Slot s;
+            s.ts = ts;
+            s.filled = false;
+            _slots.push_back(s);
+        }
+        /** @return the new visible point, or a null OpTime if it hasn't moved */
+        OpTime filled(const OpTime& ts) {
+            for( deque<Slot>::iterator i = _slots.begin(); i != _slots.end(); i++ ) {
+                if( i->ts == ts ) {
+                    i->filled = true;
+                    break;
+                }
+            }
+            OpTime visible;
+            while( !_slots.empty() && _slots.front().filled ) {
+                visible = _slots.front().ts;
+                _slots.pop_front();
+            }
+            return visible;
+        }
+    };
+    static OplogSlots oplogSlots;
 
+    /** appenders build their entries at the same time, so each thread has its own builder.  it is
+        kept to avoid a malloc/free for this on every logop call. 
+    */
+    static boost::thread_specific_ptr<BufBuilder> logopbufbuilder;
+    static BufBuilder& logOpBufBuilder() { 
+        BufBuilder *b = logopbufbuilder.get();
+        if( b == 0 ) {
+            b = new BufBuilder(8*1024);
+            logopbufbuilder.reset(b);
+        }
+        b->reset();
+        return *b;
+    }
+
+    /** writers to different databases append to the oplog at the same time: each holds local in 
+        intent mode, and under OpTime::m takes its ts and hash and reserves its record, then fills
+        the record in with only the intent lock held.  readers of local wait for all appenders,
+        so never see a record that isn't filled in yet.
+    */
+    static void _logOpRS(const char *opstr, const char *ns, const char *logNS, const BSONObj& obj, BSONObj *o2, bool *bb, bool fromMigrate ) {
         if ( strncmp(ns, "local.", 6) == 0 ) {
-            if ( strncmp(ns, "local.slaves", 12) == 0 )
+            if ( strncmp(ns, "local.slaves", 12) == 0 ) {
+                Lock::DBWrite lk("local");
                 resetSlaveCache();
+            }
             return;
         }
 
-        mutex::scoped_lock lk2(OpTime::m);
-
-        const OpTime ts = OpTime::now(lk2);
-        long long hashNew;
-        if( theReplSet ) {
-            massert(13312, "replSet error : logOp() but not primary?", theReplSet->box.getState().primary());
-            hashNew = (theReplSet->lastH * 131 + ts.asLL()) * 17 + theReplSet->selfId();
-        }
-        else {
-            // must be initiation
-            verify( *ns == 0 );
-            hashNew = 0;
+        DEV verify( logNS == 0 );
+        const char *logns = rsoplog;
+        if ( rsOplogDetails == 0 ) {
+            // opening local needs it locked exclusively
+            Lock::DBWrite lk("local");
+            Client::Context ctx( logns , dbpath, false);
+            localDB = ctx.db();
+            verify( localDB );
+            rsOplogDetails = nsdetails(logns);
+            massert(13347, "local.oplog.rs missing. did you drop it? if so restart server", rsOplogDetails);
         }
 
+        Lock::OplogAppend lk1;
+        Client::Context ctx( logns , localDB, false );
+
         /* we jump through a bunch of hoops here to avoid copying the obj buffer twice --
            instead we do a single copy to the destination position in the memory mapped file.
         */
 
-        logopbufbuilder.reset();
-        BSONObjBuilder b(logopbufbuilder);
-        b.appendTimestamp("ts", ts.asDate());
-        b.append("h", hashNew);
-        b.append("op", opstr);
-        b.append("ns", ns);
-        if (fromMigrate) 
-            b.appendBool("fromMigrate", true);
-        if ( bb )
-            b.appendBool("b", *bb);
-        if ( o2 )
-            b.append("o2", *o2);
-        BSONObj partial = b.done();
-        int posz = partial.objsize();
-        int len = posz + obj.objsize() + 1 + 2 /*o:*/;
-
+        BSONObj partial;
         Record *r;
-        DEV verify( logNS == 0 );
+        OpTime ts;
         {
-            const char *logns = rsoplog;
-            if ( rsOplogDetails == 0 ) {
-                Client::Context ctx( logns , dbpath, false);
-                localDB = ctx.db();
-                verify( localDB );
-                rsOplogDetails = nsdetails(logns);
-                massert(13347, "local.oplog.rs missing. did you drop it? if so restart server", rsOplogDetails);
+            mutex::scoped_lock lk2(OpTime::m);
+
+            ts = OpTime::now(lk2);
+            long long hashNew;
+            if( theReplSet ) {
+                massert(13312, "replSet error : logOp() but not primary?", theReplSet->box.getState().primary());
+                hashNew = (theReplSet->lastH * 131 + ts.asLL()) * 17 + theReplSet->selfId();
             }
-            Client::Context ctx( logns , localDB, false );
+            else {
+                // must be initiation
+                verify( *ns == 0 );
+                hashNew = 0;
+            }
+
+            BSONObjBuilder b(logOpBufBuilder());
+            b.appendTimestamp("ts", ts.asDate());
+            b.append("h", hashNew);
+            b.append("op", opstr);
+            b.append("ns", ns);
+            if (fromMigrate) 
+                b.appendBool("fromMigrate", true);
+            if ( bb )
+                b.appendBool("b", *bb);
+            if ( o2 )
+                b.append("o2", *o2);
+            partial = b.done();
+            int posz = partial.objsize();
+            int len = posz + obj.objsize() + 1 + 2 /*o:*/;
+
             r = theDataFileMgr.fast_oplog_insert(rsOplogDetails, logns, len);
             /* todo: now() has code to handle clock skew.  but if the skew server to server is large it will get unhappy.
                      this code (or code in now() maybe) should be improved.
                      */
             if( theReplSet ) {
-                if( !(theReplSet->lastOpTimeWritten<ts) ) {
-                    log() << "replSet ERROR possible failover clock skew issue? " << theReplSet->lastOpTimeWritten << ' ' << ts << rsLog;
+                const OpTime last = oplogSlots.last(theReplSet->lastOpTimeWritten);
+                if( !(last<ts) ) {
+                    log() << "replSet ERROR possible failover clock skew issue? " << last << ' ' << ts << rsLog;
                     log() << "replSet " << theReplSet->isPrimary() << rsLog;
                 }
-                theReplSet->lastOpTimeWritten = ts;
+                // the next entry's hash chains from this one whether or not it is visible yet
                 theReplSet->lastH = hashNew;
-                ctx.getClient()->setLastOp( ts );
+                oplogSlots.reserved(ts);
             }
         }
 
         append_O_Obj(r->data(), partial, obj);
 
+        if( theReplSet ) {
+            {
+                mutex::scoped_lock lk2(OpTime::m);
+                const OpTime visible = oplogSlots.filled(ts);
+                if( !visible.isNull() )
+                    theReplSet->lastOpTimeWritten = visible;
+            }
+            ctx.getClient()->setLastOp( ts );
+        }
+
         if ( logLevel >= 6 ) {
             BSONObj temp(r);
             log( 6 ) << "logOp:" << temp << endl;
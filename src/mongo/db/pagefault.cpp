@@ -15,6 +15,8 @@ namespace mongo {
         cc().getPageFaultRetryableSection()->didLap();
         r = _r;
         era = LockMongoFilesShared::getEra();
+        prefetchLimit = r->prefetchLimit();
+        recordStats.pageFaultExceptionsThrown += 1;
         LOG(2) << "PageFaultException thrown" << endl;
     }
 
@@ -27,7 +29,7 @@ namespace mongo {
             dlog(2) << "era changed" << endl;
             return;
         }
-        r->touch();
+        r->prefetch(prefetchLimit);
     }
 
     PageFaultRetryableSection::~PageFaultRetryableSection() {
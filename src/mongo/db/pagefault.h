@@ -2,19 +2,42 @@
 
 #pragma once
 
+#include "mongo/platform/atomic_uint64.h"
+
 namespace mongo {
 
     class Record;
+    class BSONObjBuilder;
 
     class PageFaultException /*: public DBException*/ { 
         unsigned era;
         const Record *r;
+        const char *prefetchLimit;
     public:
-        PageFaultException(const PageFaultException& rhs) : era(rhs.era), r(rhs.r) { }
+        PageFaultException(const PageFaultException& rhs) : era(rhs.era), r(rhs.r), prefetchLimit(rhs.prefetchLimit) { }
         explicit PageFaultException(const Record*);
+        /** outside the lock, read in the record and what follows it.  see Record::prefetch() */
         void touch();
     };
 
+    /** serverStatus.recordStats */
+    struct RecordStats { 
+        /** residency checks that said a record wasn't in memory */
+        AtomicUInt64 accessesNotInMemory;
+        AtomicUInt64 pageFaultExceptionsThrown;
+        /** yields for a record, by PageFaultException or ClientCursor::yield(), where outside the
+            lock the record still wasn't in memory, and where it already was */
+        AtomicUInt64 faultsAccurate;
+        AtomicUInt64 faultsMispredicted;
+        /** a sample of the checks that said in memory, redone without the cache */
+        AtomicUInt64 inMemorySampled;
+        AtomicUInt64 inMemoryMispredicted;
+        /** read ahead after the faulting records */
+        AtomicUInt64 prefetchedBytes;
+        void append( BSONObjBuilder& b ) const;
+    };
+    extern RecordStats recordStats;
+
     class PageFaultRetryableSection : boost::noncopyable { 
         unsigned _laps;
     public:
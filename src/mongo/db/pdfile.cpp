@@ -944,6 +944,85 @@ namespace mongo {
         dropNS(name);
     }
 
+    /** while a background build of a non unique index scans, sorts and bulk loads the keys it found
+        in the collection, writers leave that index's btree alone and append the keys they would
+        have added or removed here instead.  the build replays the log once its btree is loaded.
+        writers log with the collection's write lock held: Lock::CollectionWrite, which holds the
+        database only in intent mode, or the database's write lock.  the log also guards its
+        entries with its own mutex, so it doesn't depend on every writer taking the same lock.
+    */
+    class BgIndexSideLog : boost::noncopyable {
+    public:
+        struct Op {
+            Op(bool ins, const BSONObj& k, const DiskLoc& l) : insert(ins), key(k.getOwned()), loc(l) { }
+            bool insert;
+            BSONObj key;
+            DiskLoc loc;
+        };
+
+        /** @return the log for d's in progress index, or 0 if writers should update its btree */
+        static BgIndexSideLog* get(NamespaceDetails *d) {
+            SimpleMutex::scoped_lock lk(_m);
+            map<NamespaceDetails*,BgIndexSideLog*>::iterator i = _logs.find(d);
+            return i == _logs.end() ? 0 : i->second;
+        }
+
+        void logKeys(bool insert, const BSONObjSet& keys, const DiskLoc& loc) {
+            SimpleMutex::scoped_lock lk(_opsMutex);
+            for( BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); i++ )
+                _ops.push_back( Op(insert, *i, loc) );
+        }
+        void logKeys(bool insert, const vector<BSONObj*>& keys, const DiskLoc& loc) {
+            SimpleMutex::scoped_lock lk(_opsMutex);
+            for( unsigned i = 0; i < keys.size(); i++ )
+                _ops.push_back( Op(insert, *keys[i], loc) );
+        }
+
+        /** moves up to n of the oldest entries to the end of out */
+        void take(unsigned n, vector<Op>& out) {
+            SimpleMutex::scoped_lock lk(_opsMutex);
+            while( n-- && !_ops.empty() ) {
+                out.push_back( _ops.front() );
+                _ops.pop_front();
+            }
+        }
+        size_t size() {
+            SimpleMutex::scoped_lock lk(_opsMutex);
+            return _ops.size();
+        }
+
+        class Scope;
+
+    private:
+        BgIndexSideLog() : _opsMutex("bgIndexSideLogOps") { }
+        SimpleMutex _opsMutex; // guards _ops
+        deque<Op> _ops;
+        static SimpleMutex _m;
+        static map<NamespaceDetails*,BgIndexSideLog*> _logs;
+    };
+
+    /** for its lifetime, writes to d's in progress index are logged */
+    class BgIndexSideLog::Scope : boost::noncopyable {
+    public:
+        Scope(NamespaceDetails *d) : _d(d) {
+            SimpleMutex::scoped_lock lk(_m);
+            verify( _logs.count(d) == 0 );
+            _logs[d] = &_log;
+        }
+        ~Scope() { stop(); }
+        BgIndexSideLog& log() { return _log; }
+        /** writers go to the btree from here on.  the log should be empty */
+        void stop() {
+            SimpleMutex::scoped_lock lk(_m);
+            _logs.erase(_d);
+        }
+    private:
+        NamespaceDetails *_d;
+        BgIndexSideLog _log;
+    };
+    SimpleMutex BgIndexSideLog::_m("bgIndexSideLog");
+    map<NamespaceDetails*,BgIndexSideLog*> BgIndexSideLog::_logs;
+
     /* unindex all keys in index for this record. */
     static void _unindexRecord(IndexDetails& id, BSONObj& obj, const DiskLoc& dl, bool logMissing = true) {
         BSONObjSet keys;
@@ -970,6 +1049,20 @@ namespace mongo {
             }
         }
     }
+
+    /* unindex a record from the index being built in the background */
+    static void unindexInProgRecord(NamespaceDetails *d, BSONObj& obj, const DiskLoc& dl) {
+        IndexDetails& idx = d->idx(d->nIndexes);
+        if( BgIndexSideLog *sideLog = BgIndexSideLog::get(d) ) {
+            BSONObjSet keys;
+            idx.getKeysFromObject(obj, keys);
+            sideLog->logKeys(false, keys, dl);
+            return;
+        }
+        // always pass nowarn here, as this one may be missing for valid reasons as we are concurrently building it
+        _unindexRecord(idx, obj, dl, false);
+    }
+
 //zzz
     /* unindex all keys in all indexes for this record. */
     static void unindexRecord(NamespaceDetails *d, Record *todelete, const DiskLoc& dl, bool noWarn = false) {
@@ -978,8 +1071,7 @@ namespace mongo {
         for ( int i = 0; i < n; i++ )
             _unindexRecord(d->idx(i), obj, dl, !noWarn);
         if( d->indexBuildInProgress ) { // background index
-            // always pass nowarn here, as this one may be missing for valid reasons as we are concurrently building it
-            _unindexRecord(d->idx(n), obj, dl, false);
+            unindexInProgRecord(d, obj, dl);
         }
     }
 
@@ -1134,6 +1226,13 @@ namespace mongo {
             for ( int x = 0; x < z; x++ ) {
                 IndexDetails& idx = d->idx(x);
                 IndexInterface& ii = idx.idxInterface();
+                if( x == d->nIndexes ) {
+                    if( BgIndexSideLog *sideLog = BgIndexSideLog::get(d) ) {
+                        sideLog->logKeys(false, changes[x].removed, dl);
+                        sideLog->logKeys(true, changes[x].added, dl);
+                        continue;
+                    }
+                }
                 for ( unsigned i = 0; i < changes[x].removed.size(); i++ ) {
                     try {
                         bool found = ii.unindex(idx.head, idx, *changes[x].removed[i], dl);
@@ -1246,6 +1345,16 @@ namespace mongo {
         {
             BSONObjSet keys;
             for ( int i = 0; i < n; i++ ) {
+                if( i == d->nIndexes ) {
+                    if( BgIndexSideLog *sideLog = BgIndexSideLog::get(d) ) {
+                        d->idx(i).getKeysFromObject(obj, keys);
+                        if( keys.size() > 1 )
+                            d->setIndexIsMultikey(ns, i);
+                        sideLog->logKeys(true, keys, loc);
+                        keys.clear();
+                        continue;
+                    }
+                }
                 // this call throws on unique constraint violation.  we haven't done any writes yet so that is fine.
                 _addKeysToIndexStepOneOfTwo(/*out*/keys, inserter, d, i, obj, loc);
                 if( keys.size() > 1 ) {
@@ -1280,7 +1389,10 @@ namespace mongo {
                         */
                         for( int j = 0; j < n; j++ ) {
                             try {
-                                _unindexRecord(d->idx(j), obj, loc, false);
+                                if( j == d->nIndexes )
+                                    unindexInProgRecord(d, obj, loc);
+                                else
+                                    _unindexRecord(d->idx(j), obj, loc, false);
                             }
                             catch(...) {
                                 log(3) << "unindex fails on rollback after unique key constraint prevented insert\n";
@@ -1408,6 +1520,82 @@ namespace mongo {
         }
     }
 
+    /** threads for the key extraction and external sort of a foreground index build */
+    static int indexBuildThreads() {
+        unsigned n = ProcessInfo().getNumCores();
+        return n < 1 ? 1 : n > 16 ? 16 : n;
+    }
+
+    /** records whose keys are extracted together on one thread during a foreground index build */
+    struct KeyBatch {
+        vector< pair<BSONObj,DiskLoc> > records;
+        vector<BSONObjSet> keys;
+        int errCode;
+        string errMsg;
+
+        static void getKeys(const IndexSpec *spec, KeyBatch *b) {
+            b->keys.clear();
+            b->keys.resize(b->records.size());
+            b->errCode = 0;
+            try {
+                for( unsigned i = 0; i < b->records.size(); i++ )
+                    spec->getKeys(b->records[i].first, b->keys[i]);
+            }
+            catch( DBException& e ) {
+                b->errCode = e.getCode();
+                b->errMsg = e.what();
+            }
+        }
+    };
+
+    /** phase one of a foreground index build: the keys of every record in ns into p1.sorter.  the
+        keys are extracted on a pool of threads, a batch of records each, and added in record order.
+        we are write locked and don't yield, so the records stay put meanwhile.
+    */
+    static void addExistingKeys(const char *ns, const IndexSpec& spec, SortPhaseOne& p1, 
+                                ProgressMeterHolder& pm, int nThreads) {
+        shared_ptr<Cursor> c = theDataFileMgr.findAll(ns);
+        if( nThreads <= 1 ) {
+            while ( c->ok() ) {
+                p1.addKeys(spec, c->current(), c->currLoc());
+                c->advance();
+                pm.hit();
+            }
+            return;
+        }
+
+        const unsigned BatchSize = 1000;
+        ThreadPool pool(nThreads);
+        vector<KeyBatch> batches(nThreads);
+        while ( c->ok() ) {
+            for( int b = 0; b < nThreads; b++ ) {
+                batches[b].records.clear();
+                while( c->ok() && batches[b].records.size() < BatchSize ) {
+                    batches[b].records.push_back( make_pair( c->current(), c->currLoc() ) );
+                    c->advance();
+                }
+                if( !batches[b].records.empty() )
+                    pool.schedule(&KeyBatch::getKeys, &spec, &batches[b]);
+            }
+            pool.join();
+            for( int b = 0; b < nThreads; b++ ) {
+                KeyBatch& batch = batches[b];
+                if( batch.records.empty() )
+                    continue;
+                if( batch.errCode )
+                    uasserted(batch.errCode, batch.errMsg);
+                for( unsigned i = 0; i < batch.records.size(); i++ ) {
+                    p1.addKeys(batch.keys[i], batch.records[i].second);
+                    pm.hit();
+                }
+            }
+            killCurrentOp.checkForInterrupt();
+            if ( logLevel > 1 ) {
+                printMemInfo( "\t iterating objects" );
+            }
+        }
+    }
+
     // throws DBException
     unsigned long long fastBuildIndex(const char *ns, NamespaceDetails *d, IndexDetails& idx, int idxNo) {
         CurOp * op = cc().curop();
@@ -1431,20 +1619,11 @@ namespace mongo {
         if( phase1 == 0 ) {
             phase1 = &_ours;
             SortPhaseOne& p1 = *phase1;
-            shared_ptr<Cursor> c = theDataFileMgr.findAll(ns);
-            p1.sorter.reset( new BSONObjExternalSorter(idx.idxInterface(), order) );
+            // small collections aren't worth starting threads for
+            int nThreads = d->stats.nrecords > 100000 ? indexBuildThreads() : 1;
+            p1.sorter.reset( new BSONObjExternalSorter(idx.idxInterface(), order, 1024 * 1024 * 100, nThreads) );
             p1.sorter->hintNumObjects( d->stats.nrecords );
-            const IndexSpec& spec = idx.getSpec();
-            while ( c->ok() ) {
-                BSONObj o = c->current();
-                DiskLoc loc = c->currLoc();
-                p1.addKeys(spec, o, loc);
-                c->advance();
-                pm.hit();
-                if ( logLevel > 1 && p1.n % 10000 == 0 ) {
-                    printMemInfo( "\t iterating objects" );
-                }
-            };
+            addExistingKeys(ns, idx.getSpec(), p1, pm, nThreads);
         }
         pm.finished();
 
@@ -1558,6 +1737,171 @@ namespace mongo {
             return n;
         }
 
+        /** phase one of a sorted background build: the keys of every record in ns into p1.sorter.
+            the scan goes in natural (extent) order, a batch of records at a time: the keys of a batch
+            are extracted on a pool of threads, as in a foreground build, with the lock held, and we
+            only consider yielding between batches.
+        */
+        void scanAndSort(const char *ns, NamespaceDetails *d, const IndexSpec& spec, SortPhaseOne& p1,
+                         ProgressMeter& progress, int nThreads) {
+            auto_ptr<ClientCursor> cc;
+            {
+                shared_ptr<Cursor> c = theDataFileMgr.findAll(ns);
+                cc.reset( new ClientCursor(QueryOption_NoCursorTimeout, c, ns) );
+            }
+
+            const unsigned BatchSize = 1000;
+            ThreadPool pool(nThreads);
+            vector<KeyBatch> batches(nThreads);
+            while ( cc->ok() ) {
+                for( int b = 0; b < nThreads; b++ ) {
+                    batches[b].records.clear();
+                    while( cc->ok() && batches[b].records.size() < BatchSize ) {
+                        batches[b].records.push_back( make_pair( cc->current(), cc->currLoc() ) );
+                        cc->advance();
+                    }
+                    if( batches[b].records.empty() )
+                        continue;
+                    if( nThreads == 1 )
+                        KeyBatch::getKeys(&spec, &batches[b]);
+                    else
+                        pool.schedule(&KeyBatch::getKeys, &spec, &batches[b]);
+                }
+                pool.join();
+                for( int b = 0; b < nThreads; b++ ) {
+                    KeyBatch& batch = batches[b];
+                    if( batch.records.empty() )
+                        continue;
+                    if( batch.errCode )
+                        uasserted(batch.errCode, batch.errMsg);
+                    for( unsigned i = 0; i < batch.records.size(); i++ ) {
+                        p1.addKeys(batch.keys[i], batch.records[i].second);
+                        progress.hit();
+                    }
+                    batch.records.clear();
+                }
+
+                if ( cc->yieldSometimes( ClientCursor::WillNeed ) ) {
+                    progress.setTotalWhileRunning( d->stats.nrecords );
+                }
+                else {
+                    cc.release();
+                    uasserted(16389, "cursor gone during bg index");
+                }
+            }
+        }
+
+        /** phase two: load the sorted keys into the btree bottom up, yielding between keys when
+            others are waiting.  nobody else touches the new buckets meanwhile: the index isn't
+            visible to queries yet and writers append to the side log.
+        */
+        template< class V >
+        void bulkLoad(const char *ns, IndexDetails& idx, BSONObjExternalSorter& sorter, ProgressMeter& progress) {
+            BtreeBuilder<V> btBuilder(/*dupsAllowed*/true, idx);
+            auto_ptr<BSONObjExternalSorter::Iterator> i = sorter.iterator();
+            unsigned long long k = 0;
+            while( i->more() ) {
+                BSONObjExternalSorter::Data d = i->next();
+                btBuilder.addKey(d.first, d.second);
+                progress.hit();
+                if( ++k % 128 == 0 ) {
+                    int micros = ClientCursor::suggestYieldMicros();
+                    if( micros > 0 ) {
+                        ClientCursor::staticYield(micros, ns, 0);
+                        btBuilder.relocked();
+                    }
+                }
+            }
+            btBuilder.commit();
+        }
+
+        /** phase three: apply the writes logged while we scanned and loaded.  a chunk at a time,
+            yielding in between for as long as that drains the log; the last of it is applied
+            without releasing the lock, so it is empty when writers switch to the btree.
+            replay is idempotent: an insert of a key we already have and a remove of one we
+            don't are no-ops, and as the log is in write order the last op on a key wins.
+        */
+        unsigned long long catchUp(const char *ns, NamespaceDetails *d, IndexDetails& idx,
+                                   BgIndexSideLog& sideLog) {
+            IndexInterface& ii = idx.idxInterface();
+            Ordering ordering = Ordering::make(idx.keyPattern());
+            ProgressMeter& progress = cc().curop()->setMessage( "bg index build (3/3) catch up" , sideLog.size() );
+            unsigned long long n = 0;
+            size_t lastLeft = sideLog.size() + 1;
+            vector<BgIndexSideLog::Op> ops;
+            while( sideLog.size() ) {
+                ops.clear();
+                sideLog.take(1000, ops);
+                for( unsigned i = 0; i < ops.size(); i++ ) {
+                    BgIndexSideLog::Op& op = ops[i];
+                    if( op.insert ) {
+                        try {
+                            ii.bt_insert(idx.head, op.loc, op.key, ordering, /*dupsAllowed*/true, idx);
+                        }
+                        catch( AssertionException& e ) {
+                            if( e.getCode() != 10287 )
+                                throw;
+                        }
+                    }
+                    else {
+                        ii.unindex(idx.head, idx, op.key, op.loc);
+                    }
+                    getDur().commitIfNeeded();
+                    progress.hit();
+                }
+                n += ops.size();
+
+                size_t left = sideLog.size();
+                if( left && left < lastLeft ) {
+                    lastLeft = left;
+                    ClientCursor::staticYield(-1, ns, 0);
+                    progress.setTotalWhileRunning( n + sideLog.size() );
+                }
+            }
+            progress.finished();
+            return n;
+        }
+
+        /** the sorted build for an index without a uniqueness constraint.  the btree is built from
+            sorted keys as in a foreground build, while concurrent writes to the collection go to a
+            side log which is then replayed.  unique indexes keep building into the live btree, as
+            a duplicate key must fail the write that adds it.
+        */
+        unsigned long long buildSorted(const char *ns, NamespaceDetails *d, IndexDetails& idx, int idxNo) {
+            Timer t;
+            BgIndexSideLog::Scope sideLog(d);
+
+            SortPhaseOne p1;
+            int nThreads = d->stats.nrecords > 100000 ? indexBuildThreads() : 1;
+            p1.sorter.reset( new BSONObjExternalSorter(idx.idxInterface(), idx.keyPattern(), 1024 * 1024 * 100, nThreads) );
+            p1.sorter->hintNumObjects( d->stats.nrecords );
+            {
+                ProgressMeter& progress = cc().curop()->setMessage( "bg index build (1/3) scan and sort" , d->stats.nrecords );
+                scanAndSort(ns, d, idx.getSpec(), p1, progress, nThreads);
+                progress.finished();
+            }
+            if( p1.multi )
+                d->setIndexIsMultikey(ns, idxNo);
+            p1.sorter->sort();
+            log(t.seconds() > 5 ? 0 : 1) << "\t bg index external sort used : " << p1.sorter->numFiles() << " files " << " in " << t.seconds() << " secs" << endl;
+
+            {
+                ProgressMeter& progress = cc().curop()->setMessage( "bg index build (2/3) btree bottom up" , p1.nkeys );
+                if( idx.version() == 0 )
+                    bulkLoad<V0>(ns, idx, *p1.sorter, progress);
+                else if( idx.version() == 1 )
+                    bulkLoad<V1>(ns, idx, *p1.sorter, progress);
+                else
+                    verify(false);
+                progress.finished();
+            }
+
+            unsigned long long logged = catchUp(ns, d, idx, sideLog.log());
+            sideLog.stop();
+            log(t.seconds() > 5 ? 0 : 1) << "\t bg index replayed " << logged << " concurrent writes" << endl;
+            return p1.n;
+        }
+
         /* we do set a flag in the namespace for quick checking, but this is our authoritative info -
            that way on a crash/restart, we don't think we are still building one. */
         set<NamespaceDetails*> bgJobsInProgress;
@@ -1581,8 +1925,14 @@ namespace mongo {
             prep(ns.c_str(), d);
             verify( idxNo == d->nIndexes );
             try {
-                idx.head.writing() = idx.idxInterface().addBucket(idx);
-                n = addExistingToIndex(ns.c_str(), d, idx, idxNo);
+                if( !idx.unique() && !idx.dropDups() ) {
+                    getDur().writingDiskLoc(idx.head).Null();
+                    n = buildSorted(ns.c_str(), d, idx, idxNo);
+                }
+                else {
+                    idx.head.writing() = idx.idxInterface().addBucket(idx);
+                    n = addExistingToIndex(ns.c_str(), d, idx, idxNo);
+                }
             }
             catch(...) {
                 if( cc().database() && nsdetails(ns.c_str()) == d ) {
@@ -1706,6 +2056,9 @@ namespace mongo {
     }
 
 #pragma pack(1)
+    /** an _id element, init() its oid before use.  made on the stack for each insert: writers
+        to different collections insert at the same time.
+    */
     struct IDToInsert_ {
         char type;
         char _id[4];
@@ -1713,13 +2066,10 @@ namespace mongo {
         IDToInsert_() {
             type = (char) jstOID;
             strcpy(_id, "_id");
-            verify( sizeof(IDToInsert_) == 17 );
         }
-    } idToInsert_;
+    };
 #pragma pack()
-    struct IDToInsert : public BSONElement {
-        IDToInsert() : BSONElement( ( char * )( &idToInsert_ ) ) {}
-    } idToInsert;
+    BOOST_STATIC_ASSERT( sizeof(IDToInsert_) == 17 );
 
     void DataFileMgr::insertAndLog( const char *ns, const BSONObj &o, bool god, bool fromMigrate ) {
         BSONObj tmp = o;
@@ -1943,6 +2293,8 @@ namespace mongo {
         }
 
         int addID = 0; // 0 if not adding _id; if adding, the length of that new element
+        IDToInsert_ idToInsert_;
+        BSONElement idToInsert( (char *) &idToInsert_ );
         if( !god ) {
             /* Check if we have an _id field. If we don't, we'll add it.
                Note that btree buckets which we insert aren't BSONObj's, but in that case god==true.
@@ -2076,6 +2428,145 @@ namespace mongo {
         return loc;
     }
 
+    /** an index key of the batch in insertBatch(), and which of its documents it is for */
+    struct BatchKey {
+        BatchKey( const BSONObj& k , int d ) : key( k ) , doc( d ) { }
+        BSONObj key;
+        int doc;
+    };
+
+    /** index order, then document order so the first of a batch's duplicates is the one kept */
+    class BatchKeyOrder {
+    public:
+        BatchKeyOrder( const Ordering& o ) : _o( o ) { }
+        bool operator()( const BatchKey& a , const BatchKey& b ) const {
+            int c = a.key.woCompare( b.key , _o , false );
+            if ( c != 0 )
+                return c < 0;
+            return a.doc < b.doc;
+        }
+    private:
+        const Ordering& _o;
+    };
+
+    bool DataFileMgr::insertBatch(const char *ns, vector<BSONObj>& objs, size_t begin, size_t end) {
+        const int n = end - begin;
+        if ( n < 2 || strstr( ns , "system." ) || !NamespaceString::normal( ns ) )
+            return false;
+        NamespaceDetails *d = nsdetails(ns);
+        if ( d == 0 || d->isCapped() || d->indexBuildInProgress )
+            return false;
+        uassert( 16402 , str::stream() << "invalid ns: " << ns , isValidNS( ns ) );
+
+        // nothing is written until all the documents have checked out
+        const bool addIds = d->haveIdIndex() && strstr( ns , ".local." ) == 0;
+        vector<int> lens( n );
+        int total = 0;
+        for ( int i = 0; i < n; i++ ) {
+            BSONObj& o = objs[begin + i];
+            BSONElement idField = o.getField( "_id" );
+            uassert( 16403 , "_id cannot be an array" , idField.type() != Array );
+            if ( idField.eoo() && addIds ) {
+                IDToInsert_ idToInsert_;
+                idToInsert_.oid.init();
+                BSONElement idToInsert( (char *) &idToInsert_ );
+                BSONObjBuilder b( o.objsize() + idToInsert.size() );
+                b.append( idToInsert );
+                b.appendElements( o );
+                o = b.obj();
+            }
+            BSONElementManipulator::lookForTimestamps( o );
+            lens[i] = ( d->getRecordAllocationSize( o.objsize() + Record::HeaderSize ) + 3 ) & 0xfffffffc;
+            total += lens[i];
+        }
+
+        DiskLoc first = allocateSpaceForANewRecord( ns , d , total , false );
+        if ( first.isNull() )
+            return false;
+
+        Record *r = first.rec();
+        const int regionLen = r->lengthWithHeaders();
+        const int extentOfs = r->extentOfs();
+        // alloc() may have handed over more than asked for, which goes to the last record
+        lens[n - 1] += regionLen - total;
+
+        char *base = (char *) getDur().writingPtr( r , regionLen );
+        vector<DiskLoc> locs( n );
+        int ofs = 0;
+        for ( int i = 0; i < n; i++ ) {
+            Record *w = (Record *) ( base + ofs );
+            const BSONObj& o = objs[begin + i];
+            w->lengthWithHeaders() = lens[i];
+            w->extentOfs() = extentOfs;
+            w->prevOfs() = i == 0 ? DiskLoc::NullOfs : first.getOfs() + ofs - lens[i - 1];
+            w->nextOfs() = i == n - 1 ? DiskLoc::NullOfs : first.getOfs() + ofs + lens[i];
+            memcpy( w->data() , o.objdata() , o.objsize() );
+            locs[i] = DiskLoc( first.a() , first.getOfs() + ofs );
+            ofs += lens[i];
+        }
+
+        // the run goes on the end of the extent's record list as a whole
+        Extent *e = DataFileMgr::getExtent( DiskLoc( first.a() , extentOfs ) );
+        if ( e->lastRecord.isNull() ) {
+            Extent::FL *fl = getDur().writing( e->fl() );
+            fl->firstRecord = locs[0];
+            fl->lastRecord = locs[n - 1];
+        }
+        else {
+            ( (Record *) base )->prevOfs() = e->lastRecord.getOfs();
+            getDur().writingInt( e->lastRecord.rec()->nextOfs() ) = locs[0].getOfs();
+            getDur().writingDiskLoc( e->lastRecord ) = locs[n - 1];
+        }
+
+        {
+            NamespaceDetails::Stats *s = getDur().writing( &d->stats );
+            s->datasize += regionLen - n * Record::HeaderSize;
+            s->nrecords += n;
+        }
+
+        try {
+            for ( int idxNo = 0; idxNo < d->nIndexes; idxNo++ ) {
+                IndexDetails& idx = d->idx( idxNo );
+                vector<BatchKey> keys;
+                keys.reserve( n );
+                BSONObjSet docKeys;
+                for ( int i = 0; i < n; i++ ) {
+                    idx.getKeysFromObject( objs[begin + i] , docKeys );
+                    if ( docKeys.size() > 1 )
+                        d->setIndexIsMultikey( ns , idxNo );
+                    for ( BSONObjSet::iterator k = docKeys.begin(); k != docKeys.end(); ++k )
+                        keys.push_back( BatchKey( *k , i ) );
+                    docKeys.clear();
+                }
+
+                // in key order consecutive inserts mostly land in the same, already faulted in bucket
+                Ordering ordering = Ordering::make( idx.keyPattern() );
+                sort( keys.begin() , keys.end() , BatchKeyOrder( ordering ) );
+                IndexInterface& ii = idx.idxInterface();
+                for ( size_t k = 0; k < keys.size(); k++ )
+                    ii.bt_insert( idx.head , locs[keys[k].doc] , keys[k].key , ordering , !idx.unique() , idx );
+            }
+        }
+        catch ( AssertionException& e ) {
+            // which documents would have failed inserted one at a time depends on the order the
+            // keys went in, so undo them all and leave that to the caller
+            LOG(1) << "batch insert of " << n << " into " << ns << " undone: " << e.toString() << endl;
+            for ( int i = 0; i < n; i++ ) {
+                Record *ri = locs[i].rec();
+                unindexRecord( d , ri , locs[i] , true );
+                _deleteRecord( d , ns , ri , locs[i] );
+            }
+            return false;
+        }
+
+        NamespaceDetailsTransient& nsdt = NamespaceDetailsTransient::get( ns );
+        for ( int i = 0; i < n; i++ ) {
+            nsdt.notifyOfWriteOp();
+            d->paddingFits();
+        }
+        return true;
+    }
+
     /* special version of insert for transaction logging -- streamlined a bit.
        assumes ns is capped and no indexes
     */
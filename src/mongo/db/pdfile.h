@@ -85,6 +85,12 @@ namespace mongo {
 
         unsigned long long length() const { return mmf.length(); }
 
+        /** @return the end of this file's view if p is within it, else 0 */
+        const char* viewEnd( const void *p ) const { 
+            const char *end = this->p() + length();
+            return p >= _mb && p < end ? end : 0;
+        }
+
         /* return max size an extent may be */
         static int maxSize();
 
@@ -142,6 +148,15 @@ namespace mongo {
         void insertNoReturnVal(const char *ns, BSONObj o, bool god = false);
 
         DiskLoc insert(const char *ns, const void *buf, int len, bool god = false, bool mayAddIndex = true, bool *addedID = 0);
+
+        /** insert objs[begin, end) into ns together: their records are carved from one allocation
+            and written under one write intent, and each index gets the batch's keys in key order.
+            objs without an _id get one added, as insertWithObjMod() does.
+            @return false if ns isn't an existing, uncapped user collection, or if a document
+                    failed to index (a duplicate key), in which case the whole batch is undone.
+                    insert them one at a time then.
+        */
+        bool insertBatch(const char *ns, vector<BSONObj>& objs, size_t begin, size_t end);
         static shared_ptr<Cursor> findAll(const char *ns, const DiskLoc &startLoc = DiskLoc());
 
         /* special version of insert for transaction logging -- streamlined a bit.
@@ -274,6 +289,21 @@ namespace mongo {
          */
         Record* accessed();
 
+        enum { PrefetchBytes = 1024 * 1024 };
+
+        /**
+         * with the database locked, when this record isn't in memory: where reading ahead of it 
+         * stops, which is PrefetchBytes on or the end of its data file.  records that follow in 
+         * the file are what a scan will want in its next batch.
+         */
+        const char* prefetchLimit() const;
+
+        /**
+         * outside the database lock, under LockMongoFilesShared: touch() this record and have the
+         * os read in what follows it up to limit from prefetchLimit()
+         */
+        void prefetch( const char *limit ) const;
+
     private:
         
         int _netLength() const { return _lengthWithHeaders - HeaderSize; }
@@ -36,6 +36,10 @@ namespace mongo {
         ExpressionNary() {
     }
 
+    size_t Accumulator::getApproximateSize() const {
+        return sizeof(*this);
+    }
+
     void Accumulator::opToBson(
         BSONObjBuilder *pBuilder, string opName,
         string fieldName) const {
@@ -43,6 +43,15 @@ namespace mongo {
          */
         virtual intrusive_ptr<const Value> getValue() const = 0;
 
+        /*
+          Get the approximate amount of memory held by this accumulator.
+
+          $group uses this to decide when to spill to disk.
+
+          @returns the approximate size, in bytes
+         */
+        virtual size_t getApproximateSize() const;
+
     protected:
         Accumulator();
 
@@ -69,6 +78,9 @@ namespace mongo {
         virtual intrusive_ptr<const Value> getValue() const;
         virtual const char *getOpName() const;
 
+        // virtuals from Accumulator
+        virtual size_t getApproximateSize() const;
+
         /*
           Create an appending accumulator.
 
@@ -80,9 +92,12 @@ namespace mongo {
 
     private:
         AccumulatorAddToSet(const intrusive_ptr<ExpressionContext> &pTheCtx);
+        void insert(const intrusive_ptr<const Value> &pValue) const;
+
         typedef boost::unordered_set<intrusive_ptr<const Value>, Value::Hash > SetType;
         mutable SetType set;
         mutable SetType::iterator itr; 
+        mutable size_t setSize; /* approximate size of the values in set */
         intrusive_ptr<ExpressionContext> pCtx;
     };
 
@@ -99,6 +114,9 @@ namespace mongo {
         // virtuals from Expression
         virtual intrusive_ptr<const Value> getValue() const;
 
+        // virtuals from Accumulator
+        virtual size_t getApproximateSize() const;
+
     protected:
         AccumulatorSingleValue();
 
@@ -218,10 +236,14 @@ namespace mongo {
         static intrusive_ptr<Accumulator> create(
             const intrusive_ptr<ExpressionContext> &pCtx);
 
+        // virtuals from Accumulator
+        virtual size_t getApproximateSize() const;
+
     private:
         AccumulatorPush(const intrusive_ptr<ExpressionContext> &pTheCtx);
 
         mutable vector<intrusive_ptr<const Value> > vpValue;
+        mutable size_t valuesSize; /* approximate size of vpValue's values */
         intrusive_ptr<ExpressionContext> pCtx;
     };
 
@@ -29,7 +29,7 @@ namespace mongo {
         if (prhs->getType() == Undefined)
             ; /* nothing to add to the array */
         else if (!pCtx->getInRouter())
-            set.insert(prhs);
+            insert(prhs);
         else {
             /*
               If we're in the router, we need to take apart the arrays we
@@ -42,13 +42,25 @@ namespace mongo {
             intrusive_ptr<ValueIterator> pvi(prhs->getArray());
             while(pvi->more()) {
                 intrusive_ptr<const Value> pElement(pvi->next());
-                set.insert(pElement);
+                insert(pElement);
             }
         }
 
         return Value::getNull();
     }
 
+    void AccumulatorAddToSet::insert(
+        const intrusive_ptr<const Value> &pValue) const {
+        if (set.insert(pValue).second)
+            setSize += pValue->getApproximateSize();
+    }
+
+    size_t AccumulatorAddToSet::getApproximateSize() const {
+        /* each set entry is a node holding the pointer, plus a bucket */
+        return sizeof(*this) +
+            set.size() * 3 * sizeof(void *) + setSize;
+    }
+
     intrusive_ptr<const Value> AccumulatorAddToSet::getValue() const {
         vector<intrusive_ptr<const Value> > valVec;
 
@@ -63,6 +75,7 @@ namespace mongo {
         const intrusive_ptr<ExpressionContext> &pTheCtx):
         Accumulator(),
         set(),
+        setSize(0),
         pCtx(pTheCtx) {
     }
 
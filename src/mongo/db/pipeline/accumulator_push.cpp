@@ -28,8 +28,10 @@ namespace mongo {
 
         if (prhs->getType() == Undefined)
             ; /* nothing to add to the array */
-        else if (!pCtx->getInRouter())
+        else if (!pCtx->getInRouter()) {
             vpValue.push_back(prhs);
+            valuesSize += prhs->getApproximateSize();
+        }
         else {
             /*
               If we're in the router, we need to take apart the arrays we
@@ -43,6 +45,7 @@ namespace mongo {
             while(pvi->more()) {
                 intrusive_ptr<const Value> pElement(pvi->next());
                 vpValue.push_back(pElement);
+                valuesSize += pElement->getApproximateSize();
             }
         }
 
@@ -53,10 +56,17 @@ namespace mongo {
         return Value::createArray(vpValue);
     }
 
+    size_t AccumulatorPush::getApproximateSize() const {
+        return sizeof(*this) +
+            vpValue.capacity() * sizeof(intrusive_ptr<const Value>) +
+            valuesSize;
+    }
+
     AccumulatorPush::AccumulatorPush(
         const intrusive_ptr<ExpressionContext> &pTheCtx):
         Accumulator(),
         vpValue(),
+        valuesSize(0),
         pCtx(pTheCtx) {
     }
 
@@ -25,6 +25,13 @@ namespace mongo {
         return pValue;
     }
 
+    size_t AccumulatorSingleValue::getApproximateSize() const {
+        size_t size = sizeof(*this);
+        if (pValue.get())
+            size += pValue->getApproximateSize();
+        return size;
+    }
+
     AccumulatorSingleValue::AccumulatorSingleValue():
         pValue(intrusive_ptr<const Value>()) {
     }
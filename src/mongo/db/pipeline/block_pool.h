@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2012 10gen Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "pch.h"
+
+#include <boost/thread/tss.hpp>
+
+namespace mongo {
+
+    /*
+      A per thread free list of fixed size blocks.
+
+      Pipelines create and destroy Values and Documents by the million,
+      almost all of them the same few sizes; these classes' operator new
+      and delete use this to recycle blocks rather than go to malloc() for
+      each one.  Like their (non-atomic) reference counts, it assumes an
+      object is created and destroyed on the thread running its pipeline;
+      a block freed on another thread just moves to that thread's list.
+
+      Each thread keeps at most MaxFree blocks, and frees them on exit.
+     */
+    template <size_t BlockSize>
+    class BlockPool {
+    public:
+        static void *alloc();
+        static void free(void *p);
+
+    private:
+        enum { MaxFree = 64 * 1024 };
+
+        struct FreeList :
+            boost::noncopyable {
+            FreeList(): pHead(NULL), n(0) {}
+            ~FreeList();
+
+            struct Block { Block *pNext; };
+            Block *pHead;
+            size_t n;
+        };
+
+        /* a function rather than a static member, so it is there for
+           Values created during static initialization */
+        static boost::thread_specific_ptr<FreeList> &freeList();
+    };
+}
+
+
+/* ======================= INLINED IMPLEMENTATIONS ========================== */
+
+namespace mongo {
+
+    template <size_t BlockSize>
+    inline boost::thread_specific_ptr<typename BlockPool<BlockSize>::FreeList> &
+        BlockPool<BlockSize>::freeList() {
+        static boost::thread_specific_ptr<FreeList> tl;
+        return tl;
+    }
+
+    template <size_t BlockSize>
+    inline void *BlockPool<BlockSize>::alloc() {
+        FreeList *pList = freeList().get();
+        if (pList && pList->pHead) {
+            typename FreeList::Block *pBlock = pList->pHead;
+            pList->pHead = pBlock->pNext;
+            --pList->n;
+            return pBlock;
+        }
+        return ::operator new(BlockSize);
+    }
+
+    template <size_t BlockSize>
+    inline void BlockPool<BlockSize>::free(void *p) {
+        FreeList *pList = freeList().get();
+        if (!pList) {
+            pList = new FreeList();
+            freeList().reset(pList);
+        }
+        if (pList->n >= MaxFree) {
+            ::operator delete(p);
+            return;
+        }
+        typename FreeList::Block *pBlock =
+            static_cast<typename FreeList::Block *>(p);
+        pBlock->pNext = pList->pHead;
+        pList->pHead = pBlock;
+        ++pList->n;
+    }
+
+    template <size_t BlockSize>
+    BlockPool<BlockSize>::FreeList::~FreeList() {
+        while(pHead) {
+            Block *pBlock = pHead;
+            pHead = pBlock->pNext;
+            ::operator delete(pBlock);
+        }
+    }
+
+}
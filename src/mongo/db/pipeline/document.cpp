@@ -16,7 +16,9 @@
 
 #include "pch.h"
 #include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 #include "db/jsobj.h"
+#include "db/pipeline/block_pool.h"
 #include "db/pipeline/dependency_tracker.h"
 #include "db/pipeline/document.h"
 #include "db/pipeline/value.h"
@@ -27,6 +29,83 @@ namespace mongo {
 
     string Document::idName("_id");
 
+    namespace {
+        /*
+          Field names of Documents made from BSON.  Almost every document
+          in a pipeline has the same few names, so we keep one copy of each
+          and the Documents' names are copies of that, which share its
+          storage rather than allocating their own.
+
+          Per thread, like Documents, so there's no locking.  Bounded, as
+          field names may be data (e.g., {<userid>: ...}); past MaxNames we
+          just make a new string.
+         */
+        class FieldNames :
+            boost::noncopyable {
+        public:
+            ~FieldNames() {
+                for(Map::iterator i = names.begin(); i != names.end(); ++i)
+                    delete i->second;
+            }
+
+            const string &get(const StringData &name) {
+                Map::const_iterator i = names.find(name);
+                if (i != names.end())
+                    return *i->second;
+
+                if (names.size() >= MaxNames) {
+                    overflow = name.data();
+                    return overflow;
+                }
+
+                string *pName = new string(name.data(), name.size());
+                names[StringData(pName->c_str(), pName->size())] = pName;
+                return *pName;
+            }
+
+            static FieldNames &forThread() {
+                FieldNames *p = tl.get();
+                if (!p) {
+                    p = new FieldNames();
+                    tl.reset(p);
+                }
+                return *p;
+            }
+
+        private:
+            enum { MaxNames = 4096 };
+
+            struct Hash {
+                size_t operator()(const StringData &s) const {
+                    return boost::hash_range(s.data(), s.data() + s.size());
+                }
+            };
+            struct Equal {
+                bool operator()(const StringData &l, const StringData &r) const {
+                    return l.size() == r.size() &&
+                        memcmp(l.data(), r.data(), l.size()) == 0;
+                }
+            };
+            typedef boost::unordered_map<StringData, string *, Hash, Equal> Map;
+
+            Map names; // keys point into the values
+            string overflow;
+
+            static boost::thread_specific_ptr<FieldNames> tl;
+        };
+
+        boost::thread_specific_ptr<FieldNames> FieldNames::tl;
+    }
+
+    void *Document::operator new(size_t size) {
+        verify(size == sizeof(Document));
+        return BlockPool<sizeof(Document)>::alloc();
+    }
+
+    void Document::operator delete(void *p, size_t size) {
+        BlockPool<sizeof(Document)>::free(p);
+    }
+
     intrusive_ptr<Document> Document::createFromBsonObj(
         BSONObj *pBsonObj, const DependencyTracker *pDependencies) {
         intrusive_ptr<Document> pDocument(
@@ -36,27 +115,26 @@ namespace mongo {
 
     Document::Document(BSONObj *pBsonObj,
                        const DependencyTracker *pDependencies):
-        vFieldName(),
-        vpValue() {
+        vFields() {
+        FieldNames &fieldNames = FieldNames::forThread();
+        vFields.reserve(pBsonObj->nFields());
+
         BSONObjIterator bsonIterator(pBsonObj->begin());
         while(bsonIterator.more()) {
             BSONElement bsonElement(bsonIterator.next());
-            string fieldName(bsonElement.fieldName());
 
             // LATER check pDependencies
             // LATER grovel through structures???
-            intrusive_ptr<const Value> pValue(
-                Value::createFromBsonElement(&bsonElement));
-
-            vFieldName.push_back(fieldName);
-            vpValue.push_back(pValue);
+            vFields.push_back(FieldPair(
+                fieldNames.get(bsonElement.fieldName()),
+                Value::createFromBsonElement(&bsonElement)));
         }
     }
 
     void Document::toBson(BSONObjBuilder *pBuilder) {
-        const size_t n = vFieldName.size();
+        const size_t n = vFields.size();
         for(size_t i = 0; i < n; ++i)
-            vpValue[i]->addToBsonObj(pBuilder, vFieldName[i]);
+            vFields[i].second->addToBsonObj(pBuilder, vFields[i].first);
     }
 
     intrusive_ptr<Document> Document::create(size_t sizeHint) {
@@ -65,19 +143,16 @@ namespace mongo {
     }
 
     Document::Document(size_t sizeHint):
-        vFieldName(),
-        vpValue() {
-        if (sizeHint) {
-            vFieldName.reserve(sizeHint);
-            vpValue.reserve(sizeHint);
-        }
+        vFields() {
+        if (sizeHint)
+            vFields.reserve(sizeHint);
     }
 
     intrusive_ptr<Document> Document::clone() {
-        const size_t n = vFieldName.size();
+        const size_t n = vFields.size();
         intrusive_ptr<Document> pNew(Document::create(n));
         for(size_t i = 0; i < n; ++i)
-            pNew->addField(vFieldName[i], vpValue[i]);
+            pNew->addField(vFields[i].first, vFields[i].second);
 
         return pNew;
     }
@@ -100,10 +175,10 @@ namespace mongo {
           in a particular place as we would with a statically compilable
           reference.
         */
-        const size_t n = vFieldName.size();
+        const size_t n = vFields.size();
         for(size_t i = 0; i < n; ++i) {
-            if (fieldName.compare(vFieldName[i]) == 0)
-                return vpValue[i];
+            if (fieldName.compare(vFields[i].first) == 0)
+                return vFields[i].second;
         }
 
         return(intrusive_ptr<const Value>());
@@ -114,8 +189,7 @@ namespace mongo {
         uassert(15945, str::stream() << "cannot add undefined field " <<
                 fieldName << " to document", pValue->getType() != Undefined);
 
-        vFieldName.push_back(fieldName);
-        vpValue.push_back(pValue);
+        vFields.push_back(FieldPair(fieldName, pValue));
     }
 
     void Document::setField(size_t index,
@@ -123,8 +197,7 @@ namespace mongo {
                             const intrusive_ptr<const Value> &pValue) {
         /* special case:  should this field be removed? */
         if (!pValue.get()) {
-            vFieldName.erase(vFieldName.begin() + index);
-            vpValue.erase(vpValue.begin() + index);
+            vFields.erase(vFields.begin() + index);
             return;
         }
 
@@ -133,15 +206,15 @@ namespace mongo {
                 fieldName << " to document", pValue->getType() != Undefined);
 
         /* set the indicated field */
-        vFieldName[index] = fieldName;
-        vpValue[index] = pValue;
+        vFields[index].first = fieldName;
+        vFields[index].second = pValue;
     }
 
     intrusive_ptr<const Value> Document::getField(const string &fieldName) const {
-        const size_t n = vFieldName.size();
+        const size_t n = vFields.size();
         for(size_t i = 0; i < n; ++i) {
-            if (fieldName.compare(vFieldName[i]) == 0)
-                return vpValue[i];
+            if (fieldName.compare(vFields[i].first) == 0)
+                return vFields[i].second;
         }
 
         /* if we got here, there's no such field */
@@ -150,18 +223,18 @@ namespace mongo {
 
     size_t Document::getApproximateSize() const {
         size_t size = sizeof(Document);
-        const size_t n = vpValue.size();
+        const size_t n = vFields.size();
         for(size_t i = 0; i < n; ++i)
-            size += vpValue[i]->getApproximateSize();
+            size += vFields[i].second->getApproximateSize();
 
         return size;
     }
 
     size_t Document::getFieldIndex(const string &fieldName) const {
-        const size_t n = vFieldName.size();
+        const size_t n = vFields.size();
         size_t i = 0;
         for(; i < n; ++i) {
-            if (fieldName.compare(vFieldName[i]) == 0)
+            if (fieldName.compare(vFields[i].first) == 0)
                 break;
         }
 
@@ -169,17 +242,17 @@ namespace mongo {
     }
 
     void Document::hash_combine(size_t &seed) const {
-        const size_t n = vFieldName.size();
+        const size_t n = vFields.size();
         for(size_t i = 0; i < n; ++i) {
-            boost::hash_combine(seed, vFieldName[i]);
-            vpValue[i]->hash_combine(seed);
+            boost::hash_combine(seed, vFields[i].first);
+            vFields[i].second->hash_combine(seed);
         }
     }
 
     int Document::compare(const intrusive_ptr<Document> &rL,
                           const intrusive_ptr<Document> &rR) {
-        const size_t lSize = rL->vFieldName.size();
-        const size_t rSize = rR->vFieldName.size();
+        const size_t lSize = rL->vFields.size();
+        const size_t rSize = rR->vFields.size();
 
         for(size_t i = 0; true; ++i) {
             if (i >= lSize) {
@@ -192,11 +265,13 @@ namespace mongo {
             if (i >= rSize)
                 return 1; // right document is shorter
 
-            const int nameCmp = rL->vFieldName[i].compare(rR->vFieldName[i]);
+            const int nameCmp =
+                rL->vFields[i].first.compare(rR->vFields[i].first);
             if (nameCmp)
                 return nameCmp; // field names are unequal
 
-            const int valueCmp = Value::compare(rL->vpValue[i], rR->vpValue[i]);
+            const int valueCmp = Value::compare(rL->vFields[i].second,
+                                                rR->vFields[i].second);
             if (valueCmp)
                 return valueCmp; // fields are unequal
         }
@@ -214,14 +289,11 @@ namespace mongo {
     }
 
     bool FieldIterator::more() const {
-        return (index < pDocument->vFieldName.size());
+        return (index < pDocument->vFields.size());
     }
 
     pair<string, intrusive_ptr<const Value> > FieldIterator::next() {
         verify(more());
-        pair<string, intrusive_ptr<const Value> > result(
-            pDocument->vFieldName[index], pDocument->vpValue[index]);
-        ++index;
-        return result;
+        return pDocument->vFields[index++];
     }
 }
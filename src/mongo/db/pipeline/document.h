@@ -186,15 +186,25 @@ namespace mongo {
         */
         void hash_combine(size_t &seed) const;
 
+        /*
+          Documents are allocated from a per thread BlockPool (see
+          block_pool.h) rather than with malloc() one at a time.
+        */
+        static void *operator new(size_t size);
+        static void operator delete(void *p, size_t size);
+
     private:
         friend class FieldIterator;
 
         Document(size_t sizeHint);
         Document(BSONObj *pBsonObj, const DependencyTracker *pDependencies);
 
-        /* these two vectors parallel each other */
-        vector<string> vFieldName;
-        vector<intrusive_ptr<const Value> > vpValue;
+        /*
+          Names and values together, so a Document's fields are one
+          allocation.  Names from BSON are interned (see document.cpp), so
+          copies of the same name share storage.
+        */
+        vector<FieldPair> vFields;
     };
 
 
@@ -241,12 +251,12 @@ namespace mongo {
 namespace mongo {
 
     inline size_t Document::getFieldCount() const {
-        return vFieldName.size();
+        return vFields.size();
     }
     
     inline Document::FieldPair Document::getField(size_t index) const {
-        verify( index < vFieldName.size() );
-        return FieldPair(vFieldName[index], vpValue[index]);
+        verify( index < vFields.size() );
+        return vFields[index];
     }
 
 }
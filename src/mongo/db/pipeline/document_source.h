@@ -23,6 +23,7 @@
 #include "client/parallel.h"
 #include "db/clientcursor.h"
 #include "db/jsobj.h"
+#include "db/pipeline/document_spill.h"
 #include "db/pipeline/dependency_tracker.h"
 #include "db/pipeline/document.h"
 #include "db/pipeline/expression.h"
@@ -619,10 +620,30 @@ namespace mongo {
 
 
         intrusive_ptr<Document> makeDocument(
-            const GroupsType::iterator &rIter);
+            const intrusive_ptr<const Value> &pId,
+            const vector<intrusive_ptr<Accumulator> > &accumulators);
 
         GroupsType::iterator groupsIterator;
         intrusive_ptr<Document> pCurrent;
+
+        /*
+          If populate() goes over the ExpressionContext's memory budget, it
+          spills the partial results of the groups it has so far to disk,
+          in _id order, as a shard would send them to the router, and starts
+          again with no groups.  If there are runs, the results come from
+          merging them, combining each _id's partial results the same way
+          createMerger()'s group would.
+         */
+        void spill();
+        intrusive_ptr<Document> mergeGroup();
+        static bool idLessThan(const GroupsType::iterator &rL,
+                               const GroupsType::iterator &rR);
+        static int compareIds(const intrusive_ptr<Document> &pL,
+                              const intrusive_ptr<Document> &pR);
+
+        scoped_ptr<DocumentSpill> pSpill;
+        scoped_ptr<DocumentSpill::Merger> pMerger;
+        vector<intrusive_ptr<Expression> > vpMergeExpression;
     };
 
 
@@ -928,6 +949,16 @@ namespace mongo {
         bool populated;
         long long count;
 
+        /*
+          If populate() goes over the ExpressionContext's memory budget, it
+          sorts what it has so far and spills that to disk as a run.  If
+          there are runs, the results come from merging them rather than
+          from documents.
+         */
+        void spill();
+        scoped_ptr<DocumentSpill> pSpill;
+        scoped_ptr<DocumentSpill::Merger> pMerger;
+
         /* these two parallel each other */
         typedef vector<intrusive_ptr<ExpressionFieldPath> > SortPaths;
         SortPaths vSortKey;
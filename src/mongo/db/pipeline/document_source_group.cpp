@@ -39,6 +39,9 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (pMerger.get())
+            return !pCurrent.get();
+
         return (groupsIterator == groups.end());
     }
 
@@ -48,6 +51,16 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (pMerger.get()) {
+            verify(pCurrent.get());
+            if (pMerger->eof()) {
+                pCurrent.reset();
+                return false;
+            }
+            pCurrent = mergeGroup();
+            return true;
+        }
+
         verify(groupsIterator != groups.end());
 
         ++groupsIterator;
@@ -56,7 +69,8 @@ namespace mongo {
             return false;
         }
 
-        pCurrent = makeDocument(groupsIterator);
+        pCurrent = makeDocument(groupsIterator->first,
+                                groupsIterator->second);
         return true;
     }
 
@@ -99,7 +113,10 @@ namespace mongo {
         groups(),
         vFieldName(),
         vpAccumulatorFactory(),
-        vpExpression() {
+        vpExpression(),
+        pSpill(),
+        pMerger(),
+        vpMergeExpression() {
     }
 
     void DocumentSourceGroup::addAccumulator(
@@ -291,6 +308,14 @@ namespace mongo {
     }
 
     void DocumentSourceGroup::populate() {
+        /*
+          If we have somewhere to put them, spill the groups when they go
+          over the memory budget.
+         */
+        const bool canSpill = !pExpCtx->getTempDir().empty();
+        const size_t maxMemory = pExpCtx->getMaxMemoryBytes();
+        size_t memoryUsed = 0;
+
         for(bool hasNext = !pSource->eof(); hasNext;
                 hasNext = pSource->advance()) {
             intrusive_ptr<Document> pDocument(pSource->getCurrent());
@@ -331,7 +356,13 @@ namespace mongo {
                         (*vpAccumulatorFactory[i])(pExpCtx));
                     pAccumulator->addOperand(vpExpression[i]);
                     pGroup->push_back(pAccumulator);
+
+                    if (canSpill)
+                        memoryUsed += pAccumulator->getApproximateSize();
                 }
+
+                if (canSpill)
+                    memoryUsed += pId->getApproximateSize();
             }
 
             /* point at the existing key */
@@ -339,29 +370,64 @@ namespace mongo {
 
             /* tickle all the accumulators for the group we found */
             const size_t n = pGroup->size();
-            for(size_t i = 0; i < n; ++i)
-                (*pGroup)[i]->evaluate(pDocument);
+            if (!canSpill) {
+                for(size_t i = 0; i < n; ++i)
+                    (*pGroup)[i]->evaluate(pDocument);
+                continue;
+            }
+
+            for(size_t i = 0; i < n; ++i) {
+                Accumulator *pAccumulator = (*pGroup)[i].get();
+                memoryUsed -= pAccumulator->getApproximateSize();
+                pAccumulator->evaluate(pDocument);
+                memoryUsed += pAccumulator->getApproximateSize();
+            }
+
+            if (memoryUsed > maxMemory) {
+                spill();
+                memoryUsed = 0;
+            }
+        }
+
+        if (pSpill.get()) {
+            /* spill the rest too, and merge all the runs */
+            if (!groups.empty())
+                spill();
+
+            const size_t n = vFieldName.size();
+            for(size_t i = 0; i < n; ++i) {
+                vpMergeExpression.push_back(
+                    ExpressionFieldPath::create(vFieldName[i]));
+            }
+
+            pMerger.reset(new DocumentSpill::Merger(*pSpill, compareIds));
+            groupsIterator = groups.end();
+            if (!pMerger->eof())
+                pCurrent = mergeGroup();
+            populated = true;
+            return;
         }
 
         /* start the group iterator */
         groupsIterator = groups.begin();
         if (groupsIterator != groups.end())
-            pCurrent = makeDocument(groupsIterator);
+            pCurrent = makeDocument(groupsIterator->first,
+                                    groupsIterator->second);
         populated = true;
     }
 
     intrusive_ptr<Document> DocumentSourceGroup::makeDocument(
-        const GroupsType::iterator &rIter) {
-        vector<intrusive_ptr<Accumulator> > *pGroup = &rIter->second;
+        const intrusive_ptr<const Value> &pId,
+        const vector<intrusive_ptr<Accumulator> > &accumulators) {
         const size_t n = vFieldName.size();
         intrusive_ptr<Document> pResult(Document::create(1 + n));
 
         /* add the _id field */
-        pResult->addField(Document::idName, rIter->first);
+        pResult->addField(Document::idName, pId);
 
         /* add the rest of the fields */
         for(size_t i = 0; i < n; ++i) {
-            intrusive_ptr<const Value> pValue((*pGroup)[i]->getValue());
+            intrusive_ptr<const Value> pValue(accumulators[i]->getValue());
             if (pValue->getType() != Undefined)
                 pResult->addField(vFieldName[i], pValue);
         }
@@ -369,6 +435,104 @@ namespace mongo {
         return pResult;
     }
 
+    /*
+      Sets an ExpressionContext's shard and router flags for the life of
+      the setter, so that accumulators produce (inShard) or consume
+      (inRouter) partial results.  Other sources in the pipeline share the
+      context, so this must not outlast a call into the group.
+     */
+    class GroupSpillFlagSetter :
+        boost::noncopyable {
+    public:
+        GroupSpillFlagSetter(ExpressionContext *pTheCtx,
+                             bool inShard, bool inRouter):
+            pCtx(pTheCtx),
+            wasInShard(pCtx->getInShard()),
+            wasInRouter(pCtx->getInRouter()) {
+            pCtx->setInShard(inShard);
+            pCtx->setInRouter(inRouter);
+        }
+
+        ~GroupSpillFlagSetter() {
+            pCtx->setInShard(wasInShard);
+            pCtx->setInRouter(wasInRouter);
+        }
+
+    private:
+        ExpressionContext *pCtx;
+        bool wasInShard;
+        bool wasInRouter;
+    };
+
+    bool DocumentSourceGroup::idLessThan(const GroupsType::iterator &rL,
+                                         const GroupsType::iterator &rR) {
+        return Value::compare(rL->first, rR->first) < 0;
+    }
+
+    int DocumentSourceGroup::compareIds(const intrusive_ptr<Document> &pL,
+                                        const intrusive_ptr<Document> &pR) {
+        return Value::compare(pL->getValue(Document::idName),
+                              pR->getValue(Document::idName));
+    }
+
+    void DocumentSourceGroup::spill() {
+        /* runs are merged by _id, so they have to be written in that order */
+        vector<GroupsType::iterator> sorted;
+        sorted.reserve(groups.size());
+        for(GroupsType::iterator i(groups.begin()); i != groups.end(); ++i)
+            sorted.push_back(i);
+        sort(sorted.begin(), sorted.end(), idLessThan);
+
+        if (!pSpill.get())
+            pSpill.reset(new DocumentSpill(pExpCtx->getTempDir(), "group"));
+
+        GroupSpillFlagSetter partial(
+            pExpCtx.get(), true, pExpCtx->getInRouter());
+
+        pSpill->startRun();
+        const size_t n = sorted.size();
+        for(size_t i = 0; i < n; ++i)
+            pSpill->add(makeDocument(sorted[i]->first, sorted[i]->second));
+        pSpill->endRun();
+
+        groups.clear();
+    }
+
+    intrusive_ptr<Document> DocumentSourceGroup::mergeGroup() {
+        /*
+          The partial results for an _id come off the merge together, in
+          the order they were spilled, so $first, $last and $push see them
+          in the same order as the original documents.
+         */
+        intrusive_ptr<const Value> pId(
+            pMerger->peek()->getValue(Document::idName));
+
+        const size_t n = vFieldName.size();
+        vector<intrusive_ptr<Accumulator> > accumulators;
+        accumulators.reserve(n);
+        for(size_t i = 0; i < n; ++i) {
+            intrusive_ptr<Accumulator> pAccumulator(
+                (*vpAccumulatorFactory[i])(pExpCtx));
+            pAccumulator->addOperand(vpMergeExpression[i]);
+            accumulators.push_back(pAccumulator);
+        }
+
+        {
+            GroupSpillFlagSetter merging(
+                pExpCtx.get(), pExpCtx->getInShard(), true);
+
+            do {
+                intrusive_ptr<Document> pPartial(pMerger->next());
+                for(size_t i = 0; i < n; ++i)
+                    accumulators[i]->evaluate(pPartial);
+            } while(!pMerger->eof() &&
+                    (Value::compare(pMerger->peek()->getValue(
+                        Document::idName), pId) == 0));
+        }
+
+        return makeDocument(pId, accumulators);
+    }
+
     intrusive_ptr<DocumentSource> DocumentSourceGroup::createMerger() {
         intrusive_ptr<DocumentSourceGroup> pMerger(
             DocumentSourceGroup::create(pExpCtx));
@@ -41,6 +41,9 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (pMerger.get())
+            return !pCurrent.get();
+
         return (listIterator == documents.end());
     }
 
@@ -50,6 +53,16 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (pMerger.get()) {
+            verify(pCurrent.get());
+            if (pMerger->eof()) {
+                pCurrent.reset();
+                return false;
+            }
+            pCurrent = pMerger->next();
+            return true;
+        }
+
         verify(listIterator != documents.end());
 
         ++listIterator;
@@ -86,7 +99,9 @@ namespace mongo {
     DocumentSourceSort::DocumentSourceSort(
         const intrusive_ptr<ExpressionContext> &pExpCtx):
         DocumentSource(pExpCtx),
-        populated(false) {
+        populated(false),
+        pSpill(),
+        pMerger() {
     }
 
     void DocumentSourceSort::addKey(const string &fieldPath, bool ascending) {
@@ -151,8 +166,17 @@ namespace mongo {
         /* make sure we've got a sort key */
         verify(vSortKey.size());
 
-        /* track and warn about how much physical memory has been used */
-        DocMemMonitor dmm(this);
+        /*
+          If we have somewhere to put them, spill sorted runs when we go
+          over the memory budget.  If not, track and warn about how much
+          physical memory has been used.
+         */
+        const bool canSpill = !pExpCtx->getTempDir().empty();
+        const size_t maxMemory = pExpCtx->getMaxMemoryBytes();
+        size_t memoryUsed = 0;
+        scoped_ptr<DocMemMonitor> pDmm;
+        if (!canSpill)
+            pDmm.reset(new DocMemMonitor(this));
 
         /* pull everything from the underlying source */
         for(bool hasNext = !pSource->eof(); hasNext;
@@ -160,7 +184,26 @@ namespace mongo {
             intrusive_ptr<Document> pDocument(pSource->getCurrent());
             documents.push_back(Carrier(this, pDocument));
 
-            dmm.addToTotal(pDocument->getApproximateSize());
+            const size_t size = pDocument->getApproximateSize();
+            if (!canSpill)
+                pDmm->addToTotal(size);
+            else if ((memoryUsed += size) > maxMemory) {
+                spill();
+                memoryUsed = 0;
+            }
+        }
+
+        if (pSpill.get()) {
+            /* spill the rest too, and merge all the runs */
+            if (!documents.empty())
+                spill();
+            pMerger.reset(new DocumentSpill::Merger(
+                *pSpill, boost::bind(&DocumentSourceSort::compare,
+                                     this, _1, _2)));
+            if (!pMerger->eof())
+                pCurrent = pMerger->next();
+            populated = true;
+            return;
         }
 
         /* sort the list */
@@ -174,6 +217,22 @@ namespace mongo {
         populated = true;
     }
 
+    void DocumentSourceSort::spill() {
+        /* list::sort() is stable, and so is the merge of the runs */
+        documents.sort(Carrier::lessThan);
+
+        if (!pSpill.get())
+            pSpill.reset(new DocumentSpill(pExpCtx->getTempDir(), "sort"));
+
+        pSpill->startRun();
+        for(ListType::const_iterator i(documents.begin());
+            i != documents.end(); ++i)
+            pSpill->add(i->pDocument);
+        pSpill->endRun();
+
+        documents.clear();
+    }
+
     int DocumentSourceSort::compare(
         const intrusive_ptr<Document> &pL, const intrusive_ptr<Document> &pR) {
 
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2012 10gen Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+
+#include "db/pipeline/document_spill.h"
+
+#include <boost/filesystem/convenience.hpp>
+#include <boost/filesystem/operations.hpp>
+#include "db/jsobj.h"
+#include "db/pipeline/value.h"
+#include "util/mongoutils/str.h"
+
+namespace mongo {
+    using namespace mongoutils;
+
+    DocumentSpill::DocumentSpill(const string &tempDir, const char *pName):
+        nRuns(0),
+        writing(false),
+        bytesWritten(0) {
+        verify(!tempDir.empty());
+
+        stringstream ss;
+        ss << tempDir;
+        if (tempDir[tempDir.size() - 1] != '/')
+            ss << '/';
+        ss << pName << '.' << time(0) << '.' << rand() << '/';
+        dir = ss.str();
+    }
+
+    DocumentSpill::~DocumentSpill() {
+        if (writing)
+            out.close();
+
+        if (nRuns) {
+            try {
+                boost::filesystem::remove_all(dir);
+            }
+            catch(std::exception &e) {
+                warning() << "couldn't remove aggregation temp files in " <<
+                    dir << ": " << e.what() << endl;
+            }
+        }
+    }
+
+    string DocumentSpill::runFileName(size_t run) const {
+        stringstream ss;
+        ss << dir << "run." << run;
+        return ss.str();
+    }
+
+    void DocumentSpill::startRun() {
+        if (writing)
+            endRun();
+
+        if (!nRuns) {
+            boost::filesystem::create_directories(dir);
+            log(1) << "aggregation spilling to " << dir << endl;
+        }
+
+        string fileName(runFileName(nRuns));
+        out.open(fileName.c_str(), ios_base::out | ios_base::binary);
+        assertStreamGood(16384, "couldn't open aggregation temp file " +
+                         fileName, out);
+        ++nRuns;
+        writing = true;
+    }
+
+    void DocumentSpill::add(const intrusive_ptr<Document> &pDocument) {
+        verify(writing);
+
+        BSONObjBuilder builder;
+        pDocument->toBson(&builder);
+        BSONObj obj(builder.done());
+        out.write(obj.objdata(), obj.objsize());
+        bytesWritten += obj.objsize();
+    }
+
+    void DocumentSpill::endRun() {
+        verify(writing);
+        writing = false;
+
+        out.close();
+        uassert(16385, str::stream() <<
+                "error writing aggregation temp file " <<
+                runFileName(nRuns - 1), !out.fail());
+
+        log(2) << "aggregation spilled run " << nRuns - 1 << ", " <<
+            bytesWritten << " bytes so far" << endl;
+    }
+
+    DocumentSpill::Reader *DocumentSpill::openRun(size_t run) const {
+        verify(run < nRuns);
+        verify(!writing || (run < nRuns - 1));
+        return new Reader(runFileName(run));
+    }
+
+    DocumentSpill::Reader::Reader(const string &theFileName):
+        in(),
+        fileName(theFileName),
+        buf(),
+        pNext() {
+        in.open(fileName.c_str(), ios_base::in | ios_base::binary);
+        assertStreamGood(16386, "couldn't open aggregation temp file " +
+                         fileName, in);
+        readNext();
+    }
+
+    intrusive_ptr<Document> DocumentSpill::Reader::next() {
+        verify(pNext.get());
+        intrusive_ptr<Document> pDocument(pNext);
+        readNext();
+        return pDocument;
+    }
+
+    void DocumentSpill::Reader::readNext() {
+        pNext.reset();
+
+        int size;
+        in.read((char *)&size, sizeof(size));
+        if (in.eof() && !in.gcount())
+            return;
+
+        uassert(16387, str::stream() << "corrupt aggregation temp file " <<
+                fileName, in.good() && (size >= 5) &&
+                (size <= BSONObjMaxInternalSize));
+
+        buf.resize(size);
+        memcpy(&buf[0], &size, sizeof(size));
+        in.read(&buf[sizeof(size)], size - sizeof(size));
+        uassert(16388, str::stream() << "corrupt aggregation temp file " <<
+                fileName, in.good());
+
+        /* the Document copies everything out of the BSON */
+        BSONObj obj(&buf[0]);
+        pNext = Document::createFromBsonObj(&obj);
+    }
+
+    DocumentSpill::Merger::Merger(const DocumentSpill &spill,
+                                  const Compare &theCompare):
+        compare(theCompare),
+        vpReader(),
+        vpHead(),
+        heap() {
+        const size_t n = spill.getRunCount();
+        vpReader.reserve(n);
+        vpHead.resize(n);
+        heap.reserve(n);
+        for(size_t i = 0; i < n; ++i) {
+            vpReader.push_back(spill.openRun(i));
+            if (!vpReader[i]->eof()) {
+                vpHead[i] = vpReader[i]->next();
+                heap.push_back(i);
+            }
+        }
+        make_heap(heap.begin(), heap.end(), HeadCmp(this));
+    }
+
+    DocumentSpill::Merger::~Merger() {
+        for(size_t i = 0; i < vpReader.size(); ++i)
+            delete vpReader[i];
+    }
+
+    intrusive_ptr<Document> DocumentSpill::Merger::next() {
+        verify(!heap.empty());
+
+        pop_heap(heap.begin(), heap.end(), HeadCmp(this));
+        const size_t run = heap.back();
+        intrusive_ptr<Document> pDocument(vpHead[run]);
+
+        if (!vpReader[run]->eof()) {
+            vpHead[run] = vpReader[run]->next();
+            push_heap(heap.begin(), heap.end(), HeadCmp(this));
+        }
+        else {
+            vpHead[run].reset();
+            heap.pop_back();
+        }
+
+        return pDocument;
+    }
+
+}
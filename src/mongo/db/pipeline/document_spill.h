@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2012 10gen Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU Affero General Public License, version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "pch.h"
+
+#include <fstream>
+#include <boost/function.hpp>
+#include "db/pipeline/document.h"
+
+namespace mongo {
+
+    /*
+      Temporary files of Documents, for DocumentSources that have to spill
+      to disk.
+
+      Like BSONObjExternalSorter, Documents are written out in runs, one
+      file per run, each a sequence of BSON objects; a Reader then streams
+      a run back in the order it was written.  The files are in a
+      directory of their own under the given temp directory, which is
+      created on the first run and removed with the DocumentSpill.
+     */
+    class DocumentSpill :
+        boost::noncopyable {
+    public:
+        /*
+          @param tempDir where to put the spill directory
+          @param pName names the spill directory, to say what it's for
+         */
+        DocumentSpill(const string &tempDir, const char *pName);
+        ~DocumentSpill();
+
+        /*
+          Start writing a new run.
+
+          Any run already being written is finished first.
+         */
+        void startRun();
+
+        /*
+          Add a Document to the end of the current run.
+
+          @param pDocument the Document to write
+         */
+        void add(const intrusive_ptr<Document> &pDocument);
+
+        /*
+          Finish writing the current run.
+         */
+        void endRun();
+
+        /*
+          @returns the number of runs started so far
+         */
+        size_t getRunCount() const;
+
+        class Reader :
+            boost::noncopyable {
+        public:
+            /*
+              @returns true if there are no more Documents in the run
+             */
+            bool eof() const;
+
+            /*
+              @returns the next Document of the run
+             */
+            intrusive_ptr<Document> next();
+
+        private:
+            friend class DocumentSpill;
+            Reader(const string &fileName);
+
+            void readNext();
+
+            ifstream in;
+            string fileName;
+            vector<char> buf;
+            intrusive_ptr<Document> pNext;
+        };
+
+        /*
+          Read back a finished run.
+
+          @param run which run, from 0 to getRunCount() - 1
+          @returns a Reader for the run; the caller owns it
+         */
+        Reader *openRun(size_t run) const;
+
+        /*
+          Returns the Documents of all of the runs in order, if each run was
+          written in that order: a k way merge, with the run with the
+          smallest next Document on top of a heap.  Ties go to the earlier
+          run, so if the runs are successive pieces of the input, the merge
+          is as stable as the sort of each run was.
+         */
+        class Merger :
+            boost::noncopyable {
+        public:
+            /* like Value::compare(), <0, 0, or >0 */
+            typedef boost::function<int(const intrusive_ptr<Document> &,
+                                        const intrusive_ptr<Document> &)>
+                Compare;
+
+            /*
+              @param spill the runs to merge; all must be finished
+              @param compare orders the Documents
+             */
+            Merger(const DocumentSpill &spill, const Compare &compare);
+            ~Merger();
+
+            bool eof() const;
+
+            /*
+              @returns the next Document, without moving past it
+             */
+            const intrusive_ptr<Document> &peek() const;
+
+            /*
+              @returns the next Document
+             */
+            intrusive_ptr<Document> next();
+
+        private:
+            class HeadCmp {
+            public:
+                HeadCmp(const Merger *pMerger);
+                bool operator()(size_t l, size_t r) const;
+            private:
+                const Merger *pMerger;
+            };
+
+            Compare compare;
+            vector<Reader *> vpReader;
+            vector<intrusive_ptr<Document> > vpHead; /* next of each run */
+            vector<size_t> heap; /* of runs that have a head */
+        };
+
+    private:
+        string runFileName(size_t run) const;
+
+        string dir;
+        size_t nRuns;
+        ofstream out;
+        bool writing;
+        long long bytesWritten;
+    };
+
+}
+
+
+/* ======================= INLINED IMPLEMENTATIONS ========================== */
+
+namespace mongo {
+
+    inline size_t DocumentSpill::getRunCount() const {
+        return nRuns;
+    }
+
+    inline bool DocumentSpill::Reader::eof() const {
+        return !pNext.get();
+    }
+
+    inline bool DocumentSpill::Merger::eof() const {
+        return heap.empty();
+    }
+
+    inline const intrusive_ptr<Document> &DocumentSpill::Merger::peek() const {
+        verify(!heap.empty());
+        return vpHead[heap.front()];
+    }
+
+    inline DocumentSpill::Merger::HeadCmp::HeadCmp(const Merger *pM):
+        pMerger(pM) {
+    }
+
+    inline bool DocumentSpill::Merger::HeadCmp::operator()(
+        size_t l, size_t r) const {
+        /* std::*_heap() keep the greatest on top, so this is "greater" */
+        int cmp = pMerger->compare(pMerger->vpHead[l], pMerger->vpHead[r]);
+        if (cmp)
+            return cmp > 0;
+        return l > r;
+    }
+
+}
@@ -27,6 +27,8 @@ namespace mongo {
     inline ExpressionContext::ExpressionContext(InterruptStatus *pS):
         inShard(false),
         inRouter(false),
+        maxMemoryBytes(DefaultMaxMemoryBytes),
+        tempDir(),
         intCheckCounter(1),
         pStatus(pS) {
     }
@@ -42,6 +42,22 @@ namespace mongo {
          */
         void checkForInterrupt();
 
+        /**
+           Spilling to disk.
+
+           $sort and $group hold up to about this many bytes of documents
+           in memory; past that, they write what they have to temporary
+           files under the temp directory, and merge those at the end.
+           With no temp directory (as in mongos) they don't spill, and a
+           DocMemMonitor limits their memory instead.
+         */
+        void setMaxMemoryBytes(size_t bytes);
+        size_t getMaxMemoryBytes() const;
+        void setTempDir(const string &dir);
+        const string &getTempDir() const;
+
+        enum { DefaultMaxMemoryBytes = 100 * 1024 * 1024 };
+
         static ExpressionContext *create(InterruptStatus *pStatus);
 
     private:
@@ -49,6 +65,8 @@ namespace mongo {
         
         bool inShard;
         bool inRouter;
+        size_t maxMemoryBytes;
+        string tempDir;
         unsigned intCheckCounter; // interrupt check counter
         InterruptStatus *const pStatus;
     };
@@ -75,4 +93,20 @@ namespace mongo {
         return inRouter;
     }
 
+    inline void ExpressionContext::setMaxMemoryBytes(size_t bytes) {
+        maxMemoryBytes = bytes;
+    }
+
+    inline size_t ExpressionContext::getMaxMemoryBytes() const {
+        return maxMemoryBytes;
+    }
+
+    inline void ExpressionContext::setTempDir(const string &dir) {
+        tempDir = dir;
+    }
+
+    inline const string &ExpressionContext::getTempDir() const {
+        return tempDir;
+    }
+
 };
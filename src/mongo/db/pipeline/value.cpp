@@ -19,6 +19,7 @@
 
 #include <boost/functional/hash.hpp>
 #include "db/jsobj.h"
+#include "db/pipeline/block_pool.h"
 #include "db/pipeline/builder.h"
 #include "db/pipeline/document.h"
 #include "util/mongoutils/str.h"
@@ -38,6 +39,35 @@ namespace mongo {
     Value::~Value() {
     }
 
+    void *Value::operator new(size_t size) {
+        /* a subclass may be bigger */
+        if (size != sizeof(Value))
+            return ::operator new(size);
+        return BlockPool<sizeof(Value)>::alloc();
+    }
+
+    void Value::operator delete(void *p, size_t size) {
+        if (size != sizeof(Value)) {
+            ::operator delete(p);
+            return;
+        }
+        BlockPool<sizeof(Value)>::free(p);
+    }
+
+    static const intrusive_ptr<const Value> *makeSmallInts(int min, int max) {
+        intrusive_ptr<const Value> *p =
+            new intrusive_ptr<const Value>[max - min + 1];
+        for(int i = min; i <= max; ++i)
+            p[i - min] = new ValueStatic(i);
+        return p;
+    }
+
+    const intrusive_ptr<const Value> *Value::getSmallInts() {
+        static const intrusive_ptr<const Value> *pSmallInts =
+            makeSmallInts(SmallIntMin, SmallIntMax);
+        return pSmallInts;
+    }
+
     Value::Value():
         type(jstNULL),
         oidValue(),
@@ -98,6 +128,18 @@ namespace mongo {
 
     intrusive_ptr<const Value> Value::createFromBsonElement(
         BSONElement *pBsonElement) {
+        /* share the static Values for the common scalars */
+        switch(pBsonElement->type()) {
+        case jstNULL:
+            return getNull();
+        case Bool:
+            return pBsonElement->boolean() ? getTrue() : getFalse();
+        case NumberInt:
+            return createInt(pBsonElement->numberInt());
+        default:
+            break;
+        }
+
         intrusive_ptr<const Value> pValue(new Value(pBsonElement));
         return pValue;
     }
@@ -191,6 +233,9 @@ namespace mongo {
     }
 
     intrusive_ptr<const Value> Value::createInt(int value) {
+        if (value >= SmallIntMin && value <= SmallIntMax)
+            return getSmallInts()[value - SmallIntMin];
+
         intrusive_ptr<const Value> pValue(new Value(value));
         return pValue;
     }
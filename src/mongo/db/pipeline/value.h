@@ -293,6 +293,13 @@ namespace mongo {
             size_t operator()(const intrusive_ptr<const Value> &rV) const;
         };
 
+        /*
+          Values are allocated from a per thread BlockPool (see block_pool.h)
+          rather than with malloc() one at a time.
+        */
+        static void *operator new(size_t size);
+        static void operator delete(void *p, size_t size);
+
     protected:
         Value(); // creates null value
         Value(BSONType type); // creates an empty (unitialized value) of type
@@ -344,6 +351,14 @@ namespace mongo {
         static const intrusive_ptr<const Value> pFieldZero;
         static const intrusive_ptr<const Value> pFieldOne;
 
+        /*
+          createInt() and BSON conversion share these for ints in
+          [SmallIntMin, SmallIntMax] -- counts, flags, small enums -- rather
+          than allocating a Value for each.
+        */
+        enum { SmallIntMin = -16, SmallIntMax = 1023 };
+        static const intrusive_ptr<const Value> *getSmallInts();
+
         /* this implementation is used for getArray() */
         class vi :
             public ValueIterator {
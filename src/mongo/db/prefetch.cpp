@@ -0,0 +1,128 @@
+// prefetch.cpp
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+
+#include "mongo/db/prefetch.h"
+
+#include "mongo/db/client.h"
+#include "mongo/db/cmdline.h"
+#include "mongo/db/dbhelpers.h"
+#include "mongo/db/index.h"
+#include "mongo/db/namespace_details.h"
+#include "mongo/db/pdfile.h"
+
+namespace mongo {
+
+    ReplApplyStats replApplyStats;
+
+    static ReplIndexPrefetch indexPrefetch = ReplIndexPrefetchAll;
+
+    bool setReplIndexPrefetch( const string& mode ) {
+        if ( mode == "none" )
+            indexPrefetch = ReplIndexPrefetchNone;
+        else if ( mode == "_id_only" )
+            indexPrefetch = ReplIndexPrefetchIdOnly;
+        else if ( mode == "all" )
+            indexPrefetch = ReplIndexPrefetchAll;
+        else
+            return false;
+        cmdLine.replIndexPrefetch = mode;
+        return true;
+    }
+
+    /** walk idx to where obj's keys are or would go, reading in the buckets on the way */
+    static void prefetchKeys( IndexDetails& idx , const BSONObj& obj ) {
+        BSONObjSet keys;
+        idx.getKeysFromObject( obj , keys );
+        if ( keys.empty() )
+            return;
+        const Ordering ordering = Ordering::make( idx.keyPattern() );
+        for ( BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i ) {
+            int pos;
+            bool found;
+            idx.idxInterface().locate( idx , idx.head , *i , ordering , pos , found , minDiskLoc );
+        }
+    }
+
+    void prefetchIndexPages( NamespaceDetails* nsd , const BSONObj& obj ) {
+        switch ( indexPrefetch ) {
+        case ReplIndexPrefetchNone:
+            return;
+        case ReplIndexPrefetchIdOnly: {
+            int idxNo = nsd->findIdIndex();
+            if ( idxNo >= 0 )
+                prefetchKeys( nsd->idx( idxNo ) , obj );
+            return;
+        }
+        case ReplIndexPrefetchAll: {
+            NamespaceDetails::IndexIterator ii = nsd->ii();
+            while ( ii.more() )
+                prefetchKeys( ii.next() , obj );
+            return;
+        }
+        }
+    }
+
+    void prefetchPagesForReplicatedOp( const BSONObj& op ) {
+        const char *opType = op.getStringField( "op" );
+        if ( *opType != 'i' && *opType != 'u' && *opType != 'd' )
+            return;
+        const char *ns = op.getStringField( "ns" );
+        // index builds and the like are applied alone and aren't worth it
+        if ( *ns == 0 || *ns == '.' || str::contains( ns , ".system." ) )
+            return;
+
+        try {
+            Client::ReadContext ctx( ns );
+            NamespaceDetails *nsd = nsdetails( ns );
+            if ( nsd == 0 )
+                return;
+
+            if ( *opType == 'i' ) {
+                // where the new document's keys will go
+                prefetchIndexPages( nsd , op.getObjectField( "o" ) );
+                return;
+            }
+
+            // an update or delete finds its document by _id, then unindexes the document's keys
+            BSONElement id = op.getObjectField( *opType == 'u' ? "o2" : "o" )["_id"];
+            if ( id.eoo() || nsd->findIdIndex() < 0 )
+                return;
+            DiskLoc loc = Helpers::findById( nsd , id.wrap() );
+            if ( loc.isNull() )
+                return;
+            Record *r = loc.rec();
+            r->touch();
+            if ( indexPrefetch == ReplIndexPrefetchAll )
+                prefetchIndexPages( nsd , BSONObj( r->data() ) );
+        }
+        catch ( DBException& e ) {
+            LOG(2) << "ignoring exception prefetching for " << op.toString() << ": " << e.toString() << endl;
+        }
+    }
+
+    void ReplApplyStats::append( BSONObjBuilder& b ) const {
+        b.append( "batches" , (long long) batches );
+        b.append( "ops" , (long long) ops );
+        b.append( "prefetchMicros" , (long long) prefetchMicros );
+        b.append( "applyMicros" , (long long) applyMicros );
+        b.append( "indexPrefetch" , cmdLine.replIndexPrefetch );
+    }
+
+} // namespace mongo
@@ -0,0 +1,66 @@
+// prefetch.h
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/db/jsobj.h"
+#include "mongo/platform/atomic_uint64.h"
+
+namespace mongo {
+
+    class NamespaceDetails;
+
+    /** how much of a collection's indexes a secondary reads in before applying an op to it */
+    enum ReplIndexPrefetch {
+        ReplIndexPrefetchNone,
+        ReplIndexPrefetchIdOnly,
+        ReplIndexPrefetchAll
+    };
+
+    /**
+     * set the mode from its name: "none", "_id_only" or "all" (--replIndexPrefetch).  also sets
+     * cmdLine.replIndexPrefetch.
+     * @return false if mode isn't one of those
+     */
+    bool setReplIndexPrefetch( const string& mode );
+
+    /**
+     * read in the pages applying op will need, so the writer that applies it doesn't fault with
+     * the write lock held.  an update or delete finds its document through the _id index and
+     * reads it in whatever the mode; the index keys an op will add or remove are then walked to
+     * as the mode says.  takes a read lock on op's database, so must be called with nothing
+     * locked.  errors are ignored: the op will meet them again when it's applied.
+     */
+    void prefetchPagesForReplicatedOp( const BSONObj& op );
+
+    /** with nsd's database locked, walk to obj's keys in the indexes the mode says */
+    void prefetchIndexPages( NamespaceDetails* nsd , const BSONObj& obj );
+
+    /** serverStatus.repl.apply: where a secondary's time applying batches of ops goes */
+    struct ReplApplyStats {
+        AtomicUInt64 batches;
+        AtomicUInt64 ops;
+        /** reading in pages for the ops in the batch, before locking anything */
+        AtomicUInt64 prefetchMicros;
+        /** applying the batch and writing it to our oplog */
+        AtomicUInt64 applyMicros;
+        void append( BSONObjBuilder& b ) const;
+    };
+    extern ReplApplyStats replApplyStats;
+
+} // namespace mongo
@@ -934,6 +934,10 @@ doneCheckOrder:
             if ( _plans._mayRecordPlan && op.mayRecordPlan() ) {
                 op.qp().registerSelf( op.nscanned(), _plans.characterizeCandidatePlans() );
             }
+            else if ( _plans._usingCachedPlan ) {
+                QueryUtilIndexed::noteRunForPatterns( *_plans._frsp, _plans._order, op.nscanned(),
+                                                     _timer.micros() );
+            }
             _done = true;
             return holder._op;
         }
@@ -1500,6 +1504,28 @@ doneCheckOrder:
         }
         return CachedQueryPlan();
     }
+
+    void QueryUtilIndexed::noteRunForPatterns( const FieldRangeSetPair &frsp, const BSONObj &order,
+                                              long long nScanned, long long micros ) {
+        SimpleMutex::scoped_lock lk(NamespaceDetailsTransient::_qcMutex);
+        QueryPlanCache &cache = NamespaceDetailsTransient::get_inlock( frsp.ns() ).queryPlanCache();
+        // the plan came from the first of these with an entry, as in bestIndexForPatterns()
+        if ( !cache.noteRun( frsp._singleKey.pattern( order ), nScanned, micros ) ) {
+            cache.noteRun( frsp._multiKey.pattern( order ), nScanned, micros );
+        }
+    }
+
+    int QueryUtilIndexed::pinIndexesForPatterns( const FieldRangeSetPair &frsp, const BSONObj &order,
+                                                 bool pinned ) {
+        SimpleMutex::scoped_lock lk(NamespaceDetailsTransient::_qcMutex);
+        QueryPlanCache &cache = NamespaceDetailsTransient::get_inlock( frsp.ns() ).queryPlanCache();
+        int n = 0;
+        if ( cache.pin( frsp._singleKey.pattern( order ), pinned ) )
+            ++n;
+        if ( cache.pin( frsp._multiKey.pattern( order ), pinned ) )
+            ++n;
+        return n;
+    }
     
     bool QueryUtilIndexed::uselessOr( const OrRangeGenerator &org, NamespaceDetails *d, int hintIdx ) {
         for( list<FieldRangeSetPair>::const_iterator i = org._originalOrSets.begin(); i != org._originalOrSets.end(); ++i ) {
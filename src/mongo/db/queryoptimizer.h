@@ -445,6 +445,8 @@ namespace mongo {
             our_priority_queue<OpHolder> _queue;
             shared_ptr<ExplainClauseInfo> _explainClauseInfo;
             bool _done;
+            /** how long a recorded plan took to complete, for the query plan cache statistics */
+            Timer _timer;
         };
 
     private:
@@ -688,6 +690,14 @@ namespace mongo {
         static void clearIndexesForPatterns( const FieldRangeSetPair &frsp, const BSONObj &order );
         /** Return a recorded best index for the single or multi key pattern. */
         static CachedQueryPlan bestIndexForPatterns( const FieldRangeSetPair &frsp, const BSONObj &order );        
+        /**
+         * Note a completed run of the recorded plan bestIndexForPatterns() returned, for the
+         * pattern's statistics.
+         */
+        static void noteRunForPatterns( const FieldRangeSetPair &frsp, const BSONObj &order,
+                                       long long nScanned, long long micros );
+        /** Pin or unpin the plans recorded for the single and multi key patterns. @return # found */
+        static int pinIndexesForPatterns( const FieldRangeSetPair &frsp, const BSONObj &order, bool pinned );
         static bool uselessOr( const OrRangeGenerator& org, NamespaceDetails *d, int hintIdx );
     };
     
@@ -0,0 +1,207 @@
+// queryplancache.cpp
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+
+#include "mongo/db/queryplancache.h"
+
+namespace mongo {
+
+    static Histogram *newLatencyHistogram() {
+        // 100us, 200us, ... 1.6s and up
+        Histogram::Options opts;
+        opts.numBuckets = 16;
+        opts.bucketSize = 100;
+        opts.exponential = true;
+        return new Histogram( opts );
+    }
+
+    QueryPlanCache::Entry::Entry() :
+        pinned(),
+        writesAtConfirm(),
+        hits(),
+        runs(),
+        lastNScanned(),
+        maxNScanned(),
+        avgNScanned(),
+        micros( newLatencyHistogram() ) {
+    }
+
+    QueryPlanCache::QueryPlanCache() :
+        _writes(),
+        _hits(),
+        _misses(),
+        _evictedLRU(),
+        _evictedDrift(),
+        _evictedWrites() {
+    }
+
+    bool QueryPlanCache::stale( const Entry &e ) const {
+        return !e.pinned && _writes - e.writesAtConfirm >= WriteLimit;
+    }
+
+    void QueryPlanCache::evict( EntryMap::iterator i, long long &counter ) {
+        _lru.erase( i->second.lru );
+        _entries.erase( i );
+        ++counter;
+    }
+
+    CachedQueryPlan QueryPlanCache::get( const QueryPattern &pattern ) {
+        EntryMap::iterator i = _entries.find( pattern );
+        if ( i == _entries.end() ) {
+            ++_misses;
+            return CachedQueryPlan();
+        }
+        if ( stale( i->second ) ) {
+            evict( i, _evictedWrites );
+            ++_misses;
+            return CachedQueryPlan();
+        }
+        Entry &e = i->second;
+        _lru.splice( _lru.begin(), _lru, e.lru );
+        ++e.hits;
+        ++_hits;
+        return e.plan;
+    }
+
+    void QueryPlanCache::set( const QueryPattern &pattern, const CachedQueryPlan &plan ) {
+        EntryMap::iterator i = _entries.find( pattern );
+        if ( plan.indexKey().isEmpty() ) {
+            if ( i != _entries.end() ) {
+                _lru.erase( i->second.lru );
+                _entries.erase( i );
+            }
+            return;
+        }
+
+        if ( i == _entries.end() ) {
+            while( (int) _entries.size() >= MaxEntries ) {
+                // the least recently used entry that isn't pinned
+                list<QueryPattern>::iterator j = _lru.end();
+                while( j != _lru.begin() ) {
+                    --j;
+                    if ( !_entries.find( *j )->second.pinned )
+                        break;
+                }
+                EntryMap::iterator victim = _entries.find( *j );
+                if ( victim->second.pinned ) {
+                    // everything is pinned, so don't cache this one
+                    return;
+                }
+                evict( victim, _evictedLRU );
+            }
+            _lru.push_front( pattern );
+            i = _entries.insert( make_pair( pattern, Entry() ) ).first;
+            i->second.lru = _lru.begin();
+        }
+        else {
+            // a new winner for the pattern starts its statistics over
+            Entry fresh;
+            fresh.pinned = i->second.pinned;
+            fresh.lru = i->second.lru;
+            i->second = fresh;
+            _lru.splice( _lru.begin(), _lru, i->second.lru );
+        }
+        i->second.plan = plan;
+        i->second.writesAtConfirm = _writes;
+    }
+
+    bool QueryPlanCache::noteRun( const QueryPattern &pattern, long long nScanned, long long micros ) {
+        EntryMap::iterator i = _entries.find( pattern );
+        if ( i == _entries.end() )
+            return false;
+        Entry &e = i->second;
+        e.micros->insert( micros > 0xffffffffLL ? 0xffffffffU : (uint32_t) micros );
+        e.lastNScanned = nScanned;
+        e.maxNScanned = max( e.maxNScanned, nScanned );
+        e.avgNScanned = e.runs ? ( e.avgNScanned * 3 + nScanned ) / 4 : nScanned;
+        ++e.runs;
+
+        long long won = max( e.plan.nScanned(), (long long) DriftMinNScanned );
+        if ( e.avgNScanned > won * DriftFactor ) {
+            if ( e.runs >= 3 && !e.pinned ) {
+                evict( i, _evictedDrift );
+            }
+            return true;
+        }
+        e.writesAtConfirm = _writes;
+        return true;
+    }
+
+    bool QueryPlanCache::pin( const QueryPattern &pattern, bool pinned ) {
+        EntryMap::iterator i = _entries.find( pattern );
+        if ( i == _entries.end() )
+            return false;
+        i->second.pinned = pinned;
+        i->second.writesAtConfirm = _writes;
+        return true;
+    }
+
+    void QueryPlanCache::clear() {
+        _entries.clear();
+        _lru.clear();
+    }
+
+    void QueryPlanCache::appendStats( BSONObjBuilder &b ) const {
+        BSONArrayBuilder plans( b.subarrayStart( "plans" ) );
+        for( list<QueryPattern>::const_iterator j = _lru.begin(); j != _lru.end(); ++j ) {
+            const Entry &e = _entries.find( *j )->second;
+            BSONObjBuilder p( plans.subobjStart() );
+            p.append( "pattern", j->toString() );
+            p.append( "index", e.plan.indexKey() );
+            p.append( "nscanned", e.plan.nScanned() );
+            p.append( "pinned", e.pinned );
+            p.append( "stale", stale( e ) );
+            p.append( "hits", e.hits );
+            p.append( "runs", e.runs );
+            p.append( "lastNScanned", e.lastNScanned );
+            p.append( "avgNScanned", e.avgNScanned );
+            p.append( "maxNScanned", e.maxNScanned );
+            {
+                BSONObjBuilder h( p.subobjStart( "micros" ) );
+                for( uint32_t k = 0; k < e.micros->getBucketsNum(); ++k ) {
+                    uint64_t n = e.micros->getCount( k );
+                    if ( n == 0 )
+                        continue;
+                    if ( k == e.micros->getBucketsNum() - 1 )
+                        h.append( "over", (long long) n );
+                    else
+                        h.append( BSONObjBuilder::numStr( e.micros->getBoundary( k ) ), (long long) n );
+                }
+                h.done();
+            }
+            p.done();
+        }
+        plans.done();
+
+        BSONObjBuilder c( b.subobjStart( "stats" ) );
+        c.append( "entries", size() );
+        c.append( "hits", _hits );
+        c.append( "misses", _misses );
+        c.append( "writes", _writes );
+        {
+            BSONObjBuilder ev( c.subobjStart( "evicted" ) );
+            ev.append( "lru", _evictedLRU );
+            ev.append( "drift", _evictedDrift );
+            ev.append( "writes", _evictedWrites );
+            ev.done();
+        }
+        c.done();
+    }
+
+} // namespace mongo
@@ -0,0 +1,103 @@
+// queryplancache.h
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/querypattern.h"
+#include "mongo/util/histogram.h"
+
+namespace mongo {
+
+    /**
+     * The query plans recorded for a namespace, by QueryPattern, with statistics on how each has
+     * done since it was recorded.
+     *
+     * An entry is evicted
+     *  - least recently used first, beyond MaxEntries
+     *  - when the nscanned of runs of its plan drifts well above the nscanned it won with
+     *  - when WriteLimit writes to the namespace have happened since a run last confirmed it
+     * Pinned entries are exempt from these, but are still removed by clear() and by recording an
+     * empty plan for their pattern, which is how a plan that failed a query is discarded.
+     *
+     * Like the rest of the query cache, used with NamespaceDetailsTransient::_qcMutex held or
+     * with the namespace write locked.
+     */
+    class QueryPlanCache : boost::noncopyable {
+    public:
+        enum { MaxEntries = 200, WriteLimit = 100, DriftFactor = 4, DriftMinNScanned = 100 };
+
+        QueryPlanCache();
+
+        /** @return the plan recorded for pattern, or an empty CachedQueryPlan.  counts a hit or miss. */
+        CachedQueryPlan get( const QueryPattern &pattern );
+
+        /** record plan for pattern.  an empty plan removes the entry, pinned or not. */
+        void set( const QueryPattern &pattern, const CachedQueryPlan &plan );
+
+        /**
+         * note a completed run of pattern's recorded plan, which scanned nScanned in micros.
+         * @return false if there is no entry for pattern
+         */
+        bool noteRun( const QueryPattern &pattern, long long nScanned, long long micros );
+
+        /** a write to the namespace.  entries not confirmed by a run in a while age out. */
+        void noteWrite() { ++_writes; }
+
+        /** @return false if there is no entry for pattern */
+        bool pin( const QueryPattern &pattern, bool pinned );
+
+        void clear();
+        bool empty() const { return _entries.empty(); }
+        int size() const { return _entries.size(); }
+
+        /** each entry, most recently used first, and the cache counters */
+        void appendStats( BSONObjBuilder &b ) const;
+
+    private:
+        struct Entry {
+            Entry();
+            CachedQueryPlan plan;
+            list<QueryPattern>::iterator lru;
+            bool pinned;
+            long long writesAtConfirm;
+            long long hits;
+            long long runs;
+            long long lastNScanned;
+            long long maxNScanned;
+            /** moving average of the runs' nscanned */
+            double avgNScanned;
+            shared_ptr<Histogram> micros;
+        };
+        typedef map<QueryPattern,Entry> EntryMap;
+
+        void evict( EntryMap::iterator i, long long &counter );
+        bool stale( const Entry &e ) const;
+
+        EntryMap _entries;
+        /** most recently used at the front */
+        list<QueryPattern> _lru;
+        long long _writes;
+        long long _hits;
+        long long _misses;
+        long long _evictedLRU;
+        long long _evictedDrift;
+        long long _evictedWrites;
+    };
+
+} // namespace mongo
@@ -9,6 +9,18 @@
 namespace mongo {
 
     namespace ps {
+
+        /** log2 of the os page size: the pages tracked here are the ones the os reports on */
+        static unsigned pageShift() {
+            static unsigned shift = 0;
+            if ( shift == 0 ) {
+                unsigned s = 0;
+                while ( ( 1UL << s ) < ProcessInfo::pageSize() )
+                    s++;
+                shift = s;
+            }
+            return shift;
+        }
         
         enum State {
             In , Out, Unk
@@ -178,9 +190,125 @@ namespace mongo {
 
             SimpleMutex _lock;
         } rolling;
+
+        /**
+         * page residency as the os reports it (mincore() and the like), for 64 pages with one call.
+         * a region's answer is kept for MaxAgeMillis so a scan asks once per region rather than 
+         * once per record; pages we read in ourselves are marked in as we go.
+         */
+        class Residency {
+        public:
+            enum { PagesPerRegion = 64, NumEntries = 16384, MaxAgeMillis = 250 };
+
+            Residency() : _lock( "ps::Residency" ) {
+                memset( _entries , 0 , sizeof(_entries) );
+            }
+
+            /** @return In if all of [start,end) is in memory, Out if not, Unk if the os won't say */
+            State get( const char *start , const char *end ) {
+                size_t first = (size_t) start >> pageShift();
+                size_t last = ( (size_t) end - 1 ) >> pageShift();
+                if ( last < first )
+                    last = first;
+                if ( last - first >= PagesPerRegion ) // a big record: its first region will do
+                    last = first + PagesPerRegion - 1;
+                for ( size_t region = first / PagesPerRegion; region <= last / PagesPerRegion; region++ ) {
+                    unsigned long long bits;
+                    if ( ! _bits( region , &bits ) )
+                        return _uncached( first , last );
+                    size_t base = region * PagesPerRegion;
+                    size_t lo = max( first , base ) - base;
+                    size_t hi = min( last , base + PagesPerRegion - 1 ) - base;
+                    for ( size_t i = lo; i <= hi; i++ ) {
+                        if ( ! ( bits & ( 1ULL << i ) ) )
+                            return Out;
+                    }
+                }
+                return In;
+            }
+
+            /** the page start is on was just read in */
+            void in( const void *start ) {
+                size_t page = (size_t) start >> pageShift();
+                size_t region = page / PagesPerRegion;
+                Entry &e = _entries[ hash( region ) % NumEntries ];
+                SimpleMutex::scoped_lock lk( _lock );
+                if ( e.region == region )
+                    e.bits |= 1ULL << ( page % PagesPerRegion );
+            }
+
+        private:
+            struct Entry {
+                size_t region;
+                unsigned long long bits;
+                long long checked;
+            };
+
+            bool _bits( size_t region , unsigned long long *bits ) {
+                Entry &e = _entries[ hash( region ) % NumEntries ];
+                long long now = Listener::getElapsedTimeMillis();
+                {
+                    SimpleMutex::scoped_lock lk( _lock );
+                    if ( e.region == region && now - e.checked < MaxAgeMillis ) {
+                        *bits = e.bits;
+                        return true;
+                    }
+                }
+                // the system call is made without the lock
+                char out[PagesPerRegion];
+                if ( ! ProcessInfo::pagesInMemory( (const void*) ( ( region * PagesPerRegion ) << pageShift() ) , PagesPerRegion , out ) )
+                    return false;
+                unsigned long long b = 0;
+                for ( int i = 0; i < PagesPerRegion; i++ ) {
+                    if ( out[i] )
+                        b |= 1ULL << i;
+                }
+                SimpleMutex::scoped_lock lk( _lock );
+                e.region = region;
+                e.bits = b;
+                e.checked = now;
+                *bits = b;
+                return true;
+            }
+
+            /** for a region that isn't all mapped, as where a data file's view starts or ends */
+            State _uncached( size_t first , size_t last ) {
+                char out[PagesPerRegion];
+                if ( ! ProcessInfo::pagesInMemory( (const void*) ( first << pageShift() ) , last - first + 1 , out ) )
+                    return Unk;
+                for ( size_t i = 0; i <= last - first; i++ ) {
+                    if ( ! out[i] )
+                        return Out;
+                }
+                return In;
+            }
+
+            SimpleMutex _lock;
+            Entry _entries[NumEntries];
+        } residency;
         
     }
 
+    RecordStats recordStats;
+
+    void RecordStats::append( BSONObjBuilder& b ) const {
+        b.append( "accessesNotInMemory" , (long long) accessesNotInMemory );
+        b.append( "pageFaultExceptionsThrown" , (long long) pageFaultExceptionsThrown );
+        {
+            BSONObjBuilder f( b.subobjStart( "faults" ) );
+            f.append( "accurate" , (long long) faultsAccurate );
+            f.append( "mispredicted" , (long long) faultsMispredicted );
+            f.done();
+        }
+        {
+            BSONObjBuilder s( b.subobjStart( "inMemorySampled" ) );
+            s.append( "checks" , (long long) inMemorySampled );
+            s.append( "mispredicted" , (long long) inMemoryMispredicted );
+            s.done();
+        }
+        b.append( "prefetchedBytes" , (long long) prefetchedBytes );
+    }
+
     bool Record::MemoryTrackingEnabled = true;
     
     volatile int __record_touch_dummy = 1; // this is used to make sure the compiler doesn't get too smart on us
@@ -206,13 +334,38 @@ namespace mongo {
 
     const bool blockSupported = ProcessInfo::blockCheckSupported();
 
+    /** every this many residency checks that say in memory, one is redone without the cache */
+    static const unsigned SampleEvery = 1024;
+
     bool Record::likelyInPhysicalMemory() const {
         DEV if ( rand() % 100 == 0 ) return false;
 
         if ( ! MemoryTrackingEnabled )
             return true;
 
-        const size_t page = (size_t)_data >> 12;
+        if ( blockSupported ) {
+            // the header first, as reading the length from it would fault if it isn't in
+            const char *start = (const char *) this;
+            ps::State s = ps::residency.get( start , _data );
+            if ( s == ps::In )
+                s = ps::residency.get( _data , start + _lengthWithHeaders );
+            if ( s != ps::Unk ) {
+                if ( s == ps::Out ) {
+                    recordStats.accessesNotInMemory += 1;
+                    return false;
+                }
+                static unsigned n = 0;
+                if ( ++n % SampleEvery == 0 ) {
+                    char in = 1;
+                    recordStats.inMemorySampled += 1;
+                    if ( ProcessInfo::pagesInMemory( start , 1 , &in ) && ! in )
+                        recordStats.inMemoryMispredicted += 1;
+                }
+                return true;
+            }
+        }
+
+        const size_t page = (size_t)_data >> ps::pageShift();
         const size_t region = page >> 6;
         const size_t offset = page & 0x3f;
         
@@ -237,12 +390,45 @@ namespace mongo {
 
 
     Record* Record::accessed() {
-        const size_t page = (size_t)_data >> 12;
+        const size_t page = (size_t)_data >> ps::pageShift();
         const size_t region = page >> 6;
         const size_t offset = page & 0x3f;        
         ps::rolling.access( region , offset , true );
+        ps::residency.in( _data );
         return this;
     }
+
+    const char* Record::prefetchLimit() const {
+        const char *p = (const char *) this;
+        Database *db = cc().database();
+        if ( db == 0 || ! Database::_openAllFiles )
+            return p;
+        for ( int i = 0; i < db->numFiles(); i++ ) {
+            const char *end = db->getFile( i )->viewEnd( p );
+            if ( end )
+                return end - p > PrefetchBytes ? p + PrefetchBytes : end;
+        }
+        return p;
+    }
+
+    void Record::prefetch( const char *limit ) const {
+        if ( blockSupported ) {
+            char in = 0;
+            if ( ProcessInfo::pagesInMemory( this , 1 , &in ) ) {
+                if ( in )
+                    recordStats.faultsMispredicted += 1;
+                else
+                    recordStats.faultsAccurate += 1;
+            }
+        }
+        touch();
+        ps::residency.in( this );
+        const char *p = (const char *) this;
+        if ( limit > p ) {
+            ProcessInfo::willNeed( p , limit - p );
+            recordStats.prefetchedBytes += limit - p;
+        }
+    }
     
     Record* DiskLoc::rec() const {
         Record *r = DataFileMgr::getRecord(*this);
@@ -21,7 +21,9 @@
 #include "../../util/concurrency/list.h"
 #include "../../util/concurrency/value.h"
 #include "../../util/concurrency/msg.h"
+#include "../../util/concurrency/thread_pool.h"
 #include "../../util/net/hostandport.h"
+#include "../cloner.h"
 #include "../commands.h"
 #include "../oplog.h"
 #include "../oplogreader.h"
@@ -90,6 +92,31 @@ namespace mongo {
             virtual ~SyncTail() {}
             SyncTail(const string& host) : Sync(host) {}
             virtual bool syncApply(const BSONObj &o);
+
+            /** apply a batch of ops using the threads of writers.  ops are partitioned by namespace 
+                and _id, so all the ops for one document are applied in oplog order by one writer.  
+                ops that can't run concurrently with others (see mustApplyAlone) are applied on 
+                this thread after everything before them in the batch has been applied.  readers 
+                are locked out (Lock::ParallelBatchWriterMode) for the duration.  
+                throws if any op fails.
+            */
+            void multiApply(const vector<BSONObj>& ops, ThreadPool& writers);
+
+            /** @return true if op must not be applied in parallel with any other op: commands, 
+                index builds, and ops we can't assign to a single document.
+            */
+            static bool mustApplyAlone(const BSONObj& op);
+
+            /** read in the pages applying ops will need (see prefetchPagesForReplicatedOp), 
+                using the threads of writers.  must be called with nothing locked.
+            */
+            void prefetchOps(const vector<BSONObj>& ops, ThreadPool& writers);
+
+        private:
+            struct WriterErrors;
+            static void prefetchRange(const vector<BSONObj> *ops, unsigned a, unsigned b);
+            void applyPartitions(vector< vector<BSONObj> >& partitions, ThreadPool& writers);
+            static void applyPartition(SyncTail *st, const vector<BSONObj> *ops, WriterErrors *errs);
         };
 
         /**
@@ -333,6 +360,33 @@ namespace mongo {
         set<HostAndPort> seedSet;
     };
 
+    /** replSetGetStatus.initialSync: how this member's last initial sync went, phase by phase */
+    class InitialSyncStats : boost::noncopyable {
+    public:
+        InitialSyncStats() : _m("InitialSyncStats"), _started(0), _phaseStarted(0) { }
+
+        /** a new initial sync is starting with phase; forgets the last one */
+        void start(const string& phase);
+
+        /** phase is now under way, the one before it done */
+        void phase(const string& phase);
+
+        void done() { phase(""); }
+
+        /** nothing if there hasn't been an initial sync */
+        void append(BSONObjBuilder& b) const;
+
+        CloneStats clone;
+
+    private:
+        mutable SimpleMutex _m;
+        Date_t _started;
+        /** the phases done and how many millis each took */
+        vector< pair<string,long long> > _phases;
+        string _current;
+        unsigned long long _phaseStarted;
+    };
+
     /* information about the entire repl set, such as the various servers in the set, and their state */
     /* note: We currently do not free mem when the set goes away - it is assumed the replset is a
              singleton and long lived.
@@ -520,6 +574,8 @@ namespace mongo {
 
     private:
         bool initialSyncOplogApplication(const OpTime& applyGTE, const OpTime& minValid);
+        InitialSyncStats _initialSyncStats;
+        bool _initialSyncClone(const string& host, const list<string>& dbs);
         void _syncDoInitialSync();
         void syncDoInitialSync();
         void _syncThread();
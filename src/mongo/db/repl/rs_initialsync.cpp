@@ -56,11 +56,86 @@ namespace mongo {
         }
     }
 
-    /* todo : progress metering to sethbmsg. */
-    static bool clone(const char *master, string db) {
-        string err;
-        return cloneFrom(master, err, db, false,
-                         /* slave_ok */ true, true, false, /*mayYield*/true, /*mayBeInterrupted*/false);
+    void InitialSyncStats::start(const string& phase) {
+        clone.reset();
+        SimpleMutex::scoped_lock lk(_m);
+        _started = jsTime();
+        _phases.clear();
+        _current = phase;
+        _phaseStarted = curTimeMillis64();
+    }
+
+    void InitialSyncStats::phase(const string& phase) {
+        SimpleMutex::scoped_lock lk(_m);
+        unsigned long long now = curTimeMillis64();
+        if( !_current.empty() )
+            _phases.push_back( make_pair(_current, (long long) (now - _phaseStarted)) );
+        _current = phase;
+        _phaseStarted = now;
+    }
+
+    void InitialSyncStats::append(BSONObjBuilder& b) const {
+        SimpleMutex::scoped_lock lk(_m);
+        if( _started.millis == 0 )
+            return;
+        BSONObjBuilder s( b.subobjStart("initialSync") );
+        s.appendDate("started", _started);
+        if( !_current.empty() )
+            s.append("phase", _current);
+
+        long long cloneMillis = 0;
+        {
+            BSONObjBuilder p( s.subobjStart("phaseMillis") );
+            vector< pair<string,long long> > phases = _phases;
+            if( !_current.empty() )
+                phases.push_back( make_pair(_current, (long long) (curTimeMillis64() - _phaseStarted)) );
+            for( vector< pair<string,long long> >::const_iterator i = phases.begin(); i != phases.end(); ++i ) {
+                p.append(i->first, i->second);
+                if( i->first == "clone" )
+                    cloneMillis = i->second;
+            }
+            p.done();
+        }
+        {
+            BSONObjBuilder c( s.subobjStart("clone") );
+            clone.append(c);
+            unsigned long long bytes = clone.bytes;
+            c.append("bytesPerSec", cloneMillis ? (long long) (bytes * 1000 / cloneMillis) : 0LL);
+            c.done();
+        }
+        s.done();
+    }
+
+    /** threads, with a connection each, copying the data for an initial sync */
+    static ThreadPool& initialSyncPool() {
+        static ThreadPool *p = new ThreadPool(cmdLine.initialSyncThreads);
+        return *p;
+    }
+
+    /** copy every database but local from host, then build their indexes. see ParallelCloner. */
+    bool ReplSetImpl::_initialSyncClone(const string& host, const list<string>& dbs) {
+        vector<string> toClone;
+        for( list<string>::const_iterator i = dbs.begin(); i != dbs.end(); i++ ) {
+            if( *i != "local" )
+                toClone.push_back(*i);
+        }
+
+        _initialSyncStats.phase("clone");
+        sethbmsg( str::stream() << "initial sync cloning " << toClone.size() << " databases", 0);
+        ParallelCloner cloner(host, initialSyncPool(), _initialSyncStats.clone);
+        string errmsg;
+        if( !cloner.cloneData(toClone, errmsg) ) {
+            sethbmsg( str::stream() << "initial sync error clone failed: " << errmsg << " sleeping 5 minutes", 0);
+            return false;
+        }
+
+        _initialSyncStats.phase("buildIndexes");
+        sethbmsg("initial sync building indexes", 0);
+        if( !cloner.buildIndexes(errmsg) ) {
+            sethbmsg( str::stream() << "initial sync error building indexes failed: " << errmsg << " sleeping 5 minutes", 0);
+            return false;
+        }
+        return true;
     }
 
     void _logOpObjRS(const BSONObj& op);
@@ -197,31 +272,22 @@ namespace mongo {
 
         if (replSettings.fastsync) {
             log() << "fastsync: skipping database clone" << rsLog;
+            _initialSyncStats.start("applyOplog");
         }
         else {
+            _initialSyncStats.start("dropDatabases");
             sethbmsg("initial sync drop all databases", 0);
             dropAllDatabasesExceptLocal();
 
             sethbmsg("initial sync clone all databases", 0);
 
             list<string> dbs = r.conn()->getDatabaseNames();
-            for( list<string>::iterator i = dbs.begin(); i != dbs.end(); i++ ) {
-                string db = *i;
-                if( db != "local" ) {
-                    sethbmsg( str::stream() << "initial sync cloning db: " << db , 0);
-                    bool ok;
-                    {
-                        Client::WriteContext ctx(db);
-                        ok = clone(sourceHostname.c_str(), db);
-                    }
-                    if( !ok ) {
-                        sethbmsg( str::stream() << "initial sync error clone of " << db << " failed sleeping 5 minutes" ,0);
-                        veto(source->fullName(), 600);
-                        sleepsecs(300);
-                        return;
-                    }
-                }
+            if( !_initialSyncClone(sourceHostname, dbs) ) {
+                veto(source->fullName(), 600);
+                sleepsecs(300);
+                return;
             }
+            _initialSyncStats.phase("applyOplog");
         }
 
         sethbmsg("initial sync query minValid",0);
@@ -277,6 +343,7 @@ namespace mongo {
             }
         }
 
+        _initialSyncStats.phase("finish");
         sethbmsg("initial sync finishing up",0);
 
         verify( !box.getState().primary() ); // wouldn't make sense if we were.
@@ -292,6 +359,7 @@ namespace mongo {
             cx.ctx().db()->flushFiles(true);
         }
 
+        _initialSyncStats.done();
         sethbmsg("initial sync done",0);
     }
 
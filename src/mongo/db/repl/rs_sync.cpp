@@ -19,12 +19,19 @@
 #include "rs.h"
 #include "mongo/db/repl.h"
 #include "connections.h"
+#include "mongo/db/cmdline.h"
+#include "mongo/db/dbhelpers.h"
+#include "mongo/db/prefetch.h"
+#include "third_party/murmurhash3/MurmurHash3.h"
 
 namespace mongo {
 
     using namespace bson;
     extern unsigned replSetForceInitialSyncFailure;
 
+    /** most ops gathered into one batch for a parallel apply on a secondary */
+    static const unsigned replBatchLimitOperations = 5000;
+
     void NOINLINE_DECL blank(const BSONObj& o) {
         if( *o.getStringField("op") != 'n' ) {
             log() << "replSet skipping bad op in oplog: " << o.toString() << rsLog;
@@ -46,6 +53,166 @@ namespace mongo {
         return !applyOperation_inlock(o);
     }
 
+    /** the lock to hold while applying op o.  a command may need a global write lock, so we 
+        conservatively go ahead and grab one for those.  suboptimal. :-( 
+    */
+    static Lock::ScopedLock* lockForOp(const BSONObj& o) {
+        const char *ns = o.getStringField("ns");
+        if( *ns == 0 || str::contains(ns, ".$cmd") ) {
+            // an empty ns is ugly.  this is often a no-op but can't be 100% sure
+            return new Lock::GlobalWrite();
+        }
+        return new Lock::DBWrite(ns);
+    }
+
+    /** the _id of the document op o modifies; EOO if there isn't one */
+    static BSONElement docIdOf(const BSONObj& o) {
+        const char *opType = o.getStringField("op");
+        return o.getObjectField( *opType == 'u' ? "o2" : "o" )["_id"];
+    }
+
+    bool replset::SyncTail::mustApplyAlone(const BSONObj& o) {
+        const char *opType = o.getStringField("op");
+        if( *opType == 'n' )
+            return false;
+        const char *ns = o.getStringField("ns");
+        if( *opType == 'c' || *ns == 0 || *ns == '.' || str::contains(ns, ".$cmd") )
+            return true;
+        // index builds are done by the sync thread itself (see Client::isSyncThread)
+        if( str::contains(ns, ".system.indexes") )
+            return true;
+        return docIdOf(o).eoo();
+    }
+
+    /** which writer applies op o.  equal _id values must hash the same even if their bson 
+        types differ (e.g. 1 and 1.0) so we hash numbers by value.
+    */
+    static unsigned partitionFor(const BSONObj& o, unsigned nPartitions) {
+        const char *ns = o.getStringField("ns");
+        uint32_t h;
+        MurmurHash3_x86_32(ns, strlen(ns), 0, &h);
+        BSONElement id = docIdOf(o);
+        if( id.isNumber() ) {
+            double d = id.number();
+            MurmurHash3_x86_32(&d, sizeof(d), h, &h);
+        }
+        else {
+            MurmurHash3_x86_32(id.value(), id.valuesize(), h, &h);
+        }
+        return h % nPartitions;
+    }
+
+    struct replset::SyncTail::WriterErrors {
+        WriterErrors() : m("replWriterErrors") { }
+        SimpleMutex m;
+        ExceptionInfo first;
+    };
+
+    void replset::SyncTail::applyPartition(SyncTail *st, const vector<BSONObj> *ops, WriterErrors *errs) {
+        Client::initThreadIfNotAlready("repl writer worker");
+        Lock::ParallelBatchWriterMode::iAmABatchParticipant();
+        replLocalAuth();
+
+        const BSONObj *o = 0;
+        try {
+            Timer timeInWriteLock;
+            scoped_ptr<Lock::ScopedLock> lk;
+            for( vector<BSONObj>::const_iterator i = ops->begin(); i != ops->end(); ++i ) {
+                o = &*i;
+                const char *ns = o->getStringField("ns");
+                // we don't relock on every single op to be faster; but we do let other writers 
+                // of the same db in now and then, and must relock if switching databases.
+                if( timeInWriteLock.micros() > 1000 || !Lock::isWriteLocked(ns) ) {
+                    lk.reset();
+                    verify( !Lock::isLocked() );
+                    lk.reset( lockForOp(*o) );
+                    timeInWriteLock.reset();
+                }
+                st->syncApply(*o);
+                getDur().commitIfNeeded();
+            }
+        }
+        catch( DBException& e ) {
+            SimpleMutex::scoped_lock lk(errs->m);
+            if( errs->first.empty() ) {
+                errs->first = ExceptionInfo( str::stream() << e.toString() << ", syncing: " << 
+                                             ( o ? o->toString() : string() ), e.getCode() );
+            }
+        }
+    }
+
+    void replset::SyncTail::applyPartitions(vector< vector<BSONObj> >& partitions, ThreadPool& writers) {
+        WriterErrors errs;
+        for( unsigned i = 0; i < partitions.size(); i++ ) {
+            if( !partitions[i].empty() )
+                writers.schedule(applyPartition, this, &partitions[i], &errs);
+        }
+        writers.join();
+        for( unsigned i = 0; i < partitions.size(); i++ )
+            partitions[i].clear();
+        if( !errs.first.empty() )
+            uasserted(errs.first.code, errs.first.msg);
+    }
+
+    void replset::SyncTail::prefetchRange(const vector<BSONObj> *ops, unsigned a, unsigned b) {
+        Client::initThreadIfNotAlready("repl writer worker");
+        replLocalAuth();
+        for( unsigned i = a; i < b; i++ )
+            prefetchPagesForReplicatedOp((*ops)[i]);
+    }
+
+    void replset::SyncTail::prefetchOps(const vector<BSONObj>& ops, ThreadPool& writers) {
+        verify( !Lock::isLocked() );
+        unsigned n = writers.nThreads();
+        unsigned per = ( ops.size() + n - 1 ) / n;
+        for( unsigned a = 0; a < ops.size(); a += per )
+            writers.schedule(prefetchRange, &ops, a, min<unsigned>(a + per, ops.size()));
+        writers.join();
+    }
+
+    void replset::SyncTail::multiApply(const vector<BSONObj>& ops, ThreadPool& writers) {
+        verify( !Lock::isLocked() );
+        Lock::ParallelBatchWriterMode pbwm;
+
+        vector< vector<BSONObj> > partitions( writers.nThreads() );
+        for( vector<BSONObj>::const_iterator i = ops.begin(); i != ops.end(); ++i ) {
+            const BSONObj& o = *i;
+            if( !mustApplyAlone(o) ) {
+                if( *o.getStringField("op") != 'n' )
+                    partitions[ partitionFor(o, partitions.size()) ].push_back(o);
+                continue;
+            }
+            // everything before o in the batch has to be applied first
+            applyPartitions(partitions, writers);
+            {
+                scoped_ptr<Lock::ScopedLock> lk( lockForOp(o) );
+                syncApply(o);
+            }
+            getDur().commitIfNeeded();
+        }
+        applyPartitions(partitions, writers);
+    }
+
+    /** writer threads for applying batches of ops on a secondary */
+    static ThreadPool& replWriterPool() {
+        static ThreadPool *p = new ThreadPool(cmdLine.replWriterThreads);
+        return *p;
+    }
+
+    /** if we stop part way through a batch, some of its ops have been applied but not written 
+        to our oplog.  we must not go live until we have reapplied through the end of the batch, 
+        so minvalid moves to the last op of the batch before we start on it.
+    */
+    static void setMinValidForBatch(const BSONObj& lastOp) {
+        Lock::DBWrite lk("local.replset.minvalid");
+        BSONObj mv;
+        if( Helpers::getSingleton("local.replset.minvalid", mv) && 
+            mv["ts"]._opTime() >= lastOp["ts"]._opTime() ) {
+            return;
+        }
+        Helpers::putSingleton("local.replset.minvalid", lastOp);
+    }
+
     /* initial oplog application, during initial sync, after cloning.
        @return false on failure.
        this method returns an error and doesn't throw exceptions (i think).
@@ -402,148 +569,137 @@ namespace mongo {
 
         while( 1 ) {
             verify( !Lock::isLocked() );
+
             {
-                Timer timeInWriteLock;
-                scoped_ptr<Lock::ScopedLock> lk;
-                while( 1 ) {
-                    if( !r.moreInCurrentBatch() ) {
-                        lk.reset();
-                        timeInWriteLock.reset();
-
-                        {
-                            lock lk(this);
-                            if (_forceSyncTarget) {
-                                return;
-                            }
-                        }
+                lock lk(this);
+                if (_forceSyncTarget) {
+                    return;
+                }
+            }
 
-                        {
-                            // we need to occasionally check some things. between
-                            // batches is probably a good time.                            
-                            if( state().recovering() ) { // perhaps we should check this earlier? but not before the rollback checks.
-                                /* can we go to RS_SECONDARY state?  we can if not too old and if minvalid achieved */
-                                OpTime minvalid;
-                                bool golive = ReplSetImpl::tryToGoLiveAsASecondary(minvalid);
-                                if( golive ) {
-                                    ;
-                                }
-                                else {
-                                    sethbmsg(str::stream() << "still syncing, not yet to minValid optime" << minvalid.toString());
-                                }
-                                // todo: too stale capability
-                            }
-                            if( !target->hbinfo().hbstate.readable() ) {
-                                return;
-                            }
-                        }
-                        r.more(); // to make the requestmore outside the db lock, which obviously is quite important
+            {
+                // we need to occasionally check some things. between
+                // batches is probably a good time.
+                if( state().recovering() ) { // perhaps we should check this earlier? but not before the rollback checks.
+                    /* can we go to RS_SECONDARY state?  we can if not too old and if minvalid achieved */
+                    OpTime minvalid;
+                    bool golive = ReplSetImpl::tryToGoLiveAsASecondary(minvalid);
+                    if( golive ) {
+                        ;
                     }
-                    if( timeInWriteLock.micros() > 1000 ) {
-                        lk.reset();
-                        timeInWriteLock.reset();
+                    else {
+                        sethbmsg(str::stream() << "still syncing, not yet to minValid optime" << minvalid.toString());
                     }
-                    if( !r.more() )
-                        break;
-                    {
-                        BSONObj o = r.nextSafe(); // note we might get "not master" at some point
-
-                        int sd = myConfig().slaveDelay;
-                        // ignore slaveDelay if the box is still initializing. once
-                        // it becomes secondary we can worry about it.
-                        if( sd && box.getState().secondary() ) {
-                            const OpTime ts = o["ts"]._opTime();
-                            long long a = ts.getSecs();
-                            long long b = time(0);
-                            long long lag = b - a;
-                            long long sleeptime = sd - lag;
-                            if( sleeptime > 0 ) {
-                                lk.reset();
-                                uassert(12000, "rs slaveDelay differential too big check clocks and systems", sleeptime < 0x40000000);
-                                if( sleeptime < 60 ) {
-                                    sleepsecs((int) sleeptime);
-                                }
-                                else {
-                                    log() << "replSet slavedelay sleep long time: " << sleeptime << rsLog;
-                                    // sleep(hours) would prevent reconfigs from taking effect & such!
-                                    long long waitUntil = b + sleeptime;
-                                    while( 1 ) {
-                                        sleepsecs(6);
-                                        if( time(0) >= waitUntil )
-                                            break;
-
-                                        if( !target->hbinfo().hbstate.readable() ) {
-                                            break;
-                                        }
-                                    
-                                        if( myConfig().slaveDelay != sd ) // reconf
-                                            break;
-                                    }
+                    // todo: too stale capability
+                }
+                if( !target->hbinfo().hbstate.readable() ) {
+                    return;
+                }
+            }
+
+            // the requestmore happens here, outside the db lock, which obviously is quite important
+            if( !r.more() ) {
+                r.tailCheck();
+                if( !r.haveCursor() ) {
+                    LOG(1) << "replSet end syncTail pass with " << hn << rsLog;
+                    // TODO : reuse our connection to the primary.
+                    return;
+                }
+                // looping back is ok because this is a tailable cursor
+                continue;
+            }
+
+            // gather a batch from what we have already received.  these objects point into the 
+            // cursor's current batch, which stays valid until we next call r.more().
+            vector<BSONObj> ops;
+            while( r.moreInCurrentBatch() && ops.size() < replBatchLimitOperations ) {
+                BSONObj o = r.nextSafe(); // note we might get "not master" at some point
+
+                int sd = myConfig().slaveDelay;
+                // ignore slaveDelay if the box is still initializing. once
+                // it becomes secondary we can worry about it.
+                if( sd && box.getState().secondary() ) {
+                    const OpTime ts = o["ts"]._opTime();
+                    long long a = ts.getSecs();
+                    long long b = time(0);
+                    long long lag = b - a;
+                    long long sleeptime = sd - lag;
+                    if( sleeptime > 0 ) {
+                        if( !ops.empty() ) {
+                            // apply what we have; this op waits for the next batch
+                            r.putBack(o);
+                            break;
+                        }
+                        uassert(12000, "rs slaveDelay differential too big check clocks and systems", sleeptime < 0x40000000);
+                        if( sleeptime < 60 ) {
+                            sleepsecs((int) sleeptime);
+                        }
+                        else {
+                            log() << "replSet slavedelay sleep long time: " << sleeptime << rsLog;
+                            // sleep(hours) would prevent reconfigs from taking effect & such!
+                            long long waitUntil = b + sleeptime;
+                            while( 1 ) {
+                                sleepsecs(6);
+                                if( time(0) >= waitUntil )
+                                    break;
+
+                                if( !target->hbinfo().hbstate.readable() ) {
+                                    break;
                                 }
-                            }
-                        } // endif slaveDelay
-
-                        const char *ns = o.getStringField("ns");
-                        if( ns ) {
-                            if ( strlen(ns) == 0 ) {
-                                // this is ugly
-                                // this is often a no-op
-                                // but can't be 100% sure
-                                lk.reset();
-                                verify( !Lock::isLocked() );
-                                lk.reset( new Lock::GlobalWrite() );
-                            }
-                            else if( str::contains(ns, ".$cmd") ) { 
-                                // a command may need a global write lock. so we will conservatively go ahead and grab one here. suboptimal. :-( 
-                                lk.reset();
-                                verify( !Lock::isLocked() );
-                                lk.reset( new Lock::GlobalWrite() );
-                            }
-                            else if( !Lock::isWriteLocked(ns) || Lock::isW() ) {
-                                // we don't relock on every single op to try to be faster. however if switching collections, we have to.
-                                // note here we must reset to 0 first to assure the old object is destructed before our new operator invocation.
-                                lk.reset();
-                                verify( !Lock::isLocked() );
-                                lk.reset( new Lock::DBWrite(ns) );
+                            
+                                if( myConfig().slaveDelay != sd ) // reconf
+                                    break;
                             }
                         }
+                    }
+                } // endif slaveDelay
 
-                        try {
-                            /* if we have become primary, we dont' want to apply things from elsewhere
-                               anymore. assumePrimary is in the db lock so we are safe as long as
-                               we check after we locked above. */
-                            if( box.getState().primary() ) {
-                                log(0) << "replSet stopping syncTail we are now primary" << rsLog;
-                                return;
-                            }
+                ops.push_back(o);
+            }
 
-                            // TODO: make this whole method a member of SyncTail (SERVER-4444)
-                            replset::SyncTail tail("");
-                            tail.syncApply(o);
-                            _logOpObjRS(o);   // with repl sets we write the ops to our oplog too
-                            getDur().commitIfNeeded();
-                        }
-                        catch (DBException& e) {
-                            sethbmsg(str::stream() << "syncTail: " << e.toString() << ", syncing: " << o);
-                            veto(target->fullName(), 300);
-                            lk.reset();
-                            sleepsecs(30);
-                            return;
-                        }
+            try {
+                replset::SyncTail tail("");
+
+                // read in what the batch will touch while readers can still run
+                Timer timer;
+                tail.prefetchOps(ops, replWriterPool());
+                replApplyStats.prefetchMicros += timer.micros();
+                timer.reset();
+
+                // readers wait for the whole batch, including our oplog writes
+                Lock::ParallelBatchWriterMode pbwm;
+
+                /* if we have become primary, we dont' want to apply things from elsewhere
+                   anymore. assumePrimary takes a lock, which waits for the batch lock, so we 
+                   are safe as long as we check after we locked above. */
+                if( box.getState().primary() ) {
+                    log(0) << "replSet stopping syncTail we are now primary" << rsLog;
+                    return;
+                }
+
+                if( ops.size() > 1 )
+                    setMinValidForBatch(ops.back());
+
+                tail.multiApply(ops, replWriterPool());
+
+                {
+                    Lock::DBWrite lk("local");
+                    for( vector<BSONObj>::const_iterator i = ops.begin(); i != ops.end(); ++i ) {
+                        _logOpObjRS(*i);   // with repl sets we write the ops to our oplog too
                     }
-                } // end while
-            } // end writelock scope
+                }
+                getDur().commitIfNeeded();
 
-            r.tailCheck();
-            if( !r.haveCursor() ) {
-                LOG(1) << "replSet end syncTail pass with " << hn << rsLog;
-                // TODO : reuse our connection to the primary.
-                return;
+                replApplyStats.applyMicros += timer.micros();
+                replApplyStats.batches += 1;
+                replApplyStats.ops += ops.size();
             }
-            
-            if( !target->hbinfo().hbstate.readable() ) {
+            catch (DBException& e) {
+                sethbmsg(str::stream() << "syncTail: " << e.toString());
+                veto(target->fullName(), 300);
+                sleepsecs(30);
                 return;
             }
-            // looping back is ok because this is a tailable cursor
         }
     }
 
@@ -21,7 +21,7 @@
 #include "counters.h"
 
 namespace mongo {
-    OpCounters::OpCounters() {}
+    OpCounters::OpCounters() : _lock("OpCounters") {}
 
     void OpCounters::gotOp( int op , bool isCommand ) {
         switch ( op ) {
@@ -45,34 +45,43 @@ namespace mongo {
     }
 
     BSONObj OpCounters::getObj() {
+        scoped_lock lk( _lock );
+        Counts total;
+        vector<Counts*> all;
+        _counts.all( all );
+        for ( unsigned i = 0; i < all.size(); i++ ) {
+            const Counts& c = *all[i];
+            total.insert += c.insert;
+            total.query += c.query;
+            total.update += c.update;
+            total.remove += c.remove;
+            total.getmore += c.getmore;
+            total.command += c.command;
+        }
+
+        // unsigned arithmetic, so the differences hold across the counts wrapping
         const unsigned MAX = 1 << 30;
         RARELY {
             bool wrap =
-            _insert.get() > MAX ||
-            _query.get() > MAX ||
-            _update.get() > MAX ||
-            _delete.get() > MAX ||
-            _getmore.get() > MAX ||
-            _command.get() > MAX;
-
-            if ( wrap ) {
-                _insert.zero();
-                _query.zero();
-                _update.zero();
-                _delete.zero();
-                _getmore.zero();
-                _command.zero();
-            }
+            total.insert - _base.insert > MAX ||
+            total.query - _base.query > MAX ||
+            total.update - _base.update > MAX ||
+            total.remove - _base.remove > MAX ||
+            total.getmore - _base.getmore > MAX ||
+            total.command - _base.command > MAX;
+
+            if ( wrap )
+                _base = total;
 
         }
         BSONObjBuilder b;
         {
-            b.append( "insert" , _insert.get() );
-            b.append( "query" , _query.get() );
-            b.append( "update" , _update.get() );
-            b.append( "delete" , _delete.get() );
-            b.append( "getmore" , _getmore.get() );
-            b.append( "command" , _command.get() );
+            b.append( "insert" , total.insert - _base.insert );
+            b.append( "query" , total.query - _base.query );
+            b.append( "update" , total.update - _base.update );
+            b.append( "delete" , total.remove - _base.remove );
+            b.append( "getmore" , total.getmore - _base.getmore );
+            b.append( "command" , total.command - _base.command );
         }
         return b.obj();
     }
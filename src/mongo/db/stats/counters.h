@@ -22,39 +22,49 @@
 #include "../../util/net/message.h"
 #include "../../util/processinfo.h"
 #include "../../util/concurrency/spin_lock.h"
+#include "../../util/concurrency/thread_slabs.h"
 
 namespace mongo {
 
     /**
      * for storing operation counters
-     * note: not thread safe.  ok with that for speed
+     * each thread counts in its own slab, getObj() adds them up.
      */
     class OpCounters {
     public:
 
         OpCounters();
-        void incInsertInWriteLock(int n) { _insert.x += n; }
-        void gotInsert() { _insert++; }
-        void gotQuery() { _query++; }
-        void gotUpdate() { _update++; }
-        void gotDelete() { _delete++; }
-        void gotGetMore() { _getmore++; }
-        void gotCommand() { _command++; }
+        void incInsertInWriteLock(int n) { _counts.get().insert += n; }
+        void gotInsert() { _counts.get().insert++; }
+        void gotQuery() { _counts.get().query++; }
+        void gotUpdate() { _counts.get().update++; }
+        void gotDelete() { _counts.get().remove++; }
+        void gotGetMore() { _counts.get().getmore++; }
+        void gotCommand() { _counts.get().command++; }
 
         void gotOp( int op , bool isCommand );
 
         BSONObj getObj();
 
     private:
-
-        // todo: there will be a lot of cache line contention on these.  need to do something 
-        //       else eventually.
-        AtomicUInt _insert;
-        AtomicUInt _query;
-        AtomicUInt _update;
-        AtomicUInt _delete;
-        AtomicUInt _getmore;
-        AtomicUInt _command;
+        /** word sized, so getObj() reads them whole while their thread counts on even on 32 bit
+            builds.  they wrap around, which getObj() allows for: what it reports wraps anyway.
+        */
+        struct Counts {
+            Counts() : insert(0), query(0), update(0), remove(0), getmore(0), command(0) { }
+            unsigned insert;
+            unsigned query;
+            unsigned update;
+            unsigned remove;
+            unsigned getmore;
+            unsigned command;
+        };
+
+        ThreadSlabs<Counts> _counts;
+
+        mongo::mutex _lock; // for getObj()
+        // the totals when the reported counts were last wrapped around to 0
+        Counts _base;
     };
 
     extern OpCounters globalOpCounters;
@@ -0,0 +1,186 @@
+// latency.cpp
+/*
+ *    Copyright (C) 2012 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "pch.h"
+#include "latency.h"
+#include "../../util/net/message.h"
+#include "../commands.h"
+
+namespace mongo {
+
+    OpLatencies opLatencies;
+
+    static const char * const kindNames[] = { "reads" , "writes" , "commands" , "getmores" };
+
+    static OpLatencies::Kind kindOf( int op , bool isCommand ) {
+        switch ( op ) {
+        case dbQuery:
+            return isCommand ? OpLatencies::Commands : OpLatencies::Reads;
+        case dbGetMore:
+            return OpLatencies::GetMores;
+        case dbInsert:
+        case dbUpdate:
+        case dbDelete:
+            return OpLatencies::Writes;
+        default:
+            return OpLatencies::NumKinds;
+        }
+    }
+
+    OpLatencies::OpLatencies() : _m( "OpLatencies" ) { }
+
+    void OpLatencies::record( const char *ns , int op , bool isCommand , unsigned long long micros , 
+                              long long lockWaitMicros ) {
+        Kind k = kindOf( op , isCommand );
+        if ( k == NumKinds )
+            return;
+
+        ThreadState *t = _threads.get();
+        if ( t == 0 ) {
+            t = new ThreadState();
+            t->shard = _nextShard++ % NumShards;
+            _threads.reset( t );
+        }
+
+        Shard& s = _shards[t->shard];
+        s.total[k].insert( micros );
+        if ( lockWaitMicros >= 0 ) {
+            unsigned long long wait = std::min( (unsigned long long) lockWaitMicros , micros );
+            s.lockWait[k].insert( wait );
+            s.execution[k].insert( micros - wait );
+        }
+
+        if ( *ns ) {
+            NsLatencies *n = _lookup( *t , ns );
+            if ( n )
+                n->total[k].insert( micros );
+        }
+    }
+
+    OpLatencies::NsLatencies* OpLatencies::_lookup( ThreadState& t , const char *ns ) {
+        map<string,NsLatencies*>::iterator i = t.names.find( ns );
+        if ( i != t.names.end() )
+            return i->second;
+
+        NsLatencies *n = 0;
+        {
+            scoped_lock lk( _m );
+            map<string,NsLatencies*>::iterator j = _namespaces.find( ns );
+            if ( j != _namespaces.end() ) {
+                n = j->second;
+            }
+            else if ( _namespaces.size() < MaxNamespaces ) {
+                n = new NsLatencies();
+                _namespaces[ns] = n;
+            }
+        }
+        if ( t.names.size() >= MaxNamespaces )
+            t.names.clear();
+        t.names[ns] = n;
+        return n;
+    }
+
+    static void appendPercentiles( BSONObjBuilder& b , const LogLinearHistogram& h ) {
+        b.appendNumber( "count" , (long long) h.count() );
+        b.appendNumber( "p50" , (long long) h.percentile( 0.50 ) );
+        b.appendNumber( "p95" , (long long) h.percentile( 0.95 ) );
+        b.appendNumber( "p99" , (long long) h.percentile( 0.99 ) );
+        b.appendNumber( "p999" , (long long) h.percentile( 0.999 ) );
+        b.appendNumber( "max" , (long long) h.max() );
+    }
+
+    void OpLatencies::append( BSONObjBuilder& b , bool byNamespace ) {
+        b.append( "note" , "all times in microseconds" );
+
+        for ( int k = 0; k < NumKinds; k++ ) {
+            LogLinearHistogram total;
+            LogLinearHistogram lockWait;
+            LogLinearHistogram execution;
+            for ( int i = 0; i < NumShards; i++ ) {
+                total.add( _shards[i].total[k] );
+                lockWait.add( _shards[i].lockWait[k] );
+                execution.add( _shards[i].execution[k] );
+            }
+
+            BSONObjBuilder bb( b.subobjStart( kindNames[k] ) );
+            appendPercentiles( bb , total );
+            if ( lockWait.count() ) {
+                BSONObjBuilder w( bb.subobjStart( "lockWait" ) );
+                appendPercentiles( w , lockWait );
+                w.done();
+                BSONObjBuilder e( bb.subobjStart( "execution" ) );
+                appendPercentiles( e , execution );
+                e.done();
+            }
+            bb.done();
+        }
+
+        if ( ! byNamespace )
+            return;
+
+        BSONObjBuilder nsb( b.subobjStart( "namespaces" ) );
+        scoped_lock lk( _m );
+        for ( map<string,NsLatencies*>::const_iterator i = _namespaces.begin(); i != _namespaces.end(); ++i ) {
+            const NsLatencies& n = *i->second;
+            BSONObjBuilder bb( nsb.subobjStart( i->first ) );
+            for ( int k = 0; k < NumKinds; k++ ) {
+                if ( n.total[k].count() == 0 )
+                    continue;
+                BSONObjBuilder kb( bb.subobjStart( kindNames[k] ) );
+                appendPercentiles( kb , n.total[k] );
+                kb.done();
+            }
+            bb.done();
+        }
+        nsb.done();
+    }
+
+    void OpLatencies::reset() {
+        for ( int i = 0; i < NumShards; i++ ) {
+            for ( int k = 0; k < NumKinds; k++ ) {
+                _shards[i].total[k].reset();
+                _shards[i].lockWait[k].reset();
+                _shards[i].execution[k].reset();
+            }
+        }
+        scoped_lock lk( _m );
+        for ( map<string,NsLatencies*>::iterator i = _namespaces.begin(); i != _namespaces.end(); ++i ) {
+            for ( int k = 0; k < NumKinds; k++ )
+                i->second->total[k].reset();
+        }
+    }
+
+    class CmdResetOpLatencies : public Command {
+    public:
+        CmdResetOpLatencies() : Command( "resetOpLatencies" ) {}
+
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& help ) const { 
+            help << "zero the latency histograms of serverStatus.opLatencies"; 
+        }
+
+        virtual bool run(const string& , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            opLatencies.reset();
+            return true;
+        }
+
+    } cmdResetOpLatencies;
+
+}
@@ -0,0 +1,85 @@
+// latency.h
+/*
+ *    Copyright (C) 2012 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../../pch.h"
+#include "../jsobj.h"
+#include "../../util/histogram.h"
+#include "../../util/concurrency/mutex.h"
+
+namespace mongo {
+
+    /**
+     * how long operations take, for serverStatus.opLatencies: percentiles of the latency of reads,
+     * writes, commands and getMores, overall and by namespace.  on mongod the overall latency is
+     * also split into the time spent waiting for locks and the rest.
+     *
+     * each thread records into one of a number of shards of histograms so that cores seldom
+     * increment the same counters; they are added up when read.
+     */
+    class OpLatencies : boost::noncopyable {
+    public:
+        enum Kind { Reads, Writes, Commands, GetMores, NumKinds };
+
+        OpLatencies();
+
+        /**
+         * @param ns may be empty, then the op is only counted in the totals
+         * @param lockWaitMicros how much of micros was spent waiting for locks, -1 if not known
+         */
+        void record( const char *ns , int op , bool isCommand , unsigned long long micros , 
+                     long long lockWaitMicros = -1 );
+
+        /** @param byNamespace also report each namespace's latencies */
+        void append( BSONObjBuilder& b , bool byNamespace );
+
+        void reset();
+
+    private:
+        /** namespaces beyond this many are only counted in the totals */
+        enum { NumShards = 16, MaxNamespaces = 1000 };
+
+        struct Shard {
+            LogLinearHistogram total[NumKinds];
+            LogLinearHistogram lockWait[NumKinds];
+            LogLinearHistogram execution[NumKinds];
+        };
+
+        struct NsLatencies {
+            LogLinearHistogram total[NumKinds];
+        };
+
+        /** per thread: its shard, and the namespaces it has looked up */
+        struct ThreadState {
+            unsigned shard;
+            map<string,NsLatencies*> names;
+        };
+
+        NsLatencies* _lookup( ThreadState& t , const char *ns );
+
+        Shard _shards[NumShards];
+        AtomicUInt _nextShard;
+        boost::thread_specific_ptr<ThreadState> _threads;
+
+        mongo::mutex _m; // guards _namespaces.  entries are never removed, reset() zeroes them
+        map<string,NsLatencies*> _namespaces;
+    };
+
+    extern OpLatencies opLatencies;
+
+}
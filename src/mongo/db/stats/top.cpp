@@ -42,21 +42,106 @@ namespace mongo {
 
     }
 
+    void Top::CollectionData::add( const CollectionData& other ) {
+        total.add( other.total );
+        readLock.add( other.readLock );
+        writeLock.add( other.writeLock );
+        queries.add( other.queries );
+        getmore.add( other.getmore );
+        insert.add( other.insert );
+        update.add( other.update );
+        remove.add( other.remove );
+        commands.add( other.commands );
+    }
+
     void Top::record( const string& ns , int op , int lockType , long long micros , bool command ) {
+        NsCache c;
+        intern( c , ns.c_str() , command || op == dbQuery );
+        record( c , op , lockType , micros , command );
+    }
+
+    void Top::intern( NsCache& c , const char *ns , bool queryOrCommand ) {
+        if ( c.valid() && c._name == ns )
+            return;
+        c._name = ns;
+        c._ns = 0;
         if ( ns[0] == '?' )
             return;
+        c._ns = _intern( _slabs.get() , c._name , queryOrCommand , &c._generation );
+    }
+
+    void Top::record( const NsCache& c , int op , int lockType , long long micros , bool command ) {
+        if ( ! c.valid() )
+            return;
+
+        //cout << "record: " << c._name << "\t" << op << "\t" << command << endl;
+        Slab& s = _slabs.get();
+        SimpleMutex::scoped_lock lk( s.m );
+        Slab::Entry& e = s.usage[c._ns];
+        if ( e.generation != c._generation ) {
+            // new to this thread, or what we had is for a namespace since dropped
+            e.generation = c._generation;
+            e.data = CollectionData();
+        }
+        _record( e.data , op , lockType , micros , command );
+        _record( s.global , op , lockType , micros , command );
+    }
+
+    Top::Ns* Top::_intern( Slab& s , const string& ns , bool queryOrCommand , unsigned* generation ) {
+        map< string , pair<Ns*,unsigned> >::iterator i = s.names.find( ns );
+        if ( i != s.names.end() && i->second.first->generation == i->second.second ) {
+            *generation = i->second.second;
+            return i->second.first;
+        }
 
-        //cout << "record: " << ns << "\t" << op << "\t" << command << endl;
         scoped_lock lk(_lock);
 
-        if ( ( command || op == dbQuery ) && ns == _lastDropped ) {
+        if ( queryOrCommand && ns == _lastDropped ) {
             _lastDropped = "";
-            return;
+            return 0;
         }
 
-        CollectionData& coll = _usage[ns];
-        _record( coll , op , lockType , micros , command );
-        _record( _global , op , lockType , micros , command );
+        Ns*& n = _names[ns];
+        if ( n == 0 ) {
+            if ( _free.empty() ) {
+                n = new Ns();
+            }
+            else {
+                n = _free.back();
+                _free.pop_back();
+            }
+            n->name = ns;
+        }
+
+        if ( s.names.size() >= MaxCachedNames )
+            s.names.clear();
+        *generation = n->generation;
+        s.names[ns] = make_pair( n , *generation );
+        return n;
+    }
+
+    void Top::_collect( UsageMap* usage , CollectionData* global ) const {
+        scoped_lock lk(_lock);
+        vector<Slab*> slabs;
+        _slabs.all( slabs );
+        for ( unsigned i = 0; i < slabs.size(); i++ ) {
+            Slab& s = *slabs[i];
+            SimpleMutex::scoped_lock slk( s.m );
+            if ( global )
+                global->add( s.global );
+            boost::unordered_map<const Ns*,Slab::Entry>::iterator j = s.usage.begin();
+            while ( j != s.usage.end() ) {
+                const Ns *n = j->first;
+                if ( j->second.generation != n->generation ) {
+                    // dropped
+                    s.usage.erase( j++ );
+                    continue;
+                }
+                if ( usage )
+                    (*usage)[n->name].add( j->second.data );
+                ++j;
+            }
+        }
     }
 
     void Top::_record( CollectionData& c , int op , int lockType , long long micros , bool command ) {
@@ -104,18 +189,31 @@ namespace mongo {
     void Top::collectionDropped( const string& ns ) {
         //cout << "collectionDropped: " << ns << endl;
         scoped_lock lk(_lock);
-        _usage.erase(ns);
+        map<string,Ns*>::iterator i = _names.find( ns );
+        if ( i != _names.end() ) {
+            Ns *n = i->second;
+            _names.erase( i );
+            n->generation++;
+            _free.push_back( n );
+        }
         _lastDropped = ns;
     }
 
     void Top::cloneMap(Top::UsageMap& out) const {
-        scoped_lock lk(_lock);
-        out = _usage;
+        out.clear();
+        _collect( &out , 0 );
+    }
+
+    Top::CollectionData Top::getGlobalData() const {
+        CollectionData global;
+        _collect( 0 , &global );
+        return global;
     }
 
     void Top::append( BSONObjBuilder& b ) {
-        scoped_lock lk( _lock );
-        _appendToUsageMap( b , _usage );
+        UsageMap usage;
+        _collect( &usage , 0 );
+        _appendToUsageMap( b , usage );
     }
 
     void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const {
@@ -18,11 +18,17 @@
 #pragma once
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "mongo/util/concurrency/thread_slabs.h"
 
 namespace mongo {
 
     /**
      * tracks usage by collection
+     * each thread records into its own slab, keyed by interned namespace; the slabs are added up
+     * when the usage is read.  a thread keeps the namespace it is using in an NsCache so that
+     * recording needs no lookup by name.
      */
     class Top {
 
@@ -39,6 +45,10 @@ namespace mongo {
                 count++;
                 time += micros;
             }
+            void add( const UsageData& other ) {
+                count += other.count;
+                time += other.time;
+            }
         };
 
         struct CollectionData {
@@ -59,29 +69,83 @@ namespace mongo {
             UsageData update;
             UsageData remove;
             UsageData commands;
+
+            void add( const CollectionData& other );
         };
 
         typedef map<string,CollectionData> UsageMap;
 
+        /** an interned namespace.  when it is dropped its generation changes and it is reused for
+            the next new namespace, which makes the usage recorded under it stale */
+        struct Ns {
+            Ns() : generation(1) { }
+            string name;
+            volatile unsigned generation;
+        };
+
+        /** one thread's last namespace, interned, so that ops on the same collection one after
+            another neither look it up again nor record under a string */
+        class NsCache {
+        public:
+            NsCache() : _ns(0), _generation(0) { }
+            /** false if unset, not to be recorded, or since dropped */
+            bool valid() const { return _ns && _ns->generation == _generation; }
+        private:
+            friend class Top;
+            Ns *_ns;
+            unsigned _generation;
+            string _name;
+        };
+
     public:
+        /** points c at ns, looking ns up only if c was for another namespace or it was dropped */
+        void intern( NsCache& c , const char *ns , bool queryOrCommand );
+        /** under what c points at, if it's valid() */
+        void record( const NsCache& c , int op , int lockType , long long micros , bool command );
         void record( const string& ns , int op , int lockType , long long micros , bool command );
         void append( BSONObjBuilder& b );
         void cloneMap(UsageMap& out) const;
-        CollectionData getGlobalData() const { return _global; }
+        CollectionData getGlobalData() const;
         void collectionDropped( const string& ns );
 
     public: // static stuff
         static Top global;
 
     private:
+        /** what one thread recorded */
+        struct Slab {
+            Slab() : m("Top::Slab") { }
+
+            struct Entry {
+                Entry() : generation(0) { }
+                unsigned generation;
+                CollectionData data;
+            };
+
+            // guards global and usage: taken by the owning thread to record, so it is only 
+            // contended when the usage is read
+            SimpleMutex m;
+            CollectionData global;
+            boost::unordered_map<const Ns*,Entry> usage;
+
+            // the namespaces the owning thread has looked up, and their generation then.  only
+            // the owning thread uses it
+            map< string , pair<Ns*,unsigned> > names;
+        };
+        enum { MaxCachedNames = 1000 };
+
+        /** @return the interned ns and its generation then, or 0 if this op shouldn't be recorded */
+        Ns* _intern( Slab& s , const string& ns , bool queryOrCommand , unsigned* generation );
+        void _collect( UsageMap* usage , CollectionData* global ) const;
         void _appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const;
         void _appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ) const;
         void _record( CollectionData& c , int op , int lockType , long long micros , bool command );
 
-        mutable mongo::mutex _lock;
-        CollectionData _global;
-        UsageMap _usage;
+        mutable mongo::mutex _lock; // guards the interned namespaces and _lastDropped
+        map<string,Ns*> _names;
+        vector<Ns*> _free;
         string _lastDropped;
+        mutable ThreadSlabs<Slab> _slabs;
     };
 
 } // namespace mongo
@@ -637,6 +637,25 @@ namespace BasicTests {
         }
     };
 
+    class BoundedQueueTest {
+    public:
+        void run() {
+            BlockingQueue<int> q( 2 );
+            boost::thread producer( boost::bind( &BoundedQueueTest::produce, &q ) );
+            for( int i = 0; i < 100; ++i ) {
+                ASSERT( q.size() <= 2 );
+                ASSERT_EQUALS( i, q.blockingPop() );
+            }
+            producer.join();
+            ASSERT( q.empty() );
+        }
+    private:
+        static void produce( BlockingQueue<int> *q ) {
+            for( int i = 0; i < 100; ++i )
+                q->push( i );
+        }
+    };
+
     class StrTests {
     public:
 
@@ -789,6 +808,7 @@ namespace BasicTests {
             add< IsValidUTF8Test >();
 
             add< QueueTest >();
+            add< BoundedQueueTest >();
 
             add< StrTests >();
 
@@ -50,7 +50,9 @@ namespace mongo {
             }
             
             chunkRanges.reloadAll( chunkMap );
+            _buildRoutingIndex();
         }
+        bool routesByIndex() const { return ! _routingIndex.empty(); }
     };
     
 } // namespace mongo
@@ -236,7 +238,159 @@ namespace ChunkTests {
             }
         };
 
+        /** findChunk by the encoded bounds gives the chunk the map would */
+        class FindChunkBase {
+        public:
+            virtual ~FindChunkBase() {}
+            void run() {
+                ChunkManager chunkManager;
+                chunkManager.setShardKey( BSON( "a" << 1 ) );
+                chunkManager.setSingleChunkForShards( splitPoints() );
+                ASSERT_EQUALS( indexed(), chunkManager.routesByIndex() );
+
+                vector<BSONObj> keys = splitPoints();
+                keys.push_back( BSON( "a" << MINKEY ) );
+                keys.push_back( BSON( "a" << -1 ) );
+                keys.push_back( BSON( "a" << 5.5 ) );
+                keys.push_back( BSON( "a" << 100LL ) );
+                keys.push_back( BSON( "a" << "abc" ) );
+                keys.push_back( BSON( "a" << OID::gen() ) );
+                keys.push_back( BSONObjBuilder().appendTimestamp( "a" , 1000 , 1 ).obj() );
+                for( vector<BSONObj>::const_iterator i = keys.begin(); i != keys.end(); ++i ) {
+                    ChunkPtr c = chunkManager.findChunk( *i );
+                    ASSERT( c->contains( *i ) );
+                }
+            }
+        protected:
+            virtual vector<BSONObj> splitPoints() const = 0;
+            virtual bool indexed() const { return true; }
+        };
+
+        class FindChunkNumbers : public FindChunkBase {
+        protected:
+            virtual vector<BSONObj> splitPoints() const {
+                vector<BSONObj> ret;
+                ret.push_back( BSON( "a" << 0 ) );
+                ret.push_back( BSON( "a" << 5 ) );
+                ret.push_back( BSON( "a" << 5.5 ) );
+                ret.push_back( BSON( "a" << 10LL ) );
+                ret.push_back( BSON( "a" << "x" ) );
+                return ret;
+            }
+        };
+
+        class FindChunkUnencodableBound : public FindChunkNumbers {
+            virtual vector<BSONObj> splitPoints() const {
+                vector<BSONObj> ret = FindChunkNumbers::splitPoints();
+                ret.push_back( BSON( "a" << BSON( "b" << 1 ) ) );
+                return ret;
+            }
+            virtual bool indexed() const { return false; }
+        };
+
     } // namespace ChunkManagerTests
+
+    namespace ShardKeyIndexTests {
+
+        /** memcmp of encodings orders keys the way woCompare does */
+        class EncodingOrder {
+        public:
+            void run() {
+                vector<BSONObj> keys;
+                keys.push_back( BSON( "a" << MINKEY ) );
+                keys.push_back( BSON( "a" << BSONNULL ) );
+                keys.push_back( BSON( "a" << numeric_limits<double>::quiet_NaN() ) );
+                keys.push_back( BSON( "a" << -numeric_limits<double>::infinity() ) );
+                keys.push_back( BSON( "a" << -(1LL << 53) ) );
+                keys.push_back( BSON( "a" << -2.5 ) );
+                keys.push_back( BSON( "a" << -2 ) );
+                keys.push_back( BSON( "a" << -0.0 ) );
+                keys.push_back( BSON( "a" << 0 ) );
+                keys.push_back( BSON( "a" << 0LL ) );
+                keys.push_back( BSON( "a" << 1e-300 ) );
+                keys.push_back( BSON( "a" << 3 ) );
+                keys.push_back( BSON( "a" << 3LL ) );
+                keys.push_back( BSON( "a" << 3.0 ) );
+                keys.push_back( BSON( "a" << 3.5 ) );
+                keys.push_back( BSON( "a" << ( 1LL << 40 ) ) );
+                keys.push_back( BSON( "a" << numeric_limits<double>::infinity() ) );
+                keys.push_back( BSON( "a" << "" ) );
+                keys.push_back( BSONObjBuilder().append( "a" , "\0" , 2 ).obj() );
+                keys.push_back( BSONObjBuilder().append( "a" , "\0\0" , 3 ).obj() );
+                keys.push_back( BSONObjBuilder().append( "a" , "\0a" , 3 ).obj() );
+                keys.push_back( BSON( "a" << "a" ) );
+                keys.push_back( BSON( "a" << "a" << "b" << MINKEY ) );
+                keys.push_back( BSON( "a" << "a" << "b" << 1 ) );
+                keys.push_back( BSON( "a" << "a\xff" ) );
+                keys.push_back( BSON( "a" << "ab" ) );
+                keys.push_back( BSON( "a" << OID( "000000000000000000000000" ) ) );
+                keys.push_back( BSON( "a" << OID( "4f0000000000000000000001" ) ) );
+                keys.push_back( BSON( "a" << false ) );
+                keys.push_back( BSON( "a" << true ) );
+                keys.push_back( BSON( "a" << Date_t( (unsigned long long) -1000LL ) ) );
+                keys.push_back( BSON( "a" << Date_t( 0 ) ) );
+                keys.push_back( BSON( "a" << Date_t( 1000 ) ) );
+                keys.push_back( BSON( "a" << MAXKEY ) );
+
+                for( unsigned i = 0; i < keys.size(); ++i ) {
+                    for( unsigned j = 0; j < keys.size(); ++j ) {
+                        int expected = keys[i].woCompare( keys[j] );
+                        int actual = compareEncoded( keys[i], keys[j] );
+                        ASSERT_EQUALS( expected < 0, actual < 0 );
+                        ASSERT_EQUALS( expected == 0, actual == 0 );
+                    }
+                }
+            }
+        private:
+            static int compareEncoded( const BSONObj& l, const BSONObj& r ) {
+                StackBufBuilder lb;
+                StackBufBuilder rb;
+                ASSERT( ShardKeyIndex::encode( l, lb ) );
+                ASSERT( ShardKeyIndex::encode( r, rb ) );
+                int c = memcmp( lb.buf(), rb.buf(), min( lb.len(), rb.len() ) );
+                return c ? c : lb.len() - rb.len();
+            }
+        };
+
+        class Unencodable {
+        public:
+            void run() {
+                StackBufBuilder b;
+                BSONObj timestamp = BSONObjBuilder().appendTimestamp( "a" , 1000 , 1 ).obj();
+                ASSERT( ! ShardKeyIndex::encode( timestamp, b ) );
+                ASSERT( ! ShardKeyIndex::encode( BSON( "a" << BSON( "b" << 1 ) ), b ) );
+                ASSERT( ! ShardKeyIndex::encode( BSON( "a" << ( 1LL << 53 ) + 1 ), b ) );
+
+                ShardKeyIndex index;
+                ASSERT( index.push_back( BSON( "a" << 1 ) ) );
+                ASSERT( ! index.push_back( BSON( "a" << BSON_ARRAY( 1 ) ) ) );
+                ASSERT_EQUALS( 1, index.size() );
+                ASSERT_EQUALS( -1, index.upperBound( timestamp ) );
+            }
+        };
+
+        class UpperBound {
+        public:
+            void run() {
+                ShardKeyIndex index;
+                for( int i = 1; i <= 100; ++i ) {
+                    ASSERT( index.push_back( BSON( "a" << i * 10 ) ) );
+                }
+                ASSERT( index.push_back( BSON( "a" << MAXKEY ) ) );
+                ASSERT_EQUALS( 101, index.size() );
+
+                ASSERT_EQUALS( 0, index.upperBound( BSON( "a" << MINKEY ) ) );
+                ASSERT_EQUALS( 0, index.upperBound( BSON( "a" << 9.9 ) ) );
+                ASSERT_EQUALS( 1, index.upperBound( BSON( "a" << 10 ) ) );
+                ASSERT_EQUALS( 1, index.upperBound( BSON( "a" << 10LL ) ) );
+                ASSERT_EQUALS( 50, index.upperBound( BSON( "a" << 505 ) ) );
+                ASSERT_EQUALS( 100, index.upperBound( BSON( "a" << 1000 ) ) );
+                ASSERT_EQUALS( 100, index.upperBound( BSON( "a" << "x" ) ) );
+                ASSERT_EQUALS( 101, index.upperBound( BSON( "a" << MAXKEY ) ) );
+            }
+        };
+
+    } // namespace ShardKeyIndexTests
     
     class All : public Suite {
     public:
@@ -264,6 +418,11 @@ namespace ChunkTests {
             add<ChunkManagerTests::InequalityThenUnsatisfiable>();
             add<ChunkManagerTests::OrEqualityUnsatisfiableInequality>();
             add<ChunkManagerTests::InMultiShard>();
+            add<ChunkManagerTests::FindChunkNumbers>();
+            add<ChunkManagerTests::FindChunkUnencodableBound>();
+            add<ShardKeyIndexTests::EncodingOrder>();
+            add<ShardKeyIndexTests::Unencodable>();
+            add<ShardKeyIndexTests::UpperBound>();
         }
     } myall;
     
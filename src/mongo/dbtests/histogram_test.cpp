@@ -79,6 +79,68 @@ namespace mongo {
         }
     };
 
+    class LogLinearBuckets {
+    public:
+        void run() {
+            // one bucket per value below 8, then 8 per power of two
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( 0 ), 0u );
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( 7 ), 7u );
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( 8 ), 8u );
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( 15 ), 15u );
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( 16 ), 16u );
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( 17 ), 16u );
+            ASSERT_EQUALS( LogLinearHistogram::getBoundary( 16 ), 17u );
+            ASSERT_EQUALS( LogLinearHistogram::getBoundary( 23 ), 31u );
+
+            // every bucket holds the values from just past the one before to its boundary
+            for ( uint32_t b = 1; b < LogLinearHistogram::NumBuckets - 1; b++ ) {
+                uint64_t low = LogLinearHistogram::getBoundary( b - 1 ) + 1;
+                uint64_t high = LogLinearHistogram::getBoundary( b );
+                ASSERT( low <= high );
+                ASSERT_EQUALS( LogLinearHistogram::findBucket( low ), b );
+                ASSERT_EQUALS( LogLinearHistogram::findBucket( high ), b );
+                // within an eighth of the value
+                ASSERT( ( high - low ) * 8 <= low );
+            }
+
+            ASSERT_EQUALS( LogLinearHistogram::findBucket( numeric_limits<uint64_t>::max() ),
+                           (uint32_t) LogLinearHistogram::NumBuckets - 1 );
+        }
+    };
+
+    class LogLinearPercentiles {
+    public:
+        void run() {
+            LogLinearHistogram h;
+            ASSERT_EQUALS( h.percentile( 0.5 ), 0u );
+
+            for ( uint64_t i = 1; i <= 1000; i++ )
+                h.insert( i );
+            h.insert( 1000000 );
+
+            ASSERT_EQUALS( h.count(), 1001u );
+            ASSERT_EQUALS( h.max(), 1000000u );
+            assertNear( h.percentile( 0.50 ), 501 );
+            assertNear( h.percentile( 0.99 ), 991 );
+            ASSERT_EQUALS( h.percentile( 1.0 ), 1000000u );
+
+            LogLinearHistogram sum;
+            sum.add( h );
+            sum.add( h );
+            ASSERT_EQUALS( sum.count(), 2002u );
+            assertNear( sum.percentile( 0.50 ), 501 );
+
+            h.reset();
+            ASSERT_EQUALS( h.count(), 0u );
+            ASSERT_EQUALS( h.max(), 0u );
+        }
+    private:
+        void assertNear( uint64_t got, uint64_t expected ) {
+            ASSERT( got >= expected );
+            ASSERT( got <= expected + expected / 8 );
+        }
+    };
+
     class HistogramSuite : public Suite {
     public:
         HistogramSuite() : Suite( "histogram" ) {}
@@ -87,6 +149,8 @@ namespace mongo {
             add< BoundariesInit >();
             add< BoundariesExponential >();
             add< BoundariesFind >();
+            add< LogLinearBuckets >();
+            add< LogLinearPercentiles >();
             // TODO: complete the test suite
         }
     } histogramSuite;
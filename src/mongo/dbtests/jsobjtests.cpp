@@ -1685,6 +1685,34 @@ namespace JsobjTests {
             }
         };
 
+        /** runs written and merged on a pool of threads, and an in memory sort in parallel pieces */
+        template< bool OnDisk >
+        class Parallel {
+        public:
+            void run() {
+                const int total = 50000;
+                BSONObjExternalSorter sorter( indexInterfaceForTheseTests, BSONObj() , OnDisk ? 200000 : 100000000 , 4 );
+                for ( int i=0; i<total; i++ ) {
+                    sorter.add( BSON( "x" << rand() % 1000 ) , 5  , i );
+                }
+
+                sorter.sort();
+                ASSERT( OnDisk ? sorter.numFiles() > 4 : sorter.numFiles() == 0 );
+
+                auto_ptr<BSONObjExternalSorter::Iterator> i = sorter.iterator();
+                int num=0;
+                pair<BSONObj,DiskLoc> prev( BSON( "x" << -1 ) , DiskLoc() );
+                while ( i->more() ) {
+                    pair<BSONObj,DiskLoc> p = i->next();
+                    num++;
+                    int c = p.first["x"].numberInt() - prev.first["x"].numberInt();
+                    ASSERT( c > 0 || ( c == 0 && prev.second < p.second ) );
+                    prev = p;
+                }
+                ASSERT_EQUALS( total , num );
+            }
+        };
+
         class D1 {
         public:
             void run() {
@@ -2289,6 +2317,8 @@ namespace JsobjTests {
             add< external_sort::ByDiskLock >();
             add< external_sort::Big1 >();
             add< external_sort::Big2 >();
+            add< external_sort::Parallel<true> >();
+            add< external_sort::Parallel<false> >();
             add< external_sort::D1 >();
             add< CompatBSON >();
             add< CompareDottedFieldNamesTest >();
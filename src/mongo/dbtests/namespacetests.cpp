@@ -1195,6 +1195,82 @@ namespace NamespaceTests {
             }
         };
 
+        class PowerOf2Base : public Base {
+        protected:
+            void create() {
+                Base::create();
+                nsd()->setUserFlag( NamespaceDetails::Flag_UsePowerOf2Sizes );
+            }
+            DiskLoc insert() {
+                BSONObj b = bigObj( true );
+                DiskLoc l = theDataFileMgr.insert( ns(), b.objdata(), b.objsize() );
+                ASSERT( !l.isNull() );
+                // 233 bytes with the header
+                ASSERT_EQUALS( 256, l.rec()->lengthWithHeaders() );
+                return l;
+            }
+            void remove( const DiskLoc& l ) {
+                theDataFileMgr.deleteRecord( ns(), l.rec(), l );
+            }
+        private:
+            virtual string spec() const {
+                return "{}";
+            }
+        };
+
+        /** with power of 2 sizes a freed record is what the next record of its size gets */
+        class SizeClassAlloc : public PowerOf2Base {
+        public:
+            void run() {
+                create();
+                DiskLoc l[ 4 ];
+                for ( int i = 0; i < 4; ++i )
+                    l[ i ] = insert();
+                remove( l[ 1 ] );
+                ASSERT( l[ 1 ] == insert() );
+                remove( l[ 2 ] );
+                remove( l[ 0 ] );
+                ASSERT( l[ 0 ] == insert() );
+                ASSERT( l[ 2 ] == insert() );
+            }
+        };
+
+        class CoalesceDeleted : public PowerOf2Base {
+        public:
+            void run() {
+                create();
+                DiskLoc l[ 6 ];
+                for ( int i = 0; i < 6; ++i )
+                    l[ i ] = insert();
+                remove( l[ 1 ] );
+                remove( l[ 2 ] );
+                remove( l[ 3 ] );
+
+                // those three and the rest of the extent
+                NamespaceDetails::FreeListStats before;
+                nsd()->freeListStats( before, 1000 );
+                ASSERT_EQUALS( 4, before.records );
+                ASSERT_EQUALS( 2, before.coalescible );
+                ASSERT_EQUALS( 3, before.byBucket[ NamespaceDetails::bucket( 256 ) ] );
+
+                // a bounded pass merges part of the run, the next one the rest
+                ASSERT_EQUALS( 1, nsd()->coalesceDeletedRecords( 1000, 1 ) );
+                ASSERT_EQUALS( 2 * 256, l[ 1 ].drec()->lengthWithHeaders() );
+                ASSERT_EQUALS( 1, nsd()->coalesceDeletedRecords() );
+                NamespaceDetails::FreeListStats after;
+                nsd()->freeListStats( after, 1000 );
+                ASSERT_EQUALS( 2, after.records );
+                ASSERT_EQUALS( 0, after.coalescible );
+                ASSERT_EQUALS( before.size, after.size );
+                ASSERT_EQUALS( 3 * 256, l[ 1 ].drec()->lengthWithHeaders() );
+                ASSERT_EQUALS( 0, nsd()->coalesceDeletedRecords() );
+
+                // and it splits again
+                ASSERT( l[ 1 ] == insert() );
+                ASSERT_EQUALS( 4, nRecords() );
+            }
+        };
+
         // This isn't a particularly useful test, and because it doesn't clean up
         // after itself, /tmp/unittest needs to be cleared after running.
         //        class BigCollection : public Base {
@@ -1282,6 +1358,47 @@ namespace NamespaceTests {
                 assertCachedIndexKey( BSONObj() );
             }
         };                                                                                         
+
+        /** A cached plan ages out after enough writes, unless a run confirms it or it is pinned. */
+        class QueryCacheWrites : public NamespaceDetailsTests::CachedPlanBase {
+        public:
+            void run() {
+                registerIndexKey( BSON( "a" << 1 ) );
+                for( int i = 0; i < QueryPlanCache::WriteLimit - 1; ++i ) {
+                    nsdt().notifyOfWriteOp();
+                }
+                // A run scanning about what the plan won with confirms it.
+                ASSERT( nsdt().queryPlanCache().noteRun( _pattern, 1, 10 ) );
+                nsdt().notifyOfWriteOp();
+                assertCachedIndexKey( BSON( "a" << 1 ) );
+
+                ASSERT( nsdt().queryPlanCache().pin( _pattern, true ) );
+                for( int i = 0; i < QueryPlanCache::WriteLimit; ++i ) {
+                    nsdt().notifyOfWriteOp();
+                }
+                assertCachedIndexKey( BSON( "a" << 1 ) );
+
+                ASSERT( nsdt().queryPlanCache().pin( _pattern, false ) );
+                for( int i = 0; i < QueryPlanCache::WriteLimit; ++i ) {
+                    nsdt().notifyOfWriteOp();
+                }
+                assertCachedIndexKey( BSONObj() );
+            }
+        };
+
+        /** A cached plan whose runs scan far more than it won with is evicted. */
+        class QueryCacheDrift : public NamespaceDetailsTests::CachedPlanBase {
+        public:
+            void run() {
+                registerIndexKey( BSON( "a" << 1 ) );
+                long long big = QueryPlanCache::DriftMinNScanned * QueryPlanCache::DriftFactor * 2;
+                nsdt().queryPlanCache().noteRun( _pattern, big, 10 );
+                nsdt().queryPlanCache().noteRun( _pattern, big, 10 );
+                assertCachedIndexKey( BSON( "a" << 1 ) );
+                nsdt().queryPlanCache().noteRun( _pattern, big, 10 );
+                assertCachedIndexKey( BSONObj() );
+            }
+        };
         
     } // namespace NamespaceDetailsTransientTests
                                                                                  
@@ -1338,7 +1455,11 @@ namespace NamespaceTests {
             //            add< NamespaceDetailsTests::BigCollection >();
             add< NamespaceDetailsTests::Size >();
             add< NamespaceDetailsTests::SetIndexIsMultikey >();
+            add< NamespaceDetailsTests::SizeClassAlloc >();
+            add< NamespaceDetailsTests::CoalesceDeleted >();
             add< NamespaceDetailsTransientTests::ClearQueryCache >();
+            add< NamespaceDetailsTransientTests::QueryCacheWrites >();
+            add< NamespaceDetailsTransientTests::QueryCacheDrift >();
         }
     } myall;
 } // namespace NamespaceTests
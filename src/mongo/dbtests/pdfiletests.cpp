@@ -22,6 +22,8 @@
 
 #include "../db/db.h"
 #include "../db/json.h"
+#include "../db/pagefault.h"
+#include "../util/processinfo.h"
 
 #include "dbtests.h"
 
@@ -303,6 +305,103 @@ namespace PdfileTests {
                 ASSERT( 0 != o.getField( "a" ).date() );
             }
         };
+
+        class BatchBase : public Base {
+        protected:
+            /** the collection with { _id : 0 , a : 0 } and an index on a */
+            void create() {
+                BSONObj o = BSON( "_id" << 0 << "a" << 0 );
+                theDataFileMgr.insertWithObjMod( ns(), o );
+                BSONObj idx = BSON( "ns" << ns() << "key" << BSON( "a" << 1 ) << "name" << "a_1" );
+                theDataFileMgr.insertWithObjMod( "unittests.system.indexes", idx );
+                ASSERT_EQUALS( 2, nsd()->nIndexes );
+            }
+            static bool indexed( int idxNo, const BSONObj& key ) {
+                IndexDetails& idx = nsd()->idx( idxNo );
+                return !idx.idxInterface().findSingle( idx, idx.head, key ).isNull();
+            }
+            static int scanned() {
+                int n = 0;
+                for ( boost::shared_ptr<Cursor> i = theDataFileMgr.findAll( ns() ); i->ok(); i->advance() )
+                    ++n;
+                return n;
+            }
+        };
+
+        class Batch : public BatchBase {
+        public:
+            void run() {
+                create();
+                vector<BSONObj> objs;
+                for ( int i = 1; i <= 10; i++ ) {
+                    if ( i % 2 )
+                        objs.push_back( BSON( "a" << 20 - i ) );
+                    else
+                        objs.push_back( BSON( "_id" << i << "a" << 20 - i ) );
+                }
+                ASSERT( theDataFileMgr.insertBatch( ns(), objs, 0, objs.size() ) );
+                ASSERT_EQUALS( 11, nsd()->stats.nrecords );
+                ASSERT_EQUALS( 11, scanned() );
+
+                // in natural order after the first, with _ids added where missing
+                boost::shared_ptr<Cursor> c = theDataFileMgr.findAll( ns() );
+                c->advance();
+                for ( int i = 0; i < 10; i++, c->advance() ) {
+                    ASSERT( c->ok() );
+                    ASSERT_EQUALS( objs[i], c->current() );
+                    ASSERT( !objs[i]["_id"].eoo() );
+                    ASSERT( indexed( 0, BSON( "" << objs[i]["_id"] ) ) );
+                    ASSERT( indexed( 1, BSON( "" << 20 - ( i + 1 ) ) ) );
+                }
+            }
+        };
+
+        class BatchUndone : public BatchBase {
+        public:
+            void run() {
+                create();
+                vector<BSONObj> objs;
+                objs.push_back( BSON( "_id" << 1 << "a" << 1 ) );
+                objs.push_back( BSON( "_id" << 2 << "a" << 2 ) );
+                objs.push_back( BSON( "_id" << 0 << "a" << 3 ) ); // a duplicate
+                objs.push_back( BSON( "_id" << 4 << "a" << 4 ) );
+                ASSERT( !theDataFileMgr.insertBatch( ns(), objs, 0, objs.size() ) );
+                ASSERT_EQUALS( 1, nsd()->stats.nrecords );
+                ASSERT_EQUALS( 1, scanned() );
+                for ( int i = 1; i <= 4; i++ ) {
+                    ASSERT( !indexed( 0, BSON( "" << i ) ) );
+                    ASSERT( !indexed( 1, BSON( "" << i ) ) );
+                }
+                ASSERT( indexed( 1, BSON( "" << 0 ) ) );
+            }
+        };
+
+        class Prefetch : public Base {
+        public:
+            void run() {
+                BSONObj o = BSON( "_id" << 0 << "a" << 0 );
+                theDataFileMgr.insertWithObjMod( ns(), o );
+                DiskLoc loc = theDataFileMgr.findAll( ns() )->currLoc();
+                Record *r = loc.rec();
+                const char *p = (const char *) r;
+                MongoDataFile *f = cc().database()->getFile( loc.a() );
+
+                // read ahead stays within the record's data file
+                const char *limit = r->prefetchLimit();
+                ASSERT( limit > p );
+                ASSERT( limit <= p + Record::PrefetchBytes );
+                ASSERT( f->viewEnd( p ) );
+                ASSERT( limit <= f->viewEnd( p ) );
+
+                long long before = recordStats.prefetchedBytes;
+                r->prefetch( limit );
+                ASSERT_EQUALS( before + ( limit - p ), (long long) recordStats.prefetchedBytes );
+
+                char in = 0;
+                if ( ProcessInfo::pagesInMemory( r, 1, &in ) )
+                    ASSERT( in );
+            }
+        };
     } // namespace Insert
 
     class ExtentSizing {
@@ -398,6 +497,9 @@ namespace PdfileTests {
             add< ScanCapped::FirstInExtent >();
             add< ScanCapped::LastInExtent >();
             add< Insert::UpdateDate >();
+            add< Insert::Batch >();
+            add< Insert::BatchUndone >();
+            add< Insert::Prefetch >();
             add< ExtentSizing >();
             add< ExtentAllocOrder >();
         }
@@ -26,6 +26,7 @@
 #include "mongo/db/queryoptimizer.h"
 #include "mongo/dbtests/framework.h"
 #include "mongo/util/file_allocator.h"
+#include "mongo/util/timer.h"
 #include "mongo/unittest/unittest.h"
 
 namespace mongo {
@@ -721,6 +722,40 @@ namespace Plan {
     } all;
 } // namespace Plan
 
+namespace IndexBuild {
+    /** a build of a two field index on a collection of N records */
+    template< int N, bool Background >
+    class Build {
+    public:
+        Build() : ns_( testNs( this ) ) {
+            srand( 5 );
+            for( int i = 0; i < N; ++i )
+                client_->insert( ns_.c_str(), BSON( "_id" << i << "a" << rand() << "b" << ( i % 1000 ) ) );
+        }
+        void run() {
+            mongo::Timer t;
+            client_->ensureIndex( ns_, BSON( "a" << 1 << "b" << 1 ), false, "", true, Background );
+            long long micros = t.micros() + 1;
+            cout << ( Background ? "background " : "" ) << "index build " << N << " keys: "
+                 << ( N * 1000000LL / micros ) << " keys/sec" << endl;
+        }
+        string ns_;
+    };
+
+    class All : public RunnerSuite {
+    public:
+        All() : RunnerSuite( "indexbuild" ) {}
+        void setupTests() {
+            add< Build<10*1000, false> >();
+            add< Build<100*1000, false> >();
+            add< Build<1000*1000, false> >();
+            add< Build<10*1000, true> >();
+            add< Build<100*1000, true> >();
+            add< Build<1000*1000, true> >();
+        }
+    } all;
+} // namespace IndexBuild
+
 namespace Misc {
     class TimeMicros64 {
     public:
@@ -38,7 +38,18 @@
 #include "../db/key.h"
 #include "../util/compress.h"
 #include "../util/concurrency/qlock.h"
+#include "../db/repl/rs.h"
+#include "../db/interrupt_status_mongod.h"
+#include "../db/pipeline/document_source.h"
+#include "../db/pipeline/expression_context.h"
+#include "../util/net/message_port.h"
+#include "../util/net/message_server.h"
+#include "../util/processinfo.h"
+#include "../s/chunk_routing.h"
 #include <boost/filesystem/operations.hpp>
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
 
 using namespace bson;
 
@@ -46,6 +57,7 @@ namespace mongo {
     namespace dbtests {
         extern unsigned perfHist;
     }
+    extern bool useBatchInserts;
 }
 
 namespace PerfTests {
@@ -206,6 +218,9 @@ namespace PerfTests {
         /* override if your test output doesn't need that */
         virtual bool showDurStats() { return true; }
 
+        /* override if one timed() call does more than one operation; rps is then per operation */
+        virtual unsigned opsPerTimed() { return 1; }
+
     public:
         virtual unsigned batchSize() { return 50; }
 
@@ -330,7 +345,7 @@ namespace PerfTests {
             client().getLastError(); // block until all ops are finished
             int ms = t.millis();
 
-            say(n, ms, name());
+            say(n * opsPerTimed(), ms, name());
 
             post();
 
@@ -458,6 +473,86 @@ namespace PerfTests {
         }
     };
 
+    /** $group throughput: docs/sec through a BSON array source and a $group with a few accumulators */
+    class GroupDocs : public NonDurTest {
+    public:
+        enum { N = 10000 };
+        string name() { return "GroupDocs"; }
+        virtual unsigned opsPerTimed() { return N; }
+        GroupDocs() {
+            BSONArrayBuilder docs;
+            for( int i = 0; i < N; i++ ) {
+                docs.append( BSON( "_id" << i << "k" << i % 100 << "x" << i << "y" << i * 0.5 <<
+                                   "s" << "a string a string" ) );
+            }
+            input = BSON( "docs" << docs.arr() );
+            group = BSON( "$group" << BSON( "_id" << "$k" << "n" << BSON( "$sum" << 1 ) <<
+                                            "x" << BSON( "$sum" << "$x" ) <<
+                                            "y" << BSON( "$avg" << "$y" ) <<
+                                            "m" << BSON( "$max" << "$x" ) ) );
+        }
+        void timed() {
+            intrusive_ptr<ExpressionContext> pCtx(
+                ExpressionContext::create(&InterruptStatusMongod::status));
+            BSONElement docs = input["docs"];
+            intrusive_ptr<DocumentSource> pSource(DocumentSourceBsonArray::create(&docs, pCtx));
+            BSONElement spec = group["$group"];
+            intrusive_ptr<DocumentSource> pGroup(DocumentSourceGroup::createFromBson(&spec, pCtx));
+            pGroup->setSource(pSource.get());
+            unsigned n = 0;
+            for( bool more = !pGroup->eof(); more; more = pGroup->advance() ) {
+                pGroup->getCurrent();
+                n++;
+            }
+            verify( n == 100 );
+        }
+    private:
+        BSONObj input, group;
+    };
+
+    /**
+     * mongos routing a shard key to one of N chunks: a binary search of the chunks' encoded max
+     * bounds, as ChunkManager::findChunk does, or upper_bound on the old chunk map
+     */
+    template< int N, bool Indexed >
+    class ChunkRouting : public NonDurTest {
+    public:
+        enum { Keys = 1024 };
+        string name() { return str::stream() << "ChunkRouting-" << N << ( Indexed ? "-index" : "-map" ); }
+        virtual int howLongMillis() { return 2000; }
+        void prep() {
+            for( int i = 1; i <= N; i++ ) {
+                BSONObj bound = BSON( "_id" << i * 10 );
+                if( Indexed )
+                    verify( index.push_back( bound ) );
+                else
+                    chunks[ bound ] = i - 1;
+            }
+            if( Indexed )
+                verify( index.push_back( BSON( "_id" << MAXKEY ) ) );
+            else
+                chunks[ BSON( "_id" << MAXKEY ) ] = N;
+            for( int i = 0; i < Keys; i++ )
+                keys.push_back( BSON( "_id" << (double) ( rand() % ( N * 10 ) ) ) );
+            k = 0;
+        }
+        void timed() {
+            const BSONObj& key = keys[ k++ % Keys ];
+            int chunk = Indexed ? index.upperBound( key ) : chunks.upper_bound( key )->second;
+            verify( chunk * 10 <= key["_id"].number() );
+        }
+        void post() {
+            index.clear();
+            chunks.clear();
+            keys.clear();
+        }
+    private:
+        ShardKeyIndex index;
+        map<BSONObj,int,BSONObjCmp> chunks;
+        vector<BSONObj> keys;
+        unsigned k;
+    };
+
     class KeyTest : public B {
     public:
         KeyV1Owned a,b,c;
@@ -1070,6 +1165,174 @@ namespace PerfTests {
         }
     };
 
+    /** multi-document inserts of Batch documents each, through DataFileMgr::insertBatch() or, not
+        Batched, a document at a time.  rps is documents/sec.
+    */
+    template< bool Batched >
+    class InsertMulti : public B {
+        enum { Batch = 1000 };
+        long long _nextId;
+        bool _was;
+    public:
+        InsertMulti() : _nextId(0), _was(true) { }
+        virtual string name() { return str::stream() << "insert-multi-" << ( Batched ? "batched" : "one-at-a-time" ); }
+        virtual unsigned batchSize() { return 1; }
+        virtual unsigned opsPerTimed() { return Batch; }
+        void prep() {
+            _was = useBatchInserts;
+            useBatchInserts = Batched;
+            client().insert( ns(), BSONObj() );
+            client().ensureIndex( ns(), BSON( "x" << 1 ) );
+        }
+        void timed() {
+            vector<BSONObj> docs;
+            for( int i = 0; i < Batch; i++ )
+                docs.push_back( BSON( "_id" << _nextId++ << "x" << rand() << "y" << rand() << "z" << 33 ) );
+            client().insert( ns(), docs );
+        }
+        void post() {
+            useBatchInserts = _was;
+            verify( client().count( ns() ) == (unsigned long long) _nextId + 1 );
+        }
+    };
+
+    /** a secondary applying batches of replicated inserts and updates spread over a few 
+        databases, as replset::SyncTail::multiApply does for syncTail.  rps is ops applied/sec.
+    */
+    template< int NWriters >
+    class ReplApplyBatch : public B {
+        enum { NDBs = 4, OpsPerBatch = 1000 };
+        unsigned long long _nextId;
+        ThreadPool *_writers;
+        string dbns(unsigned long long id) const { 
+            return str::stream() << "perftest_repl" << ( id % NDBs ) << ".c";
+        }
+    public:
+        ReplApplyBatch() : _nextId(0), _writers(0) { }
+        virtual string name() { return str::stream() << "repl-apply-batch-" << NWriters << "-writers"; }
+        virtual unsigned batchSize() { return 1; }
+        virtual unsigned opsPerTimed() { return OpsPerBatch; }
+        void prep() {
+            for( int i = 0; i < NDBs; i++ )
+                client().dropDatabase( str::stream() << "perftest_repl" << i );
+            // never freed: the writers keep their Clients for the life of the process
+            _writers = new ThreadPool(NWriters);
+        }
+        void timed() {
+            // half new documents, half $inc's of documents inserted by earlier batches
+            vector<BSONObj> ops;
+            for( int i = 0; i < OpsPerBatch; i++ ) {
+                if( i % 2 == 0 || _nextId < OpsPerBatch ) {
+                    unsigned long long id = _nextId++;
+                    ops.push_back( BSON( "op" << "i" << "ns" << dbns(id) << 
+                                         "o" << BSON( "_id" << (long long) id << "x" << 0 ) ) );
+                }
+                else {
+                    unsigned long long id = rand() % _nextId;
+                    ops.push_back( BSON( "op" << "u" << "ns" << dbns(id) << 
+                                         "o2" << BSON( "_id" << (long long) id ) << 
+                                         "o" << BSON( "$inc" << BSON( "x" << 1 ) ) ) );
+                }
+            }
+            replset::SyncTail tail("");
+            tail.multiApply(ops, *_writers);
+        }
+        void post() {
+            for( int i = 0; i < NDBs; i++ )
+                client().dropDatabase( str::stream() << "perftest_repl" << i );
+        }
+    };
+
+    /** replies to each message with the message itself */
+    class EchoHandler : public MessageHandler {
+    public:
+        virtual void connected( AbstractMessagingPort* p ) { }
+        virtual void process( Message& m , AbstractMessagingPort* p , LastError * le ) {
+            p->reply( m, m, m.header()->id );
+        }
+        virtual void disconnected( AbstractMessagingPort* p ) { }
+    } echoHandler;
+
+    /** round trips on one connection to an in process echo server which also has as many idle
+        connections as the fd limit allows.  NWorkers 0 is a thread per connection, otherwise 
+        it is the event driven server with that many worker threads.  compare rps, and the 
+        resident memory reported, across the two.
+    */
+    template< int NWorkers >
+    class IdleConnections : public B {
+        enum { NIdle = 20000 };
+        int _port;
+        MessagingPort *_busy;
+        vector<MessagingPort*> _idle;
+    public:
+        IdleConnections() : _port( 27400 + NWorkers ), _busy(0) { }
+        virtual string name() { 
+            return str::stream() << "idle-conns-" << ( NWorkers ? "event-" : "thread-per-conn" ) << 
+                ( NWorkers ? BSONObjBuilder::numStr(NWorkers) : "" );
+        }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        virtual unsigned batchSize() { return 1; }
+        void prep() {
+            MessageServer::Options opts;
+            opts.port = _port;
+            opts.ipList = "127.0.0.1";
+            opts.workerThreads = NWorkers;
+            // never freed: there is no way to stop a listener, it serves for the life of the process
+            MessageServer *server = createServer( opts, &echoHandler );
+            boost::thread thr( boost::bind( &MessageServer::run, server ) );
+
+            SockAddr sa( "127.0.0.1", _port );
+            _busy = new MessagingPort();
+            for( int i = 0; ! _busy->connect( sa ); i++ ) {
+                verify( i < 100 );
+                sleepmillis(10);
+            }
+
+            // both ends of each connection are in this process, so we need two fds for each
+#ifndef _WIN32
+            const rlim_t needFds = 2 * NIdle + 200;
+            struct rlimit limits;
+            verify( getrlimit( RLIMIT_NOFILE, &limits ) == 0 );
+            if( limits.rlim_cur < needFds ) {
+                limits.rlim_cur = needFds;
+                if( limits.rlim_max != RLIM_INFINITY && limits.rlim_max < needFds )
+                    limits.rlim_max = needFds; // only root may raise the hard limit
+                uassert( 16414, str::stream() << name() << " needs " << needFds << 
+                         " open files, raise the limit (ulimit -n): " << errnoWithDescription(),
+                         setrlimit( RLIMIT_NOFILE, &limits ) == 0 );
+            }
+#endif
+            if( connTicketHolder.available() < NIdle + 10 )
+                connTicketHolder.resize( connTicketHolder.used() + NIdle + 10 );
+            for( int i = 0; i < NIdle; i++ ) {
+                MessagingPort *p = new MessagingPort();
+                if( ! p->connect( sa ) ) {
+                    delete p;
+                    uasserted( 16415, str::stream() << name() << " made only " << i << " of " << 
+                               NIdle << " idle connections" );
+                }
+                _idle.push_back( p );
+            }
+            sleepmillis(500); // let the server accept them
+            cout << name() << ' ' << _idle.size() << " idle connections, resident " << 
+                ProcessInfo().getResidentSize() << "MB" << endl;
+        }
+        void timed() {
+            Message toSend;
+            toSend.setData( dbMsg, "ping" );
+            Message response;
+            verify( _busy->call( toSend, response ) );
+        }
+        void post() {
+            for( unsigned i = 0; i < _idle.size(); i++ )
+                delete _idle[i];
+            _idle.clear();
+            delete _busy;
+            _busy = 0;
+        }
+    };
+
     void t() {
         for( int i = 0; i < 20; i++ ) {
             sleepmillis(21);
@@ -1149,6 +1412,13 @@ namespace PerfTests {
                 add< BSONIter >();
                 add< BSONGetFields1 >();
                 add< BSONGetFields2 >();
+                add< GroupDocs >();
+                add< ChunkRouting<10000, true> >();
+                add< ChunkRouting<10000, false> >();
+                add< ChunkRouting<100000, true> >();
+                add< ChunkRouting<100000, false> >();
+                add< ChunkRouting<1000000, true> >();
+                add< ChunkRouting<1000000, false> >();
                 //add< TaskQueueTest >();
                 add< InsertDup >();
                 add< Insert1 >();
@@ -1157,6 +1427,16 @@ namespace PerfTests {
                 add< Update1 >();
                 add< MoreIndexes<Update1> >();
                 add< InsertBig >();
+                add< InsertMulti<false> >();
+                add< InsertMulti<true> >();
+                add< MoreIndexes< InsertMulti<false> > >();
+                add< MoreIndexes< InsertMulti<true> > >();
+                add< ReplApplyBatch<1> >();
+                add< ReplApplyBatch<8> >();
+                add< IdleConnections<0> >();
+#ifdef __linux__
+                add< IdleConnections<8> >();
+#endif
             }
         }
     } myall;
@@ -1337,6 +1337,39 @@ namespace QueryTests {
         }
     };
 
+    /** Many open cursors, spread over the registry partitions, are each found and killed by id. */
+    class ManyOpenCursors : public CollectionBase {
+    public:
+        ManyOpenCursors() : CollectionBase( "manyopencursors" ) {
+        }
+        void run() {
+            unsigned startNumCursors = ClientCursor::numCursors();
+            client().insert( ns(), vector<BSONObj>( 3, BSONObj() ) );
+            vector<long long> ids;
+            for( int i = 0; i < 200; ++i ) {
+                auto_ptr<DBClientCursor> cursor = client().query( ns(), BSONObj(), 0, 0, 0, 0, 2 );
+                ASSERT( cursor->more() );
+                ids.push_back( cursor->getCursorId() );
+                cursor->decouple();
+            }
+            ASSERT_EQUALS( startNumCursors + 200, ClientCursor::numCursors() );
+
+            {
+                Client::ReadContext ctx( ns() );
+                for( unsigned i = 0; i < ids.size(); ++i ) {
+                    ClientCursor::Pointer p( ids[ i ] );
+                    ASSERT( p.c() );
+                    ASSERT_EQUALS( ids[ i ], p.c()->cursorid() );
+                }
+            }
+
+            for( unsigned i = 0; i < ids.size(); ++i ) {
+                client().killCursor( ids[ i ] );
+            }
+            ASSERT_EQUALS( startNumCursors, ClientCursor::numCursors() );
+        }
+    };
+
     namespace parsedtests {
         class basic1 {
         public:
@@ -1612,6 +1645,7 @@ namespace QueryTests {
             add< QueryCursorTimeout >();
             add< QueryReadsAll >();
             add< KillPinnedCursor >();
+            add< ManyOpenCursors >();
 
             add< parsedtests::basic1 >();
 
@@ -19,6 +19,10 @@
 
 #include "pch.h"
 #include "../util/net/sock.h"
+#include "../util/net/message_port.h"
+#include "../util/net/message_server.h"
+#include "../util/concurrency/synchronization.h"
+#include "../util/timer.h"
 #include "dbtests.h"
 
 namespace SockTests {
@@ -36,11 +40,177 @@ namespace SockTests {
         }
     };
 
+#ifndef _WIN32
+    /** two MessagingPorts connected by a socketpair */
+    class PortPair {
+    public:
+        PortPair() {
+            int fds[2];
+            ASSERT_EQUALS( 0, socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) );
+            a.reset( new MessagingPort( fds[0], SockAddr() ) );
+            b.reset( new MessagingPort( fds[1], SockAddr() ) );
+        }
+        scoped_ptr<MessagingPort> a;
+        scoped_ptr<MessagingPort> b;
+    };
+
+    class RecvBufferReuse {
+    public:
+        void run() {
+            PortPair p;
+            RecvBufferPool& pool = p.b->recvBufferPool();
+            MsgData *x = pool.get( 100 );
+            RecvBufferPool::release( x );
+            // the same size class hands the same buffer back
+            MsgData *y = pool.get( 1000 );
+            ASSERT( x == y );
+            MsgData *big = pool.get( 4 * 1024 * 1024 );
+            ASSERT( big != y );
+            RecvBufferPool::release( big );
+            RecvBufferPool::release( y );
+
+            // what was read stays good after its port is gone
+            Message m;
+            m.setData( dbMsg, "hello" );
+            p.a->say( m );
+            Message r;
+            ASSERT( p.b->recv( r ) );
+            p.b.reset();
+            ASSERT_EQUALS( string( "hello" ), r.singleData()->_data );
+            r.reset();
+        }
+    };
+
+    class PiggyBack {
+    public:
+        void run() {
+            PortPair p;
+            Message held;
+            held.setData( dbMsg, "held" );
+            p.a->piggyBack( held );
+            ASSERT( held.empty() );
+            Message said;
+            said.setData( dbMsg, "said" );
+            p.a->say( said );
+
+            Message r;
+            ASSERT( p.b->recv( r ) );
+            ASSERT_EQUALS( string( "held" ), r.singleData()->_data );
+            r.reset();
+            ASSERT( p.b->recv( r ) );
+            ASSERT_EQUALS( string( "said" ), r.singleData()->_data );
+            ASSERT_EQUALS( said.header()->id, r.header()->id );
+        }
+    };
+
+    /** messages sent as a header and a results buffer, the way replyToQuery() does, and read
+        into pooled buffers.  prints the time per message.
+    */
+    class RoundTripTiming {
+    public:
+        void run() {
+            PortPair p;
+            BufBuilder results;
+            for ( int i = 0; i < 100; i++ ) {
+                BSONObj o = BSON( "_id" << i << "x" << "some string or other" );
+                results.appendBuf( o.objdata(), o.objsize() );
+            }
+
+            const int N = 20000;
+            mongo::Timer t;
+            for ( int i = 0; i < N; i++ ) {
+                char header[MsgDataHeaderSize];
+                ((MsgData *) header)->setOperation( dbMsg );
+                Message m;
+                m.appendUnownedData( header, MsgDataHeaderSize );
+                m.appendUnownedData( results.buf(), results.len() );
+                p.a->say( m );
+
+                Message r;
+                ASSERT( p.b->recv( r ) );
+                ASSERT_EQUALS( MsgDataHeaderSize + results.len(), r.size() );
+            }
+            log() << "RoundTripTiming " << N << " messages of " << MsgDataHeaderSize + results.len()
+                  << " bytes, " << t.micros() / N << "us each" << endl;
+        }
+    };
+#endif
+
+#ifdef __linux__
+    /** replies to "wait" only after a "release" comes in, on any connection */
+    class ReleaseHandler : public MessageHandler {
+    public:
+        virtual void connected( AbstractMessagingPort* p ) { }
+        virtual void process( Message& m , AbstractMessagingPort* p , LastError * le ) {
+            if ( string( "wait" ) == m.singleData()->_data ) {
+                waiting.notifyOne();
+                released.waitToBeNotified();
+            }
+            else {
+                released.notifyOne();
+            }
+            p->reply( m, m, m.header()->id );
+        }
+        virtual void disconnected( AbstractMessagingPort* p ) { }
+        Notification waiting;
+        Notification released;
+    };
+
+    /** a request that blocks its worker until a request queued behind it runs, as reads under
+        fsyncLock wait for the fsyncUnlock.  with one worker thread both finish only if the
+        event driven server grows its pool.
+    */
+    class BlockedWorkers {
+    public:
+        void run() {
+            MessageServer::Options opts;
+            opts.port = 27390;
+            opts.ipList = "127.0.0.1";
+            opts.workerThreads = 1;
+            // never freed: there is no way to stop a listener, it serves for the life of the process
+            ReleaseHandler *handler = new ReleaseHandler();
+            MessageServer *server = createServer( opts, handler );
+            boost::thread thr( boost::bind( &MessageServer::run, server ) );
+
+            SockAddr sa( "127.0.0.1", opts.port );
+            MessagingPort waiter;
+            for ( int i = 0; ! waiter.connect( sa ); i++ ) {
+                ASSERT( i < 100 );
+                sleepmillis( 10 );
+            }
+            MessagingPort releaser;
+            ASSERT( releaser.connect( sa ) );
+
+            Message wait;
+            wait.setData( dbMsg, "wait" );
+            waiter.say( wait );
+            handler->waiting.waitToBeNotified(); // the only worker is now blocked
+
+            Message release;
+            release.setData( dbMsg, "release" );
+            Message response;
+            ASSERT( releaser.call( release, response ) );
+            ASSERT_EQUALS( string( "release" ), response.singleData()->_data );
+            response.reset();
+            ASSERT( waiter.recv( wait, response ) );
+            ASSERT_EQUALS( string( "wait" ), response.singleData()->_data );
+        }
+    };
+#endif
+
     class All : public Suite {
     public:
         All() : Suite( "sock" ) {}
         void setupTests() {
             add< HostByName >();
+#ifndef _WIN32
+            add< RecvBufferReuse >();
+            add< PiggyBack >();
+            add< RoundTripTiming >();
+#endif
+#ifdef __linux__
+            add< BlockedWorkers >();
+#endif
         }
     } myall;
 
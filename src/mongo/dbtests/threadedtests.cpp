@@ -31,6 +31,8 @@
 #include "../util/concurrency/qlock.h"
 #include "dbtests.h"
 #include "mongo/util/concurrency/ticketholder.h"
+#include "mongo/util/concurrency/thread_slabs.h"
+#include "mongo/db/stats/top.h"
 
 namespace mongo { 
     void testNonGreedy();
@@ -282,6 +284,70 @@ namespace ThreadedTests {
         }
     };
 
+    /** each thread counts in its own slab, and nothing counted is lost when threads exit */
+    class ThreadSlabsCount : public ThreadedTest<10> {
+        static const int iterations = 100000;
+        struct Counts { 
+            Counts() : n(0) { }
+            unsigned long long n;
+        };
+        ThreadSlabs<Counts> counts;
+
+        void subthread(int) {
+            Counts& mine = counts.get();
+            for( int i = 0; i < iterations; i++ )
+                counts.get().n++;
+            ASSERT_EQUALS( (unsigned long long) iterations , mine.n );
+        }
+        void validate() {
+            vector<Counts*> all;
+            counts.all( all );
+            ASSERT( all.size() <= (unsigned) nthreads );
+            unsigned long long total = 0;
+            for( unsigned i = 0; i < all.size(); i++ )
+                total += all[i]->n;
+            ASSERT_EQUALS( (unsigned long long) nthreads * iterations , total );
+        }
+    };
+
+    /** Top adds up what each thread recorded, and forgets a dropped collection */
+    class TopRecord : public ThreadedTest<8> {
+        static const int iterations = 1000;
+        Top top;
+
+        void subthread(int x) {
+            Top::NsCache a;
+            for( int i = 0; i < iterations; i++ ) {
+                top.intern( a , "toptest.a" , false );
+                top.record( a , dbInsert , 1 , 2 , false );
+                top.record( x % 2 ? "toptest.b" : "toptest.c" , dbQuery , -1 , 1 , false );
+            }
+        }
+        void validate() {
+            Top::UsageMap usage;
+            top.cloneMap( usage );
+            ASSERT_EQUALS( 3U , usage.size() );
+            ASSERT_EQUALS( (long long) nthreads * iterations , usage["toptest.a"].insert.count );
+            ASSERT_EQUALS( (long long) nthreads * iterations * 2 , usage["toptest.a"].writeLock.time );
+            ASSERT_EQUALS( (long long) nthreads / 2 * iterations , usage["toptest.b"].queries.count );
+            ASSERT_EQUALS( (long long) nthreads / 2 * iterations , usage["toptest.c"].readLock.count );
+            ASSERT_EQUALS( (long long) nthreads * iterations * 2 , top.getGlobalData().total.count );
+
+            Top::NsCache a;
+            top.intern( a , "toptest.a" , false );
+            top.collectionDropped( "toptest.a" );
+            ASSERT( ! a.valid() );
+            top.record( a , dbInsert , 1 , 1 , false );
+            // the drop command itself isn't recorded against the dropped collection
+            top.record( "toptest.a" , dbQuery , -1 , 1 , true );
+            top.record( "toptest.d" , dbUpdate , 1 , 1 , false );
+            top.cloneMap( usage );
+            ASSERT_EQUALS( 3U , usage.size() );
+            ASSERT( usage.count( "toptest.a" ) == 0 );
+            ASSERT_EQUALS( 1 , usage["toptest.d"].update.count );
+        }
+    };
+
     class MVarTest : public ThreadedTest<> {
         static const int iterations = 10000;
         MVar<int> target;
@@ -854,6 +920,96 @@ namespace ThreadedTests {
         }
     };
 
+    /** writers of two collections of a database hold their locks at the same time, a DBWrite of
+        the database waits for both.  thread 1 holds its lock until thread 3 is about to wait. */
+    class CollectionWriteLocks : public ThreadedTest<3> {
+    public:
+        CollectionWriteLocks() : aHeld(false), bGot(false) { }
+    private:
+        bool aHeld;
+        bool bGot;
+        Notification aLocked, bDone, dbWaiting;
+        virtual void validate() { 
+            ASSERT( bGot );
+        }
+        virtual void subthread(int x) {
+            Client::initThread("ctest");
+            if( x == 1 ) { 
+                Lock::CollectionWrite lk("coltest.a");
+                aHeld = true;
+                ASSERT( Lock::isCollectionWriteLocked() );
+                ASSERT( Lock::isWriteLocked("coltest.a") );
+                ASSERT( Lock::isWriteLocked("coltest.a.$x_1") );
+                ASSERT( !Lock::isWriteLocked("coltest.b") );
+                aLocked.notifyOne();
+                dbWaiting.waitToBeNotified();
+                aHeld = false;
+            }
+            if( x == 2 ) {
+                aLocked.waitToBeNotified();
+                {
+                    Lock::CollectionWrite lk("coltest.b");
+                    ASSERT( aHeld );
+                    bGot = true;
+                }
+                bDone.notifyOne();
+            }
+            if( x == 3 ) {
+                bDone.waitToBeNotified();
+                dbWaiting.notifyOne();
+                Lock::DBWrite lk("coltest");
+                ASSERT( !aHeld );
+                ASSERT( !Lock::isCollectionWriteLocked() );
+                ASSERT( Lock::isWriteLocked("coltest.a") );
+            }
+            cc().shutdown();
+        }
+    };
+
+    /** writers to two databases append to the oplog at the same time, a reader of local waits for
+        both.  thread 1 holds its locks until thread 3 is about to wait. */
+    class OplogAppendLocks : public ThreadedTest<3> {
+    public:
+        OplogAppendLocks() : aHeld(false), bGot(false) { }
+    private:
+        bool aHeld;
+        bool bGot;
+        Notification aLocked, bDone, readerWaiting;
+        virtual void validate() { 
+            ASSERT( bGot );
+        }
+        virtual void subthread(int x) {
+            Client::initThread("otest");
+            if( x == 1 ) { 
+                Lock::DBWrite lk("appendtesta");
+                Lock::OplogAppend append;
+                aHeld = true;
+                ASSERT( Lock::isWriteLocked("local.oplog.rs") );
+                ASSERT( Lock::isWriteLocked("appendtesta.foo") );
+                aLocked.notifyOne();
+                readerWaiting.waitToBeNotified();
+                aHeld = false;
+            }
+            if( x == 2 ) {
+                aLocked.waitToBeNotified();
+                {
+                    Lock::DBWrite lk("appendtestb");
+                    Lock::OplogAppend append;
+                    ASSERT( aHeld );
+                    bGot = true;
+                }
+                bDone.notifyOne();
+            }
+            if( x == 3 ) {
+                bDone.waitToBeNotified();
+                readerWaiting.notifyOne();
+                Lock::DBRead lk("local");
+                ASSERT( !aHeld );
+            }
+            cc().shutdown();
+        }
+    };
+
     // Tests waiting on the TicketHolder by running many more threads than can fit into the "hotel", but only
     // max _nRooms threads should ever get in at once
     class TicketHolderWaits : public ThreadedTest<10> {
@@ -950,6 +1106,8 @@ namespace ThreadedTests {
             add< List1Test2 >();
 
             add< IsAtomicUIntAtomic >();
+            add< ThreadSlabsCount >();
+            add< TopRecord >();
             add< MVarTest >();
             add< ThreadPoolTest >();
             add< LockTest >();
@@ -962,6 +1120,8 @@ namespace ThreadedTests {
 
             add< MongoMutexTest >();
             add< TicketHolderWaits >();
+            add< CollectionWriteLocks >();
+            add< OplogAppendLocks >();
         }
     } myall;
 }
@@ -79,6 +79,11 @@ namespace mongo {
         : _manager(info), _min(min), _max(max), _shard(shard), _lastmod(0), _jumbo(false), _dataWritten(mkDataWritten())
     {}
 
+    Chunk::Chunk(const ChunkManager * info , const Chunk& other)
+        : _manager(info), _min(other._min), _max(other._max), _shard(other._shard), _lastmod(other._lastmod),
+          _jumbo(other._jumbo), _dataWritten(other._dataWritten)
+    {}
+
     long Chunk::mkDataWritten() {
         return rand() % ( MaxChunkSize / 5 );
     }
@@ -560,7 +565,7 @@ namespace mongo {
 
     AtomicUInt ChunkManager::NextSequenceNumber = 1;
 
-    ChunkManager::ChunkManager( string ns , ShardKeyPattern pattern , bool unique ) :
+    ChunkManager::ChunkManager( string ns , ShardKeyPattern pattern , bool unique , ChunkManagerPtr oldManager ) :
         _ns( ns ) , _key( pattern ) , _unique( unique ) , _chunkRanges(), _mutex("ChunkManager"),
         _nsLock( ConnectionString( configServer.modelServer() , ConnectionString::SYNC ) , ns ),
 
@@ -578,10 +583,15 @@ namespace mongo {
             set<Shard> shards;
             ShardVersionMap shardVersions;
             Timer t;
-            _load(chunkMap, shards, shardVersions);
+            // if the changes since the old manager don't add up to a valid config, read it all
+            bool incremental = oldManager && tries == 2 &&
+                               _loadChanges(*oldManager, chunkMap, shards, shardVersions);
+            if ( ! incremental )
+                _load(chunkMap, shards, shardVersions);
             {
                 int ms = t.millis();
                 log() << "ChunkManager: time to load chunks for " << ns << ": " << ms << "ms" 
+                      << ( incremental ? " (changes only)" : "" )
                       << " sequenceNumber: " << _sequenceNumber 
                       << " version: " << _version.toString() 
                       << endl;
@@ -595,6 +605,7 @@ namespace mongo {
                 const_cast<set<Shard>&>(_shards).swap(shards);
                 const_cast<ShardVersionMap&>(_shardVersions).swap(shardVersions);
                 const_cast<ChunkRangeManager&>(_chunkRanges).reloadAll(_chunkMap);
+                _buildRoutingIndex();
                 return;
             }
             
@@ -646,6 +657,90 @@ namespace mongo {
         conn.done();
     }
 
+    bool ChunkManager::_loadChanges(const ChunkManager& old, ChunkMap& chunkMap, set<Shard>& shards, ShardVersionMap& shardVersions) {
+        if ( old._chunkMap.empty() || old._key.key().woCompare( _key.key() ) != 0 || old._unique != _unique )
+            return false;
+
+        for ( ChunkMap::const_iterator i = old._chunkMap.begin(); i != old._chunkMap.end(); ++i ) {
+            ChunkPtr c( new Chunk( this , *i->second ) );
+            chunkMap.insert( chunkMap.end() , make_pair( c->getMax() , c ) );
+        }
+
+        ScopedDbConnection conn( configServer.modelServer() );
+
+        BSONObjBuilder query;
+        query.append( "ns" , _ns );
+        {
+            BSONObjBuilder since( query.subobjStart( "lastmod" ) );
+            since.appendTimestamp( "$gt" , old.getVersion().toLong() );
+            since.done();
+        }
+
+        // oldest first, so a chunk split more than once ends up with its latest bounds
+        auto_ptr<DBClientCursor> cursor = conn->query( Chunk::chunkMetadataNS, Query( query.obj() ).sort( "lastmod" , 1 ) );
+        verify( cursor.get() );
+        int changed = 0;
+        while ( cursor->more() ) {
+            BSONObj d = cursor->next();
+            if ( d["isMaxMarker"].trueValue() ) {
+                continue;
+            }
+
+            ChunkPtr c( new Chunk( this, d ) );
+
+            // replace whatever the changed chunk now covers
+            ChunkMap::iterator i = chunkMap.upper_bound( c->getMin() );
+            while ( i != chunkMap.end() && i->second->getMin().woCompare( c->getMax() ) < 0 )
+                chunkMap.erase( i++ );
+            chunkMap[c->getMax()] = c;
+            changed++;
+        }
+
+        // we only reload when something changed, so nothing newer means the versions went
+        // backwards, as when the collection is dropped and sharded again.  a count that doesn't
+        // match catches that when the new versions have already passed the old ones.
+        unsigned long long total = conn->count( Chunk::chunkMetadataNS , BSON( "ns" << _ns ) );
+        conn.done();
+
+        if ( changed == 0 || total != chunkMap.size() ) {
+            LOG(1) << "ChunkManager: " << changed << " changed chunks for " << _ns << " since " << old.getVersion().toString()
+                   << " don't add up to " << total << " chunks, reloading all" << endl;
+            chunkMap.clear();
+            return false;
+        }
+
+        for ( ChunkMap::const_iterator i = chunkMap.begin(); i != chunkMap.end(); ++i ) {
+            ChunkPtr c = i->second;
+            shards.insert(c->getShard());
+
+            if ( c->getLastmod() > _version )
+                _version = c->getLastmod();
+
+            ShardChunkVersion& shardMax = shardVersions[c->getShard()];
+            if ( c->getLastmod() > shardMax )
+                shardMax = c->getLastmod();
+        }
+        return true;
+    }
+
+    void ChunkManager::_buildRoutingIndex() {
+        ShardKeyIndex& index = const_cast<ShardKeyIndex&>(_routingIndex);
+        vector<ChunkPtr>& chunks = const_cast<vector<ChunkPtr>&>(_routingChunks);
+        index.clear();
+        chunks.clear();
+        chunks.reserve( _chunkMap.size() );
+
+        for ( ChunkMap::const_iterator i = _chunkMap.begin(); i != _chunkMap.end(); ++i ) {
+            if ( ! index.push_back( i->first ) ) {
+                LOG(1) << "ChunkManager: routing " << _ns << " through the chunk map, can't index " << i->first << endl;
+                index.clear();
+                chunks.clear();
+                return;
+            }
+            chunks.push_back( i->second );
+        }
+    }
+
     bool ChunkManager::_isValid(const ChunkMap& chunkMap) {
 #define ENSURE(x) do { if(!(x)) { log() << "ChunkManager::_isValid failed: " #x << endl; return false; } } while(0)
 
@@ -774,6 +869,16 @@ namespace mongo {
     ChunkPtr ChunkManager::findChunk( const BSONObj & obj ) const {
         BSONObj key = _key.extractKey(obj);
 
+        if ( ! _routingIndex.empty() ) {
+            int i = _routingIndex.upperBound( key );
+            if ( i >= 0 && i < (int) _routingChunks.size() ) {
+                // the chunks are contiguous, so the first to end past key holds it
+                dassert( _routingChunks[i]->contains( key ) );
+                return _routingChunks[i];
+            }
+            // a key that can't be encoded goes through the map
+        }
+
         {
             BSONObj foo;
             ChunkPtr c;
@@ -23,6 +23,7 @@
 #include "../bson/util/atomic_int.h"
 #include "../client/distlock.h"
 
+#include "chunk_routing.h"
 #include "shardkey.h"
 #include "shard.h"
 #include "util.h"
@@ -55,6 +56,8 @@ namespace mongo {
     public:
         Chunk( const ChunkManager * info , BSONObj from);
         Chunk( const ChunkManager * info , const BSONObj& min, const BSONObj& max, const Shard& shard);
+        /** a copy of other that belongs to info, for carrying unchanged chunks over on a reload */
+        Chunk( const ChunkManager * info , const Chunk& other );
 
         //
         // serialization support
@@ -298,7 +301,11 @@ namespace mongo {
     public:
         typedef map<Shard,ShardChunkVersion> ShardVersionMap;
 
-        ChunkManager( string ns , ShardKeyPattern pattern , bool unique );
+        /**
+         * @param oldManager if given, only the chunks changed since its version are read from
+         *        the config server and the rest are carried over from it
+         */
+        ChunkManager( string ns , ShardKeyPattern pattern , bool unique , ChunkManagerPtr oldManager = ChunkManagerPtr() );
 
         string getns() const { return _ns; }
 
@@ -359,7 +366,9 @@ namespace mongo {
 
         // helpers for constructor
         void _load(ChunkMap& chunks, set<Shard>& shards, ShardVersionMap& shardVersions);
+        bool _loadChanges(const ChunkManager& old, ChunkMap& chunks, set<Shard>& shards, ShardVersionMap& shardVersions);
         static bool _isValid(const ChunkMap& chunks);
+        void _buildRoutingIndex();
 
         // All members should be const for thread-safety
         const string _ns;
@@ -369,6 +378,10 @@ namespace mongo {
         const ChunkMap _chunkMap;
         const ChunkRangeManager _chunkRanges;
 
+        // _chunkMap's max bounds and chunks in order, for findChunk.  empty if a bound can't be encoded.
+        const ShardKeyIndex _routingIndex;
+        const vector<ChunkPtr> _routingChunks;
+
         const set<Shard> _shards;
 
         const ShardVersionMap _shardVersions; // max version per shard
@@ -0,0 +1,165 @@
+// chunk_routing.cpp
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+
+#include "mongo/s/chunk_routing.h"
+
+namespace mongo {
+
+    static void appendBigEndian( StackBufBuilder& b , unsigned long long x ) {
+        for ( int shift = 56; shift >= 0; shift -= 8 )
+            b.appendUChar( (unsigned char) ( x >> shift ) );
+    }
+
+    /**
+     * numbers compare as doubles unless both are ints or both are longs, which compare exactly,
+     * so a long is only encodable if it is exactly a double.  NaN is less than every other number
+     * and equal to itself; -0 equals 0.
+     */
+    static bool appendNumber( StackBufBuilder& b , const BSONElement& e ) {
+        double d;
+        if ( e.type() == NumberLong ) {
+            const long long Exact = 1LL << 53;
+            long long x = e._numberLong();
+            if ( x < -Exact || x > Exact )
+                return false;
+            d = (double) x;
+        }
+        else {
+            d = e.number();
+        }
+
+        if ( isNaN( d ) ) {
+            appendBigEndian( b , 0 );
+            return true;
+        }
+        if ( d == 0 )
+            d = 0; // no -0
+
+        unsigned long long bits;
+        memcpy( &bits , &d , sizeof( bits ) );
+        // flip negatives entirely and set the sign bit of positives so the bits sort unsigned
+        if ( bits >> 63 )
+            bits = ~bits;
+        else
+            bits |= 1ULL << 63;
+        appendBigEndian( b , bits );
+        return true;
+    }
+
+    /**
+     * strings compare as memcmp() of their bytes, shorter first when one is a prefix of the
+     * other.  escaping each 0 byte as 0 0xff and ending with 0 0 keeps that order when
+     * something follows the string in the key.
+     */
+    static void appendString( StackBufBuilder& b , const BSONElement& e ) {
+        const char* s = e.valuestr();
+        const char* end = s + e.valuestrsize() - 1;
+        for ( ; s < end; ++s ) {
+            b.appendChar( *s );
+            if ( *s == 0 )
+                b.appendUChar( 0xff );
+        }
+        b.appendChar( 0 );
+        b.appendChar( 0 );
+    }
+
+    bool ShardKeyIndex::encode( const BSONObj& key , StackBufBuilder& b ) {
+        BSONObjIterator i( key );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+            // elements of different canonical types compare by that alone
+            b.appendUChar( (unsigned char) ( e.canonicalType() + 1 ) );
+
+            switch ( e.type() ) {
+            case MinKey:
+            case MaxKey:
+            case jstNULL:
+            case Undefined:
+                break;
+            case NumberDouble:
+            case NumberInt:
+            case NumberLong:
+                if ( ! appendNumber( b , e ) )
+                    return false;
+                break;
+            case String:
+            case Symbol:
+                appendString( b , e );
+                break;
+            case jstOID:
+                b.appendBuf( e.value() , sizeof( OID ) );
+                break;
+            case Bool:
+                b.appendUChar( *e.value() );
+                break;
+            case Date:
+                appendBigEndian( b , (unsigned long long) e.date().millis ^ ( 1ULL << 63 ) );
+                break;
+            default:
+                // Timestamp shares Date's canonical type but compares differently, and objects,
+                // arrays and the rest aren't worth routing by bytes
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ShardKeyIndex::push_back( const BSONObj& bound ) {
+        StackBufBuilder b;
+        if ( ! encode( bound , b ) )
+            return false;
+        dassert( empty() || _upperBound( b.buf() , b.len() ) == size() );
+        _keys.append( b.buf() , b.len() );
+        _offsets.push_back( _keys.size() );
+        return true;
+    }
+
+    int ShardKeyIndex::upperBound( const BSONObj& key ) const {
+        StackBufBuilder b;
+        if ( ! encode( key , b ) )
+            return -1;
+        return _upperBound( b.buf() , b.len() );
+    }
+
+    int ShardKeyIndex::_upperBound( const char* key , int len ) const {
+        const char* keys = _keys.data();
+        int lo = 0;
+        int hi = size();
+        while ( lo < hi ) {
+            int mid = lo + ( hi - lo ) / 2;
+            int midLen = _offsets[mid + 1] - _offsets[mid];
+            int c = memcmp( keys + _offsets[mid] , key , min( midLen , len ) );
+            if ( c == 0 )
+                c = midLen - len;
+            if ( c > 0 )
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        return lo;
+    }
+
+    void ShardKeyIndex::clear() {
+        _keys.clear();
+        _offsets.clear();
+        _offsets.push_back( 0 );
+    }
+
+} // namespace mongo
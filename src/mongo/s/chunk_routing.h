@@ -0,0 +1,73 @@
+// chunk_routing.h
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * A sorted, immutable array of shard key bounds, each encoded so that memcmp() of two
+     * encodings orders them the way BSONObj::woCompare() orders the keys.  ChunkManager keeps one
+     * of its chunks' max bounds so routing a key is a binary search over flat memory instead of
+     * O(log n) woCompare calls down a map.
+     *
+     * Only the types shard keys are commonly made of can be encoded: numbers, strings, symbols,
+     * ObjectIds, bools, dates, null, undefined, MinKey and MaxKey.  A key with anything else
+     * doesn't encode and the caller has to fall back to its map.
+     */
+    class ShardKeyIndex {
+    public:
+        ShardKeyIndex() { _offsets.push_back( 0 ); }
+
+        /**
+         * appends key's encoding to b
+         * @return false if key has a value that can't be encoded; b is then partly written
+         */
+        static bool encode( const BSONObj& key , StackBufBuilder& b );
+
+        /**
+         * add a bound, which must be greater than all those added before
+         * @return false if bound can't be encoded, leaving the index as it was
+         */
+        bool push_back( const BSONObj& bound );
+
+        /**
+         * @return the position of the first bound greater than key, which is size() if there is
+         *         none, or -1 if key can't be encoded
+         */
+        int upperBound( const BSONObj& key ) const;
+
+        int size() const { return _offsets.size() - 1; }
+        bool empty() const { return size() == 0; }
+        void clear();
+
+        /** bytes used by the encoded bounds and their offsets */
+        size_t dataSize() const { return _keys.size() + _offsets.size() * sizeof( unsigned ); }
+
+    private:
+        int _upperBound( const char* key , int len ) const;
+
+        /** all the encoded bounds, back to back */
+        string _keys;
+        /** where each bound starts in _keys, plus the end of the last one */
+        vector<unsigned> _offsets;
+    };
+
+} // namespace mongo
@@ -84,6 +84,14 @@ namespace mongo {
         return info;
     }
 
+    ClientInfo * ClientInfo::detach() {
+        return _tlInfo.release();
+    }
+
+    void ClientInfo::attach( ClientInfo * info ) {
+        _tlInfo.reset( info );
+    }
+
     ClientBasic* ClientBasic::getCurrent() {
         return ClientInfo::get();
     }
@@ -87,6 +87,9 @@ namespace mongo {
         void noAutoSplit() { _autoSplitOk = false; }
 
         static ClientInfo * get();
+        /** take this thread's info off it (it may be null) so it can be attach()ed elsewhere */
+        static ClientInfo * detach();
+        static void attach( ClientInfo * info );
         const AuthenticationInfo* getAuthenticationInfo() const { return (AuthenticationInfo*)&_ai; }
         AuthenticationInfo* getAuthenticationInfo() { return (AuthenticationInfo*)&_ai; }
         bool isAdmin() { return _ai.isAuthorized( "admin" ); }
@@ -39,6 +39,7 @@
 #include "../db/dbmessage.h"
 #include "../db/commands.h"
 #include "../db/stats/counters.h"
+#include "../db/stats/latency.h"
 
 #include "config.h"
 #include "chunk.h"
@@ -164,6 +165,12 @@ namespace mongo {
 
                 result.append( "shardCursorType" , shardedCursorTypes.getObj() );
 
+                {
+                    BSONObjBuilder bb( result.subobjStart( "opLatencies" ) );
+                    opLatencies.append( bb , cmdObj["opLatencies"].numberInt() > 1 );
+                    bb.done();
+                }
+
                 {
                     BSONObjBuilder asserts( result.subobjStart( "asserts" ) );
                     asserts.append( "regular" , assertionCount.regular );
@@ -340,7 +340,16 @@ namespace mongo {
                 
             }
             
-            temp.reset( new ChunkManager( ns , key , unique ) );
+            // unless forced, start from the chunks we have and read only what changed
+            ChunkManagerPtr oldManager;
+            if ( ! forceReload ) {
+                scoped_lock lk( _lock );
+                CollectionInfo& ci = _collections[ns];
+                if ( ci.isSharded() )
+                    oldManager = ci.getCM();
+            }
+
+            temp.reset( new ChunkManager( ns , key , unique , oldManager ) );
             if ( temp->numChunks() == 0 ) {
                 // maybe we're not sharded any more
                 reload(); // this is a full reload
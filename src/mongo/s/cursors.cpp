@@ -136,6 +136,8 @@ namespace mongo {
         _totalSent += docCount;
         _done = ! hasMore;
 
+        cursorCache.noteShardWaits( _cursor );
+
         return hasMore;
     }
 
@@ -283,6 +285,25 @@ namespace mongo {
         result.appendNumber( "shardedEver" , _shardedTotal );
         result.append( "refs" , (int)_refs.size() );
         result.append( "totalOpen" , (int)(_cursors.size() + _refs.size() ) );
+
+        BSONObjBuilder waits( result.subobjStart( "shardWaits" ) );
+        for ( ShardWaitStatsMap::const_iterator i = _shardWaits.begin(); i != _shardWaits.end(); ++i ) {
+            BSONObjBuilder b( waits.subobjStart( i->first ) );
+            i->second.append( b );
+            b.done();
+        }
+        waits.done();
+    }
+
+    void CursorCache::noteShardWaits( ClusteredCursor* cursor ) {
+        ShardWaitStatsMap waits;
+        cursor->takeShardWaitStats( waits );
+        if ( waits.empty() )
+            return;
+
+        scoped_lock lk( _mutex );
+        for ( ShardWaitStatsMap::const_iterator i = waits.begin(); i != waits.end(); ++i )
+            _shardWaits[i->first].add( i->second );
     }
 
     void CursorCache::doTimeouts() {
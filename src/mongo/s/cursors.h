@@ -109,6 +109,9 @@ namespace mongo {
 
         void appendInfo( BSONObjBuilder& result ) const ;
 
+        /** adds cursor's shard wait stats since the last call to the totals in appendInfo() */
+        void noteShardWaits( ClusteredCursor* cursor );
+
         long long genId();
 
         void doTimeouts();
@@ -121,6 +124,8 @@ namespace mongo {
 
         long long _shardedTotal;
 
+        ShardWaitStatsMap _shardWaits;
+
         static const int _myLogLevel;
     };
 
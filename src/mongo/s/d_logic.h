@@ -179,6 +179,9 @@ namespace mongo {
 
         static ShardedConnectionInfo* get( bool create );
         static void reset();
+        /** take this thread's info off it (it may be null) so it can be attach()ed elsewhere */
+        static ShardedConnectionInfo* detach();
+        static void attach( ShardedConnectionInfo* info );
         static void addHook();
 
         bool inForceVersionOkMode() const {
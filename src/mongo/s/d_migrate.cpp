@@ -41,6 +41,7 @@
 #include "mongo/client/dbclientcursor.h"
 
 #include "../util/queue.h"
+#include "../util/concurrency/thread_pool.h"
 #include "../util/startup_test.h"
 #include "../util/processinfo.h"
 #include "../util/ramlog.h"
@@ -84,7 +85,11 @@ namespace mongo {
             }
         }
 
-        void done( int step ) {
+        /**
+         * @param docs, bytes how much the step moved, for steps that move data; the changelog
+         *        then has "step<n>Throughput" with the rate as well as the time
+         */
+        void done( int step , long long docs = -1 , long long bytes = 0 ) {
             verify( step == ++_next );
             verify( step <= _total );
 
@@ -98,9 +103,20 @@ namespace mongo {
             else
                 warning() << "op is null in MoveTimingHelper::done" << migrateLog;
 
-            _b.appendNumber( s , _t.millis() );
+            int ms = _t.millis();
+            _b.appendNumber( s , ms );
             _t.reset();
 
+            if ( docs >= 0 ) {
+                double secs = std::max( ms , 1 ) / 1000.0;
+                BSONObjBuilder bb( _b.subobjStart( s + "Throughput" ) );
+                bb.appendNumber( "docs" , docs );
+                bb.appendNumber( "bytes" , bytes );
+                bb.append( "docsPerSec" , docs / secs );
+                bb.append( "MBPerSec" , bytes / secs / ( 1024 * 1024 ) );
+                bb.done();
+            }
+
 #if 0
             // debugging for memory leak?
             ProcessInfo pi;
@@ -219,10 +235,14 @@ namespace mongo {
     class MigrateFromStatus {
     public:
 
-        MigrateFromStatus() : _m("MigrateFromStatus") , _workLock("MigrateFromStatus::workLock") {
+        MigrateFromStatus() : _m("MigrateFromStatus") , _cloneMutex("MigrateFromStatus::cloneMutex") ,
+                              _workLock("MigrateFromStatus::workLock") {
             _active = false;
             _inCriticalSection = false;
             _memoryUsed = 0;
+            _haveNextBatch = false;
+            _clonedDocs = 0;
+            _clonedBytes = 0;
         }
 
         void start( string ns , const BSONObj& min , const BSONObj& max ) {
@@ -244,10 +264,25 @@ namespace mongo {
             verify( _reload.size() == 0 );
             verify( _memoryUsed == 0 );
 
+            _clonedDocs = 0;
+            _clonedBytes = 0;
+            if ( ! _prefetcher )
+                _prefetcher.reset( new ThreadPool( 1 ) );
+
             _active = true;
         }
 
         void done() {
+            {
+                // before locking: a batch being prefetched needs a read lock to finish
+                scoped_lock cl( _cloneMutex );
+                if ( _prefetcher )
+                    _prefetcher->join();
+                _nextBatch = BSONObj();
+                _haveNextBatch = false;
+                _prefetchError.clear();
+            }
+
             Lock::DBRead lk( _ns );
 
             {
@@ -467,12 +502,67 @@ namespace mongo {
             return true;
         }
 
+        /**
+         * called from the dest of a migrate, until it gets an empty batch
+         * returns the batch built while the dest was inserting the last one, and starts building
+         * the next, so that reading and serializing here overlaps inserting there
+         */
         bool clone( string& errmsg , BSONObjBuilder& result ) {
             if ( ! _getActive() ) {
                 errmsg = "not active";
                 return false;
             }
 
+            // we need the lock in case there is a malicious _migrateClone for example
+            scoped_lock cl( _cloneMutex );
+
+            _prefetcher->join();
+            if ( ! _prefetchError.empty() ) {
+                errmsg = _prefetchError;
+                _prefetchError.clear();
+                return false;
+            }
+
+            BSONObj batch;
+            if ( _haveNextBatch ) {
+                batch = _nextBatch;
+                _nextBatch = BSONObj();
+                _haveNextBatch = false;
+            }
+            else {
+                batch = _buildBatch();
+            }
+
+            bool more;
+            {
+                scoped_spinlock lk( _trackerLocks );
+                more = ! _cloneLocs.empty();
+            }
+            if ( more )
+                _prefetcher->schedule( _prefetchBatch , this );
+
+            result.appendArray( "objects" , batch );
+            return true;
+        }
+
+        long long clonedDocs() const { return _clonedDocs; }
+        long long clonedBytes() const { return _clonedBytes; }
+
+    private:
+        static void _prefetchBatch( MigrateFromStatus* s ) {
+            Client::initThreadIfNotAlready( "migratePrefetch" );
+            try {
+                s->_nextBatch = s->_buildBatch();
+                s->_haveNextBatch = true;
+            }
+            catch ( std::exception& e ) {
+                s->_prefetchError = str::stream() << "_migrateClone prefetch failed: " << e.what();
+                warning() << s->_prefetchError << migrateLog;
+            }
+        }
+
+        /** next batch of _cloneLocs, in disk order, up to the max user object size */
+        BSONObj _buildBatch() {
             ElapsedTracker tracker (128, 10); // same as ClientCursor::_yieldSometimesTracker
 
             int allocSize;
@@ -518,6 +608,8 @@ namespace mongo {
                         }
                         
                         a.append( o );
+                        _clonedDocs++;
+                        _clonedBytes += o.objsize();
                     }
                     
                     _cloneLocs.erase( _cloneLocs.begin() , i );
@@ -536,10 +628,10 @@ namespace mongo {
                 
             }
 
-            result.appendArray( "objects" , a.arr() );
-            return true;
+            return a.arr();
         }
 
+    public:
         void aboutToDelete( const Database* db , const DiskLoc& dl ) {
             verify(db);
             Lock::assertWriteLocked(db->name);
@@ -603,6 +695,16 @@ namespace mongo {
         list<BSONObj> _deleted; // objects deleted during clone that should be deleted later
         long long _memoryUsed; // bytes in _reload + _deleted
 
+        // _migrateClone batches are built ahead on _prefetcher; _cloneMutex keeps clone() and
+        // done() to one at a time, and they join _prefetcher before touching the batch
+        mongo::mutex _cloneMutex;
+        scoped_ptr<ThreadPool> _prefetcher;
+        BSONObj _nextBatch;
+        bool _haveNextBatch;
+        string _prefetchError;
+        long long _clonedDocs;  // sent to the dest, for the changelog
+        long long _clonedBytes;
+
         mutable mongo::mutex _workLock; // this is used to make sure only 1 thread is doing serious work
                                         // for now, this means migrate or removing old chunk data
 
@@ -998,7 +1100,7 @@ namespace mongo {
 
                 killCurrentOp.checkForInterrupt();
             }
-            timing.done(4);
+            timing.done( 4 , migrateFromStatus.clonedDocs() , migrateFromStatus.clonedBytes() );
 
             // 5.
             {
@@ -1275,6 +1377,49 @@ namespace mongo {
        commend to "commit"
     */
 
+    struct MigrateWriterErrors {
+        MigrateWriterErrors() : m("migrateWriterErrors") { }
+        SimpleMutex m;
+        ExceptionInfo first;
+        /** the latest op any writer logged, so we can wait for the clone to replicate */
+        OpTime lastOp;
+    };
+
+    /** threads inserting the documents of a migrate's initial clone */
+    static ThreadPool& migrateWriterPool() {
+        static ThreadPool *p = new ThreadPool( cmdLine.migrateWriterThreads );
+        return *p;
+    }
+
+    /** on a migrateWriterPool() thread, inserts part of a _migrateClone batch */
+    static void insertCloned( const string* ns , const vector<BSONObj>* objs , MigrateWriterErrors* errs ) {
+        Client::initThreadIfNotAlready( "migrateWriter" );
+        try {
+            // don't relock for every document, but let others in now and then
+            Timer timeInWriteLock;
+            scoped_ptr<Lock::DBWrite> lk;
+            for ( vector<BSONObj>::const_iterator i = objs->begin(); i != objs->end(); ++i ) {
+                if ( ! lk || timeInWriteLock.micros() > 1000 ) {
+                    lk.reset();
+                    lk.reset( new Lock::DBWrite( *ns ) );
+                    timeInWriteLock.reset();
+                }
+                Helpers::upsert( *ns , *i , true );
+                getDur().commitIfNeeded();
+            }
+        }
+        catch ( DBException& e ) {
+            SimpleMutex::scoped_lock lk( errs->m );
+            if ( errs->first.empty() )
+                errs->first = ExceptionInfo( e.toString() , e.getCode() );
+        }
+        // our Client's, not the migrate thread's
+        OpTime last = cc().getLastOp();
+        SimpleMutex::scoped_lock lk( errs->m );
+        if ( errs->lastOp < last )
+            errs->lastOp = last;
+    }
+
     class MigrateStatus {
     public:
         
@@ -1290,6 +1435,7 @@ namespace mongo {
             numCloned = 0;
             clonedBytes = 0;
             numCatchup = 0;
+            catchupBytes = 0;
             numSteady = 0;
 
             active = true;
@@ -1356,46 +1502,110 @@ namespace mongo {
                 timing.done(2);
             }
 
+            ReplTime lastOpApplied = 0;
 
             {
                 // 3. initial bulk clone
+                // the writers insert one batch while we fetch the next, which the donor built
+                // while we were inserting the one before
                 state = CLONE;
 
-                while ( true ) {
-                    BSONObj res;
-                    if ( ! conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res ) ) {  // gets array of objects to copy, in disk order
-                        state = FAIL;
-                        errmsg = "_migrateClone failed: ";
-                        errmsg += res.toString();
-                        error() << errmsg << migrateLog;
-                        conn.done();
-                        return;
-                    }
+                ThreadPool& writers = migrateWriterPool();
+                vector< vector<BSONObj> > parts( writers.nThreads() );
+                OpTime clonedLastOp;
 
+                BSONObj res;
+                bool ok = conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res );  // gets array of objects to copy, in disk order
+                while ( ok ) {
                     BSONObj arr = res["objects"].Obj();
                     int thisTime = 0;
+                    long long bytesThisTime = 0;
 
+                    // contiguous pieces, to keep each writer in disk order
+                    int n = arr.nFields();
                     BSONObjIterator i( arr );
                     while( i.more() ) {
                         BSONObj o = i.next().Obj();
-                        {
-                            Lock::DBWrite lk( ns );
-                            Helpers::upsert( ns, o, true );
-                        }
+                        parts[ (long long)thisTime * parts.size() / n ].push_back( o );
                         thisTime++;
-                        numCloned++;
-                        clonedBytes += o.objsize();
+                        bytesThisTime += o.objsize();
                     }
 
                     if ( thisTime == 0 )
                         break;
+
+                    MigrateWriterErrors errs;
+                    for ( unsigned j = 0; j < parts.size(); j++ ) {
+                        if ( ! parts[j].empty() )
+                            writers.schedule( insertCloned , &ns , &parts[j] , &errs );
+                    }
+
+                    BSONObj next;
+                    try {
+                        ok = conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , next );
+                    }
+                    catch ( ... ) {
+                        writers.join(); // they are using parts and res
+                        throw;
+                    }
+                    writers.join();
+
+                    for ( unsigned j = 0; j < parts.size(); j++ )
+                        parts[j].clear();
+                    if ( clonedLastOp < errs.lastOp )
+                        clonedLastOp = errs.lastOp;
+                    if ( ! errs.first.empty() )
+                        uasserted( errs.first.code , errs.first.msg );
+
+                    numCloned += thisTime;
+                    clonedBytes += bytesThisTime;
+                    res = next;
                 }
 
-                timing.done(3);
-            }
+                if ( ! ok ) {
+                    state = FAIL;
+                    errmsg = "_migrateClone failed: ";
+                    errmsg += res.toString();
+                    error() << errmsg << migrateLog;
+                    conn.done();
+                    return;
+                }
 
-            // if running on a replicated system, we'll need to flush the docs we cloned to the secondaries
-            ReplTime lastOpApplied = cc().getLastOp().asDate();
+                timing.done( 3 , numCloned , clonedBytes );
+
+                // if running on a replicated system, we'll need to flush the docs we cloned to
+                // the secondaries.  the writers logged them on their own Clients.
+                OpTime last = cc().getLastOp();
+                if ( last < clonedLastOp )
+                    last = clonedLastOp;
+                lastOpApplied = last.asDate();
+
+                const int maxIterations = 3600*50;
+                int i;
+                for ( i = 0; i < maxIterations; i++ ) {
+                    if ( state == ABORT ) {
+                        timing.note( "aborted" );
+                        return;
+                    }
+
+                    if ( opReplicatedEnough( lastOpApplied ) )
+                        break;
+
+                    if ( i > 100 ) {
+                        warning() << "secondaries having hard time keeping up with migrate" << migrateLog;
+                    }
+
+                    sleepmillis( 20 );
+                }
+
+                if ( i == maxIterations ) {
+                    errmsg = "secondary can't keep up with migrate";
+                    error() << errmsg << migrateLog;
+                    conn.done();
+                    state = FAIL;
+                    return;
+                }
+            }
 
             {
                 // 4. do bulk of mods
@@ -1413,6 +1623,7 @@ namespace mongo {
                     if ( res["size"].number() == 0 )
                         break;
 
+                    catchupBytes += res["size"].numberLong();
                     apply( res , &lastOpApplied );
                     
                     const int maxIterations = 3600*50;
@@ -1442,7 +1653,7 @@ namespace mongo {
                     } 
                 }
 
-                timing.done(4);
+                timing.done( 4 , numCatchup , catchupBytes );
             }
 
             { 
@@ -1514,6 +1725,7 @@ namespace mongo {
                 bb.append( "cloned" , numCloned );
                 bb.append( "clonedBytes" , clonedBytes );
                 bb.append( "catchup" , numCatchup );
+                bb.append( "catchupBytes" , catchupBytes );
                 bb.append( "steady" , numSteady );
                 bb.done();
             }
@@ -1528,6 +1740,7 @@ namespace mongo {
             }
 
             bool didAnything = false;
+            long long& numApplied = ( state == CATCHUP ) ? numCatchup : numSteady;
 
             if ( xfer["deleted"].isABSONObj() ) {
                 RemoveSaver rs( "moveChunk" , ns , "removedDuring" );
@@ -1552,6 +1765,7 @@ namespace mongo {
 
                     *lastOpApplied = cx.ctx().getClient()->getLastOp().asDate();
                     didAnything = true;
+                    numApplied++;
                 }
             }
 
@@ -1566,6 +1780,7 @@ namespace mongo {
 
                     *lastOpApplied = cx.ctx().getClient()->getLastOp().asDate();
                     didAnything = true;
+                    numApplied++;
                 }
             }
 
@@ -1655,6 +1870,7 @@ namespace mongo {
         long long numCloned;
         long long clonedBytes;
         long long numCatchup;
+        long long catchupBytes;
         long long numSteady;
         
         int slaveCount;
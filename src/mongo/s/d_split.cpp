@@ -240,7 +240,8 @@ namespace mongo {
     class SplitVector : public Command {
     public:
         SplitVector() : Command( "splitVector" , false ) {}
-        virtual bool slaveOk() const { return false; }
+        // read only, and initial sync splits big collections with it whatever it syncs from
+        virtual bool slaveOk() const { return true; }
         virtual LockType locktype() const { return NONE; }
         virtual void help( stringstream &help ) const {
             help <<
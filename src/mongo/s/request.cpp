@@ -22,6 +22,7 @@
 #include "../db/commands.h"
 #include "../db/dbmessage.h"
 #include "../db/stats/counters.h"
+#include "../db/stats/latency.h"
 
 #include "../client/connpool.h"
 
@@ -123,6 +124,8 @@ namespace mongo {
 
         _d.markSet();
 
+        Timer t;
+
         bool iscmd = false;
         if ( op == dbQuery ) {
             iscmd = isCommand();
@@ -139,6 +142,7 @@ namespace mongo {
 
         globalOpCounters.gotOp( op , iscmd );
         _counter->gotOp( op , iscmd );
+        opLatencies.record( getns() , op , iscmd , t.micros() );
     }
 
     bool Request::isCommand() const {
@@ -43,6 +43,7 @@
 #include "mongo/util/util.h"
 #include "mongo/util/concurrency/remap_lock.h"
 #include "mongo/db/lasterror.h"
+#include "mongo/db/nonce.h"
 
 #if defined(_WIN32)
 # include "../util/ntservice.h"
@@ -139,6 +140,39 @@ namespace mongo {
         virtual void disconnected( AbstractMessagingPort* p ) {
             // all things are thread local
         }
+
+        /** a connection's ClientInfo, nonce and shard connections, while it is off a worker thread */
+        class ConnectionState : public ThreadState {
+        public:
+            ConnectionState() : info(0), nonce(0), shards(0) { }
+            virtual ~ConnectionState() {
+                delete info;
+                delete nonce;
+                ShardConnection::releaseConnections( shards );
+            }
+            ClientInfo *info;
+            nonce64 *nonce;
+            ClientConnections *shards;
+        };
+
+        virtual ThreadState* newThreadState() { return new ConnectionState(); }
+
+        virtual void attach( ThreadState* s ) {
+            ConnectionState *cs = static_cast<ConnectionState*>( s );
+            ClientInfo::attach( cs->info );
+            lastNonce.reset( cs->nonce );
+            ShardConnection::attachConnections( cs->shards );
+            cs->info = 0;
+            cs->nonce = 0;
+            cs->shards = 0;
+        }
+
+        virtual void detach( ThreadState* s ) {
+            ConnectionState *cs = static_cast<ConnectionState*>( s );
+            cs->info = ClientInfo::detach();
+            cs->nonce = lastNonce.release();
+            cs->shards = ShardConnection::detachConnections();
+        }
     };
 
     void sighandler(int sig) {
@@ -277,6 +311,7 @@ static bool runMongosServer( bool doUpgrade ) {
     MessageServer::Options opts;
     opts.port = cmdLine.port;
     opts.ipList = cmdLine.bind_ip;
+    opts.workerThreads = cmdLine.netWorkerThreads;
     start(opts);
 
     // listen() will return when exit code closes its socket.
@@ -315,6 +350,9 @@ int _main(int argc, char* argv[]) {
     ( "ipv6", "enable IPv6 support (disabled by default)" )
     ( "jsonp","allow JSONP access via http (has security implications)" )
     ( "noscripting", "disable scripting engine" )
+    ( "connPoolMaxConnsPerHost" , po::value<int>() , "most connections open to each shard at once, 0 for no limit" )
+    ( "connPoolMinConnsPerHost" , po::value<int>() , "connections to keep open to each shard ahead of need" )
+    ( "connPoolMaxWaitMS" , po::value<int>() , "how long to wait for a shard connection at the limit" )
     ;
 
     visible_options.add(general_options);
@@ -358,6 +396,33 @@ int _main(int argc, char* argv[]) {
         enableIPv6();
     }
 
+    if ( params.count( "connPoolMaxConnsPerHost" ) ) {
+        int x = params["connPoolMaxConnsPerHost"].as<int>();
+        if ( x < 0 ) {
+            out() << "error: connPoolMaxConnsPerHost can't be negative" << endl;
+            return 11;
+        }
+        PoolForHost::setMaxOpenPerHost( x );
+    }
+
+    if ( params.count( "connPoolMinConnsPerHost" ) ) {
+        int x = params["connPoolMinConnsPerHost"].as<int>();
+        if ( x < 0 ) {
+            out() << "error: connPoolMinConnsPerHost can't be negative" << endl;
+            return 11;
+        }
+        PoolForHost::setMinOpenPerHost( x );
+    }
+
+    if ( params.count( "connPoolMaxWaitMS" ) ) {
+        int x = params["connPoolMaxWaitMS"].as<int>();
+        if ( x < 0 ) {
+            out() << "error: connPoolMaxWaitMS can't be negative" << endl;
+            return 11;
+        }
+        PoolForHost::setMaxWaitMillis( x );
+    }
+
     if ( params.count( "jsonp" ) ) {
         cmdLine.jsonp = true;
     }
@@ -213,6 +213,7 @@ namespace mongo {
 
     class ChunkManager;
     typedef shared_ptr<const ChunkManager> ChunkManagerPtr;
+    class ClientConnections;
 
     class ShardConnection : public AScopedConnection {
     public:
@@ -262,6 +263,14 @@ namespace mongo {
 
         static void sync();
 
+        /** take this thread's shard connections, with their versions and auth, off it so they
+            can be attachConnections()ed to the thread serving the client's next request.  then
+            a getLastError goes to the connections its writes went on. */
+        static ClientConnections* detachConnections();
+        static void attachConnections( ClientConnections* conns );
+        /** for detached connections that won't be attached again */
+        static void releaseConnections( ClientConnections* conns );
+
         void donotCheckVersion() {
             _setVersion = false;
             _finishedInit = true;
@@ -28,7 +28,8 @@ namespace mongo {
 
     /**
      * holds all the actual db connections for a client to various servers
-     * 1 per thread, so doesn't have to be thread safe
+     * 1 per thread, so doesn't have to be thread safe.  a client served by worker threads moves
+     * it from thread to thread with ShardConnection::detachConnections/attachConnections.
      */
     class ClientConnections : boost::noncopyable {
     public:
@@ -77,7 +78,7 @@ namespace mongo {
                     shardConnectionPool.onHandedOut( c );
                 }
                 catch ( std::exception& ) {
-                    delete c;
+                    shardConnectionPool.destroy( addr , c );
                     throw;
                 }
                 return c;
@@ -210,7 +211,7 @@ namespace mongo {
     void ShardConnection::kill() {
         if ( _conn ) {
             if( versionManager.isVersionableCB( _conn ) ) versionManager.resetShardVersionCB( _conn );
-            delete _conn;
+            shardConnectionPool.destroy( _addr , _conn );
             _conn = 0;
             _finishedInit = true;
         }
@@ -220,6 +221,18 @@ namespace mongo {
         ClientConnections::threadInstance()->sync();
     }
 
+    ClientConnections* ShardConnection::detachConnections() {
+        return ClientConnections::_perThread.release();
+    }
+
+    void ShardConnection::attachConnections( ClientConnections* conns ) {
+        ClientConnections::_perThread.reset( conns );
+    }
+
+    void ShardConnection::releaseConnections( ClientConnections* conns ) {
+        delete conns;
+    }
+
     bool ShardConnection::runCommand( const string& db , const BSONObj& cmd , BSONObj& res ) {
         verify( _conn );
         bool ok = _conn->runCommand( db , cmd , res );
@@ -18,7 +18,11 @@
 
 #include "../pch.h"
 #include "../db/db.h"
+#include "mongo/client/dbclient_rs.h"
 #include "mongo/client/dbclientcursor.h"
+#include "mongo/db/namespacestring.h"
+#include "mongo/util/compress.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "tool.h"
 
 #include <fcntl.h>
@@ -41,14 +45,65 @@ class Dump : public Tool {
     private:
         FILE* _f;
     };
+    /**
+     * A collection's .bson file.  Any number of Writers add whole blocks of documents to it, so
+     * the documents of a collection dumped by several cursors interleave; restore doesn't mind.
+     */
+    class OutputFile : boost::noncopyable {
+    public:
+        OutputFile( FILE* f , bool compress ) : _f( f ) , _compress( compress ) , _m( "dumpOutputFile" ) {
+            if ( _compress )
+                write( CompressedBSONFile::Magic , sizeof( CompressedBSONFile::Magic ) );
+        }
+
+        void writeBlock( const char* data , int len ) {
+            if ( ! _compress ) {
+                scoped_lock lk( _m );
+                write( data , len );
+                return;
+            }
+
+            // compress before taking the lock, so the writers compress in parallel
+            string out;
+            compress( data , len , &out );
+            char size[4];
+            little<int>::ref( size ) = out.size();
+
+            scoped_lock lk( _m );
+            write( size , 4 );
+            write( out.data() , out.size() );
+        }
+
+    private:
+        void write( const char* data , size_t toWrite ) {
+            size_t written = 0;
+            while (toWrite) {
+                size_t ret = fwrite( data+written, 1, toWrite, _f );
+                uassert(14035, errnoWithPrefix("couldn't write to file"), ret);
+                toWrite -= ret;
+                written += ret;
+            }
+        }
+
+        FILE* _f;
+        const bool _compress;
+        mongo::mutex _m;
+    };
+
 public:
-    Dump() : Tool( "dump" , ALL , "" , "" , true ) {
+    Dump() : Tool( "dump" , ALL , "" , "" , true ) , _usingMongos( false ) {
         add_options()
         ("out,o", po::value<string>()->default_value("dump"), "output directory or \"-\" for stdout")
         ("query,q", po::value<string>() , "json query" )
         ("oplog", "Use oplog for point-in-time snapshotting" )
         ("repair", "try to recover a crashed database" )
         ("forceTableScan", "force a table scan (do not use $snapshot)" )
+        ("compress", "snappy compress the .bson files (mongorestore and bsondump read them)" )
+        ("numParallelCollections", po::value<int>()->default_value(4), "number of collections to dump in parallel" )
+        ("numCursorsPerCollection", po::value<int>()->default_value(1), "dump large collections with up to this many cursors, over ranges of _id" )
+        ;
+        add_hidden_options()
+        ("minBytesPerCursor", po::value<int>(), "smallest range of a collection to give its own cursor") // For testing
         ;
     }
 
@@ -65,20 +120,20 @@ public:
         out << "Export MongoDB data to BSON files.\n" << endl;
     }
 
-    // This is a functor that writes a BSONObj to a file
-    struct Writer {
-        Writer(FILE* out, ProgressMeter* m) :_out(out), _m(m) {}
+    // Buffers the documents from one cursor into blocks for an OutputFile, and if it has a name
+    // logs its throughput every so often
+    class Writer : boost::noncopyable {
+    public:
+        Writer( OutputFile& out , ProgressMeter* m , const string& name = "" )
+            : _out( out ) , _m( m ) , _name( name ) , _docs( 0 ) , _bytes( 0 ) , _lastReport( 0 ) {
+        }
 
         void operator () (const BSONObj& obj) {
-            size_t toWrite = obj.objsize();
-            size_t written = 0;
-
-            while (toWrite) {
-                size_t ret = fwrite( obj.objdata()+written, 1, toWrite, _out );
-                uassert(14035, errnoWithPrefix("couldn't write to file"), ret);
-                toWrite -= ret;
-                written += ret;
-            }
+            _b.appendBuf( obj.objdata() , obj.objsize() );
+            _docs++;
+            _bytes += obj.objsize();
+            if ( _b.len() >= CompressedBSONFile::BlockSize )
+                flush();
 
             // if there's a progress bar, hit it
             if (_m) {
@@ -86,26 +141,89 @@ public:
             }
         }
 
-        FILE* _out;
+        void flush() {
+            if ( _b.len() == 0 )
+                return;
+            _out.writeBlock( _b.buf() , _b.len() );
+            _b.reset();
+
+            if ( ! _name.empty() && _timer.seconds() - _lastReport >= 10 ) {
+                _lastReport = _timer.seconds();
+                report();
+            }
+        }
+
+        /** flush, and log the totals */
+        void finish() {
+            flush();
+            if ( ! _name.empty() )
+                report();
+        }
+
+        long long docs() const { return _docs; }
+        long long bytes() const { return _bytes; }
+
+    private:
+        void report() {
+            double secs = max( _timer.micros() / 1000000.0 , 0.001 );
+            log() << "\t\t" << _name << ": " << _docs << " objects\t" << (long long)( _docs / secs )
+                  << " objects/second\t" << ( _bytes / secs / ( 1024 * 1024 ) ) << " MB/second" << endl;
+        }
+
+        OutputFile& _out;
         ProgressMeter* _m;
+        const string _name;
+        BufBuilder _b;
+        long long _docs;
+        long long _bytes;
+        Timer _timer;
+        int _lastReport;
+    };
+
+    // a collection for dumpQueued() to write
+    struct QueuedCollection {
+        QueuedCollection() : docs( 0 ) , bytes( 0 ) {}
+        string ns;
+        boost::filesystem::path file;
+        long long docs;
+        long long bytes;
+        string err;
     };
 
-    void doCollection( const string coll , FILE* out , ProgressMeter *m ) {
+    // a range of _id, bounds empty at the ends, dumped by its own cursor
+    struct Range {
+        BSONObj min;
+        BSONObj max;
+        string name;
+        long long docs;
+        long long bytes;
+        string err;
+    };
+
+    /** what conn( true ) is to conn() */
+    static DBClientBase& readConn( DBClientBase& c ) {
+        if ( c.type() == ConnectionString::SET )
+            return static_cast<DBClientReplicaSet&>( c ).slaveConn();
+        return c;
+    }
+
+    Query collectionQuery( const string& coll ) {
         Query q = _query;
+        if ( ! startsWith(coll.c_str(), "local.oplog.") &&
+             _query.isEmpty() && !hasParam("dbpath") && !hasParam("forceTableScan") )
+            q.snapshot();
+        return q;
+    }
 
+    void doCollection( const string coll , Query q , Writer& writer , DBClientBase& connBase ) {
         int queryOptions = QueryOption_SlaveOk | QueryOption_NoCursorTimeout;
         if (startsWith(coll.c_str(), "local.oplog."))
             queryOptions |= QueryOption_OplogReplay;
-        else if ( _query.isEmpty() && !hasParam("dbpath") && !hasParam("forceTableScan") )
-            q.snapshot();
-        
-        DBClientBase& connBase = conn(true);
-        Writer writer(out, m);
 
         // use low-latency "exhaust" mode if going over the network
         if (!_usingMongos && typeid(connBase) == typeid(DBClientConnection&)) {
             DBClientConnection& conn = static_cast<DBClientConnection&>(connBase);
-            boost::function<void(const BSONObj&)> castedWriter(writer); // needed for overload resolution
+            boost::function<void(const BSONObj&)> castedWriter( boost::ref( writer ) ); // needed for overload resolution
             conn.query( castedWriter, coll.c_str() , q , NULL, queryOptions | QueryOption_Exhaust);
         }
         else {
@@ -115,20 +233,147 @@ public:
                 writer(cursor->next());
             }
         }
+        writer.finish();
+    }
+
+    /**
+     * _id values splitting coll into up to _numCursors ranges of about the same size, or none
+     * if it is too small to be worth it or can't be split
+     */
+    void findSplitPoints( const string& coll , DBClientBase& c , vector<BSONObj>& splits ) {
+        if ( _numCursors < 2 || _usingMongos || ! _query.isEmpty() || startsWith( coll.c_str() , "local." ) )
+            return;
+
+        NamespaceString ns( coll );
+        BSONObj stats;
+        if ( ! c.runCommand( ns.db , BSON( "collStats" << ns.coll ) , stats , QueryOption_SlaveOk ) )
+            return;
+        if ( stats["capped"].trueValue() ) // restore has to insert these in order
+            return;
+
+        long long size = stats["size"].numberLong();
+        int n = (int) min( (long long) _numCursors , size / _minBytesPerCursor );
+        if ( n < 2 )
+            return;
+
+        BSONObj res;
+        if ( ! c.runCommand( ns.db , BSON( "splitVector" << coll << "keyPattern" << BSON( "_id" << 1 ) <<
+                                           "maxChunkSizeBytes" << 2 * size / n << "maxSplitPoints" << n - 1 ) ,
+                             res , QueryOption_SlaveOk ) ) {
+            log() << "\tcan't split " << coll << ", dumping it with one cursor: " << res["errmsg"] << endl;
+            return;
+        }
+
+        BSONForEach( e , res["splitKeys"].Obj() )
+            splits.push_back( e.Obj().getOwned() );
+    }
+
+    void dumpRange( const string coll , Range* r , OutputFile* out ) {
+        try {
+            scoped_ptr<DBClientBase> c( newConn() );
+            // a range of the _id index sees each document once, as $snapshot does
+            Query q;
+            q.hint( BSON( "_id" << 1 ) );
+            if ( ! r->min.isEmpty() )
+                q.minKey( r->min );
+            if ( ! r->max.isEmpty() )
+                q.maxKey( r->max );
+
+            Writer w( *out , NULL , r->name );
+            doCollection( coll , q , w , readConn( *c ) );
+            r->docs = w.docs();
+            r->bytes = w.bytes();
+        }
+        catch ( std::exception& e ) {
+            r->err = e.what();
+        }
     }
 
-    void writeCollectionFile( const string coll , boost::filesystem::path outputFile ) {
-        log() << "\t" << coll << " to " << outputFile.string() << endl;
+    void writeCollectionFile( QueuedCollection& q , DBClientBase& c ) {
+        log() << "\t" << q.ns << " to " << q.file.string() << endl;
 
-        FilePtr f (fopen(outputFile.string().c_str(), "wb"));
+        FilePtr f (fopen(q.file.string().c_str(), "wb"));
         uassert(10262, errnoWithPrefix("couldn't open file"), f);
+        OutputFile out( f , _compress );
 
-        ProgressMeter m( conn( true ).count( coll.c_str() , BSONObj() , QueryOption_SlaveOk ) );
-        m.setUnits("objects");
+        vector<BSONObj> splits;
+        findSplitPoints( q.ns , c , splits );
 
-        doCollection(coll, f, &m);
+        if ( splits.empty() ) {
+            ProgressMeter m( c.count( q.ns.c_str() , BSONObj() , QueryOption_SlaveOk ) );
+            m.setUnits("objects");
 
-        log() << "\t\t " << m.done() << " objects" << endl;
+            Writer w( out , &m , q.ns );
+            doCollection( q.ns , collectionQuery( q.ns ) , w , c );
+            q.docs = w.docs();
+            q.bytes = w.bytes();
+            return;
+        }
+
+        vector<Range> ranges( splits.size() + 1 );
+        for ( unsigned i = 0; i < ranges.size(); i++ ) {
+            ranges[i].min = i ? splits[i-1] : BSONObj();
+            ranges[i].max = i < splits.size() ? splits[i] : BSONObj();
+            ranges[i].name = str::stream() << q.ns << " [" << i + 1 << "/" << ranges.size() << "]";
+            ranges[i].docs = 0;
+            ranges[i].bytes = 0;
+        }
+        log() << "\t\tdumping " << q.ns << " with " << ranges.size() << " cursors" << endl;
+
+        {
+            ThreadPool pool( ranges.size() );
+            for ( unsigned i = 0; i < ranges.size(); i++ )
+                pool.schedule( &Dump::dumpRange , this , q.ns , &ranges[i] , &out );
+            pool.join();
+        }
+
+        for ( unsigned i = 0; i < ranges.size(); i++ ) {
+            uassert( 16398 , ranges[i].name + ": " + ranges[i].err , ranges[i].err.empty() );
+            q.docs += ranges[i].docs;
+            q.bytes += ranges[i].bytes;
+        }
+    }
+
+    void dumpCollection( QueuedCollection* q ) {
+        try {
+            scoped_ptr<DBClientBase> own;
+            if ( _numParallelCollections > 1 )
+                own.reset( newConn() );
+            writeCollectionFile( *q , own ? readConn( *own ) : conn( true ) );
+        }
+        catch ( std::exception& e ) {
+            error() << "error dumping " << q->ns << ": " << e.what() << endl;
+            q->err = e.what();
+        }
+    }
+
+    /** dumps the collections go() found, _numParallelCollections at a time */
+    void dumpQueued() {
+        Timer t;
+        if ( _numParallelCollections == 1 || _queued.size() < 2 ) {
+            // on this thread, which with --dbpath is the only one that can use conn()
+            for ( unsigned i = 0; i < _queued.size(); i++ )
+                dumpCollection( &_queued[i] );
+        }
+        else {
+            ThreadPool pool( min( _numParallelCollections , (int) _queued.size() ) );
+            for ( unsigned i = 0; i < _queued.size(); i++ )
+                pool.schedule( &Dump::dumpCollection , this , &_queued[i] );
+            pool.join();
+        }
+
+        long long docs = 0;
+        long long bytes = 0;
+        for ( unsigned i = 0; i < _queued.size(); i++ ) {
+            uassert( 16399 , "dump failed: " + _queued[i].ns + ": " + _queued[i].err , _queued[i].err.empty() );
+            docs += _queued[i].docs;
+            bytes += _queued[i].bytes;
+        }
+        _queued.clear();
+
+        double secs = max( t.micros() / 1000000.0 , 0.001 );
+        log() << "dumped " << docs << " objects, " << ( bytes / ( 1024 * 1024 ) ) << "MB in " << secs << "s: "
+              << (long long)( docs / secs ) << " objects/second, " << ( bytes / secs / ( 1024 * 1024 ) ) << " MB/second" << endl;
     }
 
     void writeMetadataFile( const string coll, boost::filesystem::path outputFile, 
@@ -167,7 +412,9 @@ public:
 
 
     void writeCollectionStdout( const string coll ) {
-        doCollection(coll, stdout, NULL);
+        OutputFile out( stdout , _compress );
+        Writer w( out , NULL );
+        doCollection( coll , collectionQuery( coll ) , w , conn( true ) );
     }
 
     void go( const string db , const boost::filesystem::path outdir ) {
@@ -230,7 +477,10 @@ public:
         for (vector<string>::iterator it = collections.begin(); it != collections.end(); ++it) {
             string name = *it;
             const string filename = name.substr( db.size() + 1 );
-            writeCollectionFile( name , outdir / ( filename + ".bson" ) );
+            QueuedCollection q;
+            q.ns = name;
+            q.file = outdir / ( filename + ".bson" );
+            _queued.push_back( q );
             writeMetadataFile( name, outdir / (filename + ".metadata.json"), collectionOptions, indexes);
         }
 
@@ -340,7 +590,8 @@ public:
         ProgressMeter m( nsd->stats.nrecords * 2 );
         m.setUnits("objects");
         
-        Writer w( f , &m );
+        OutputFile out( f , _compress );
+        Writer w( out , &m );
 
         try {
             log() << "forward extent pass" << endl;
@@ -368,6 +619,7 @@ public:
             error() << "ERROR: backwards extent pass failed:" << e.toString() << endl;
         }
 
+        w.finish();
         log() << "\t\t " << m.done() << " objects" << endl;
     }
     
@@ -410,6 +662,16 @@ public:
     }
 
     int run() {
+
+        _compress = hasParam( "compress" );
+        _numParallelCollections = max( 1 , getParam( "numParallelCollections" , 4 ) );
+        _numCursors = max( 1 , getParam( "numCursorsPerCollection" , 1 ) );
+        _minBytesPerCursor = max( 1 , getParam( "minBytesPerCursor" , 64 * 1024 * 1024 ) );
+        if ( hasParam( "dbpath" ) ) {
+            // all the reading goes through the one DBDirectClient
+            _numParallelCollections = 1;
+            _numCursors = 1;
+        }
         
         if ( hasParam( "repair" ) ){
             warning() << "repair is a work in progress" << endl;
@@ -509,13 +771,20 @@ public:
             go( db , root / db );
         }
 
+        dumpQueued();
+
+        // the oplog goes last, from when the dump started, so replaying it brings every
+        // collection up to the time the dump ended
         if (!opLogName.empty()) {
             BSONObjBuilder b;
             b.appendTimestamp("$gt", opLogStart);
 
             _query = BSON("ts" << b.obj());
 
-            writeCollectionFile( opLogName , root / "oplog.bson" );
+            QueuedCollection q;
+            q.ns = opLogName;
+            q.file = root / "oplog.bson";
+            writeCollectionFile( q , conn( true ) );
         }
 
         return 0;
@@ -523,6 +792,11 @@ public:
 
     bool _usingMongos;
     BSONObj _query;
+    bool _compress;
+    int _numParallelCollections;
+    int _numCursors;
+    int _minBytesPerCursor;
+    vector<QueuedCollection> _queued;
 };
 
 int main( int argc , char ** argv ) {
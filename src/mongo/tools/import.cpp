@@ -270,6 +270,7 @@ public:
         ("upsertFields", po::value<string>(), "comma-separated fields for the query part of the upsert. You should make sure this is indexed" )
         ("stopOnError", "stop importing at first error rather than continuing" )
         ("jsonArray", "load a json array, not one item per line. Currently limited to 16MB." )
+        ("numInsertionWorkers", po::value<int>()->default_value(1), "number of connections to insert on" )
         ;
         add_hidden_options()
         ("noimport", "don't actually import. useful for benchmarking parser" )
@@ -381,6 +382,25 @@ public:
             _jsonArray = true;
         }
 
+        int numInsertionWorkers = max( 1 , getParam( "numInsertionWorkers" , 1 ) );
+        if ( numInsertionWorkers > 1 && ( _upsert || hasParam( "dbpath" ) ) ) {
+            // upserts and inserts have to stay in order on the one connection
+            log() << "using one insertion worker" << ( _upsert ? " with --upsert" : " with --dbpath" ) << endl;
+            numInsertionWorkers = 1;
+        }
+
+        scoped_ptr<BulkInserter> inserter;
+        scoped_ptr<ParallelInserter> parallelInserter;
+        if ( numInsertionWorkers == 1 ) {
+            inserter.reset( new BulkInserter( conn() , ns ) );
+        }
+        else {
+            vector< shared_ptr<DBClientBase> > conns;
+            for ( int i = 0; i < numInsertionWorkers; i++ )
+                conns.push_back( shared_ptr<DBClientBase>( newConn() ) );
+            parallelInserter.reset( new ParallelInserter( conns , ns ) );
+        }
+
         time_t start = time(0);
         log(1) << "filesize: " << fileSize << endl;
         ProgressMeter pm( fileSize );
@@ -432,10 +452,15 @@ public:
                     }
 
                     if (doUpsert) {
+                        // after the inserts before it
+                        inserter->flush();
                         conn().update(ns, Query(b.obj()), o, true);
                     }
+                    else if ( inserter ) {
+                        inserter->insert( o );
+                    }
                     else {
-                        conn().insert( ns.c_str() , o );
+                        parallelInserter->insert( o );
                     }
                 }
 
@@ -451,11 +476,21 @@ public:
             }
 
             if ( pm.hit( len + 1 ) ) {
-                log() << "\t\t\t" << num << "\t" << ( num / ( time(0) - start ) ) << "/second" << endl;
+                long long secs = max( (time_t) 1 , time(0) - start );
+                log() << "\t\t\t" << num << "\t" << ( num / secs ) << "/second\t"
+                      << ( pm.done() / secs / ( 1024 * 1024 ) ) << " MB/second" << endl;
             }
         }
 
-        log() << "imported " << ( num - headerRows ) << " objects" << endl;
+        string err = inserter ? inserter->finish() : parallelInserter->finish();
+        if ( ! err.empty() ) {
+            error() << "error inserting: " << err << endl;
+            errors++;
+        }
+
+        long long secs = max( (time_t) 1 , time(0) - start );
+        log() << "imported " << ( num - headerRows ) << " objects in " << secs << "s, "
+              << ( ( num - headerRows ) / secs ) << "/second" << endl;
 
         conn().getLastError();
 
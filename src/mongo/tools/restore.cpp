@@ -29,6 +29,7 @@
 #include "mongo/tools/tool.h"
 #include "mongo/util/mmap.h"
 #include "mongo/util/version.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/db/json.h"
 #include "mongo/client/dbclientcursor.h"
 
@@ -49,12 +50,36 @@ public:
     bool _restoreIndexes;
     bool _restoreShardingConfig;
     int _w;
+    int _numParallelCollections;
+    int _numInsertionWorkers;
     string _curns;
     string _curdb;
     string _curcoll;
     set<string> _users; // For restoring users with --drop
     auto_ptr<Matcher> _opmatcher; // For oplog replay
-    Restore() : BSONTool( "restore" ) , _drop(false) {
+
+    // collections found by drillDown(), restored by restoreQueued()
+    struct QueuedCollection {
+        boost::filesystem::path file;
+        string ns;
+    };
+    vector<QueuedCollection> _queued;
+
+    // indexes are built once all the data is in
+    struct QueuedIndex {
+        BSONObj spec;
+        string db;
+        string coll;
+        bool keepCollName;
+    };
+    vector<QueuedIndex> _queuedIndexes;
+
+    mongo::mutex _statsMutex; // for the rest
+    long long _docsRestored;
+    long long _bytesRestored;
+    string _firstError;
+
+    Restore() : BSONTool( "restore" ) , _drop(false) , _statsMutex( "restoreStats" ) {
         add_options()
         ("drop" , "drop each collection before import" )
         ("oplogReplay", "replay oplog for point-in-time restore")
@@ -64,6 +89,8 @@ public:
         ("noIndexRestore" , "don't restore indexes")
         ("restoreShardingConfig", "restore sharding configuration before doing the full import")
         ("w" , po::value<int>()->default_value(1) , "minimum number of replicas per write" )
+        ("numParallelCollections", po::value<int>()->default_value(4), "number of collections to restore in parallel")
+        ("numInsertionWorkersPerCollection", po::value<int>()->default_value(1), "number of connections inserting into each collection")
         ;
         add_hidden_options()
         ("dir", po::value<string>()->default_value("dump"), "directory to restore from")
@@ -97,6 +124,13 @@ public:
         _restoreOptions = !hasParam("noOptionRestore");
         _restoreIndexes = !hasParam("noIndexRestore");
         _w = getParam( "w" , 1 );
+        _numParallelCollections = max( 1 , getParam( "numParallelCollections" , 4 ) );
+        _numInsertionWorkers = max( 1 , getParam( "numInsertionWorkersPerCollection" , 1 ) );
+        if ( hasParam( "dbpath" ) ) {
+            // all the writing goes through the one DBDirectClient
+            _numParallelCollections = 1;
+            _numInsertionWorkers = 1;
+        }
         _restoreShardingConfig = hasParam("restoreShardingConfig");
         bool forceConfigRestore = hasParam("forceConfigRestore");
 
@@ -184,6 +218,7 @@ public:
                 return -1;
             }
             drillDown(root / "config", false, false);
+            restoreQueued();
 
             log() << "Finished restoring config database." << endl
                  << "Calling flushRouterConfig on this connection" << endl;
@@ -200,6 +235,7 @@ public:
          * .bson file, or a single .bson file itself (a collection).
          */
         drillDown(root, _db != "", _coll != "", true);
+        restoreQueued();
 
         if (_restoreShardingConfig) {
             log() << "Flushing routing configuration from all mongos that we're aware of" << endl;
@@ -359,7 +395,17 @@ public:
             createCollectionWithOptions(metadataObject["options"].Obj());
         }
 
-        processFile( root );
+        if (_curcoll == "system.indexes" || (_drop && _curcoll == "system.users")) {
+            // these go through gotObject() rather than being inserted as they are
+            processFile( root );
+        }
+        else {
+            QueuedCollection q;
+            q.file = root;
+            q.ns = ns;
+            _queued.push_back(q);
+        }
+
         if (_drop && root.leaf() == "system.users.bson") {
             // Delete any users that used to exist but weren't in the dump file
             for (set<string>::iterator it = _users.begin(); it != _users.end(); ++it) {
@@ -372,11 +418,101 @@ public:
         if (_restoreIndexes && metadataObject.hasField("indexes")) {
             vector<BSONElement> indexes = metadataObject["indexes"].Array();
             for (vector<BSONElement>::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                createIndex((*it).Obj(), false);
+                queueIndex((*it).Obj(), false);
             }
         }
     }
 
+    /**
+     * Restores the collections drillDown() found, _numParallelCollections at a time, then builds
+     * their indexes, which is much quicker than maintaining them through the inserts.
+     */
+    void restoreQueued() {
+        Timer t;
+        _docsRestored = 0;
+        _bytesRestored = 0;
+        _firstError.clear();
+
+        if ( _numParallelCollections == 1 || _queued.size() < 2 ) {
+            // on this thread, which with --dbpath is the only one that can use conn()
+            for ( unsigned i = 0; i < _queued.size(); i++ )
+                restoreCollection( _queued[i] );
+        }
+        else {
+            ThreadPool pool( min( _numParallelCollections , (int) _queued.size() ) );
+            for ( unsigned i = 0; i < _queued.size(); i++ )
+                pool.schedule( &Restore::restoreCollection , this , _queued[i] );
+            pool.join();
+        }
+        _queued.clear();
+
+        uassert( 16394 , "restore failed: " + _firstError , _firstError.empty() );
+
+        if ( ! _queuedIndexes.empty() ) {
+            for ( unsigned i = 0; i < _queuedIndexes.size(); i++ ) {
+                const QueuedIndex& q = _queuedIndexes[i];
+                createIndex( q.spec , q.db , q.coll , q.keepCollName );
+            }
+            _queuedIndexes.clear();
+        }
+
+        double secs = t.micros() / 1000000.0;
+        if ( _docsRestored ) {
+            log() << "restored " << _docsRestored << " objects, " << ( _bytesRestored / ( 1024 * 1024 ) ) << "MB in "
+                  << secs << "s: " << (long long)( _docsRestored / secs ) << " objects/second, "
+                  << ( _bytesRestored / secs / ( 1024 * 1024 ) ) << " MB/second" << endl;
+        }
+    }
+
+    void restoreCollection( QueuedCollection q ) {
+        try {
+            Timer t;
+            long long docs;
+            long long bytes;
+            string err;
+
+            if ( _numInsertionWorkers == 1 ) {
+                scoped_ptr<DBClientBase> own;
+                if ( _numParallelCollections > 1 )
+                    own.reset( newConn() );
+                BulkInserter inserter( own ? *own : conn() , q.ns , _w );
+                processFile( q.file , boost::bind( &BulkInserter::insert , &inserter , _1 ) );
+                err = inserter.finish();
+                docs = inserter.docs();
+                bytes = inserter.bytes();
+            }
+            else {
+                vector< shared_ptr<DBClientBase> > conns;
+                for ( int i = 0; i < _numInsertionWorkers; i++ )
+                    conns.push_back( shared_ptr<DBClientBase>( newConn() ) );
+                ParallelInserter inserter( conns , q.ns , _w );
+                processFile( q.file , boost::bind( &ParallelInserter::insert , &inserter , _1 ) );
+                err = inserter.finish();
+                docs = inserter.docs();
+                bytes = inserter.bytes();
+            }
+
+            double secs = t.micros() / 1000000.0;
+            log() << "\t" << q.ns << ": " << docs << " objects in " << secs << "s, "
+                  << (long long)( docs / secs ) << " objects/second, "
+                  << ( bytes / secs / ( 1024 * 1024 ) ) << " MB/second" << endl;
+            if ( ! err.empty() ) {
+                // as when inserting one at a time, the rest of the collection still went in
+                error() << "\t" << q.ns << ": " << err << endl;
+            }
+
+            scoped_lock lk( _statsMutex );
+            _docsRestored += docs;
+            _bytesRestored += bytes;
+        }
+        catch ( std::exception& e ) {
+            error() << "error restoring " << q.ns << ": " << e.what() << endl;
+            scoped_lock lk( _statsMutex );
+            if ( _firstError.empty() )
+                _firstError = q.ns + ": " + e.what();
+        }
+    }
+
     virtual void gotObject( const BSONObj& obj ) {
         if (_curns == OPLOG_SENTINEL) { // intentional ptr compare
             if (obj["op"].valuestr()[0] == 'n') // skip no-ops
@@ -400,7 +536,7 @@ public:
             }
         }
         else if ( endsWith( _curns.c_str() , ".system.indexes" )) {
-            createIndex(obj, true);
+            queueIndex(obj, true);
         }
         else if (_drop && endsWith(_curns.c_str(), ".system.users") && _users.count(obj["user"].String())) {
             // Since system collections can't be dropped, we have to manually
@@ -499,17 +635,26 @@ private:
         }
     }
 
+    void queueIndex(const BSONObj& indexObj, bool keepCollName) {
+        QueuedIndex q;
+        q.spec = indexObj.getOwned();
+        q.db = _curdb;
+        q.coll = _curcoll;
+        q.keepCollName = keepCollName;
+        _queuedIndexes.push_back(q);
+    }
+
     /* We must handle if the dbname or collection name is different at restore time than what was dumped.
        If keepCollName is true, however, we keep the same collection name that's in the index object.
      */
-    void createIndex(BSONObj indexObj, bool keepCollName) {
+    void createIndex(BSONObj indexObj, const string& db, const string& coll, bool keepCollName) {
         BSONObjBuilder bo;
         BSONObjIterator i(indexObj);
         while ( i.more() ) {
             BSONElement e = i.next();
             if (strcmp(e.fieldName(), "ns") == 0) {
                 NamespaceString n(e.String());
-                string s = _curdb + "." + (keepCollName ? n.coll : _curcoll);
+                string s = db + "." + (keepCollName ? n.coll : coll);
                 bo.append("ns", s);
             }
             else if (strcmp(e.fieldName(), "v") != 0 || _keepIndexVersion) { // Remove index version number
@@ -518,7 +663,7 @@ private:
         }
         BSONObj o = bo.obj();
         log(0) << "\tCreating index: " << o << endl;
-        conn().insert( _curdb + ".system.indexes" ,  o );
+        conn().insert( db + ".system.indexes" ,  o );
 
         // We're stricter about errors for indexes than for regular data
         BSONObj err = conn().getLastErrorDetailed(false, false, _w);
@@ -530,7 +675,7 @@ private:
             else {
                 error() << "Error creating index " << o["ns"].String();
                 error() << ": " << err["code"].Int() << " " << err["err"].String() << endl;
-                error() << "To resume index restoration, run " << _name << " on file" << _fileName << " manually." << endl;
+                error() << "Indexes after this one in " << db << " were not created." << endl;
             }
 
             ::abort();
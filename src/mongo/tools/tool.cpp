@@ -24,6 +24,7 @@
 #include "pcrecpp.h"
 
 #include "mongo/db/namespace_details.h"
+#include "mongo/util/compress.h"
 #include "mongo/util/file_allocator.h"
 #include "mongo/util/password.h"
 #include "mongo/util/version.h"
@@ -424,17 +425,37 @@ namespace mongo {
 
         string errmsg;
         if ( _conn->auth( dbname , _username , _password , errmsg, true, level ) ) {
+            _authDb = dbname;
             return;
         }
 
         // try against the admin db
         if ( _conn->auth( "admin" , _username , _password , errmsg, true, level ) ) {
+            _authDb = "admin";
             return;
         }
 
         throw UserException( 9997 , (string)"authentication failed: " + errmsg );
     }
 
+    DBClientBase* Tool::newConn() {
+        if ( hasParam( "dbpath" ) )
+            return 0;
+
+        string errmsg;
+        ConnectionString cs = ConnectionString::parse( _host , errmsg );
+        uassert( 16391 , str::stream() << "invalid hostname [" << _host << "] " << errmsg , cs.isValid() );
+
+        DBClientBase* c = cs.connect( errmsg );
+        uassert( 16392 , str::stream() << "couldn't connect to [" << _host << "] " << errmsg , c );
+
+        if ( ! _authDb.empty() && ! c->auth( _authDb , _username , _password , errmsg , true ) ) {
+            delete c;
+            throw UserException( 16393 , (string)"authentication failed: " + errmsg );
+        }
+        return c;
+    }
+
     BSONTool::BSONTool( const char * name, DBAccess access , bool objcheck )
         : Tool( name , access , "" , "" , false ) , _objcheck( objcheck ) {
 
@@ -449,25 +470,32 @@ namespace mongo {
         _objcheck = hasParam( "objcheck" );
 
         if ( hasParam( "filter" ) )
-            _matcher.reset( new Matcher( fromjson( getParam( "filter" ) ) ) );
+            _filter = fromjson( getParam( "filter" ) );
 
         return doRun();
     }
 
-    long long BSONTool::processFile( const boost::filesystem::path& root ) {
-        _fileName = root.string();
+    long long BSONTool::processFile( const boost::filesystem::path& root , const ObjectHandler& handler ) {
+        // with a handler this may be running on several threads, so leave _fileName be, and
+        // filter with a Matcher of our own: they aren't thread safe, $where least of all
+        const string fileName = root.string();
+        scoped_ptr<Matcher> matcher;
+        if ( ! _filter.isEmpty() )
+            matcher.reset( new Matcher( _filter ) );
+        if ( handler.empty() )
+            _fileName = fileName;
 
         unsigned long long fileLength = file_size( root );
 
         if ( fileLength == 0 ) {
-            out() << "file " << _fileName << " empty, skipping" << endl;
+            out() << "file " << fileName << " empty, skipping" << endl;
             return 0;
         }
 
 
-        FILE* file = fopen( _fileName.c_str() , "rb" );
+        FILE* file = fopen( fileName.c_str() , "rb" );
         if ( ! file ) {
-            log() << "error opening file: " << _fileName << " " << errnoWithDescription() << endl;
+            log() << "error opening file: " << fileName << " " << errnoWithDescription() << endl;
             return 0;
         }
 
@@ -485,57 +513,233 @@ namespace mongo {
         boost::scoped_array<char> buf_holder(new char[BUF_SIZE]);
         char * buf = buf_holder.get();
 
-        ProgressMeter m( fileLength );
+        bool compressed = false;
+        if ( fileLength >= sizeof( CompressedBSONFile::Magic ) ) {
+            size_t amt = fread( buf , 1 , sizeof( CompressedBSONFile::Magic ) , file );
+            verify( amt == sizeof( CompressedBSONFile::Magic ) );
+            compressed = memcmp( buf , CompressedBSONFile::Magic , sizeof( CompressedBSONFile::Magic ) ) == 0;
+            if ( compressed )
+                read = sizeof( CompressedBSONFile::Magic );
+            else
+                fseek( file , 0 , SEEK_SET );
+        }
+
+        // there are far fewer hits on a compressed file, one per block
+        ProgressMeter m( fileLength , 3 , compressed ? 1 : 100 );
         m.setUnits( "bytes" );
+        if ( compressed )
+            m.hit( read );
+        Timer t;
 
+        string block;
+        string uncompressed;
         while ( read < fileLength ) {
             size_t amt = fread(buf, 1, 4, file);
             verify( amt == 4 );
-
             int size = little<int>::ref( buf );
-            uassert( 10264 , str::stream() << "invalid object size: " << size , size < BUF_SIZE );
-
-            amt = fread(buf+4, 1, size-4, file);
-            verify( amt == (size_t)( size - 4 ) );
-
-            BSONObj o( buf );
-            if ( _objcheck && ! o.valid() ) {
-                cerr << "INVALID OBJECT - going try and pring out " << endl;
-                cerr << "size: " << size << endl;
-                BSONObjIterator i(o);
-                while ( i.more() ) {
-                    BSONElement e = i.next();
-                    try {
-                        e.validate();
-                    }
-                    catch ( ... ) {
-                        cerr << "\t\t NEXT ONE IS INVALID" << endl;
-                    }
-                    cerr << "\t name : " << e.fieldName() << " " << e.type() << endl;
-                    cerr << "\t " << e << endl;
+            int bytes;
+
+            if ( compressed ) {
+                uassert( 16395 , str::stream() << "invalid compressed block size: " << size ,
+                         size > 0 && (size_t) size <= maxCompressedLength( BSONObjMaxUserSize + CompressedBSONFile::BlockSize ) );
+                block.resize( size );
+                amt = fread( &block[0] , 1 , size , file );
+                verify( amt == (size_t) size );
+                uassert( 16396 , "corrupt compressed block" , uncompress( block.data() , size , &uncompressed ) );
+
+                const char* p = uncompressed.data();
+                const char* end = p + uncompressed.size();
+                while ( p < end ) {
+                    BSONObj o( p );
+                    uassert( 16397 , "invalid object in compressed block" , o.objsize() >= 5 && p + o.objsize() <= end );
+                    if ( _processObject( o , matcher.get() , handler ) )
+                        processed++;
+                    p += o.objsize();
+                    num++;
                 }
+                bytes = 4 + size;
             }
+            else {
+                uassert( 10264 , str::stream() << "invalid object size: " << size , size < BUF_SIZE );
 
-            if ( _matcher.get() == 0 || _matcher->matches( o ) ) {
-                gotObject( o );
-                processed++;
+                amt = fread(buf+4, 1, size-4, file);
+                verify( amt == (size_t)( size - 4 ) );
+
+                BSONObj o( buf );
+                if ( _processObject( o , matcher.get() , handler ) )
+                    processed++;
+                num++;
+                bytes = o.objsize();
             }
 
-            read += o.objsize();
-            num++;
+            read += bytes;
 
-            m.hit( o.objsize() );
+            if ( m.hit( bytes ) ) {
+                double secs = t.micros() / 1000000.0;
+                log() << "\t\t" << root.leaf() << "\t" << (long long)( processed / secs ) << " objects/second\t"
+                      << ( read / secs / ( 1024 * 1024 ) ) << " MB/second" << endl;
+            }
         }
 
         fclose( file );
 
         uassert( 10265 ,  "counts don't match" , m.done() == fileLength );
-        (_usesstdout ? cout : cerr ) << m.hits() << " objects found" << endl;
-        if ( _matcher.get() )
+        (_usesstdout ? cout : cerr ) << num << " objects found" << endl;
+        if ( matcher )
             (_usesstdout ? cout : cerr ) << processed << " objects processed" << endl;
         return processed;
     }
 
+    bool BSONTool::_processObject( const BSONObj& o , Matcher* matcher , const ObjectHandler& handler ) {
+        if ( _objcheck && ! o.valid() ) {
+            cerr << "INVALID OBJECT - going try and pring out " << endl;
+            cerr << "size: " << o.objsize() << endl;
+            BSONObjIterator i(o);
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                try {
+                    e.validate();
+                }
+                catch ( ... ) {
+                    cerr << "\t\t NEXT ONE IS INVALID" << endl;
+                }
+                cerr << "\t name : " << e.fieldName() << " " << e.type() << endl;
+                cerr << "\t " << e << endl;
+            }
+        }
+
+        if ( matcher && ! matcher->matches( o ) )
+            return false;
+
+        if ( handler.empty() )
+            gotObject( o );
+        else
+            handler( o );
+        return true;
+    }
+
+    // -1 as the length of a first document, so no plain .bson file starts this way
+    const char CompressedBSONFile::Magic[8] = { '\xff' , '\xff' , '\xff' , '\xff' , 's' , 'n' , 'a' , 'p' };
+
+    BulkInserter::BulkInserter( DBClientBase& conn , const string& ns , int w )
+        : _conn( conn ) , _ns( ns ) , _w( w ) , _b( 1024 * 1024 ) , _inBatch( 0 ) , _docs( 0 ) , _bytes( 0 ) {
+        startBatch();
+    }
+
+    void BulkInserter::startBatch() {
+        _b.reset();
+        _b.appendNum( (int) InsertOption_ContinueOnError );
+        _b.appendStr( _ns );
+        _inBatch = 0;
+    }
+
+    void BulkInserter::insert( const BSONObj& obj ) {
+        if ( _inBatch && _b.len() + obj.objsize() > MaxMessageSizeBytes - MsgDataHeaderSize )
+            flush();
+        obj.appendSelfToBufBuilder( _b );
+        _inBatch++;
+        _docs++;
+        _bytes += obj.objsize();
+    }
+
+    void BulkInserter::flush() {
+        if ( ! _inBatch )
+            return;
+
+        Message toSend;
+        toSend.setData( dbInsert , _b.buf() , _b.len() );
+        startBatch();
+        _conn.say( toSend );
+
+        // a later batch would hide this one's error.  also waits for the batch to propagate to
+        // "w" nodes (doesn't warn if w used without replset)
+        string err = DBClientWithCommands::getLastErrorString( _conn.getLastErrorDetailed( false , false , _w > 1 ? _w : 0 ) );
+        if ( ! err.empty() )
+            _errors += ( _errors.empty() ? "" : "\n" ) + err;
+    }
+
+    string BulkInserter::finish() {
+        flush();
+        return errors();
+    }
+
+    ParallelInserter::ParallelInserter( const vector< shared_ptr<DBClientBase> >& conns , const string& ns , int w )
+        : _conns( conns ) , _queue( conns.size() * 2 ) , _batchBytes( 0 ) , _docs( 0 ) , _bytes( 0 ) , _finished( false ) {
+        for ( unsigned i = 0; i < _conns.size(); i++ ) {
+            _inserters.push_back( shared_ptr<BulkInserter>( new BulkInserter( *_conns[i] , ns , w ) ) );
+            _errors.push_back( "" );
+        }
+        for ( unsigned i = 0; i < _conns.size(); i++ )
+            _threads.push_back( shared_ptr<boost::thread>( new boost::thread( boost::bind( &ParallelInserter::work , this , i ) ) ) );
+    }
+
+    ParallelInserter::~ParallelInserter() {
+        if ( ! _finished ) {
+            try {
+                finish();
+            }
+            catch ( std::exception& e ) {
+                log() << "error stopping insertion workers: " << e.what() << endl;
+            }
+        }
+    }
+
+    void ParallelInserter::insert( const BSONObj& obj ) {
+        if ( ! _batch )
+            _batch.reset( new vector<BSONObj>() );
+        _batch->push_back( obj.getOwned() );
+        _batchBytes += obj.objsize();
+        _docs++;
+        _bytes += obj.objsize();
+        if ( _batchBytes >= BatchBytes )
+            pushBatch();
+    }
+
+    string ParallelInserter::finish() {
+        _finished = true;
+        pushBatch();
+        for ( unsigned i = 0; i < _threads.size(); i++ )
+            _queue.push( Batch() ); // one stop per worker
+        for ( unsigned i = 0; i < _threads.size(); i++ )
+            _threads[i]->join();
+        string errors;
+        for ( unsigned i = 0; i < _errors.size(); i++ ) {
+            if ( _errors[i].empty() )
+                continue;
+            if ( ! errors.empty() )
+                errors += '\n';
+            errors += _errors[i];
+        }
+        return errors;
+    }
+
+    void ParallelInserter::pushBatch() {
+        if ( ! _batch )
+            return;
+        _queue.push( _batch );
+        _batch.reset();
+        _batchBytes = 0;
+    }
+
+    void ParallelInserter::work( unsigned i ) {
+        BulkInserter& inserter = *_inserters[i];
+        try {
+            while ( Batch b = _queue.blockingPop() ) {
+                for ( vector<BSONObj>::const_iterator j = b->begin(); j != b->end(); ++j )
+                    inserter.insert( *j );
+                inserter.flush();
+            }
+            _errors[i] = inserter.finish();
+        }
+        catch ( std::exception& e ) {
+            _errors[i] = inserter.errors();
+            _errors[i] += ( _errors[i].empty() ? "" : "\n" ) + string( e.what() );
+            // keep taking batches so the caller isn't left waiting on a full queue
+            while ( _queue.blockingPop() )
+                ;
+        }
+    }
+
 
 
     void setupSignals( bool inFork ) {}
@@ -20,6 +20,7 @@
 
 #include <string>
 
+#include <boost/function.hpp>
 #include <boost/program_options.hpp>
 
 #if defined(_WIN32)
@@ -29,6 +30,7 @@
 #include "db/instance.h"
 #include "db/matcher.h"
 #include "db/security.h"
+#include "util/queue.h"
 
 using std::string;
 
@@ -105,6 +107,13 @@ namespace mongo {
         mongo::DBClientBase &conn( bool slaveIfPaired = false );
         void auth( string db = "",  Auth::Level * level = NULL);
 
+        /**
+         * another connection to the server conn() is connected to, authenticated as conn() is,
+         * for tools that write on several threads.  the caller owns it.
+         * @return NULL with --dbpath, where there is only the one
+         */
+        mongo::DBClientBase *newConn();
+
         string _name;
 
         string _db;
@@ -113,6 +122,7 @@ namespace mongo {
 
         string _username;
         string _password;
+        string _authDb; // the db auth() succeeded against, if any
 
         bool _usesstdout;
         bool _noconnection;
@@ -143,7 +153,7 @@ namespace mongo {
 
     class BSONTool : public Tool {
         bool _objcheck;
-        auto_ptr<Matcher> _matcher;
+        BSONObj _filter;
 
     public:
         BSONTool( const char * name , DBAccess access=ALL, bool objcheck = false );
@@ -153,8 +163,111 @@ namespace mongo {
 
         virtual int run();
 
-        long long processFile( const boost::filesystem::path& file );
+        typedef boost::function<void(const BSONObj&)> ObjectHandler;
+
+        /**
+         * passes each object in file that matches --filter to gotObject(), or to handler if
+         * there is one.  with a handler, several files may be processed at once.
+         * the object is only valid for the duration of the call.
+         */
+        long long processFile( const boost::filesystem::path& file ,
+                               const ObjectHandler& handler = ObjectHandler() );
+
+    private:
+        /** @return true if o passed matcher, which is null without a --filter */
+        bool _processObject( const BSONObj& o , Matcher* matcher , const ObjectHandler& handler );
+    };
+
+    /**
+     * A .bson file may instead be snappy compressed: Magic, then blocks of whole documents, each
+     * an int32 length followed by that many bytes of compressed data.  processFile() reads both.
+     */
+    struct CompressedBSONFile {
+        static const char Magic[8];
+        /** a block is this much, or a single document if it's larger */
+        enum { BlockSize = 1024 * 1024 };
+    };
+
+    /**
+     * Inserts documents into one namespace in multi-document insert messages as large as the
+     * server will accept, instead of a round trip per document.  Like separate inserts, a batch
+     * continues past a document that fails, e.g. on a duplicate key.  A batch reports only its
+     * last such error, so each flush() checks for it.
+     */
+    class BulkInserter : boost::noncopyable {
+    public:
+        /** @param w  with w > 1, each batch waits to reach w replicas */
+        BulkInserter( DBClientBase& conn , const string& ns , int w = 1 );
+
+        void insert( const BSONObj& obj );
+
+        /** sends what is buffered, and waits for the server to have applied it */
+        void flush();
+
+        /**
+         * flush()
+         * @return the error of each batch that had one, a line apiece, empty if none
+         */
+        string finish();
+
+        /** of the batches flushed so far, as finish() returns them */
+        const string& errors() const { return _errors; }
+
+        long long docs() const { return _docs; }
+        long long bytes() const { return _bytes; }
+
+    private:
+        void startBatch();
+
+        DBClientBase& _conn;
+        const string _ns;
+        const int _w;
+        BufBuilder _b;
+        int _inBatch;
+        long long _docs;
+        long long _bytes;
+        string _errors;
+    };
+
+    /**
+     * Spreads the documents for one namespace over several insertion workers, each with a
+     * BulkInserter on its own connection.  The caller hands them batches of up to BatchBytes; at
+     * most two batches per worker wait, so a slow server holds back the caller rather than
+     * filling memory.
+     */
+    class ParallelInserter : boost::noncopyable {
+    public:
+        enum { BatchBytes = 16 * 1024 * 1024 };
+
+        /** a worker per connection */
+        ParallelInserter( const vector< shared_ptr<DBClientBase> >& conns , const string& ns , int w = 1 );
+        ~ParallelInserter();
+
+        void insert( const BSONObj& obj );
+
+        /** waits for the workers to insert everything.  @return every error they saw, a line apiece */
+        string finish();
+
+        /** what has been handed to insert() */
+        long long docs() const { return _docs; }
+        long long bytes() const { return _bytes; }
+
+    private:
+        typedef shared_ptr< vector<BSONObj> > Batch;
+
+        void pushBatch();
+        void work( unsigned i );
 
+        vector< shared_ptr<DBClientBase> > _conns;
+        vector< shared_ptr<BulkInserter> > _inserters;
+        vector<string> _errors;
+        vector< shared_ptr<boost::thread> > _threads;
+        BlockingQueue<Batch> _queue;
+        Batch _batch;
+        int _batchBytes;
+        long long _docs;
+        long long _bytes;
+        bool _finished;
     };
 
 }
@@ -58,6 +58,17 @@ namespace mongo {
             qsort( _data , _size , sizeof(T) , comp );
         }
 
+        /** sort [from,to) only */
+        void sort( int from, int to, int (*comp)(const void *, const void *) ) {
+            qsort( _data + from , to - from , sizeof(T) , comp );
+        }
+
+        /** merge the sorted ranges [from,mid) and [mid,to) */
+        template< class Less >
+        void merge( int from, int mid, int to, const Less& less ) {
+            std::inplace_merge( _data + from , _data + mid , _data + to , less );
+        }
+
         int size() {
             return _size;
         }
@@ -122,6 +122,21 @@ namespace mongo {
             }
         }
 
+        void ThreadPool::addThreads(int n) {
+            scoped_lock lock(_mutex);
+            _nThreads += n;
+            while (n-- > 0) {
+                Worker* worker = new Worker(*this);
+                if (!_tasks.empty()) {
+                    worker->set_task(_tasks.front());
+                    _tasks.pop_front();
+                }
+                else {
+                    _freeWorkers.push_front(worker);
+                }
+            }
+        }
+
         // should only be called by a worker from the worker thread
         void ThreadPool::task_done(Worker* worker) {
             scoped_lock lock(_mutex);
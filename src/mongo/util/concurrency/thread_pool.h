@@ -62,6 +62,11 @@ namespace mongo {
 
             int tasks_remaining() { return _tasksRemaining; }
 
+            // adds n threads, which start on queued tasks right away.  the pool never shrinks.
+            void addThreads(int n);
+
+            int nThreads() const { return _nThreads; }
+
         private:
             mongo::mutex _mutex;
             boost::condition _condition;
@@ -0,0 +1,108 @@
+// @file thread_slabs.h
+
+/**
+*    Copyright (C) 2012 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/concurrency/threadlocal.h"
+
+namespace mongo {
+
+    /** a copy of T for each thread, for statistics that every thread writes and few read.  each
+        thread writes only its own slab so the counting shares no cache line between cores; the
+        reader adds up all() of them.  when a thread exits its slab goes back on a free list and is
+        handed to the next new thread, so what it counted is kept and slabs are never freed.
+
+        e.g.
+          struct Counts { Counts() : n(0) { } unsigned long long n; };
+          ThreadSlabs<Counts> counts;
+          counts.get().n++;
+    */
+    template< class T >
+    class ThreadSlabs : boost::noncopyable {
+    public:
+        ThreadSlabs() : _m("ThreadSlabs"), _mine(&release) { }
+
+        /** only once no thread but this one may use it again.  at shutdown other threads may
+            still be counting, so the slabs of a static are left be. 
+        */
+        ~ThreadSlabs() {
+            _mine.reset();
+            if( StaticObserver::_destroyingStatics )
+                return;
+            for( unsigned i = 0; i < _all.size(); i++ )
+                delete _all[i];
+        }
+
+        /** this thread's slab */
+        T& get() {
+            Holder *h = _mine.get();
+            if( h == 0 )
+                h = take();
+            return h->slab;
+        }
+
+        /** every slab there is.  they stay valid, but other threads may be writing them */
+        void all( std::vector<T*>& out ) {
+            SimpleMutex::scoped_lock lk(_m);
+            out.clear();
+            for( unsigned i = 0; i < _all.size(); i++ )
+                out.push_back( &_all[i]->slab );
+        }
+
+    private:
+        struct Holder {
+            T slab;
+            ThreadSlabs *owner;
+            char pad[64]; // keep the next thread's slab off our cache line
+        };
+
+        Holder* take() {
+            Holder *h;
+            {
+                SimpleMutex::scoped_lock lk(_m);
+                if( _free.empty() ) {
+                    h = new Holder();
+                    h->owner = this;
+                    _all.push_back(h);
+                }
+                else {
+                    h = _free.back();
+                    _free.pop_back();
+                }
+            }
+            _mine.reset(h);
+            return h;
+        }
+
+        /** at thread exit */
+        static void release( Holder *h ) {
+            ThreadSlabs *owner = h->owner;
+            SimpleMutex::scoped_lock lk(owner->_m);
+            owner->_free.push_back(h);
+        }
+
+        SimpleMutex _m; // guards _all and _free
+        std::vector<Holder*> _all;
+        std::vector<Holder*> _free;
+        boost::thread_specific_ptr<Holder> _mine;
+    };
+
+}
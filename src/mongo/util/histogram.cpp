@@ -16,6 +16,7 @@
 
 #include "histogram.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <limits>
 #include <sstream>
@@ -126,4 +127,79 @@ namespace mongo {
         return low;
     }
 
+    void LogLinearHistogram::add( const LogLinearHistogram& other ) {
+        for ( uint32_t i = 0; i < NumBuckets; i++ ) {
+            uint32_t n = other._buckets[i];
+            if ( n )
+                _buckets[i].set( _buckets[i] + n );
+        }
+        if ( other._max > _max )
+            _max = other._max;
+    }
+
+    void LogLinearHistogram::reset() {
+        for ( uint32_t i = 0; i < NumBuckets; i++ ) {
+            _buckets[i].zero();
+        }
+        _max = 0;
+    }
+
+    uint64_t LogLinearHistogram::count() const {
+        uint64_t n = 0;
+        for ( uint32_t i = 0; i < NumBuckets; i++ ) {
+            n += _buckets[i];
+        }
+        return n;
+    }
+
+    uint64_t LogLinearHistogram::percentile( double p ) const {
+        uint64_t n = count();
+        if ( n == 0 )
+            return 0;
+
+        // the rank of the value we want, 1 based
+        uint64_t rank = (uint64_t) ( p * n );
+        if ( rank < p * n )
+            rank++;
+        if ( rank == 0 )
+            rank = 1;
+
+        uint64_t seen = 0;
+        for ( uint32_t i = 0; i < NumBuckets; i++ ) {
+            seen += _buckets[i];
+            if ( seen >= rank )
+                return std::min( getBoundary( i ) , (uint64_t) _max );
+        }
+        return _max;
+    }
+
+    uint32_t LogLinearHistogram::findBucket( uint64_t value ) {
+        const uint32_t sub = 1 << SubBits;
+        if ( value < sub )
+            return (uint32_t) value;
+
+        uint32_t highBit = 0;
+        for ( uint64_t v = value; v >>= 1; )
+            highBit++;
+        if ( highBit >= MaxBits )
+            return NumBuckets - 1;
+
+        // which of the power of two's 'sub' slices of it
+        uint32_t slice = (uint32_t) ( value >> ( highBit - SubBits ) ) & ( sub - 1 );
+        return sub + ( highBit - SubBits ) * sub + slice;
+    }
+
+    uint64_t LogLinearHistogram::getBoundary( uint32_t bucket ) {
+        const uint32_t sub = 1 << SubBits;
+        if ( bucket < sub )
+            return bucket;
+        if ( bucket >= NumBuckets - 1 )
+            return std::numeric_limits<uint64_t>::max();
+
+        uint32_t shift = ( bucket - sub ) / sub;
+        uint64_t slice = ( bucket - sub ) % sub;
+        uint64_t low = ( sub + slice ) << shift;
+        return low + ( 1ULL << shift ) - 1;
+    }
+
 }  // namespace mongo
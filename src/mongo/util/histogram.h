@@ -20,6 +20,8 @@
 #include <string>
 #include <stdint.h>
 
+#include "mongo/bson/util/atomic_int.h"
+
 namespace mongo {
 
     /**
@@ -118,6 +120,68 @@ namespace mongo {
         Histogram& operator=( const Histogram& );
     };
 
+    /**
+     * A log-linear (HDR style) histogram of 64-bit values, e.g. latencies in microseconds.
+     * Values below 2^SubBits each have a bucket of their own; above that every power of two
+     * is split into 2^SubBits equal buckets, so a percentile is reported within 1/2^SubBits
+     * of its value whatever the scale.  Values of 2^MaxBits and more share the last bucket.
+     *
+     * insert() is an atomic increment, so threads may share one histogram.  max() is kept
+     * without synchronization and may miss a value inserted at the same moment as another.
+     *
+     * Usage example:
+     *   LogLinearHistogram h;
+     *   h.insert( micros );
+     *   h.percentile( 0.99 );
+     */
+    class LogLinearHistogram {
+    public:
+        enum { SubBits = 3,
+               MaxBits = 36,
+               NumBuckets = ( 1 << SubBits ) + ( MaxBits - SubBits ) * ( 1 << SubBits ) };
+
+        LogLinearHistogram() : _max( 0 ) { }
+
+        void insert( uint64_t value ) {
+            _buckets[ findBucket( value ) ]++;
+            if ( value > _max )
+                _max = value;
+        }
+
+        /** add the counts of another histogram to this one, which nothing may be inserting into */
+        void add( const LogLinearHistogram& other );
+
+        void reset();
+
+        /** the number of values inserted */
+        uint64_t count() const;
+
+        /** the largest value inserted */
+        uint64_t max() const { return _max; }
+
+        /**
+         * The value that a fraction p (0..1] of the inserted values are at or below: the
+         * upper boundary of the bucket it falls in, but no more than max().  0 if empty.
+         */
+        uint64_t percentile( double p ) const;
+
+        // testing interface below -- consider it private
+
+        uint32_t getCount( uint32_t bucket ) const { return _buckets[ bucket ]; }
+
+        static uint32_t findBucket( uint64_t value );
+
+        /** the largest value that falls in 'bucket' */
+        static uint64_t getBoundary( uint32_t bucket );
+
+    private:
+        AtomicUInt _buckets[ NumBuckets ];
+        volatile uint64_t _max;
+
+        LogLinearHistogram( const LogLinearHistogram& );
+        LogLinearHistogram& operator=( const LogLinearHistogram& );
+    };
+
 }  // namespace mongo
 
 #endif  //  UTIL_HISTOGRAM_HEADER
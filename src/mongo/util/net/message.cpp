@@ -43,6 +43,89 @@ namespace mongo {
         }
     }
 
+    RecvBufferPool::RecvBufferPool() : _m("RecvBufferPool"), _out(0), _orphaned(false) {
+    }
+
+    RecvBufferPool::~RecvBufferPool() {
+        for ( int c = 0; c < NumClasses; c++ )
+            for ( unsigned i = 0; i < _free[c].size(); i++ )
+                free( _free[c][i] );
+    }
+
+    int RecvBufferPool::sizeClass( int len ) {
+        for ( int c = 0; c < NumClasses; c++ )
+            if ( len <= ( 1 << ( MinClassBits + c ) ) )
+                return c;
+        return -1;
+    }
+
+    MsgData* RecvBufferPool::get( int len ) {
+        int c = sizeClass( len );
+        char *p = 0;
+        {
+            SimpleMutex::scoped_lock lk(_m);
+            verify( !_orphaned );
+            _out++;
+            if ( c >= 0 && !_free[c].empty() ) {
+                p = _free[c].back();
+                _free[c].pop_back();
+            }
+        }
+        if ( p == 0 ) {
+            size_t z = c >= 0 ? ( 1 << ( MinClassBits + c ) ) : ( ( len + 1023 ) & ~1023 );
+            p = (char *) malloc( sizeof(Prefix) + z );
+            if ( p == 0 ) {
+                SimpleMutex::scoped_lock lk(_m);
+                _out--;
+                uasserted( 16413 , str::stream() << "couldn't allocate a " << z << " byte receive buffer" );
+            }
+            Prefix *pre = (Prefix *) p;
+            pre->h.pool = this;
+            pre->h.sizeClass = c;
+        }
+        return (MsgData *) ( p + sizeof(Prefix) );
+    }
+
+    void RecvBufferPool::release( void *buf ) {
+        char *p = (char *) buf - sizeof(Prefix);
+        Prefix *pre = (Prefix *) p;
+        RecvBufferPool *pool = pre->h.pool;
+        int c = pre->h.sizeClass;
+        bool last;
+        {
+            SimpleMutex::scoped_lock lk(pool->_m);
+            pool->_out--;
+            if ( c >= 0 && !pool->_orphaned && pool->_free[c].size() < (unsigned) KeepPerClass ) {
+                pool->_free[c].push_back( p );
+                p = 0;
+            }
+            last = pool->_orphaned && pool->_out == 0;
+        }
+        if ( p )
+            free( p );
+        if ( last )
+            delete pool;
+    }
+
+    void RecvBufferPool::orphan() {
+        bool last;
+        vector<char*> unused;
+        {
+            SimpleMutex::scoped_lock lk(_m);
+            _orphaned = true;
+            last = _out == 0;
+            for ( int c = 0; c < NumClasses; c++ ) {
+                unused.insert( unused.end(), _free[c].begin(), _free[c].end() );
+                _free[c].clear();
+            }
+        }
+        for ( unsigned i = 0; i < unused.size(); i++ )
+            free( unused[i] );
+        // else the last buffer out deletes us when it comes back
+        if ( last )
+            delete this;
+    }
+
     AtomicUInt NextMsgId;
 
     /*struct MsgStart {
@@ -19,6 +19,7 @@
 
 #include "sock.h"
 #include "hostandport.h"
+#include "../concurrency/mutex.h"
 
 namespace mongo {
 
@@ -135,20 +136,65 @@ namespace mongo {
         int dataLen(); // len without header
     };
     const int MsgDataHeaderSize = sizeof(MsgData) - 4;
+    /** the largest message, header included, a server will accept */
+    const int MaxMessageSizeBytes = 48000000;
     inline int MsgData::dataLen() {
         return len - MsgDataHeaderSize;
     }
 #pragma pack()
 
+    /** receive buffers for one connection, kept on a free list per power of two size so a
+        connection reading message after message gets the buffer it used last time rather than
+        going to malloc for each one.  a buffer comes back when the Message holding it is reset,
+        on whatever thread that happens.  the connection orphan()s its pool when it goes away and
+        the pool is deleted once the last of its buffers is back.
+    */
+    class RecvBufferPool : boost::noncopyable {
+    public:
+        RecvBufferPool();
+
+        /** a buffer of at least len bytes; give it back with release() */
+        MsgData* get( int len );
+
+        /** frees buf, or keeps it for the next get() of its size */
+        static void release( void *buf );
+
+        /** the connection is done with the pool.  don't use it after this */
+        void orphan();
+
+        /** smallest and largest sizes kept; larger buffers are malloc'd and freed each time */
+        enum { MinClassBits = 10, NumClasses = 7 };
+        /** free buffers kept per size: a connection rarely holds more than one message at once */
+        enum { KeepPerClass = 1 };
+
+    private:
+        ~RecvBufferPool();
+        /** ahead of each buffer.  a union so what follows it stays aligned */
+        union Prefix {
+            struct {
+                RecvBufferPool *pool;
+                int sizeClass; // -1 if not kept
+            } h;
+            char pad[16];
+        };
+        /** the class a buffer of len bytes comes from, -1 if it's larger than we keep */
+        static int sizeClass( int len );
+
+        SimpleMutex _m; // guards the rest
+        vector<char*> _free[NumClasses];
+        int _out;       // buffers handed out and not yet released
+        bool _orphaned;
+    };
+
     class Message {
     public:
         // we assume here that a vector with initial size 0 does no allocation (0 is the default, but wanted to make it explicit).
-        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ) {}
+        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ), _release( 0 ) {}
         Message( void * data , bool freeIt ) :
-            _buf( 0 ), _data( 0 ), _freeIt( false ) {
+            _buf( 0 ), _data( 0 ), _freeIt( false ), _release( 0 ) {
             _setData( reinterpret_cast< MsgData* >( data ), freeIt );
         };
-        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ) {
+        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ), _release( 0 ) {
             *this = r;
         }
         ~Message() {
@@ -218,21 +264,24 @@ namespace mongo {
             }
             r._freeIt = false;
             _freeIt = true;
+            _release = r._release;
+            r._release = 0;
             return *this;
         }
 
         void reset() {
             if ( _freeIt ) {
                 if ( _buf ) {
-                    free( _buf );
+                    _free( _buf );
                 }
                 for( vector< pair< char *, int > >::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
-                    free(i->first);
+                    _free(i->first);
                 }
             }
             _buf = 0;
             _data.clear();
             _freeIt = false;
+            _release = 0;
         }
 
         // use to add a buffer
@@ -248,12 +297,25 @@ namespace mongo {
                 return;
             }
             verify( _freeIt );
-            if ( _buf ) {
-                _data.push_back( make_pair( (char*)_buf, _buf->len ) );
-                _buf = 0;
+            verify( _release == 0 );
+            _append( d, size );
+        }
+
+        /** add a buffer the message neither owns nor frees, so it is sent from where it is
+            without being copied together with the rest.  the first must hold the whole MsgData
+            header, and all of them must outlive the message.
+        */
+        void appendUnownedData(char *d, int size) {
+            if ( size <= 0 ) {
+                return;
             }
-            _data.push_back( make_pair( d, size ) );
-            header()->len += size;
+            verify( !_freeIt );
+            if ( empty() ) {
+                reinterpret_cast< MsgData* >( d )->len = size;
+                _data.push_back( make_pair( d, size ) );
+                return;
+            }
+            _append( d, size );
         }
 
         // use to set first buffer if empty
@@ -261,6 +323,12 @@ namespace mongo {
             verify( empty() );
             _setData( d, freeIt );
         }
+        /** as above, the message owning d and handing it to release() rather than free() */
+        void setData(MsgData *d, void (*release)(void*)) {
+            verify( empty() );
+            _setData( d, true );
+            _release = release;
+        }
         void setData(int operation, const char *msgtxt) {
             setData(operation, msgtxt, strlen(msgtxt)+1);
         }
@@ -279,6 +347,14 @@ namespace mongo {
         }
 
         void send( MessagingPort &p, const char *context );
+
+        /** add our buffers, in order, to what's to be sent with one vectored send */
+        void appendBuffers( vector< pair< char *, int > >& out ) const {
+            if ( _buf )
+                out.push_back( make_pair( (char*)_buf, (int)_buf->len ) );
+            else
+                out.insert( out.end(), _data.begin(), _data.end() );
+        }
         
         string toString() const;
 
@@ -287,12 +363,28 @@ namespace mongo {
             _freeIt = freeIt;
             _buf = d;
         }
+        void _append( char *d, int size ) {
+            if ( _buf ) {
+                _data.push_back( make_pair( (char*)_buf, _buf->len ) );
+                _buf = 0;
+            }
+            _data.push_back( make_pair( d, size ) );
+            header()->len += size;
+        }
+        void _free( void *p ) {
+            if ( _release )
+                _release( p );
+            else
+                free( p );
+        }
         // if just one buffer, keep it in _buf, otherwise keep a sequence of buffers in _data
         MsgData * _buf;
         // byte buffer(s) - the first must contain at least a full MsgData unless using _buf for storage instead
         typedef vector< pair< char*, int > > MsgVec;
         MsgVec _data;
         bool _freeIt;
+        // gives back what we own; free() if 0
+        void (*_release)(void*);
     };
 
 
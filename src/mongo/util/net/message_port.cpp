@@ -47,45 +47,68 @@ namespace mongo {
 
     /* messagingport -------------------------------------------------------------- */
 
+    /* messages held back to go out with the next one said, all in one vectored send straight
+       from their own buffers - nothing is copied together first.
+    */
     class PiggyBackData {
     public:
-        PiggyBackData( MessagingPort * port ) {
-            _port = port;
-            _buf = new char[1300];
-            _cur = _buf;
+        /** larger messages aren't worth holding back */
+        enum { MaxBytes = 64 * 1024, MaxMessages = 64 };
+
+        PiggyBackData( MessagingPort * port ) : _port( port ), _len( 0 ) {
         }
 
         ~PiggyBackData() {
             DESTRUCTOR_GUARD (
                 flush();
-                delete[]( _cur );
             );
+            clear();
         }
 
+        /** takes m's buffers, leaving it empty */
         void append( Message& m ) {
-            verify( m.header()->len <= 1300 );
-
-            if ( len() + m.header()->len > 1300 )
+            if ( _held.size() >= (unsigned) MaxMessages || _len + m.size() > MaxBytes )
                 flush();
 
-            memcpy( _cur , m.singleData() , m.header()->len );
-            _cur += m.header()->len;
+            _len += m.size();
+            Message *held = new Message();
+            *held = m;
+            _held.push_back( held );
         }
 
-        void flush() {
-            if ( _buf == _cur )
+        /** send what we hold, followed by also if given */
+        void flush( Message *also = 0 ) {
+            if ( _held.empty() && also == 0 )
                 return;
 
-            _port->send( _buf , len(), "flush" );
-            _cur = _buf;
+            vector< pair< char *, int > > bufs;
+            for ( unsigned i = 0; i < _held.size(); i++ )
+                _held[i]->appendBuffers( bufs );
+            if ( also )
+                also->appendBuffers( bufs );
+            try {
+                _port->send( bufs, "flush" );
+            }
+            catch ( ... ) {
+                clear();
+                throw;
+            }
+            clear();
         }
 
-        int len() const { return _cur - _buf; }
+        int len() const { return _len; }
 
     private:
+        void clear() {
+            for ( unsigned i = 0; i < _held.size(); i++ )
+                delete _held[i];
+            _held.clear();
+            _len = 0;
+        }
+
         MessagingPort* _port;
-        char * _buf;
-        char * _cur;
+        vector<Message*> _held;
+        int _len;
     };
 
     class Ports {
@@ -120,18 +143,18 @@ namespace mongo {
     }
 
     MessagingPort::MessagingPort(int fd, const SockAddr& remote) 
-        : psock( new Socket( fd , remote ) ) , piggyBackData(0) {
+        : psock( new Socket( fd , remote ) ) , piggyBackData(0), _recvPool(0) {
         ports.insert(this);
     }
 
     MessagingPort::MessagingPort( double timeout, int ll ) 
-        : psock( new Socket( timeout, ll ) ) {
+        : psock( new Socket( timeout, ll ) ), _recvPool(0) {
         ports.insert(this);
         piggyBackData = 0;
     }
 
     MessagingPort::MessagingPort( boost::shared_ptr<Socket> sock )
-        : psock( sock ), piggyBackData( 0 ) {
+        : psock( sock ), piggyBackData( 0 ), _recvPool( 0 ) {
         ports.insert(this);
     }
 
@@ -144,6 +167,15 @@ namespace mongo {
             delete( piggyBackData );
         shutdown();
         ports.erase(this);
+        // messages we read may still be about, so the pool goes once they're gone
+        if ( _recvPool )
+            _recvPool->orphan();
+    }
+
+    RecvBufferPool& MessagingPort::recvBufferPool() {
+        if ( _recvPool == 0 )
+            _recvPool = new RecvBufferPool();
+        return *_recvPool;
     }
 
     bool MessagingPort::recv(Message& m) {
@@ -155,7 +187,7 @@ again:
             psock->recv( lenbuf, lft );
             int len = little<int>::ref( lenbuf );
 
-            if ( len < 16 || len > 48000000 ) { // messages must be large enough for headers
+            if ( len < 16 || len > MaxMessageSizeBytes ) { // messages must be large enough for headers
                 if ( len == -1 ) {
                     // Endian check from the client, after connecting, to see what mode server is running in.
                     unsigned foo = 0x10203040;
@@ -177,11 +209,8 @@ again:
                 return false;
             }
 
-            int z = (len+1023)&0xfffffc00;
-            verify(z>=len);
-            MsgData *md = (MsgData *) malloc(z);
-            ScopeGuard guard = MakeGuard(free, md);
-            verify(md);
+            MsgData *md = recvBufferPool().get( len );
+            ScopeGuard guard = MakeGuard(&RecvBufferPool::release, (void *) md);
             md->len = len;
 
             char *p = (char *) &md->id;
@@ -190,7 +219,7 @@ again:
             psock->recv( p, left );
 
             guard.Dismiss();
-            m.setData(md, true);
+            m.setData(md, &RecvBufferPool::release);
             return true;
 
         }
@@ -251,15 +280,9 @@ again:
 
         if ( piggyBackData && piggyBackData->len() ) {
             mmm( log() << "*     have piggy back" << endl; )
-            if ( ( piggyBackData->len() + toSend.header()->len ) > 1300 ) {
-                // won't fit in a packet - so just send it off
-                piggyBackData->flush();
-            }
-            else {
-                piggyBackData->append( toSend );
-                piggyBackData->flush();
-                return;
-            }
+            // out behind what's held back, in the same send
+            piggyBackData->flush( &toSend );
+            return;
         }
 
         toSend.send( *this, "say" );
@@ -267,9 +290,9 @@ again:
 
     void MessagingPort::piggyBack( Message& toSend , int responseTo ) {
 
-        if ( toSend.header()->len > 1300 ) {
-            // not worth saving because its almost an entire packet
-            say( toSend );
+        if ( toSend.header()->len > PiggyBackData::MaxBytes || !toSend.doIFreeIt() ) {
+            // not worth holding, or not ours to hold
+            say( toSend , responseTo );
             return;
         }
 
@@ -64,6 +64,7 @@ namespace mongo {
 
         /* it's assumed if you reuse a message object, that it doesn't cross MessagingPort's.
            also, the Message data will go out of scope on the subsequent recv call.
+           the data comes from recvBufferPool().
         */
         bool recv(Message& m);
         void reply(Message& received, Message& response, MSGID responseTo);
@@ -83,8 +84,12 @@ namespace mongo {
          */
         bool recv( const Message& sent , Message& response );
 
+        /** hold toSend back to go out with the next say().  takes toSend's buffers */
         void piggyBack( Message& toSend , int responseTo = -1 );
 
+        /** where the messages read from this port get their buffers */
+        RecvBufferPool& recvBufferPool();
+
         unsigned remotePort() const { return psock->remotePort(); }
         virtual HostAndPort remote() const;
 
@@ -111,6 +116,8 @@ namespace mongo {
     private:
         
         PiggyBackData * piggyBackData;
+
+        RecvBufferPool * _recvPool; // made on first use, orphaned when we go
         
         // this is the parsed version of remote
         // mutable because its initialized only on call to remote()
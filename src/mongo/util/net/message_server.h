@@ -47,6 +47,22 @@ namespace mongo {
          * called once when a socket is disconnected
          */
         virtual void disconnected( AbstractMessagingPort* p ) = 0;
+
+        /**
+         * per connection state a handler keeps in thread locals (its Client etc.), for servers 
+         * that run many connections on a shared pool of threads (Options::workerThreads).
+         * such a server makes one ThreadState per connection with newThreadState(), and calls
+         * attach() on the pool thread before connected(), process() and disconnected() for 
+         * the connection, and detach() after.  the ThreadState is deleted, detached, when the 
+         * connection is done.  a null ThreadState means the handler has nothing to move.
+         */
+        class ThreadState : boost::noncopyable {
+        public:
+            virtual ~ThreadState() {}
+        };
+        virtual ThreadState* newThreadState() { return 0; }
+        virtual void attach( ThreadState* s ) { }
+        virtual void detach( ThreadState* s ) { }
     };
 
     class MessageServer {
@@ -54,8 +70,14 @@ namespace mongo {
         struct Options {
             int port;                   // port to bind to
             string ipList;             // addresses to bind to
+            int workerThreads;         // 0: a thread per connection.  otherwise idle connections 
+                                       // are watched by one epoll thread, and each message is 
+                                       // processed by one of this many threads.  linux only.
+                                       // requests that block (fsyncLock, getLastError w:N, 
+                                       // awaitData) hold a thread, and the pool grows when all 
+                                       // are held; it does not shrink back.
 
-            Options() : port(0), ipList("") {}
+            Options() : port(0), ipList(""), workerThreads(0) {}
         };
 
         virtual ~MessageServer() {}
@@ -28,10 +28,12 @@
 #include "../../db/lasterror.h"
 #include "../../db/stats/counters.h"
 #include "mongo/util/concurrency/remap_lock.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/concurrency/ticketholder.h"
 
 #ifdef __linux__  // TODO: consider making this ifndef _WIN32
 # include <sys/resource.h>
+# include <sys/epoll.h>
 #endif
 
 namespace mongo {
@@ -111,10 +113,18 @@ namespace mongo {
         PortMessageServer(  const MessageServer::Options& opts, MessageHandler * handler ) :
             Listener( "" , opts.ipList, opts.port ) {
 
-            uassert( 10275 ,  "multiple PortMessageServer not supported" , ! pms::handler );
+            uassert( 10275 ,  "multiple PortMessageServer not supported" , ! pms::handler || pms::handler == handler );
             pms::handler = handler;
         }
 
+    protected:
+        /** for servers that don't run pms::threadRun, so may have a handler of their own */
+        explicit PortMessageServer( const MessageServer::Options& opts ) :
+            Listener( "" , opts.ipList, opts.port ) {
+        }
+
+    public:
+
         virtual void acceptedMP(MessagingPort * p) {
 
             if ( ! connTicketHolder.tryAcquire() ) {
@@ -202,7 +212,400 @@ namespace mongo {
     };
 
 
+#ifdef __linux__
+    /** a connection of an EventMessageServer.  between messages it is watched by the io 
+        thread, which reads the next message into m; a worker thread then processes it.  only 
+        one of them touches it at a time (the socket is registered EPOLLONESHOT).
+    */
+    struct EventConnection : boost::noncopyable {
+        EventConnection( MessagingPort *p ) :
+            port( p ), le( new LastError() ), state( 0 ), md( 0 ), len( 0 ), have( 0 ),
+            registered( false ), dispatched( false ) { }
+        ~EventConnection() {
+            delete state;
+            if ( md )
+                RecvBufferPool::release( md );
+        }
+
+        scoped_ptr<MessagingPort> port;
+        LastError *le;                            // owned by lastError while attached
+        MessageHandler::ThreadState *state;       // the handler's thread locals, when detached
+        string threadName;                        // "connNNN", to log as while attached
+
+        // the message being read
+        char lenbuf[4];
+        MsgData *md;
+        int len;
+        int have;
+        Message m;
+
+        bool registered; // with epoll.  set under _m, before the socket is armed
+        bool dispatched; // to a worker
+    };
+
+    /** serves connections with one epoll thread and a pool of worker threads, rather than with
+        a thread per connection.  idle connections then cost a little memory and no thread.
+        thread local per connection state is moved on and off the worker threads with
+        MessageHandler::attach/detach.
+        a request that blocks -- fsyncLock and the reads waiting on it, getLastError with w or
+        wtimeout, an awaitData getMore -- holds its worker while it waits.  when every worker
+        is held and queued requests have not moved for StallMillis the pool grows by a thread,
+        so a request that would unblock the others (an fsyncUnlock, say) still runs.
+    */
+    class EventMessageServer : public PortMessageServer {
+    public:
+        EventMessageServer( const MessageServer::Options& opts, MessageHandler * handler ) :
+            PortMessageServer( opts ),
+            _handler( handler ),
+            _workers( opts.workerThreads ),
+            _m( "EventMessageServer" ),
+            _queued( 0 ),
+            _lastStart( 0 ) {
+#ifdef MONGO_SSL
+            uassert( 16380, "ssl is not supported with worker threads", ! cmdLine.sslOnNormalPorts );
+#endif
+            _epfd = epoll_create( 1024 );
+            massert( 16381, str::stream() << "epoll_create failed: " << errnoWithDescription(), _epfd >= 0 );
+        }
+
+        virtual void acceptedMP( MessagingPort * p ) {
+            if ( ! connTicketHolder.tryAcquire() ) {
+                log() << "connection refused because too many open connections: " << connTicketHolder.used() << endl;
+                p->shutdown();
+                delete p;
+                sleepmillis(2); // otherwise we'll hard loop
+                return;
+            }
+
+            EventConnection *c = new EventConnection( p );
+            {
+                scoped_lock lk( _m );
+                _connections.insert( c );
+                c->dispatched = true;
+            }
+            schedule( &EventMessageServer::connect, c );
+        }
+
+        void run() {
+            boost::thread io( boost::bind( &EventMessageServer::ioThread, this ) );
+            initAndListen();
+        }
+
+    private:
+        enum ReadResult { ReadMore, ReadMessage, ReadDone };
+        enum { StallMillis = 500 };
+        typedef void (EventMessageServer::*WorkerTask)( EventConnection* );
+
+        /** make c's thread locals current on this thread */
+        void attach( EventConnection *c ) {
+            setThreadName( c->threadName.c_str() );
+            lastError.reset( c->le );
+            _handler->attach( c->state );
+        }
+
+        void detach( EventConnection *c ) {
+            _handler->detach( c->state );
+            lastError.release();
+            c->threadName = getThreadName();
+            setThreadName( "netWorker" );
+        }
+
+        /** watch c for its next message.  once armed c may be handed to a worker and even be
+            deleted at any moment, so nothing here touches it after a successful epoll_ctl.
+            @return false if c's socket is gone
+        */
+        bool arm( EventConnection *c ) {
+            int fd = c->port->psock->rawFD();
+            if ( fd < 0 )
+                return false;
+            struct epoll_event ev;
+            memset( &ev, 0, sizeof(ev) );
+            ev.events = EPOLLIN | EPOLLONESHOT;
+            ev.data.ptr = c;
+            bool wasRegistered;
+            {
+                scoped_lock lk( _m );
+                wasRegistered = c->registered;
+                c->registered = true;
+                c->dispatched = false;
+            }
+            if ( epoll_ctl( _epfd, wasRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev ) != 0 ) {
+                log(1) << "epoll_ctl failed " << errnoWithDescription() << endl;
+                scoped_lock lk( _m );
+                c->registered = wasRegistered;
+                c->dispatched = true;
+                return false;
+            }
+            return true;
+        }
+
+        /** hand c to a worker */
+        void dispatch( EventConnection *c, WorkerTask f ) {
+            {
+                scoped_lock lk( _m );
+                c->dispatched = true;
+            }
+            schedule( f, c );
+        }
+
+        void schedule( WorkerTask f, EventConnection *c ) {
+            {
+                scoped_lock lk( _m );
+                if ( _queued++ == 0 )
+                    _lastStart = curTimeMillis64();
+            }
+            _workers.schedule( &EventMessageServer::start, this, f, c );
+        }
+
+        // --- worker thread tasks ---
+
+        /** every task starts here, so the io thread can tell when the workers are stalled */
+        void start( WorkerTask f, EventConnection *c ) {
+            {
+                scoped_lock lk( _m );
+                _queued--;
+                _lastStart = curTimeMillis64();
+            }
+            (this->*f)( c );
+        }
+
+        void connect( EventConnection *c ) {
+            c->port->psock->setLogLevel(1);
+            c->port->psock->postFork();
+            c->threadName = "conn";
+            c->state = _handler->newThreadState();
+            attach( c ); // with threadName "conn" this assigns the connection its number
+            bool ok = true;
+            try {
+                _handler->connected( c->port.get() );
+            }
+            catch ( const DBException& e ) {
+                log() << "DBException handling connect, closing client connection: " << e << endl;
+                ok = false;
+            }
+            detach( c );
+            if ( ! ok || ! arm( c ) )
+                disconnect( c );
+        }
+
+        void process( EventConnection *c ) {
+            attach( c );
+            bool ok = true;
+            try {
+                c->port->psock->clearCounters();
+                int bytesIn = c->m.header()->len; // read by the io thread, not through psock
+                _handler->process( c->m , c->port.get() , c->le );
+                networkCounter.hit( bytesIn , c->port->psock->getBytesOut() );
+            }
+            catch ( AssertionException& e ) {
+                log() << "AssertionException handling request, closing client connection: " << e << endl;
+                ok = false;
+            }
+            catch ( SocketException& e ) {
+                log() << "SocketException handling request, closing client connection: " << e << endl;
+                ok = false;
+            }
+            catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
+                log() << "DBException handling request, closing client connection: " << e << endl;
+                ok = false;
+            }
+            catch ( std::exception &e ) {
+                error() << "Uncaught std::exception: " << e.what() << ", terminating" << endl;
+                dbexit( EXIT_UNCAUGHT );
+            }
+            detach( c );
+            c->m.reset();
+            if ( ! ok || inShutdown() || ! arm( c ) )
+                disconnect( c );
+        }
+
+        void disconnect( EventConnection *c ) {
+            if ( ! cmdLine.quiet ) {
+                int conns = connTicketHolder.used()-1;
+                const char* word = (conns == 1 ? " connection" : " connections");
+                log() << "end connection " << c->port->psock->remoteString() << " (" << conns << word << " now open)" << endl;
+            }
+            int fd = c->port->psock->rawFD();
+            if ( c->registered && fd >= 0 )
+                epoll_ctl( _epfd, EPOLL_CTL_DEL, fd, 0 );
+            c->port->shutdown();
+
+            attach( c );
+            _handler->disconnected( c->port.get() );
+            detach( c );
+            delete c->le;
+
+            {
+                scoped_lock lk( _m );
+                _connections.erase( c );
+            }
+            delete c;
+            connTicketHolder.release();
+            setThreadName( "netWorker" );
+        }
+
+        // --- io thread ---
+
+        void ioThread() {
+            setThreadName( "netIO" );
+            const int N = 256;
+            struct epoll_event events[N];
+            while ( ! inShutdown() ) {
+                checkStalled();
+                int n = epoll_wait( _epfd, events, N, StallMillis );
+                if ( n < 0 ) {
+                    if ( errno != EINTR )
+                        log() << "epoll_wait failed " << errnoWithDescription() << endl;
+                    continue;
+                }
+                for ( int i = 0; i < n; i++ ) {
+                    EventConnection *c = (EventConnection *) events[i].data.ptr;
+                    switch ( read( c ) ) {
+                    case ReadMore:
+                        if ( ! arm( c ) )
+                            dispatch( c, &EventMessageServer::disconnect );
+                        break;
+                    case ReadMessage:
+                        dispatch( c, &EventMessageServer::process );
+                        break;
+                    case ReadDone:
+                        dispatch( c, &EventMessageServer::disconnect );
+                        break;
+                    }
+                }
+                if ( n == 0 )
+                    reapClosed();
+            }
+        }
+
+        /** add a worker if requests are queued and none has started for StallMillis, as then
+            every worker is likely blocked, perhaps on a request queued behind them.
+        */
+        void checkStalled() {
+            unsigned long long now = curTimeMillis64();
+            {
+                scoped_lock lk( _m );
+                if ( _queued == 0 || now - _lastStart < StallMillis )
+                    return;
+                _lastStart = now;
+            }
+            log() << "all " << _workers.nThreads() << " network worker threads are blocked, adding one" << endl;
+            _workers.addThreads( 1 );
+        }
+
+        /** sockets closed under us, e.g. by MessagingPort::closeAllSockets(), drop out of epoll 
+            without an event.  find those connections and finish them. 
+        */
+        void reapClosed() {
+            vector<EventConnection*> closed;
+            {
+                scoped_lock lk( _m );
+                for ( set<EventConnection*>::iterator i = _connections.begin(); i != _connections.end(); ++i ) {
+                    if ( ! (*i)->dispatched && (*i)->port->psock->rawFD() < 0 ) {
+                        (*i)->dispatched = true;
+                        closed.push_back( *i );
+                    }
+                }
+            }
+            for ( unsigned i = 0; i < closed.size(); i++ )
+                schedule( &EventMessageServer::disconnect, closed[i] );
+        }
+
+        /** read what is available of c's next message without blocking.
+            same framing and special cases as MessagingPort::recv().
+        */
+        ReadResult read( EventConnection *c ) {
+            Socket& sock = *c->port->psock;
+            while ( 1 ) {
+                char *buf;
+                int want;
+                if ( c->md == 0 ) {
+                    buf = c->lenbuf + c->have;
+                    want = 4 - c->have;
+                }
+                else {
+                    buf = ((char *) c->md) + c->have;
+                    want = c->len - c->have;
+                }
+
+                int ret = ::recv( sock.rawFD(), buf, want, MSG_DONTWAIT );
+                if ( ret == 0 ) {
+                    log(3) << "Socket recv() conn closed? " << sock.remoteString() << endl;
+                    return ReadDone;
+                }
+                if ( ret < 0 ) {
+                    int e = errno;
+                    if ( e == EINTR )
+                        continue;
+                    if ( e == EAGAIN || e == EWOULDBLOCK )
+                        return ReadMore;
+                    log(1) << "Socket recv() " << errnoWithDescription(e) << ' ' << sock.remoteString() << endl;
+                    return ReadDone;
+                }
+
+                c->have += ret;
+                if ( c->md == 0 ) {
+                    if ( c->have < 4 )
+                        continue;
+                    int len = little<int>::ref( c->lenbuf );
+                    if ( len < 16 || len > MaxMessageSizeBytes ) { // messages must be large enough for headers
+                        if ( len == -1 ) {
+                            // Endian check from the client, after connecting, to see what mode server is running in.
+                            unsigned foo = 0x10203040;
+                            c->port->send( (char *) &foo, 4, "endian" );
+                            c->have = 0;
+                            continue;
+                        }
+                        if ( len == 542393671 ) {
+                            // an http GET
+                            log( sock.getLogLevel() ) << "looks like you're trying to access db over http on native driver port.  please add 1000 for webserver" << endl;
+                            string msg = "You are trying to access MongoDB on the native driver port. For http diagnostic access, add 1000 to the port number\n";
+                            stringstream ss;
+                            ss << "HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type: text/plain\r\nContent-Length: " << msg.size() << "\r\n\r\n" << msg;
+                            string s = ss.str();
+                            c->port->send( s.c_str(), s.size(), "http" );
+                            return ReadDone;
+                        }
+                        log(0) << "recv(): message len " << len << " is too large" << len << endl;
+                        return ReadDone;
+                    }
+                    try {
+                        c->md = c->port->recvBufferPool().get( len );
+                    }
+                    catch ( DBException& e ) {
+                        log() << "recv(): " << e.toString() << ' ' << sock.remoteString() << endl;
+                        return ReadDone;
+                    }
+                    c->md->len = len;
+                    c->len = len;
+                    continue;
+                }
+
+                if ( c->have == c->len ) {
+                    c->m.setData( c->md, &RecvBufferPool::release );
+                    c->md = 0;
+                    c->have = 0;
+                    return ReadMessage;
+                }
+            }
+        }
+
+        MessageHandler *_handler;
+        ThreadPool _workers;
+        int _epfd;
+        mongo::mutex _m; // protects the members below and EventConnection::dispatched
+        set<EventConnection*> _connections;
+        int _queued;                     // tasks scheduled and not yet started
+        unsigned long long _lastStart;   // when a task last started, or the queue last filled
+
+    };
+#endif
+
     MessageServer * createServer( const MessageServer::Options& opts , MessageHandler * handler ) {
+#ifdef __linux__
+        if ( opts.workerThreads > 0 )
+            return new EventMessageServer( opts , handler );
+#endif
         return new PortMessageServer( opts , handler );
     }
 
@@ -726,7 +726,7 @@ namespace mongo {
         struct msghdr meta;
         memset( &meta, 0, sizeof( meta ) );
         meta.msg_iov = &d[ 0 ];
-        meta.msg_iovlen = d.size();
+        meta.msg_iovlen = i; // the empty buffers were skipped
 
         while( meta.msg_iovlen > 0 ) {
             int ret = ::sendmsg( _fd , &meta , portSendFlags );
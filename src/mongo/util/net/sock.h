@@ -212,6 +212,9 @@ namespace mongo {
 
         bool stillConnected();
 
+        /** the file descriptor, for event loops that watch it.  -1 once closed. */
+        int rawFD() const { return _fd; }
+
 #ifdef MONGO_SSL
         /** secures inline */
         void secure( SSLManager * ssl );
@@ -104,6 +104,21 @@ namespace mongo {
 
         static bool blockInMemory( char * start );
 
+        /** the size of the os's pages, the unit pagesInMemory() answers in */
+        static unsigned long pageSize();
+
+        /**
+         * one call for a run of pages, rather than blockInMemory() for each
+         * @param out set to 1 for each of the numPages pages starting with start's that is in 
+         *            memory, 0 for each that isn't
+         * @return false if it couldn't be told, e.g. as part of the range isn't mapped
+         */
+        static bool pagesInMemory( const void * start , unsigned numPages , char * out );
+
+        /** ask the os to read [start, start+len) in ahead of its use.  best effort: a no-op where
+            that isn't supported or the range isn't mapped. */
+        static void willNeed( const void * start , size_t len );
+
     private:
         /**
          * Host and operating system info.  Does not change over time.
@@ -464,5 +464,31 @@ namespace mongo {
         return x & 0x1;
     }
 
+    unsigned long ProcessInfo::pageSize() {
+        static long pageSize = sysconf( _SC_PAGESIZE );
+        return pageSize;
+    }
+
+    bool ProcessInfo::pagesInMemory( const void * start , unsigned numPages , char * out ) {
+        const unsigned long long pageSize = ProcessInfo::pageSize();
+        char * p = (char *) start - ( (unsigned long long) start % pageSize );
+        if ( mincore( p , numPages * pageSize , (unsigned char *) out ) ) {
+            // ENOMEM just means part of the range isn't mapped
+            if ( errno != ENOMEM )
+                log() << "mincore failed: " << errnoWithDescription() << endl;
+            return false;
+        }
+        for ( unsigned i = 0; i < numPages; i++ )
+            out[i] &= 0x1;
+        return true;
+    }
+
+    void ProcessInfo::willNeed( const void * start , size_t len ) {
+        static long pageSize = sysconf( _SC_PAGESIZE );
+        char * p = (char *) start - ( (unsigned long long) start % pageSize );
+        // a range that is partly unmapped gets ENOMEM, but the mapped part is still read ahead
+        madvise( p , len + ( (char *) start - p ) , MADV_WILLNEED );
+    }
+
 
 }
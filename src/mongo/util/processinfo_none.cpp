@@ -62,4 +62,15 @@ namespace mongo {
         return true;
     }
 
+    unsigned long ProcessInfo::pageSize() {
+        return 4096;
+    }
+
+    bool ProcessInfo::pagesInMemory( const void * start , unsigned numPages , char * out ) {
+        return false;
+    }
+
+    void ProcessInfo::willNeed( const void * start , size_t len ) {
+    }
+
 }
@@ -223,4 +223,31 @@ namespace mongo {
         return false;
     }
 
+    unsigned long ProcessInfo::pageSize() {
+        static unsigned long pageSize = 0;
+        if ( pageSize == 0 ) {
+            SYSTEM_INFO si;
+            GetSystemInfo( &si );
+            pageSize = si.dwPageSize;
+        }
+        return pageSize;
+    }
+
+    bool ProcessInfo::pagesInMemory( const void * start , unsigned numPages , char * out ) {
+        const unsigned long long pageSize = ProcessInfo::pageSize();
+        char * p = (char *) start - ( (unsigned long long) start % pageSize );
+        vector<PSAPI_WORKING_SET_EX_INFORMATION> wsinfo( numPages );
+        for ( unsigned i = 0; i < numPages; i++ )
+            wsinfo[i].VirtualAddress = p + i * pageSize;
+        if ( ! psapiGlobal.QueryWSEx( GetCurrentProcess(), &wsinfo[0], numPages * sizeof(wsinfo[0]) ) )
+            return false;
+        for ( unsigned i = 0; i < numPages; i++ )
+            out[i] = wsinfo[i].VirtualAttributes.Valid ? 1 : 0;
+        return true;
+    }
+
+    void ProcessInfo::willNeed( const void * start , size_t len ) {
+        // PrefetchVirtualMemory() is windows 8 and later only
+    }
+
 }
@@ -27,13 +27,16 @@ namespace mongo {
 
     /**
      * simple blocking queue
+     * with a maxSize, push() blocks while the queue is full
      */
     template<typename T> class BlockingQueue : boost::noncopyable {
     public:
-        BlockingQueue() : _lock("BlockingQueue") { }
+        explicit BlockingQueue( size_t maxSize = 0 ) : _maxSize( maxSize ) , _lock("BlockingQueue") { }
 
         void push(T const& t) {
             scoped_lock l( _lock );
+            while( _maxSize && _queue.size() >= _maxSize )
+                _notFull.wait( l.boost() );
             _queue.push( t );
             _condition.notify_one();
         }
@@ -56,6 +59,7 @@ namespace mongo {
 
             t = _queue.front();
             _queue.pop();
+            _notFull.notify_one();
 
             return true;
         }
@@ -68,6 +72,7 @@ namespace mongo {
 
             T t = _queue.front();
             _queue.pop();
+            _notFull.notify_one();
             return t;
         }
 
@@ -93,14 +98,17 @@ namespace mongo {
 
             t = _queue.front();
             _queue.pop();
+            _notFull.notify_one();
             return true;
         }
 
     private:
         std::queue<T> _queue;
+        const size_t _maxSize;
 
         mutable mongo::mutex _lock;
         boost::condition _condition;
+        boost::condition _notFull;
     };
 
 }